@@ -152,23 +152,15 @@ void CFG_CloseConfig (void)
 
 int CFG_OpenConfig (const char *cfg_name)
 {
-	FILE	*f;
-	long		length;
-	qboolean	pak;
-
 	CFG_CloseConfig ();
 
-	length = (long) COM_FOpenFile (cfg_name, &f, NULL);
-	pak = file_from_pak;
-	if (length == -1)
-		return -1;
-
 	cfg_file = (fshandle_t *) Z_Malloc(sizeof(fshandle_t));
-	cfg_file->file = f;
-	cfg_file->start = ftell(f);
-	cfg_file->pos = 0;
-	cfg_file->length = length;
-	cfg_file->pak = pak;
+	if (FS_fopen (cfg_name, cfg_file, NULL) == -1)
+	{
+		Z_Free (cfg_file);
+		cfg_file = NULL;
+		return -1;
+	}
 
 	return 0;
 }
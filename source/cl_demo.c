@@ -293,6 +293,7 @@ void CL_Record_f (void)
 		Con_Printf ("ERROR: couldn't create %s\n", name);
 		return;
 	}
+	COM_FileCreated (name);
 
 	cls.forcetrack = track;
 	fprintf (cls.demofile, "%i\n", cls.forcetrack);
@@ -651,6 +651,8 @@ void CL_SendMove (const usercmd_t *cmd)
 //
 // send the movement message
 //
+	CL_WriteMoveSequence (&buf);
+
 	MSG_WriteByte (&buf, clc_move);
 
 	MSG_WriteFloat (&buf, cl.mtime[0]);	// so server can get ping times
@@ -727,7 +729,10 @@ void CL_SendMove (const usercmd_t *cmd)
 	{
 		Con_Printf ("CL_SendMove: lost server connection\n");
 		CL_Disconnect ();
+		return;
 	}
+
+	CL_RecordMove (cmd, tempv);
 }
 
 /*
@@ -0,0 +1,310 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_lerp.c -- jitter buffered entity interpolation
+//
+// CL_LerpPoint only knows the last two server messages, so a late packet
+// makes entities stall and a burst makes them jump. Instead every entity
+// update is kept in a short per-entity history, and entities are drawn at a
+// render clock running a little behind the newest snapshot. The delay is
+// either fixed (cl_interp) or follows the measured packet interval and
+// arrival jitter, so that there is normally a snapshot on both sides of
+// the render time.
+
+#include "quakedef.h"
+
+cvar_t	cl_lerpbuffer = {"cl_lerpbuffer", "1", CVAR_ARCHIVE};
+cvar_t	cl_interp = {"cl_interp", "0", CVAR_ARCHIVE};			// fixed delay in seconds, 0 = adaptive
+cvar_t	cl_interp_max = {"cl_interp_max", "0.25", CVAR_ARCHIVE};	// upper bound for the adaptive delay
+
+#define	LERP_SNAPS		16		// snapshots kept per entity, must be a power of 2
+#define	LERP_MASK		(LERP_SNAPS-1)
+#define	LERP_JITTERSCALE	2	// adaptive delay = interval + jitter * this
+
+typedef struct
+{
+	double	time;			// server time of the message
+	vec3_t	origin;
+	vec3_t	angles;
+} entsnap_t;
+
+typedef struct
+{
+	int			head;		// newest snapshot
+	int			count;
+	entsnap_t	snaps[LERP_SNAPS];
+} entlerp_t;
+
+static entlerp_t	*cl_entlerp;		// grown on demand, indexed by entity number
+static int			cl_entlerp_size;
+
+static struct
+{
+	double	lastservertime;		// newest svc_time
+	double	lastarrival;		// realtime it arrived
+	double	lastrealtime;		// realtime of the last render clock update
+	double	clock;				// server time entities are drawn at
+	float	interval;			// average time between server messages
+	float	jitter;				// average arrival time deviation
+	float	delay;				// current render delay
+	qboolean	active;			// the buffer drives entities this frame
+	int		snapshots;
+	int		underruns;			// frames the clock ran past the newest snapshot
+	int		resyncs;
+} lerp;
+
+/*
+==================
+CL_LerpBufferSnapshot
+
+Called for every svc_time, i.e. once per server message
+==================
+*/
+void CL_LerpBufferSnapshot (double servertime)
+{
+	float	dserver, darrival, d;
+
+	if (lerp.snapshots)
+	{
+		dserver = servertime - lerp.lastservertime;
+		darrival = realtime - lerp.lastarrival;
+		if (dserver > 0 && dserver < 1)
+		{
+			lerp.interval += (dserver - lerp.interval) * 0.1;
+		// interarrival jitter estimate as in RFC 3550
+			d = fabs (darrival - dserver);
+			lerp.jitter += (d - lerp.jitter) / 16;
+		}
+	}
+	else
+	{
+		lerp.interval = 0.05;
+		lerp.jitter = 0;
+	}
+
+	lerp.lastservertime = servertime;
+	lerp.lastarrival = realtime;
+	lerp.snapshots++;
+}
+
+/*
+==================
+CL_LerpBufferUpdate
+
+Called for every entity update, after its msg_origins[0]/msg_angles[0]
+have been read. reset drops the history, e.g. after a model change.
+==================
+*/
+void CL_LerpBufferUpdate (int num, entity_t *ent, qboolean reset)
+{
+	entlerp_t	*el;
+	entsnap_t	*snap;
+	int			newsize;
+
+	if (num >= cl_entlerp_size)
+	{
+		newsize = (num + 64) & ~63;
+		cl_entlerp = (entlerp_t *) realloc (cl_entlerp, newsize * sizeof(entlerp_t));
+		if (!cl_entlerp)
+			Sys_Error ("CL_LerpBufferUpdate: out of memory");
+		memset (cl_entlerp + cl_entlerp_size, 0, (newsize - cl_entlerp_size) * sizeof(entlerp_t));
+		cl_entlerp_size = newsize;
+	}
+
+	el = &cl_entlerp[num];
+	if (reset)
+		el->count = 0;
+	else if (el->count && el->snaps[el->head].time >= cl.mtime[0])
+	{	// several updates for the same message, keep the last one
+		snap = &el->snaps[el->head];
+		VectorCopy (ent->msg_origins[0], snap->origin);
+		VectorCopy (ent->msg_angles[0], snap->angles);
+		return;
+	}
+
+	el->head = (el->head + 1) & LERP_MASK;
+	if (el->count < LERP_SNAPS)
+		el->count++;
+
+	snap = &el->snaps[el->head];
+	snap->time = cl.mtime[0];
+	VectorCopy (ent->msg_origins[0], snap->origin);
+	VectorCopy (ent->msg_angles[0], snap->angles);
+}
+
+/*
+==================
+CL_LerpBufferFrame
+
+Advances the render clock. Returns false if entities should use the old
+two message interpolation this frame.
+==================
+*/
+qboolean CL_LerpBufferFrame (void)
+{
+	double	target, frametime;
+	float	maxdelay;
+
+	lerp.active = false;
+	frametime = realtime - lerp.lastrealtime;
+	lerp.lastrealtime = realtime;
+
+	if (!cl_lerpbuffer.value || cl_nolerp.value || sv.active || cls.demoplayback || lerp.snapshots < 2)
+	{
+		lerp.clock = 0;
+		return false;
+	}
+
+	maxdelay = CLAMP (0, cl_interp_max.value, 1);
+	if (cl_interp.value > 0)
+		lerp.delay = q_min (cl_interp.value, 1);
+	else
+	{	// follow the adaptive delay slowly so the clock doesn't surge
+		target = lerp.interval + lerp.jitter * LERP_JITTERSCALE;
+		target = CLAMP (0, target, maxdelay);
+		lerp.delay += (target - lerp.delay) * CLAMP (0, frametime, 1);
+	}
+
+// where the server is now, as far as we can tell, minus the delay
+	target = lerp.lastservertime + q_min (realtime - lerp.lastarrival, maxdelay) - lerp.delay;
+
+	lerp.clock += frametime;
+	if (!lerp.clock || fabs (target - lerp.clock) > 0.5)
+	{	// first frame, or way off after a stall
+		lerp.clock = target;
+		lerp.resyncs++;
+	}
+	else	// slew towards the target rather than jumping
+		lerp.clock += (target - lerp.clock) * CLAMP (0, frametime * 4, 1);
+
+	if (lerp.clock > lerp.lastservertime)
+	{
+		lerp.clock = lerp.lastservertime;
+		lerp.underruns++;
+	}
+
+	lerp.active = true;
+	return true;
+}
+
+/*
+==================
+CL_LerpBufferEntity
+
+Sets ent->origin and ent->angles from the two buffered snapshots around
+the render clock. Returns false if the entity has no history. With step
+set (r_lerpmove will smooth it) or across a teleport the older snapshot
+is used as is.
+==================
+*/
+qboolean CL_LerpBufferEntity (int num, entity_t *ent, qboolean step)
+{
+	entlerp_t	*el;
+	entsnap_t	*from, *to;
+	int			i, j;
+	float		f, d;
+
+	if (!lerp.active || num >= cl_entlerp_size)
+		return false;
+	el = &cl_entlerp[num];
+	if (!el->count)
+		return false;
+
+// find the newest snapshot at or before the clock
+	to = NULL;
+	from = &el->snaps[el->head];
+	for (i = 1; i < el->count && from->time > lerp.clock; i++)
+	{
+		to = from;
+		from = &el->snaps[(el->head - i) & LERP_MASK];
+	}
+
+	if (!to || from->time > lerp.clock || step)
+	{
+		VectorCopy (from->origin, ent->origin);
+		VectorCopy (from->angles, ent->angles);
+		return true;
+	}
+
+	f = (lerp.clock - from->time) / (to->time - from->time);
+	for (j = 0; j < 3; j++)
+	{
+		d = to->origin[j] - from->origin[j];
+		if (d > 100 || d < -100)
+			f = 0;		// assume a teleportation, not a motion
+	}
+
+	for (j = 0; j < 3; j++)
+	{
+		ent->origin[j] = from->origin[j] + f * (to->origin[j] - from->origin[j]);
+
+		d = to->angles[j] - from->angles[j];
+		if (d > 180)
+			d -= 360;
+		else if (d < -180)
+			d += 360;
+		ent->angles[j] = from->angles[j] + f * d;
+	}
+
+	return true;
+}
+
+/*
+==================
+CL_LerpStats_f
+==================
+*/
+static void CL_LerpStats_f (void)
+{
+	Con_Printf ("lerp buffer: %s\n", lerp.active ? "active" : "off");
+	Con_Printf ("interval   : %.1f ms\n", lerp.interval * 1000);
+	Con_Printf ("jitter     : %.1f ms\n", lerp.jitter * 1000);
+	Con_Printf ("delay      : %.1f ms\n", lerp.delay * 1000);
+	Con_Printf ("behind     : %.1f ms\n", (lerp.lastservertime - lerp.clock) * 1000);
+	Con_Printf ("snapshots  : %i\n", lerp.snapshots);
+	Con_Printf ("underruns  : %i\n", lerp.underruns);
+	Con_Printf ("resyncs    : %i\n", lerp.resyncs);
+}
+
+/*
+==================
+CL_ClearLerpBuffer
+==================
+*/
+void CL_ClearLerpBuffer (void)
+{
+	if (cl_entlerp)
+		memset (cl_entlerp, 0, cl_entlerp_size * sizeof(entlerp_t));
+	memset (&lerp, 0, sizeof(lerp));
+}
+
+/*
+==================
+CL_InitLerpBuffer
+==================
+*/
+void CL_InitLerpBuffer (void)
+{
+	Cvar_RegisterVariable (&cl_lerpbuffer);
+	Cvar_RegisterVariable (&cl_interp);
+	Cvar_RegisterVariable (&cl_interp_max);
+
+	Cmd_AddCommand ("lerpstats", CL_LerpStats_f);
+}
@@ -83,6 +83,8 @@ void CL_ClearState (void)
 
 // wipe the entire cl structure
 	memset (&cl, 0, sizeof(cl));
+	CL_ClearPrediction ();
+	CL_ClearLerpBuffer ();
 
 	SZ_Clear (&cls.message);
 
@@ -208,6 +210,12 @@ void CL_SignonReply (void)
 		MSG_WriteByte (&cls.message, clc_stringcmd);
 		sprintf (str, "spawn %s", cls.spawnparms);
 		MSG_WriteString (&cls.message, str);
+
+		if (cl_predict.value && !sv.active)
+		{
+			MSG_WriteByte (&cls.message, clc_stringcmd);
+			MSG_WriteString (&cls.message, "predict");
+		}
 		break;
 
 	case 3:
@@ -491,12 +499,16 @@ void CL_RelinkEntities (void)
 	vec3_t		delta;
 	vec3_t		oldorg;
 	dlight_t	*dl;
+	qboolean	lerpbuffer;
 
 // determine partial update time
 	frac = CL_LerpPoint ();
+	lerpbuffer = CL_LerpBufferFrame ();
 
 	CL_UpdatePowerUpAngles();
 
+	CL_PredictMove ();
+
 	cl_numvisedicts = 0;
 
 //
@@ -543,7 +555,12 @@ void CL_RelinkEntities (void)
 
 		VectorCopy (ent->origin, oldorg);
 
-		if (ent->forcelink)
+		if (lerpbuffer && i != cl.viewentity &&
+			CL_LerpBufferEntity (i, ent, r_lerpmove.value && (ent->lerpflags & LERP_MOVESTEP)))
+		{	// drawn from the jitter buffer, a little behind the newest message. Not
+			// the local player, the camera would lag behind the player's input
+		}
+		else if (ent->forcelink)
 		{	// the entity was not updated in the last message
 			// so move to the final spot
 			VectorCopy (ent->msg_origins[0], ent->origin);
@@ -578,6 +595,10 @@ void CL_RelinkEntities (void)
 			}
 		}
 
+// the local player goes where its own unacknowledged moves put it
+		if (i == cl.viewentity)
+			CL_PredictedOrigin (ent->origin, cl.velocity);
+
 // rotate binary objects locally
 		if (ent->model->flags & EF_ROTATE) {
 			ent->angles[0] = mdlflag_poweruprotate_currentangles[0];
@@ -1072,6 +1093,9 @@ void CL_Init (void)
 	Cvar_RegisterVariable (&cl_maxpitch); //johnfitz -- variable pitch clamping
 	Cvar_RegisterVariable (&cl_minpitch); //johnfitz -- variable pitch clamping
 
+	CL_InitPrediction ();
+	CL_InitLerpBuffer ();
+
 	Cmd_AddCommand ("entities", CL_PrintEntities_f);
 	Cmd_AddCommand ("disconnect", CL_Disconnect_f);
 	Cmd_AddCommand ("record", CL_Record_f);
@@ -91,7 +91,12 @@ const char *svc_strings[] =
 	"svc_bspdecal",   // 50     // [string] name [byte] decal_size [coords] pos
 	"svc_limbupdate", // 51
     "svc_achievement", // 52
-    "svc_updatekills"  // 53
+    "svc_updatekills", // 53
+	"svc_screenflash", // 54
+	"svc_lockviewmodel", // 55
+	"svc_rumble", // 56
+	"svc_movevars", // 57
+	"svc_moveack" // 58
 
 //johnfitz
 };
@@ -296,6 +301,7 @@ void CL_ParseServerInfo (void)
 	const char	*str;
 	int		i;
 	int		nummodels, numsounds;
+	double	start, waited, modeltime, soundtime;
 	char	model_precache[MAX_MODELS][MAX_QPATH];
 	char	sound_precache[MAX_SOUNDS][MAX_QPATH];
 
@@ -402,8 +408,15 @@ void CL_ParseServerInfo (void)
 	//johnfitz
 
 //
-// now we try to load everything else until a cache allocation fails
+// now we try to load everything else until a cache allocation fails,
+// with the files read ahead of the loaders
 //
+	for (i = 1; i < nummodels; i++)
+		Mod_Prefetch (model_precache[i]);
+	for (i = 1; i < numsounds; i++)
+		S_PrefetchSound (sound_precache[i]);
+	start = Sys_PreciseTime ();
+	waited = COM_PrefetchWaitTime ();
 
 	loading_num_step = loading_num_step +nummodels + numsounds;
 	loading_step = 1;
@@ -426,6 +439,7 @@ void CL_ParseServerInfo (void)
 	}
 	
 	SCR_UpdateScreen ();
+	modeltime = Sys_PreciseTime () - start;
 	
 	loading_step = 4;
 
@@ -443,6 +457,10 @@ void CL_ParseServerInfo (void)
 	
 	SCR_UpdateScreen ();
    	Clear_LoadingFill ();
+	COM_PrefetchFlush ();
+	soundtime = Sys_PreciseTime () - start - modeltime;
+	Con_DPrintf ("Loaded %i models in %.1f ms, %i sounds in %.1f ms, %.1f ms waiting on reads\n",
+		nummodels - 1, modeltime * 1000, numsounds - 1, soundtime * 1000, (COM_PrefetchWaitTime () - waited) * 1000);
 
 // local state
 	cl_entities[0].model = cl.worldmodel = cl.model_precache[1];
@@ -693,6 +711,8 @@ void CL_ParseUpdate (int bits)
 		VectorCopy (ent->msg_angles[0], ent->angles);
 		ent->forcelink = true;
 	}
+
+	CL_LerpBufferUpdate (num, ent, forcelink);
 }
 
 /*
@@ -1332,6 +1352,7 @@ void CL_ParseServerMessage (void)
 		case svc_time:
 			cl.mtime[1] = cl.mtime[0];
 			cl.mtime[0] = MSG_ReadFloat ();
+			CL_LerpBufferSnapshot (cl.mtime[0]);
 			break;
 
 		case svc_clientdata:
@@ -1621,6 +1642,14 @@ void CL_ParseServerMessage (void)
 			IN_StartRumble((int)MSG_ReadShort(), (int)MSG_ReadShort(), (int)MSG_ReadShort());
 			break;
 
+		case svc_movevars:
+			CL_ParseMoveVars ();
+			break;
+
+		case svc_moveack:
+			CL_ParseMoveAck ();
+			break;
+
 		case svc_screenflash:
 			screenflash_color = MSG_ReadByte();
 			screenflash_duration = sv.time + MSG_ReadByte();
@@ -0,0 +1,383 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_pred.c -- client side movement prediction
+//
+// When cl_predict is set the client asks the server for "predict" during
+// signon. From then on each clc_move we send is preceded by a clc_moveseq,
+// and every update carries a svc_moveack saying which move the player state
+// includes and exactly where it left us. Every frame we start from that
+// authoritative state and replay the moves the server hasn't seen yet through
+// the same pmove code the server runs, so the local player responds to input
+// without waiting a round trip. Mispredictions are blended out over
+// cl_predict_smooth seconds instead of snapping the view.
+//
+// NetQuake servers apply the latest usercmd once per server frame rather than
+// once per command, so replaying each move for the client frame it was
+// issued in is an approximation; the smoothing hides the small differences.
+
+#include "quakedef.h"
+
+cvar_t	cl_predict = {"cl_predict", "1", CVAR_ARCHIVE};
+cvar_t	cl_predict_smooth = {"cl_predict_smooth", "0.1", CVAR_ARCHIVE};
+cvar_t	cl_predict_showerror = {"cl_predict_showerror", "0", CVAR_NONE};
+
+#define	PRED_BACKUP		64		// moves kept for replay, must be a power of 2
+#define	PRED_MASK		(PRED_BACKUP-1)
+#define	PRED_MAXERROR	64		// bigger corrections are teleports, not errors
+
+typedef struct
+{
+	usercmd_t	cmd;			// viewangles are what was sent to the server
+	float		frametime;
+	vec3_t		origin;			// where the last replay put us after this move
+	qboolean	predicted;
+} predmove_t;
+
+static struct
+{
+	qboolean	active;			// server sent svc_movevars
+	qboolean	acked;			// and at least one svc_moveack
+	movevars_t	movevars;
+
+	int			outgoing;		// sequence of the last move sent
+	int			incoming;		// sequence of the last move acknowledged
+	predmove_t	moves[PRED_BACKUP];
+
+// player state after the acknowledged move
+	int			movetype;
+	int			flags;
+	int			waterlevel;
+	vec3_t		origin;
+	vec3_t		velocity;
+
+	vec3_t		error;			// misprediction still being blended out
+	vec3_t		predorigin;
+	vec3_t		predvelocity;
+	qboolean	valid;			// predorigin is usable this frame
+} pred;
+
+/*
+==================
+CL_PredictTrace
+
+pmove trace callback: the world plus any brush models (doors, platforms)
+in the last update. Other players and monsters are not clipped against.
+==================
+*/
+static void CL_ClipToBrushModel (qmodel_t *model, const vec3_t origin, const vec3_t start,
+		const vec3_t mins, const vec3_t maxs, const vec3_t end, pmtrace_t *pmtrace, qboolean first)
+{
+	trace_t		trace;
+	hull_t		*hull;
+	vec3_t		offset, start_l, end_l;
+
+	memset (&trace, 0, sizeof(trace));
+	trace.fraction = 1;
+	trace.allsolid = true;
+	VectorCopy (end, trace.endpos);
+
+	hull = SV_HullForBrushModel (model, (float *)mins, (float *)maxs);
+
+	VectorSubtract (hull->clip_mins, mins, offset);
+	VectorAdd (offset, origin, offset);
+	VectorSubtract (start, offset, start_l);
+	VectorSubtract (end, offset, end_l);
+
+	SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);
+
+	if (trace.fraction != 1)
+		VectorAdd (trace.endpos, offset, trace.endpos);
+
+	if (first || trace.allsolid || trace.startsolid || trace.fraction < pmtrace->fraction)
+	{
+		qboolean	wasstartsolid = !first && pmtrace->startsolid;
+
+		pmtrace->allsolid = trace.allsolid;
+		pmtrace->startsolid = trace.startsolid || wasstartsolid;
+		pmtrace->fraction = trace.fraction;
+		VectorCopy (trace.endpos, pmtrace->endpos);
+		VectorCopy (trace.plane.normal, pmtrace->normal);
+	}
+	else if (trace.startsolid)
+		pmtrace->startsolid = true;
+}
+
+static void CL_PredictTrace (const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, pmtrace_t *pmtrace)
+{
+	entity_t	*ent;
+	int			i;
+
+	CL_ClipToBrushModel (cl.worldmodel, vec3_origin, start, mins, maxs, end, pmtrace, true);
+	if (pmtrace->allsolid)
+		return;
+
+	for (i = 1, ent = cl_entities + 1; i < cl.num_entities; i++, ent++)
+	{
+		if (!ent->model || ent->model->type != mod_brush || ent->msgtime != cl.mtime[0])
+			continue;
+		if (i == cl.viewentity)
+			continue;
+		if (ent->msg_angles[0][0] || ent->msg_angles[0][1] || ent->msg_angles[0][2])
+			continue;	// rotated hulls are not supported
+		CL_ClipToBrushModel (ent->model, ent->msg_origins[0], start, mins, maxs, end, pmtrace, false);
+		if (pmtrace->allsolid)
+			return;
+	}
+}
+
+static int CL_PredictPointContents (const vec3_t p)
+{
+	int		cont;
+
+	cont = SV_HullPointContents (&cl.worldmodel->hulls[0], 0, (float *)p);
+	if (cont <= CONTENTS_CURRENT_0 && cont >= CONTENTS_CURRENT_DOWN)
+		cont = CONTENTS_WATER;
+	return cont;
+}
+
+/*
+==================
+CL_ParseMoveVars
+==================
+*/
+void CL_ParseMoveVars (void)
+{
+	movevars_t	*mv = &pred.movevars;
+	int			i;
+
+	mv->gravity = MSG_ReadFloat ();
+	mv->entgravity = MSG_ReadFloat ();
+	mv->friction = MSG_ReadFloat ();
+	mv->edgefriction = MSG_ReadFloat ();
+	mv->stopspeed = MSG_ReadFloat ();
+	mv->maxspeed = MSG_ReadFloat ();
+	mv->accelerate = MSG_ReadFloat ();
+	for (i = 0; i < 3; i++)
+		mv->mins[i] = MSG_ReadShort ();
+	for (i = 0; i < 3; i++)
+		mv->maxs[i] = MSG_ReadShort ();
+	mv->flags = MSG_ReadByte ();
+
+	pred.active = true;
+}
+
+/*
+==================
+CL_ParseMoveAck
+==================
+*/
+void CL_ParseMoveAck (void)
+{
+	int		i, seq;
+	int		movetype, flags, waterlevel;
+	vec3_t	origin, velocity, delta;
+	predmove_t	*move;
+
+	seq = MSG_ReadLong ();
+	movetype = MSG_ReadByte ();
+	flags = MSG_ReadByte ();
+	waterlevel = MSG_ReadByte ();
+	for (i = 0; i < 3; i++)
+		origin[i] = MSG_ReadFloat ();
+	for (i = 0; i < 3; i++)
+		velocity[i] = MSG_ReadFloat ();
+
+	if (!pred.active)
+		return;
+	if (pred.acked && seq < pred.incoming)
+		return;		// out of order datagram
+	if (seq > pred.outgoing)
+		seq = pred.outgoing;	// left over from before a reconnect
+
+// see how far off our guess for this move was, and carry that over so the
+// view doesn't jump when the replay starts from the corrected state
+	move = &pred.moves[seq & PRED_MASK];
+	if (pred.acked && seq > pred.incoming && pred.outgoing - seq < PRED_BACKUP && move->predicted)
+	{
+		VectorSubtract (move->origin, origin, delta);
+		VectorAdd (pred.error, delta, pred.error);
+		if (VectorLength (pred.error) > PRED_MAXERROR)
+			VectorClear (pred.error);
+
+		if (cl_predict_showerror.value && VectorLength (delta) > 0.5)
+			Con_Printf ("prediction error %i: %.1f %.1f %.1f\n", seq, delta[0], delta[1], delta[2]);
+	}
+
+	pred.acked = true;
+	pred.incoming = seq;
+	pred.movetype = movetype;
+	pred.flags = flags;
+	pred.waterlevel = waterlevel;
+	VectorCopy (origin, pred.origin);
+	VectorCopy (velocity, pred.velocity);
+}
+
+/*
+==================
+CL_WriteMoveSequence
+
+Tags the clc_move that follows with a sequence number the server will
+echo back in svc_moveack
+==================
+*/
+void CL_WriteMoveSequence (sizebuf_t *buf)
+{
+	if (!pred.active)
+		return;
+
+	MSG_WriteByte (buf, clc_moveseq);
+	MSG_WriteLong (buf, pred.outgoing + 1);
+}
+
+/*
+==================
+CL_RecordMove
+
+Called once the tagged move was actually sent
+==================
+*/
+void CL_RecordMove (const usercmd_t *cmd, const vec3_t sentangles)
+{
+	predmove_t	*move;
+
+	if (!pred.active)
+		return;
+
+	pred.outgoing++;
+	move = &pred.moves[pred.outgoing & PRED_MASK];
+	move->cmd = *cmd;
+	VectorCopy (sentangles, move->cmd.viewangles);
+	move->frametime = host_frametime;
+	move->predicted = false;
+}
+
+/*
+==================
+CL_PredictMove
+
+Replays every move the server hasn't acknowledged yet on top of the last
+acknowledged player state
+==================
+*/
+void CL_PredictMove (void)
+{
+	pmove_t		pm;
+	predmove_t	*move;
+	int			seq;
+	float		f;
+
+	pred.valid = false;
+
+	if (!cl_predict.value || !pred.active || !pred.acked)
+		return;
+	if (cls.demoplayback || sv.active || cl.intermission || cl.stats[STAT_HEALTH] <= 0)
+		return;
+	if (pred.flags & PMF_WATERJUMP)
+		return;
+	if (pred.movetype != MOVETYPE_WALK && pred.movetype != MOVETYPE_FLY && pred.movetype != MOVETYPE_NOCLIP)
+		return;
+	if (pred.outgoing - pred.incoming >= PRED_BACKUP)
+		return;		// too far behind to replay
+
+	memset (&pm, 0, sizeof(pm));
+	VectorCopy (pred.origin, pm.origin);
+	VectorCopy (pred.velocity, pm.velocity);
+	pm.flags = pred.flags;
+	pm.waterlevel = pred.waterlevel;
+	pm.movetype = pred.movetype;
+	pm.viewheight = cl.viewheight;
+	pm.movevars = &pred.movevars;
+	pm.trace = CL_PredictTrace;
+	pm.pointcontents = CL_PredictPointContents;
+
+	for (seq = pred.incoming + 1; seq <= pred.outgoing; seq++)
+	{
+		move = &pred.moves[seq & PRED_MASK];
+
+		pm.cmd = move->cmd;
+		pm.frametime = move->frametime;
+		VectorCopy (move->cmd.viewangles, pm.v_angle);
+		pm.angles[PITCH] = -pm.v_angle[PITCH]/3;
+		pm.angles[YAW] = pm.v_angle[YAW];
+		pm.angles[ROLL] = 0;
+		pm.angles[ROLL] = V_CalcRoll (pm.angles, pm.velocity)*4;
+
+		PM_PlayerThink (&pm);
+		PM_PlayerMove (&pm);
+
+		VectorCopy (pm.origin, move->origin);
+		move->predicted = true;
+	}
+
+// blend out the last misprediction
+	if (cl_predict_smooth.value > 0)
+	{
+		f = 1 - host_frametime / cl_predict_smooth.value;
+		if (f < 0)
+			f = 0;
+		VectorScale (pred.error, f, pred.error);
+	}
+	else
+		VectorClear (pred.error);
+
+	VectorAdd (pm.origin, pred.error, pred.predorigin);
+	VectorCopy (pm.velocity, pred.predvelocity);
+	pred.valid = true;
+}
+
+/*
+==================
+CL_PredictedOrigin
+
+Returns false if the player should be drawn where the server put it
+==================
+*/
+qboolean CL_PredictedOrigin (vec3_t origin, vec3_t velocity)
+{
+	if (!pred.valid)
+		return false;
+
+	VectorCopy (pred.predorigin, origin);
+	VectorCopy (pred.predvelocity, velocity);
+	return true;
+}
+
+/*
+==================
+CL_ClearPrediction
+==================
+*/
+void CL_ClearPrediction (void)
+{
+	memset (&pred, 0, sizeof(pred));
+}
+
+/*
+==================
+CL_InitPrediction
+==================
+*/
+void CL_InitPrediction (void)
+{
+	Cvar_RegisterVariable (&cl_predict);
+	Cvar_RegisterVariable (&cl_predict_smooth);
+	Cvar_RegisterVariable (&cl_predict_showerror);
+}
@@ -321,6 +321,30 @@ void CL_Disconnect (void);
 void CL_Disconnect_f (void);
 void CL_NextDemo (void);
 
+//
+// cl_lerp
+//
+void CL_InitLerpBuffer (void);
+void CL_ClearLerpBuffer (void);
+void CL_LerpBufferSnapshot (double servertime);
+void CL_LerpBufferUpdate (int num, entity_t *ent, qboolean reset);
+qboolean CL_LerpBufferFrame (void);
+qboolean CL_LerpBufferEntity (int num, entity_t *ent, qboolean step);
+
+//
+// cl_pred
+//
+extern	cvar_t	cl_predict;
+
+void CL_InitPrediction (void);
+void CL_ClearPrediction (void);
+void CL_ParseMoveVars (void);
+void CL_ParseMoveAck (void);
+void CL_WriteMoveSequence (sizebuf_t *buf);
+void CL_RecordMove (const usercmd_t *cmd, const vec3_t sentangles);
+void CL_PredictMove (void);
+qboolean CL_PredictedOrigin (vec3_t origin, vec3_t velocity);
+
 //
 // cl_input
 //
@@ -802,6 +802,8 @@ void	Cmd_ExecuteString (const char *text, cmd_source_t src)
 // check cvars
 	if (!Cvar_Command ())
 		Con_Printf ("Unknown command \"%s\"\n", Cmd_Argv(0));
+	else if (src == src_command && Cmd_Argc() > 1)
+		SV_RecordCommand (text);	// setting a cvar the game may read
 
 }
 
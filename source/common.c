@@ -25,6 +25,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "q_ctype.h"
 #include <errno.h>
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
 
 static char	*largv[MAX_NUM_ARGVS + 1];
 static char	argvdummy[] = " ";
@@ -129,6 +135,31 @@ void InsertLinkAfter (link_t *l, link_t *after)
 ============================================================================
 */
 
+unsigned int COM_HashString (const char *s)
+{
+	unsigned int	hash = 2166136261u;
+
+	while (*s)
+	{
+		hash ^= (byte)*s++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+unsigned int COM_HashBlock (const void *data, int length)
+{
+	const byte	*p = (const byte *)data;
+	unsigned int	hash = 2166136261u;
+
+	while (length-- > 0)
+	{
+		hash ^= *p++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
 int q_strcasecmp(const char * s1, const char * s2)
 {
 	const char * p1 = s1;
@@ -1392,34 +1423,40 @@ void COM_Init (void)
 ============
 va
 
-does a varargs printf into a temp buffer. cycles between
-4 different static buffers. the number of buffers cycled
-is defined in VA_NUM_BUFFS.
-FIXME: make this buffer size safe someday
+does a varargs printf into a temp buffer, which lasts until the end of the
+host frame
 ============
 */
-#define	VA_NUM_BUFFS	4
 #define	VA_BUFFERLEN	1024
 
-static char *get_va_buffer(void)
-{
-	static char va_buffers[VA_NUM_BUFFS][VA_BUFFERLEN];
-	static int buffer_idx = 0;
-	buffer_idx = (buffer_idx + 1) & (VA_NUM_BUFFS - 1);
-	return va_buffers[buffer_idx];
-}
-
 char *va (const char *format, ...)
 {
 	va_list		argptr;
+	char		buf[VA_BUFFERLEN];
 	char		*va_buf;
+	int			len, size;
 
-	va_buf = get_va_buffer ();
 	va_start (argptr, format);
-	q_vsnprintf (va_buf, VA_BUFFERLEN, format, argptr);
+	len = q_vsnprintf (buf, sizeof(buf), format, argptr);
 	va_end (argptr);
 
-	return va_buf;
+	if (len < (int)sizeof(buf))
+	{
+		va_buf = (char *) Frame_Alloc (FRAME_CLIENT, len + 1);
+		memcpy (va_buf, buf, len + 1);
+		return va_buf;
+	}
+
+// too long for the stack, q_vsnprintf may not have said by how much
+	for (size = len + 1; ; size *= 2)
+	{
+		va_buf = (char *) Frame_Alloc (FRAME_CLIENT, size);
+		va_start (argptr, format);
+		len = q_vsnprintf (va_buf, size, format, argptr);
+		va_end (argptr);
+		if (len < size || size >= (1 << 20))
+			return va_buf;
+	}
 }
 
 /*
@@ -1455,6 +1492,14 @@ char	com_gamedir[MAX_OSPATH];
 char	com_basedir[MAX_OSPATH];
 int	file_from_pak;		// ZOID: global indicating that file came from a pak
 
+// where the last file COM_FindFile found is: its bytes if it is stored in
+// a mapped pak, its pack entry if it is in a pak, else its OS path if it is
+// a loose file
+static const byte	*com_filedata;
+static pack_t	*com_filepack;
+static packfile_t	*com_fileentry;
+static char	com_filepath[MAX_OSPATH];
+
 searchpath_t	*com_searchpaths;
 searchpath_t	*com_base_searchpaths;
 
@@ -1505,6 +1550,7 @@ void COM_WriteFile (const char *filename, const void *data, int len)
 	Sys_Printf ("COM_WriteFile: %s\n", name);
 	Sys_FileWrite (handle, data, len);
 	Sys_FileClose (handle);
+	COM_FileCreated (name);
 }
 
 /*
@@ -1545,218 +1591,1369 @@ long COM_filelength (FILE *f)
 }
 
 /*
-===========
-COM_FindFile
+=============================================================================
 
-Finds the file in the search path.
-Sets com_filesize and one of handle or file
-If neither of file or handle is set, this
-can be used for detecting a file's presence.
-===========
+DIRECTORY INDEX
+
+Rather than asking the OS whether each file COM_FindFile looks for is in a
+game directory, which is what most lookups of external textures, .lit and
+.ent files end in, every directory that a lookup goes to is listed once
+and its names are kept in a hash table of the search path.
+
+The listings stay until COM_RescanFiles (a game change or fs_rescan), so
+files the engine writes itself have to go through COM_FileCreated.
+=============================================================================
 */
-static int COM_FindFile (const char *filename, int *handle, FILE **file,
-							unsigned int *path_id)
+
+// the file systems these run on don't care about case
+#if defined(_WIN32) || defined(PLATFORM_OSX) || defined(VITA) || defined(__SWITCH__)
+#define	FS_CASEFOLD
+#endif
+
+#define	FSE_FILE	0	// a name found in a listing
+#define	FSE_LISTED	1	// a directory that has been listed
+
+typedef struct fsentry_s
 {
-	searchpath_t	*search;
-	char		netpath[MAX_OSPATH];
-	pack_t		*pak;
-	int		i, findtime;
+	struct fsentry_s	*next;
+	unsigned int	hash;
+	int		kind;
+	char	name[1];	// relative to the search path, allocated with the entry
+} fsentry_t;
 
-	if (file && handle)
-		Sys_Error ("COM_FindFile: both handle and file set");
+typedef struct fsindex_s
+{
+	fsentry_t	**table;
+	int		tablesize;	// power of two
+	int		count;
+} fsindex_t;
 
-	file_from_pak = 0;
+static unsigned int	com_pathgeneration;	// changes whenever a lookup might find something new
 
-//
-// search through the path, one element at a time
-//
-	for (search = com_searchpaths; search; search = search->next)
+static unsigned int COM_IndexHash (const char *s, int len)
+{
+	unsigned int	hash = 2166136261u;
+
+	while (len--)
 	{
-		if (search->pack)	/* look through all the pak file elements */
-		{
-			pak = search->pack;
-			for (i = 0; i < pak->numfiles; i++)
-			{
-				if (strcmp(pak->files[i].name, filename) != 0)
-					continue;
-				// found it!
-				com_filesize = pak->files[i].filelen;
-				file_from_pak = 1;
-				if (path_id)
-					*path_id = search->path_id;
-				if (handle)
-				{
-					*handle = pak->handle;
-					Sys_FileSeek (pak->handle, pak->files[i].filepos);
-					return com_filesize;
-				}
-				else if (file)
-				{ /* open a new file on the pakfile */
-					*file = fopen (pak->filename, "rb");
-					if (*file)
-						fseek (*file, pak->files[i].filepos, SEEK_SET);
-					return com_filesize;
-				}
-				else /* for COM_FileExists() */
-				{
-					return com_filesize;
-				}
-			}
-		}
-		else	/* check a file in the directory tree */
-		{
-			if (!registered.value)
-			{ /* if not a registered version, don't ever go beyond base */
-				if ( strchr (filename, '/') || strchr (filename,'\\'))
-					continue;
-			}
+#ifdef FS_CASEFOLD
+		hash ^= (byte)q_tolower(*s++);
+#else
+		hash ^= (byte)*s++;
+#endif
+		hash *= 16777619u;
+	}
+	return hash;
+}
 
-			q_snprintf (netpath, sizeof(netpath), "%s/%s",search->filename, filename);
-			findtime = Sys_FileTime (netpath);
-			if (findtime == -1)
-				continue;
+static fsentry_t *COM_IndexFind (fsindex_t *index, const char *name, int len, int kind)
+{
+	fsentry_t	*e;
+	unsigned int	hash;
 
-			if (path_id)
-				*path_id = search->path_id;
-			if (handle)
-			{
-				com_filesize = Sys_FileOpenRead (netpath, &i);
-				*handle = i;
-				return com_filesize;
-			}
-			else if (file)
-			{
-				*file = fopen (netpath, "rb");
-				com_filesize = (*file == NULL) ? -1 : COM_filelength (*file);
-				return com_filesize;
-			}
-			else
+	hash = COM_IndexHash (name, len);
+	for (e = index->table[hash & (index->tablesize - 1)]; e; e = e->next)
+	{
+		if (e->hash != hash || e->kind != kind)
+			continue;
+#ifdef FS_CASEFOLD
+		if (!q_strncasecmp (e->name, name, len) && !e->name[len])
+#else
+		if (!strncmp (e->name, name, len) && !e->name[len])
+#endif
+			return e;
+	}
+	return NULL;
+}
+
+/*
+============
+COM_IndexAdd
+
+name is len characters of a directory, then file if that isn't NULL
+============
+*/
+static void COM_IndexAdd (fsindex_t *index, const char *name, int len, const char *file, int kind)
+{
+	fsentry_t	*e, *next, **table;
+	int		i, size;
+
+	if (index->count >= index->tablesize)
+	{
+		size = index->tablesize * 2;
+		table = (fsentry_t **) Mem_Alloc (MEM_MISC, size * sizeof(*table));
+		for (i = 0; i < index->tablesize; i++)
+		{
+			for (e = index->table[i]; e; e = next)
 			{
-				return 0;
+				next = e->next;
+				e->next = table[e->hash & (size - 1)];
+				table[e->hash & (size - 1)] = e;
 			}
 		}
+		Mem_Free (index->table);
+		index->table = table;
+		index->tablesize = size;
 	}
 
-	if (strcmp(COM_FileGetExtension(filename), "pcx") != 0
-		&& strcmp(COM_FileGetExtension(filename), "tga") != 0
-		&& strcmp(COM_FileGetExtension(filename), "lit") != 0
-		&& strcmp(COM_FileGetExtension(filename), "ent") != 0)
-		Con_DPrintf ("FindFile: can't find %s\n", filename);
-	else	Con_DPrintf2("FindFile: can't find %s\n", filename);
-		// Log pcx, tga, lit, ent misses only if (developer.value >= 2)
-
-	if (handle)
-		*handle = -1;
+	size = len + (file ? (len ? 1 : 0) + strlen (file) : 0);
+	e = (fsentry_t *) Mem_Alloc (MEM_MISC, sizeof(fsentry_t) + size);
+	memcpy (e->name, name, len);
 	if (file)
-		*file = NULL;
-	com_filesize = -1;
-	return com_filesize;
+		q_snprintf (e->name + len, size + 1 - len, "%s%s", len ? "/" : "", file);
+	e->name[size] = 0;
+	e->hash = COM_IndexHash (e->name, size);
+	e->kind = kind;
+	e->next = index->table[e->hash & (index->tablesize - 1)];
+	index->table[e->hash & (index->tablesize - 1)] = e;
+	index->count++;
 }
 
+static void COM_IndexFree (searchpath_t *search)
+{
+	fsindex_t	*index = search->index;
+	fsentry_t	*e, *next;
+	int		i;
+
+	if (!index)
+		return;
+	for (i = 0; i < index->tablesize; i++)
+	{
+		for (e = index->table[i]; e; e = next)
+		{
+			next = e->next;
+			Mem_Free (e);
+		}
+	}
+	Mem_Free (index->table);
+	Mem_Free (index);
+	search->index = NULL;
+}
 
 /*
-===========
-COM_FileExists
+============
+COM_IndexDirectory
 
-Returns whether the file is found in the quake filesystem.
-===========
+Adds the names in directory dir (len characters, empty for the top) of
+a search path, a missing directory has none
+============
 */
-qboolean COM_FileExists (const char *filename, unsigned int *path_id)
+static void COM_IndexDirectory (searchpath_t *search, const char *dir, int len)
 {
-	int ret = COM_FindFile (filename, NULL, NULL, path_id);
-	return (ret == -1) ? false : true;
+	char	path[MAX_OSPATH];
+#ifdef _WIN32
+	WIN32_FIND_DATA	fdat;
+	HANDLE	fhnd;
+#else
+	DIR		*dir_p;
+	struct dirent	*dir_t;
+#endif
+
+	COM_IndexAdd (search->index, dir, len, NULL, FSE_LISTED);
+
+#ifdef _WIN32
+	q_snprintf (path, sizeof(path), "%s/%.*s%s*", search->filename, len, dir, len ? "/" : "");
+	fhnd = FindFirstFile (path, &fdat);
+	if (fhnd == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		if (strcmp (fdat.cFileName, ".") && strcmp (fdat.cFileName, ".."))
+			COM_IndexAdd (search->index, dir, len, fdat.cFileName, FSE_FILE);
+	} while (FindNextFile (fhnd, &fdat));
+	FindClose (fhnd);
+#else
+	q_snprintf (path, sizeof(path), "%s/%.*s", search->filename, len, dir);
+	dir_p = opendir (path);
+	if (dir_p == NULL)
+		return;
+	while ((dir_t = readdir (dir_p)) != NULL)
+	{
+		if (strcmp (dir_t->d_name, ".") && strcmp (dir_t->d_name, ".."))
+			COM_IndexAdd (search->index, dir, len, dir_t->d_name, FSE_FILE);
+	}
+	closedir (dir_p);
+#endif
 }
 
 /*
-===========
-COM_OpenFile
+============
+COM_IndexablePath
 
-filename never has a leading slash, but may contain directory walks
-returns a handle and a length
-it may actually be inside a pak file
-===========
+Whether filename names a file the way a directory listing does. Anything
+else is left to the OS.
+============
 */
-int COM_OpenFile (const char *filename, int *handle, unsigned int *path_id)
+static qboolean COM_IndexablePath (const char *filename)
 {
-	return COM_FindFile (filename, handle, NULL, path_id);
+	const char	*s;
+
+	if (!*filename || *filename == '/')
+		return false;
+	for (s = filename; *s; s++)
+	{
+		if (*s == '\\' || *s == ':')
+			return false;
+		if (*s == '/' && (s[1] == '/' || !s[1]))
+			return false;
+		if (*s == '.' && (s == filename || s[-1] == '/') && (!s[1] || s[1] == '/' || (s[1] == '.' && (!s[2] || s[2] == '/'))))
+			return false;
+	}
+	return true;
 }
 
 /*
-===========
-COM_FOpenFile
+============
+COM_IndexList
 
-If the requested file is inside a packfile, a new FILE * will be opened
-into the file.
-===========
+Makes sure directory dir (len characters) of a search path is listed
+============
 */
-int COM_FOpenFile (const char *filename, FILE **file, unsigned int *path_id)
+static void COM_IndexList (searchpath_t *search, const char *dir, int len)
 {
-	return COM_FindFile (filename, NULL, file, path_id);
+	if (!search->index)
+	{
+		search->index = (fsindex_t *) Mem_Alloc (MEM_MISC, sizeof(fsindex_t));
+		search->index->tablesize = 256;
+		search->index->table = (fsentry_t **) Mem_Alloc (MEM_MISC, search->index->tablesize * sizeof(fsentry_t *));
+	}
+
+	if (!COM_IndexFind (search->index, dir, len, FSE_LISTED))
+		COM_IndexDirectory (search, dir, len);
 }
 
 /*
 ============
-COM_CloseFile
+COM_IndexedFile
 
-If it is a pak file handle, don't really close it
+Whether a file of a directory search path is in its listings, listing
+the directory the file is in the first time
 ============
 */
-void COM_CloseFile (int h)
+static qboolean COM_IndexedFile (searchpath_t *search, const char *filename)
 {
-	searchpath_t	*s;
+	const char	*slash;
 
-	for (s = com_searchpaths; s; s = s->next)
-		if (s->pack && s->pack->handle == h)
-			return;
+	slash = strrchr (filename, '/');
+	COM_IndexList (search, filename, slash ? (int)(slash - filename) : 0);
 
-	Sys_FileClose (h);
+	return COM_IndexFind (search->index, filename, strlen (filename), FSE_FILE) != NULL;
 }
 
-
 /*
 ============
-COM_LoadFile
-
-Filename are reletive to the quake directory.
-Allways appends a 0 byte.
+COM_FileCreated
 ============
 */
-#define	LOADFILE_ZONE		0
-#define	LOADFILE_HUNK		1
-#define	LOADFILE_TEMPHUNK	2
-#define	LOADFILE_CACHE		3
-#define	LOADFILE_STACK		4
-#define	LOADFILE_MALLOC		5
+void COM_FileCreated (const char *path)
+{
+	searchpath_t	*search;
+	const char	*rel, *slash;
+	int		len;
 
-static byte	*loadbuf;
-static cache_user_t *loadcache;
-static int	loadsize;
+	com_pathgeneration++;
 
-byte *COM_LoadFile (const char *path, int usehunk, unsigned int *path_id)
+	for (search = com_searchpaths; search; search = search->next)
+	{
+		if (search->pack || !search->index)
+			continue;
+		len = strlen (search->filename);
+		if (strncmp (path, search->filename, len) || path[len] != '/')
+			continue;
+		rel = path + len + 1;
+		if (!COM_IndexablePath (rel))
+			continue;
+		slash = strrchr (rel, '/');
+		len = slash ? (int)(slash - rel) : 0;
+		if (COM_IndexFind (search->index, rel, len, FSE_LISTED) && !COM_IndexFind (search->index, rel, strlen (rel), FSE_FILE))
+			COM_IndexAdd (search->index, rel, strlen (rel), NULL, FSE_FILE);
+	}
+}
+
+/*
+============
+COM_RescanFiles
+============
+*/
+void COM_RescanFiles (void)
 {
-	int		h;
-	byte	*buf;
-	char	base[32];
-	int		len;
+	searchpath_t	*search;
 
-	buf = NULL;	// quiet compiler warning
+	for (search = com_searchpaths; search; search = search->next)
+		COM_IndexFree (search);
+	com_pathgeneration++;
+}
 
-// look for it in the filesystem or pack files
-	len = COM_OpenFile (path, &h, path_id);
-	if (h == -1)
-		return NULL;
+/*
+============
+COM_PackHash
 
-// extract the filename base name for hunk tag
-	COM_FileBase (path, base, sizeof(base));
+Chains the files of a pack by name hash. The first file of a name goes
+first in its chain, like the linear search this replaced found it.
+============
+*/
+static void COM_PackHash (pack_t *pack)
+{
+	int		i, size, slot;
 
-	switch (usehunk)
+	for (size = 64; size < pack->numfiles * 2; size <<= 1)
+		;
+	pack->hashmask = size - 1;
+	pack->hashtable = (int *) Z_Malloc (size * sizeof(int));
+	for (i = 0; i < size; i++)
+		pack->hashtable[i] = -1;
+	for (i = pack->numfiles - 1; i >= 0; i--)
 	{
-	case LOADFILE_HUNK:
-		buf = (byte *) Hunk_AllocName (len+1, base);
-		break;
-	case LOADFILE_TEMPHUNK:
-		buf = (byte *) Hunk_TempAlloc (len+1);
-		break;
+		slot = COM_HashString (pack->files[i].name) & pack->hashmask;
+		pack->files[i].hashnext = pack->hashtable[slot];
+		pack->hashtable[slot] = i;
+	}
+}
+
+/*
+============
+COM_FindPackFile
+
+Index of filename in pack, -1 if it isn't there
+============
+*/
+static int COM_FindPackFile (pack_t *pack, const char *filename)
+{
+	int		i;
+
+	for (i = pack->hashtable[COM_HashString (filename) & pack->hashmask]; i != -1; i = pack->files[i].hashnext)
+	{
+		if (!strcmp (pack->files[i].name, filename))
+			return i;
+	}
+	return -1;
+}
+
+/*
+=============================================================================
+
+DEFLATED PK3 ENTRIES
+
+A deflated entry is inflated in one go straight into the buffer of
+COM_LoadFile, from the mapped pack when there is one. Handles opened with
+FS_fopen inflate as they are read instead: the stream is at the position
+the last read left it, a read elsewhere moves it first, going forward by
+inflating and throwing the data away, going back by starting over.
+=============================================================================
+*/
+
+#ifdef USE_ZLIB
+
+#define	FSZIP_BUFSIZE	16384
+
+typedef struct fszip_s
+{
+	z_stream	strm;
+	long	packstart;		// where the deflated data is in the pack
+	long	packedlen;
+	long	packedread;		// how much of it has been read into in
+	long	outpos;			// position of the stream in the inflated data
+	byte	in[FSZIP_BUFSIZE];
+} fszip_t;
+
+static fszip_t *FS_ZipOpen (const packfile_t *pf)
+{
+	fszip_t	*zip;
+
+	zip = (fszip_t *) calloc (1, sizeof(fszip_t));
+	if (!zip)
+		return NULL;
+	if (inflateInit2 (&zip->strm, -MAX_WBITS) != Z_OK)
+	{
+		free (zip);
+		return NULL;
+	}
+	zip->packstart = pf->filepos;
+	zip->packedlen = pf->packedlen;
+	return zip;
+}
+
+static void FS_ZipClose (fshandle_t *fh)
+{
+	inflateEnd (&fh->zip->strm);
+	free (fh->zip);
+	fh->zip = NULL;
+}
+
+static void FS_ZipReset (fshandle_t *fh)
+{
+	fszip_t	*zip = fh->zip;
+
+	inflateReset (&zip->strm);
+	zip->strm.avail_in = 0;
+	zip->packedread = 0;
+	zip->outpos = 0;
+	fseek (fh->file, zip->packstart, SEEK_SET);
+}
+
+/*
+============
+FS_ZipRead
+
+Inflates up to size bytes from where the stream is, returns how many
+============
+*/
+static long FS_ZipRead (fshandle_t *fh, void *ptr, long size)
+{
+	fszip_t	*zip = fh->zip;
+	long	chunk;
+	int		ret;
+
+	zip->strm.next_out = (Bytef *) ptr;
+	zip->strm.avail_out = size;
+	while (zip->strm.avail_out)
+	{
+		if (!zip->strm.avail_in)
+		{
+			chunk = q_min (zip->packedlen - zip->packedread, (long) FSZIP_BUFSIZE);
+			if (chunk > 0)
+				chunk = fread (zip->in, 1, chunk, fh->file);
+			if (chunk <= 0)
+				break;
+			zip->packedread += chunk;
+			zip->strm.next_in = zip->in;
+			zip->strm.avail_in = chunk;
+		}
+		ret = inflate (&zip->strm, Z_NO_FLUSH);
+		if (ret != Z_OK)
+			break;
+	}
+	size -= zip->strm.avail_out;
+	zip->outpos += size;
+	return size;
+}
+
+/*
+============
+FS_ZipSeek
+
+Moves the stream to offset in the inflated data
+============
+*/
+static qboolean FS_ZipSeek (fshandle_t *fh, long offset)
+{
+	byte	skip[4096];
+	long	chunk;
+
+	if (offset < fh->zip->outpos)
+		FS_ZipReset (fh);
+	while (fh->zip->outpos < offset)
+	{
+		chunk = q_min (offset - fh->zip->outpos, (long) sizeof(skip));
+		if (FS_ZipRead (fh, skip, chunk) != chunk)
+			return false;
+	}
+	return true;
+}
+
+/*
+============
+COM_InflateBuffer
+
+Inflates all of the deflated data in into outlen bytes at out
+============
+*/
+static qboolean COM_InflateBuffer (const byte *in, int inlen, byte *out, int outlen)
+{
+	z_stream	strm;
+	int		ret;
+
+	memset (&strm, 0, sizeof(strm));
+	if (inflateInit2 (&strm, -MAX_WBITS) != Z_OK)
+		return false;
+	strm.next_in = (Bytef *) in;
+	strm.avail_in = inlen;
+	strm.next_out = out;
+	strm.avail_out = outlen;
+	ret = inflate (&strm, Z_FINISH);
+	ret = (ret == Z_STREAM_END && strm.total_out == (uLong) outlen);
+	inflateEnd (&strm);
+	return ret;
+}
+
+/*
+============
+COM_InflateEntry
+
+Inflates all of a deflated pack entry into out
+============
+*/
+static qboolean COM_InflateEntry (pack_t *pack, const packfile_t *pf, byte *out)
+{
+	z_stream	strm;
+	byte	in[FSZIP_BUFSIZE];
+	int		left, chunk, ret;
+
+	if (pack->mapped && pf->filepos <= pack->mappedsize - pf->packedlen)
+		return COM_InflateBuffer (pack->mapped + pf->filepos, pf->packedlen, out, pf->filelen);
+
+	memset (&strm, 0, sizeof(strm));
+	if (inflateInit2 (&strm, -MAX_WBITS) != Z_OK)
+		return false;
+	strm.next_out = out;
+	strm.avail_out = pf->filelen;
+
+	Sys_FileSeek (pack->handle, pf->filepos);
+	left = pf->packedlen;
+	ret = Z_OK;
+	while (ret == Z_OK && left > 0)
+	{
+		chunk = q_min (left, FSZIP_BUFSIZE);
+		if (Sys_FileRead (pack->handle, in, chunk) != chunk)
+			break;
+		left -= chunk;
+		strm.next_in = in;
+		strm.avail_in = chunk;
+		ret = inflate (&strm, Z_NO_FLUSH);
+	}
+
+	ret = (ret == Z_STREAM_END && strm.total_out == (uLong) pf->filelen);
+	inflateEnd (&strm);
+	return ret;
+}
+
+/*
+============
+COM_InflateToTemp
+
+For the callers of COM_FOpenFile, which read the FILE * themselves. f is
+a FILE * at the deflated data of pf, and is closed.
+============
+*/
+static FILE *COM_InflateToTemp (FILE *f, const packfile_t *pf)
+{
+	fshandle_t	fh;
+	FILE	*tmp;
+	byte	buf[FSZIP_BUFSIZE];
+	size_t	n;
+
+	memset (&fh, 0, sizeof(fh));
+	fh.file = f;
+	fh.length = pf->filelen;
+	fh.zip = FS_ZipOpen (pf);
+	tmp = fh.zip ? tmpfile () : NULL;
+	if (!tmp)
+	{
+		Con_Printf ("COM_FOpenFile: no temporary file to inflate into\n");
+		FS_fclose (&fh);
+		return NULL;
+	}
+
+	while ((n = FS_fread (buf, 1, sizeof(buf), &fh)) > 0)
+		fwrite (buf, 1, n, tmp);
+	if (FS_ftell (&fh) != fh.length)
+	{
+		Con_Printf ("COM_FOpenFile: couldn't inflate %s\n", pf->name);
+		fclose (tmp);
+		tmp = NULL;
+	}
+	else
+		rewind (tmp);
+
+	FS_fclose (&fh);
+	return tmp;
+}
+
+#else	// !USE_ZLIB, pk3 entries are all stored
+
+static qboolean COM_InflateEntry (pack_t *pack, const packfile_t *pf, byte *out)
+{
+	return false;
+}
+
+#endif	// USE_ZLIB
+
+/*
+=============================================================================
+
+NEGATIVE LOOKUP CACHE
+
+Map loads ask for many optional files that usually aren't there: .lit and
+.ent files, external textures in each format. A name that wasn't found in
+any search path is remembered with the generation of the search paths, and
+isn't looked for again until something bumps com_pathgeneration: a game
+directory added, a rescan, or the engine writing a file.
+=============================================================================
+*/
+
+#define	FSMISS_HASHSIZE	1024
+#define	FSMISS_MAX		8192	// forget them all past this many
+
+typedef struct fsmiss_s
+{
+	struct fsmiss_s	*next;
+	unsigned int	hash;
+	unsigned int	generation;
+	char	name[1];	// allocated with the entry
+} fsmiss_t;
+
+static fsmiss_t	*com_misses[FSMISS_HASHSIZE];
+static int		com_nummisses;
+
+typedef struct
+{
+	int		found, missed, knownmissing;
+	double	foundtime, missedtime, knowntime;
+	int		reads, readbytes;
+	double	readtime;
+	int		prefetched, prefetchused, prefetchbytes;
+	int		prefetchwaits, prefetchinline;	// loads that had to wait, or read it themselves
+	double	prefetchwait;
+} fsstats_t;
+
+static fsstats_t	com_fsstats;
+
+static void COM_ClearMisses (void)
+{
+	fsmiss_t	*m, *next;
+	int		i;
+
+	for (i = 0; i < FSMISS_HASHSIZE; i++)
+	{
+		for (m = com_misses[i]; m; m = next)
+		{
+			next = m->next;
+			Mem_Free (m);
+		}
+		com_misses[i] = NULL;
+	}
+	com_nummisses = 0;
+}
+
+static qboolean COM_KnownMissing (const char *filename)
+{
+	fsmiss_t	*m;
+	unsigned int	hash;
+
+	hash = COM_HashString (filename);
+	for (m = com_misses[hash & (FSMISS_HASHSIZE - 1)]; m; m = m->next)
+	{
+		if (m->hash == hash && !strcmp (m->name, filename))
+			return m->generation == com_pathgeneration;
+	}
+	return false;
+}
+
+static void COM_AddMiss (const char *filename)
+{
+	fsmiss_t	*m;
+	unsigned int	hash;
+	int		len;
+
+	hash = COM_HashString (filename);
+	for (m = com_misses[hash & (FSMISS_HASHSIZE - 1)]; m; m = m->next)
+	{
+		if (m->hash == hash && !strcmp (m->name, filename))
+		{	// missed before, under older search paths
+			m->generation = com_pathgeneration;
+			return;
+		}
+	}
+
+	if (com_nummisses >= FSMISS_MAX)
+		COM_ClearMisses ();
+	len = strlen (filename);
+	m = (fsmiss_t *) Mem_Alloc (MEM_MISC, sizeof(fsmiss_t) + len);
+	memcpy (m->name, filename, len + 1);
+	m->hash = hash;
+	m->generation = com_pathgeneration;
+	m->next = com_misses[hash & (FSMISS_HASHSIZE - 1)];
+	com_misses[hash & (FSMISS_HASHSIZE - 1)] = m;
+	com_nummisses++;
+}
+
+/*
+============
+COM_FSStats_f
+
+How lookups went since the last "fs_stats clear", to tell time spent
+looking for files that aren't there from time spent reading
+============
+*/
+static void COM_FSStats_f (void)
+{
+	fsstats_t	*s = &com_fsstats;
+
+	if (Cmd_Argc () > 1 && !strcmp (Cmd_Argv (1), "clear"))
+	{
+		memset (s, 0, sizeof(*s));
+		return;
+	}
+
+	Con_Printf ("found          %6i in %8.2f ms\n", s->found, s->foundtime * 1000);
+	Con_Printf ("not found      %6i in %8.2f ms\n", s->missed, s->missedtime * 1000);
+	Con_Printf ("known missing  %6i in %8.2f ms\n", s->knownmissing, s->knowntime * 1000);
+	Con_Printf ("read           %6i in %8.2f ms, %i KB\n", s->reads, s->readtime * 1000, s->readbytes / 1024);
+	Con_Printf ("prefetched     %6i, %i used, %i KB\n", s->prefetched, s->prefetchused, s->prefetchbytes / 1024);
+	Con_Printf ("prefetch waits %6i in %8.2f ms, %i read by the loader\n", s->prefetchwaits, s->prefetchwait * 1000, s->prefetchinline);
+	Con_Printf ("%i names known missing\n", com_nummisses);
+}
+
+/*
+===========
+COM_SearchFile
+
+Finds the file in the search path.
+Sets com_filesize and one of handle or file
+If neither of file or handle is set, this
+can be used for detecting a file's presence.
+===========
+*/
+static int COM_SearchFile (const char *filename, int *handle, FILE **file,
+							unsigned int *path_id)
+{
+	searchpath_t	*search;
+	char		netpath[MAX_OSPATH];
+	pack_t		*pak;
+	int		i, findtime;
+
+	if (file && handle)
+		Sys_Error ("COM_SearchFile: both handle and file set");
+
+	file_from_pak = 0;
+	com_filedata = NULL;
+	com_fileentry = NULL;
+
+//
+// search through the path, one element at a time
+//
+	for (search = com_searchpaths; search; search = search->next)
+	{
+		if (search->pack)	/* look through all the pak file elements */
+		{
+			pak = search->pack;
+			i = COM_FindPackFile (pak, filename);
+			if (i != -1)
+			{
+				// found it!
+				com_filesize = pak->files[i].filelen;
+				file_from_pak = 1;
+				com_filepack = pak;
+				com_fileentry = &pak->files[i];
+				if (pak->mapped && !pak->files[i].deflated && pak->files[i].filepos >= 0 && com_filesize >= 0
+					&& pak->files[i].filepos <= pak->mappedsize - com_filesize)
+					com_filedata = pak->mapped + pak->files[i].filepos;
+				if (path_id)
+					*path_id = search->path_id;
+				if (handle)
+				{
+					*handle = pak->handle;
+					Sys_FileSeek (pak->handle, pak->files[i].filepos);
+					return com_filesize;
+				}
+				else if (file)
+				{ /* open a new file on the pakfile */
+					*file = fopen (pak->filename, "rb");
+					if (*file)
+						fseek (*file, pak->files[i].filepos, SEEK_SET);
+					return com_filesize;
+				}
+				else /* for COM_FileExists() */
+				{
+					return com_filesize;
+				}
+			}
+		}
+		else	/* check a file in the directory tree */
+		{
+			if (!registered.value)
+			{ /* if not a registered version, don't ever go beyond base */
+				if ( strchr (filename, '/') || strchr (filename,'\\'))
+					continue;
+			}
+
+			if (COM_IndexablePath (filename))
+			{
+				if (!COM_IndexedFile (search, filename))
+					continue;
+				q_snprintf (netpath, sizeof(netpath), "%s/%s",search->filename, filename);
+			}
+			else
+			{
+				q_snprintf (netpath, sizeof(netpath), "%s/%s",search->filename, filename);
+				findtime = Sys_FileTime (netpath);
+				if (findtime == -1)
+					continue;
+			}
+
+			if (path_id)
+				*path_id = search->path_id;
+			q_strlcpy (com_filepath, netpath, sizeof(com_filepath));
+			if (handle)
+			{
+				com_filesize = Sys_FileOpenRead (netpath, &i);
+				*handle = i;
+				return com_filesize;
+			}
+			else if (file)
+			{
+				*file = fopen (netpath, "rb");
+				com_filesize = (*file == NULL) ? -1 : COM_filelength (*file);
+				return com_filesize;
+			}
+			else
+			{
+				return 0;
+			}
+		}
+	}
+
+	COM_AddMiss (filename);
+
+	if (strcmp(COM_FileGetExtension(filename), "pcx") != 0
+		&& strcmp(COM_FileGetExtension(filename), "tga") != 0
+		&& strcmp(COM_FileGetExtension(filename), "lit") != 0
+		&& strcmp(COM_FileGetExtension(filename), "ent") != 0)
+		Con_DPrintf ("FindFile: can't find %s\n", filename);
+	else	Con_DPrintf2("FindFile: can't find %s\n", filename);
+		// Log pcx, tga, lit, ent misses only if (developer.value >= 2)
+
+	if (handle)
+		*handle = -1;
+	if (file)
+		*file = NULL;
+	com_filesize = -1;
+	return com_filesize;
+}
+
+/*
+===========
+COM_FindFile
+
+COM_SearchFile, unless the file is known not to be there
+===========
+*/
+static int COM_FindFile (const char *filename, int *handle, FILE **file,
+							unsigned int *path_id)
+{
+	double	start;
+	int		ret;
+
+	start = Sys_PreciseTime ();
+	if (COM_KnownMissing (filename))
+	{
+		file_from_pak = 0;
+		com_filedata = NULL;
+		com_fileentry = NULL;
+		if (handle)
+			*handle = -1;
+		if (file)
+			*file = NULL;
+		com_filesize = -1;
+		com_fsstats.knownmissing++;
+		com_fsstats.knowntime += Sys_PreciseTime () - start;
+		return com_filesize;
+	}
+
+	ret = COM_SearchFile (filename, handle, file, path_id);
+	if (ret == -1)
+	{
+		com_fsstats.missed++;
+		com_fsstats.missedtime += Sys_PreciseTime () - start;
+	}
+	else
+	{
+		com_fsstats.found++;
+		com_fsstats.foundtime += Sys_PreciseTime () - start;
+	}
+	return ret;
+}
+
+
+/*
+===========
+COM_FileExists
+
+Returns whether the file is found in the quake filesystem.
+===========
+*/
+qboolean COM_FileExists (const char *filename, unsigned int *path_id)
+{
+	int ret = COM_FindFile (filename, NULL, NULL, path_id);
+	return (ret == -1) ? false : true;
+}
+
+/*
+===========
+COM_OpenFile
+
+filename never has a leading slash, but may contain directory walks
+returns a handle and a length
+it may actually be inside a pak file, for a deflated pk3 entry the handle
+is at the deflated data
+===========
+*/
+int COM_OpenFile (const char *filename, int *handle, unsigned int *path_id)
+{
+	return COM_FindFile (filename, handle, NULL, path_id);
+}
+
+/*
+===========
+COM_FOpenFile
+
+If the requested file is inside a packfile, a new FILE * will be opened
+into the file. A deflated pk3 entry is inflated into a temporary file,
+FS_fopen reads one without that.
+===========
+*/
+int COM_FOpenFile (const char *filename, FILE **file, unsigned int *path_id)
+{
+	int		len;
+
+	len = COM_FindFile (filename, NULL, file, path_id);
+#ifdef USE_ZLIB
+	if (len != -1 && *file && com_fileentry && com_fileentry->deflated)
+	{
+		*file = COM_InflateToTemp (*file, com_fileentry);
+		if (!*file)
+			len = com_filesize = -1;
+	}
+#endif
+	return len;
+}
+
+/*
+============
+COM_CloseFile
+
+If it is a pak file handle, don't really close it
+============
+*/
+void COM_CloseFile (int h)
+{
+	searchpath_t	*s;
+
+	for (s = com_searchpaths; s; s = s->next)
+		if (s->pack && s->pack->handle == h)
+			return;
+
+	Sys_FileClose (h);
+}
+
+
+/*
+=============================================================================
+
+ASYNC PREFETCH
+
+Once a loader knows which files it is about to load, COM_Prefetch queues
+them, and a couple of threads read them into memory (inflating deflated
+pk3 entries) while the main thread goes on loading. COM_LoadFile and
+COM_MapFile take a prefetched file instead of reading it. They wait only
+if a thread is still reading it, and read it themselves if no thread has
+started on it yet.
+
+Where a file is in the search paths is worked out on the main thread
+when it is queued. The threads only use stdio and malloc. A file stored
+in a mapped pack isn't copied: a thread touches its pages so that they
+are in memory by the time the loader parses them.
+=============================================================================
+*/
+
+#define	PREFETCH_THREADS	2
+#define	PREFETCH_MAX		1024				// files queued at once
+#define	PREFETCH_BUDGET		(32 * 1024 * 1024)	// read ahead of the loaders at most
+
+#define	PF_QUEUED	0
+#define	PF_RUNNING	1
+#define	PF_DONE		2
+#define	PF_TAKEN	3		// handed out, or dropped
+
+typedef struct
+{
+	char	name[MAX_QPATH];
+	int		state;
+	unsigned int	path_id;
+	qboolean	frompak;
+	char	ospath[MAX_OSPATH];	// the loose file, or the pack it is in
+	packfile_t	entry;			// where it is in the pack
+	const byte	*mapped;		// its data in the pack, if the pack is mapped
+	byte	*data;				// malloc'd, NULL if it wasn't read
+	int		length;
+} prefetch_t;
+
+cvar_t	fs_prefetch = {"fs_prefetch", "1", CVAR_NONE};
+
+static prefetch_t	com_prefetch[PREFETCH_MAX];
+static int		com_numprefetch;		// queued since the last flush
+static int		com_prefetchnext;		// no file before this one is still queued
+static int		com_prefetchbytes;		// read and not taken yet
+static int		com_prefetchthreads = -1;	// -1 until they are started
+static SDL_mutex	*com_prefetchlock;
+static SDL_cond		*com_prefetchwork;	// there may be a file for a thread to read
+static SDL_cond		*com_prefetchdone;	// a thread has read a file
+
+/*
+============
+COM_PrefetchRead
+
+Reads the file of p, on whichever thread gets to it first
+============
+*/
+static void COM_PrefetchRead (prefetch_t *p)
+{
+	FILE	*f;
+	fshandle_t	fh;
+	qboolean	ok = false;
+	int		i;
+	volatile byte	touch = 0;
+
+	p->data = NULL;
+	p->length = 0;
+	if (p->mapped && !p->entry.deflated)
+	{
+		for (i = 0; i < p->entry.filelen; i += 4096)
+			touch += p->mapped[i];
+		return;
+	}
+
+	if (p->mapped)
+	{
+		p->length = p->entry.filelen;
+		p->data = (byte *) malloc (p->length + 1);
+#ifdef USE_ZLIB
+		ok = p->data && COM_InflateBuffer (p->mapped, p->entry.packedlen, p->data, p->length);
+#endif
+	}
+	else if ((f = fopen (p->ospath, "rb")) != NULL)
+	{
+		if (p->frompak)
+		{
+			fseek (f, p->entry.filepos, SEEK_SET);
+			p->length = p->entry.filelen;
+		}
+		else
+			p->length = COM_filelength (f);
+
+		memset (&fh, 0, sizeof(fh));
+		fh.file = f;
+		fh.start = ftell (f);
+		fh.length = p->length;
+#ifdef USE_ZLIB
+		if (p->entry.deflated)
+		{
+			fh.start = 0;
+			fh.zip = FS_ZipOpen (&p->entry);
+		}
+#endif
+		p->data = (byte *) malloc (p->length + 1);
+		ok = p->data && (!p->entry.deflated || fh.zip)
+			&& FS_fread (p->data, 1, p->length, &fh) == (size_t) p->length;
+		FS_fclose (&fh);
+	}
+
+	if (ok)
+		p->data[p->length] = 0;
+	else
+	{
+		free (p->data);
+		p->data = NULL;
+		p->length = 0;
+	}
+}
+
+static int SDLCALL COM_PrefetchThread (void *unused)
+{
+	prefetch_t	*p;
+
+	SDL_LockMutex (com_prefetchlock);
+	for (;;)
+	{
+		while (com_prefetchnext < com_numprefetch && com_prefetch[com_prefetchnext].state != PF_QUEUED)
+			com_prefetchnext++;
+		p = NULL;
+		if (com_prefetchbytes < PREFETCH_BUDGET)
+		{
+			for (p = com_prefetch + com_prefetchnext; p < com_prefetch + com_numprefetch; p++)
+			{
+				if (p->state == PF_QUEUED)
+					break;
+			}
+			if (p == com_prefetch + com_numprefetch)
+				p = NULL;
+		}
+		if (!p)
+		{
+			SDL_CondWait (com_prefetchwork, com_prefetchlock);
+			continue;
+		}
+
+		p->state = PF_RUNNING;
+		SDL_UnlockMutex (com_prefetchlock);
+		COM_PrefetchRead (p);
+		SDL_LockMutex (com_prefetchlock);
+		p->state = PF_DONE;
+		com_prefetchbytes += p->length;
+		SDL_CondBroadcast (com_prefetchdone);
+	}
+	return 0;
+}
+
+static void COM_PrefetchStart (void)
+{
+	SDL_Thread	*thread;
+
+	com_prefetchthreads = 0;
+	com_prefetchlock = SDL_CreateMutex ();
+	com_prefetchwork = SDL_CreateCond ();
+	com_prefetchdone = SDL_CreateCond ();
+	if (!com_prefetchlock || !com_prefetchwork || !com_prefetchdone)
+	{
+		Con_Printf ("COM_PrefetchStart: %s\n", SDL_GetError ());
+		return;
+	}
+
+	while (com_prefetchthreads < PREFETCH_THREADS)
+	{
+#if defined(USE_SDL2)
+		thread = SDL_CreateThread (COM_PrefetchThread, "prefetch", NULL);
+		if (thread)
+			SDL_DetachThread (thread);
+#else
+		thread = SDL_CreateThread (COM_PrefetchThread, NULL);
+#endif
+		if (!thread)
+		{
+			Con_Printf ("COM_PrefetchStart: %s\n", SDL_GetError ());
+			break;
+		}
+		com_prefetchthreads++;
+	}
+}
+
+/*
+============
+COM_Prefetch
+
+Starts reading a file that is going to be loaded soon
+============
+*/
+void COM_Prefetch (const char *path)
+{
+	prefetch_t	*p;
+	int		i;
+
+	if (!fs_prefetch.value || com_numprefetch == PREFETCH_MAX || strlen (path) >= MAX_QPATH)
+		return;
+	if (com_prefetchthreads == -1)
+		COM_PrefetchStart ();
+	if (!com_prefetchthreads)
+		return;
+
+	for (i = 0; i < com_numprefetch; i++)
+	{
+		if (!strcmp (com_prefetch[i].name, path))
+			return;
+	}
+
+	// the threads don't look past com_numprefetch, so p is ours until then
+	p = &com_prefetch[com_numprefetch];
+	if (COM_FindFile (path, NULL, NULL, &p->path_id) == -1)
+		return;
+	q_strlcpy (p->name, path, sizeof(p->name));
+	p->frompak = file_from_pak;
+	p->mapped = NULL;
+	p->data = NULL;
+	p->length = 0;
+	p->state = PF_QUEUED;
+	if (com_fileentry)
+	{
+		p->entry = *com_fileentry;
+		q_strlcpy (p->ospath, com_filepack->filename, sizeof(p->ospath));
+		if (com_filepack->mapped && p->entry.filepos >= 0 && p->entry.packedlen >= 0
+			&& p->entry.filepos <= com_filepack->mappedsize - p->entry.packedlen)
+			p->mapped = com_filepack->mapped + p->entry.filepos;
+	}
+	else
+	{
+		memset (&p->entry, 0, sizeof(p->entry));
+		q_strlcpy (p->ospath, com_filepath, sizeof(p->ospath));
+	}
+
+	SDL_LockMutex (com_prefetchlock);
+	com_numprefetch++;
+	SDL_CondSignal (com_prefetchwork);
+	SDL_UnlockMutex (com_prefetchlock);
+	com_fsstats.prefetched++;
+}
+
+/*
+============
+COM_TakePrefetch
+
+The prefetched data of path, malloc'd, if it was prefetched and could be
+read. A file no thread has started on yet is read here.
+============
+*/
+static qboolean COM_TakePrefetch (const char *path, byte **data, int *length, unsigned int *path_id)
+{
+	prefetch_t	*p;
+	double	start;
+	int		i;
+
+	if (!com_numprefetch)
+		return false;
+
+	SDL_LockMutex (com_prefetchlock);
+	for (i = 0, p = com_prefetch; i < com_numprefetch; i++, p++)
+	{
+		if (p->state != PF_TAKEN && !strcmp (p->name, path))
+			break;
+	}
+	if (i == com_numprefetch)
+	{
+		SDL_UnlockMutex (com_prefetchlock);
+		return false;
+	}
+	if (p->mapped && !p->entry.deflated)
+	{	// nothing to wait for, the loader reads the pack's pages itself
+		if (p->state == PF_QUEUED)
+			p->state = PF_TAKEN;
+		SDL_UnlockMutex (com_prefetchlock);
+		return false;
+	}
+
+	start = Sys_PreciseTime ();
+	if (p->state == PF_QUEUED)
+	{
+		p->state = PF_RUNNING;
+		SDL_UnlockMutex (com_prefetchlock);
+		COM_PrefetchRead (p);
+		SDL_LockMutex (com_prefetchlock);
+		com_fsstats.prefetchinline++;
+	}
+	else if (p->state == PF_RUNNING)
+	{
+		while (p->state == PF_RUNNING)
+			SDL_CondWait (com_prefetchdone, com_prefetchlock);
+		com_fsstats.prefetchwaits++;
+		com_prefetchbytes -= p->length;
+	}
+	else
+		com_prefetchbytes -= p->length;
+	p->state = PF_TAKEN;
+	SDL_CondSignal (com_prefetchwork);
+	SDL_UnlockMutex (com_prefetchlock);
+	com_fsstats.prefetchwait += Sys_PreciseTime () - start;
+
+	if (!p->data)
+		return false;
+	*data = p->data;
+	*length = com_filesize = p->length;
+	file_from_pak = p->frompak;
+	if (path_id)
+		*path_id = p->path_id;
+	p->data = NULL;
+	com_fsstats.prefetchused++;
+	com_fsstats.prefetchbytes += p->length;
+	return true;
+}
+
+/*
+============
+COM_PrefetchFlush
+
+Drops whatever was prefetched and not loaded, once a loader is done
+============
+*/
+void COM_PrefetchFlush (void)
+{
+	prefetch_t	*p;
+	int		i;
+
+	if (!com_numprefetch)
+		return;
+
+	SDL_LockMutex (com_prefetchlock);
+	for (i = 0, p = com_prefetch; i < com_numprefetch; i++, p++)
+	{
+		if (p->state == PF_QUEUED)
+			p->state = PF_TAKEN;
+		while (p->state == PF_RUNNING)
+			SDL_CondWait (com_prefetchdone, com_prefetchlock);
+		free (p->data);
+		p->data = NULL;
+	}
+	com_numprefetch = 0;
+	com_prefetchnext = 0;
+	com_prefetchbytes = 0;
+	SDL_UnlockMutex (com_prefetchlock);
+}
+
+double COM_PrefetchWaitTime (void)
+{
+	return com_fsstats.prefetchwait;
+}
+
+/*
+============
+COM_LoadFile
+
+Filename are reletive to the quake directory.
+Allways appends a 0 byte.
+============
+*/
+#define	LOADFILE_ZONE		0
+#define	LOADFILE_HUNK		1
+#define	LOADFILE_TEMPHUNK	2
+#define	LOADFILE_CACHE		3
+#define	LOADFILE_STACK		4
+#define	LOADFILE_MALLOC		5
+
+static byte	*loadbuf;
+static cache_user_t *loadcache;
+static int	loadsize;
+
+byte *COM_LoadFile (const char *path, int usehunk, unsigned int *path_id)
+{
+	int		h;
+	byte	*buf;
+	char	base[32];
+	int		len;
+	double	start;
+	const byte	*mapped;
+	byte	*prefetched;
+	pack_t	*pack;
+	packfile_t	*entry;
+
+	buf = NULL;	// quiet compiler warning
+
+// look for it in what was prefetched, then in the filesystem or pack files
+	if (COM_TakePrefetch (path, &prefetched, &len, path_id))
+	{
+		h = -1;
+		mapped = prefetched;
+		pack = NULL;
+		entry = NULL;
+	}
+	else
+	{
+		prefetched = NULL;
+		len = COM_OpenFile (path, &h, path_id);
+		if (h == -1)
+			return NULL;
+		mapped = com_filedata;
+		pack = com_filepack;
+		entry = com_fileentry;
+	}
+
+// extract the filename base name for hunk tag
+	COM_FileBase (path, base, sizeof(base));
+
+	switch (usehunk)
+	{
+	case LOADFILE_HUNK:
+		buf = (byte *) Hunk_AllocName (len+1, base);
+		break;
+	case LOADFILE_TEMPHUNK:
+		buf = (byte *) Hunk_TempAlloc (len+1);
+		break;
 	case LOADFILE_ZONE:
 		buf = (byte *) Z_Malloc (len+1);
 		break;
@@ -1781,8 +2978,22 @@ byte *COM_LoadFile (const char *path, int usehunk, unsigned int *path_id)
 
 	((byte *)buf)[len] = 0;
 
-	Sys_FileRead (h, buf, len);
-	COM_CloseFile (h);
+	start = Sys_PreciseTime ();
+	if (mapped)
+		memcpy (buf, mapped, len);
+	else if (entry && entry->deflated)
+	{
+		if (!COM_InflateEntry (pack, entry, buf))
+			Host_Error ("COM_LoadFile: couldn't inflate %s", path);
+	}
+	else
+		Sys_FileRead (h, buf, len);
+	if (h != -1)
+		COM_CloseFile (h);
+	free (prefetched);
+	com_fsstats.reads++;
+	com_fsstats.readbytes += len;
+	com_fsstats.readtime += Sys_PreciseTime () - start;
 
 	return buf;
 }
@@ -1826,6 +3037,89 @@ byte *COM_LoadMallocFile (const char *path, unsigned int *path_id)
 	return COM_LoadFile (path, LOADFILE_MALLOC, path_id);
 }
 
+/*
+============
+COM_MapFile
+
+For loaders that only parse a file: a file in a mapped pak is used where it
+is, a loose file is mapped, and only when neither works is it read into
+memory. The view lasts until COM_UnmapFile, or for a pak, until the game
+changes.
+============
+*/
+qboolean COM_MapFile (const char *path, mappedfile_t *mf, unsigned int *path_id)
+{
+	memset (mf, 0, sizeof(*mf));
+	if (COM_TakePrefetch (path, &mf->copy, &mf->length, path_id))
+	{
+		mf->data = mf->copy;
+		return true;
+	}
+	if (COM_FindFile (path, NULL, NULL, path_id) == -1)
+		return false;
+
+	if (com_filedata)
+	{
+		mf->data = com_filedata;
+		mf->length = com_filesize;
+		return true;
+	}
+	if (!file_from_pak && COM_MapOSFile (com_filepath, mf))
+		return true;
+
+	mf->copy = COM_LoadMallocFile (path, path_id);
+	if (!mf->copy)
+		return false;
+	mf->data = mf->copy;
+	mf->length = com_filesize;
+	return true;
+}
+
+/*
+============
+COM_MapOSFile
+
+COM_MapFile for a path outside the search paths
+============
+*/
+qboolean COM_MapOSFile (const char *path, mappedfile_t *mf)
+{
+	FILE	*f;
+
+	memset (mf, 0, sizeof(*mf));
+	mf->mapping = Sys_MapFile (path, &mf->mapsize);
+	if (mf->mapping)
+	{
+		mf->data = (const byte *) mf->mapping;
+		mf->length = mf->mapsize;
+		return true;
+	}
+
+	f = fopen (path, "rb");
+	if (!f)
+		return false;
+	mf->length = COM_filelength (f);
+	mf->copy = (byte *) malloc (mf->length + 1);
+	if (!mf->copy || fread (mf->copy, 1, mf->length, f) != (size_t) mf->length)
+	{
+		fclose (f);
+		free (mf->copy);
+		memset (mf, 0, sizeof(*mf));
+		return false;
+	}
+	fclose (f);
+	mf->data = mf->copy;
+	return true;
+}
+
+void COM_UnmapFile (mappedfile_t *mf)
+{
+	if (mf->mapping)
+		Sys_UnmapFile (mf->mapping, mf->mapsize);
+	free (mf->copy);
+	memset (mf, 0, sizeof(*mf));
+}
+
 byte *COM_LoadMallocFile_TextMode_OSPath (const char *path, long *len_out)
 {
 	FILE	*f;
@@ -1958,6 +3252,7 @@ static pack_t *COM_LoadPackFile (const char *packfile)
 		q_strlcpy (newfiles[i].name, info[i].name, sizeof(newfiles[i].name));
 		newfiles[i].filepos = LittleLong(info[i].filepos);
 		newfiles[i].filelen = LittleLong(info[i].filelen);
+		newfiles[i].packedlen = newfiles[i].filelen;
 	}
 
 	pack = (pack_t *) Z_Malloc (sizeof (pack_t));
@@ -1965,11 +3260,258 @@ static pack_t *COM_LoadPackFile (const char *packfile)
 	pack->handle = packhandle;
 	pack->numfiles = numpackfiles;
 	pack->files = newfiles;
+	COM_PackHash (pack);
+	pack->mapped = (const byte *) Sys_MapFile (packfile, &pack->mappedsize);
 
 	//Sys_Printf ("Added packfile %s (%i files)\n", packfile, numpackfiles);
 	return pack;
 }
 
+//
+// on-disk zip (pk3) structures, all little endian
+//
+#define	ZIP_LOCALSIG	0x04034b50
+#define	ZIP_CENTRALSIG	0x02014b50
+#define	ZIP_ENDSIG		0x06054b50
+#define	ZIP_LOCALSIZE	30
+#define	ZIP_CENTRALSIZE	46
+#define	ZIP_ENDSIZE		22
+#define	ZIP_MAXCOMMENT	65535
+
+#define	ZIP_STORED		0
+#define	ZIP_DEFLATED	8
+
+static int COM_ZipShort (const byte *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static int COM_ZipLong (const byte *p)
+{
+	return (int)((unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24));
+}
+
+/*
+=================
+COM_ZipDataPos
+
+Where the data of an entry starts, from its local header at ofs, or -1
+=================
+*/
+static int COM_ZipDataPos (pack_t *pack, int ofs, int filesize)
+{
+	byte	local[ZIP_LOCALSIZE];
+	const byte	*p;
+
+	if (ofs < 0 || ofs > filesize - ZIP_LOCALSIZE)
+		return -1;
+	if (pack->mapped)
+		p = pack->mapped + ofs;
+	else
+	{
+		Sys_FileSeek (pack->handle, ofs);
+		if (Sys_FileRead (pack->handle, local, ZIP_LOCALSIZE) != ZIP_LOCALSIZE)
+			return -1;
+		p = local;
+	}
+	if (COM_ZipLong (p) != ZIP_LOCALSIG)
+		return -1;
+	return ofs + ZIP_LOCALSIZE + COM_ZipShort (p + 26) + COM_ZipShort (p + 28);
+}
+
+/*
+=================
+COM_LoadZipFile
+
+Takes an explicit path to a pk3 file and reads its central directory,
+like COM_LoadPackFile. Directories, encrypted entries, names too long for
+a packfile_t and methods other than stored and deflated are left out.
+=================
+*/
+static pack_t *COM_LoadZipFile (const char *packfile)
+{
+	byte	tail[ZIP_ENDSIZE + ZIP_MAXCOMMENT];
+	byte	*dir;
+	const byte	*p, *end, *name;
+	int		packhandle, filesize, taillen;
+	int		numentries, dirofs, dirlen;
+	int		i, count, skipped, method, namelen, pos;
+	packfile_t	*newfiles;
+	pack_t	*pack;
+
+	filesize = Sys_FileOpenRead (packfile, &packhandle);
+	if (filesize == -1)
+		return NULL;
+
+	// the end of central directory record is at the end, before a comment
+	taillen = q_min (filesize, (int) sizeof(tail));
+	Sys_FileSeek (packhandle, filesize - taillen);
+	if (Sys_FileRead (packhandle, tail, taillen) != taillen)
+		taillen = 0;
+	for (i = taillen - ZIP_ENDSIZE; i >= 0; i--)
+	{
+		if (COM_ZipLong (tail + i) == ZIP_ENDSIG)
+			break;
+	}
+	if (i < 0)
+	{
+		Sys_Printf ("WARNING: %s is not a zip file, ignored\n", packfile);
+		Sys_FileClose (packhandle);
+		return NULL;
+	}
+	numentries = COM_ZipShort (tail + i + 10);
+	dirlen = COM_ZipLong (tail + i + 12);
+	dirofs = COM_ZipLong (tail + i + 16);
+	if (dirlen < 0 || dirofs < 0 || dirofs > filesize - dirlen)
+	{
+		Sys_Printf ("WARNING: %s has a bad central directory, ignored\n", packfile);
+		Sys_FileClose (packhandle);
+		return NULL;
+	}
+
+	dir = (byte *) malloc (dirlen);
+	Sys_FileSeek (packhandle, dirofs);
+	if (!dir || Sys_FileRead (packhandle, dir, dirlen) != dirlen)
+	{
+		Sys_Printf ("WARNING: couldn't read the directory of %s, ignored\n", packfile);
+		free (dir);
+		Sys_FileClose (packhandle);
+		return NULL;
+	}
+
+	newfiles = (packfile_t *) Z_Malloc ((numentries ? numentries : 1) * sizeof(packfile_t));
+	count = skipped = 0;
+	end = dir + dirlen;
+	for (i = 0, p = dir; i < numentries; i++, p += ZIP_CENTRALSIZE + namelen + COM_ZipShort (p + 30) + COM_ZipShort (p + 32))
+	{
+		if (end - p < ZIP_CENTRALSIZE || COM_ZipLong (p) != ZIP_CENTRALSIG)
+			break;
+		namelen = COM_ZipShort (p + 28);
+		if (end - p < ZIP_CENTRALSIZE + namelen)
+			break;
+		name = p + ZIP_CENTRALSIZE;
+		if (!namelen || name[namelen - 1] == '/')
+			continue;	// a directory
+
+		method = COM_ZipShort (p + 10);
+		newfiles[count].packedlen = COM_ZipLong (p + 20);
+		newfiles[count].filelen = COM_ZipLong (p + 24);
+		newfiles[count].filepos = COM_ZipLong (p + 42);	// the local header, for now
+		newfiles[count].deflated = (method == ZIP_DEFLATED);
+		if (namelen >= MAX_QPATH || (COM_ZipShort (p + 6) & 1)
+#ifndef USE_ZLIB
+			|| method == ZIP_DEFLATED
+#endif
+			|| (method != ZIP_STORED && method != ZIP_DEFLATED)
+			|| newfiles[count].packedlen < 0 || newfiles[count].filelen < 0
+			|| (method == ZIP_STORED && newfiles[count].packedlen != newfiles[count].filelen))
+		{
+			skipped++;
+			continue;
+		}
+		memcpy (newfiles[count].name, name, namelen);
+		newfiles[count].name[namelen] = 0;
+		count++;
+	}
+	free (dir);
+	if (i < numentries)
+		Sys_Printf ("WARNING: %s has a bad central directory entry\n", packfile);
+
+	pack = (pack_t *) Z_Malloc (sizeof (pack_t));
+	q_strlcpy (pack->filename, packfile, sizeof(pack->filename));
+	pack->handle = packhandle;
+	pack->files = newfiles;
+	pack->mapped = (const byte *) Sys_MapFile (packfile, &pack->mappedsize);
+	if (pack->mapped && pack->mappedsize != filesize)
+	{
+		Sys_UnmapFile (pack->mapped, pack->mappedsize);
+		pack->mapped = NULL;
+	}
+
+	// the data follows each local header, which may differ from the
+	// central directory in its extra field
+	for (i = 0; i < count; i++)
+	{
+		pos = COM_ZipDataPos (pack, newfiles[i].filepos, filesize);
+		if (pos < 0 || pos > filesize - newfiles[i].packedlen)
+		{
+			skipped++;
+			newfiles[i--] = newfiles[--count];
+			continue;
+		}
+		newfiles[i].filepos = pos;
+	}
+
+	if (skipped)
+		Sys_Printf ("WARNING: %s has %i files that can't be read\n", packfile, skipped);
+	if (!count)
+	{
+		Sys_Printf ("WARNING: %s has no files, ignored\n", packfile);
+		if (pack->mapped)
+			Sys_UnmapFile (pack->mapped, pack->mappedsize);
+		Sys_FileClose (packhandle);
+		Z_Free (newfiles);
+		Z_Free (pack);
+		return NULL;
+	}
+
+	com_modified = true;	// not the original files
+	pack->numfiles = count;
+	COM_PackHash (pack);
+
+	return pack;
+}
+
+static int COM_ZipNameCmp (const void *a, const void *b)
+{
+	return q_strcasecmp (*(const char **)a, *(const char **)b);
+}
+
+/*
+=================
+COM_AddZipFiles
+
+Adds the pk3 files at the top of a game directory in name order, so that
+each overrides the ones before it and the paks
+=================
+*/
+static void COM_AddZipFiles (searchpath_t *dir)
+{
+	fsentry_t	*e;
+	const char	**names;
+	char	packfile[MAX_OSPATH];
+	searchpath_t	*search;
+	pack_t	*pak;
+	int		i, count;
+
+	COM_IndexList (dir, "", 0);
+	names = (const char **) Mem_Alloc (MEM_MISC, (dir->index->count + 1) * sizeof(*names));
+	count = 0;
+	for (i = 0; i < dir->index->tablesize; i++)
+	{
+		for (e = dir->index->table[i]; e; e = e->next)
+		{
+			if (e->kind == FSE_FILE && !strchr (e->name, '/') && !q_strcasecmp (COM_FileGetExtension (e->name), "pk3"))
+				names[count++] = e->name;
+		}
+	}
+	qsort (names, count, sizeof(*names), COM_ZipNameCmp);
+
+	for (i = 0; i < count; i++)
+	{
+		q_snprintf (packfile, sizeof(packfile), "%s/%s", dir->filename, names[i]);
+		pak = COM_LoadZipFile (packfile);
+		if (!pak)
+			continue;
+		search = (searchpath_t *) Z_Malloc(sizeof(searchpath_t));
+		search->path_id = dir->path_id;
+		search->pack = pak;
+		search->next = com_searchpaths;
+		com_searchpaths = search;
+	}
+	Mem_Free (names);
+}
+
 /*
 =================
 COM_AddGameDirectory -- johnfitz -- modified based on topaz's tutorial
@@ -1979,12 +3521,13 @@ static void COM_AddGameDirectory (const char *base, const char *dir)
 {
 	int i;
 	unsigned int path_id;
-	searchpath_t *search;
+	searchpath_t *search, *dirsearch;
 	pack_t *pak, *qspak;
 	char pakfile[MAX_OSPATH];
 	qboolean been_here = false;
 
 	q_strlcpy (com_gamedir, va("%s/%s", base, dir), sizeof(com_gamedir));
+	com_pathgeneration++;
 
 	// assign a path_id to this game directory
 	if (com_searchpaths)
@@ -1998,6 +3541,7 @@ _add_path:
 	q_strlcpy (search->filename, com_gamedir, sizeof(search->filename));
 	search->next = com_searchpaths;
 	com_searchpaths = search;
+	dirsearch = search;
 
 	// add any pak files in the format pak0.pak pak1.pak, ...
 	for (i = 0; ; i++)
@@ -2030,6 +3574,9 @@ _add_path:
 		if (!pak) break;
 	}
 
+	// then any pk3 files, over the paks
+	COM_AddZipFiles (dirsearch);
+
 	if (!been_here && host_parms->userdir != host_parms->basedir)
 	{
 		been_here = true;
@@ -2105,14 +3652,19 @@ static void COM_Game_f (void)
 		Host_WriteConfiguration ();
 
 		//Kill the extra game if it is loaded
+		COM_PrefetchFlush ();
 		while (com_searchpaths != com_base_searchpaths)
 		{
 			if (com_searchpaths->pack)
 			{
 				Sys_FileClose (com_searchpaths->pack->handle);
 				Z_Free (com_searchpaths->pack->files);
+				Z_Free (com_searchpaths->pack->hashtable);
+				if (com_searchpaths->pack->mapped)
+					Sys_UnmapFile (com_searchpaths->pack->mapped, com_searchpaths->pack->mappedsize);
 				Z_Free (com_searchpaths->pack);
 			}
+			COM_IndexFree (com_searchpaths);
 			search = com_searchpaths->next;
 			Z_Free (com_searchpaths);
 			com_searchpaths = search;
@@ -2120,6 +3672,7 @@ static void COM_Game_f (void)
 		hipnotic = false;
 		rogue = false;
 		standard_quake = true;
+		COM_RescanFiles ();
 
 		if (q_strcasecmp(p, GAMENAME)) //game is not id1
 		{
@@ -2189,6 +3742,9 @@ void COM_InitFilesystem (void) //johnfitz -- modified based on topaz's tutorial
 	Cvar_RegisterVariable (&cmdline);
 	Cmd_AddCommand ("path", COM_Path_f);
 	Cmd_AddCommand ("game", COM_Game_f); //johnfitz
+	Cmd_AddCommand ("fs_rescan", COM_RescanFiles);
+	Cmd_AddCommand ("fs_stats", COM_FSStats_f);
+	Cvar_RegisterVariable (&fs_prefetch);
 
 	i = COM_CheckParm ("-basedir");
 	if (i && i < com_argc-1)
@@ -2251,8 +3807,36 @@ void COM_InitFilesystem (void) //johnfitz -- modified based on topaz's tutorial
 /* The following FS_*() stdio replacements are necessary if one is
  * to perform non-sequential reads on files reopened on pak files
  * because we need the bookkeeping about file start/end positions.
- * Allocating and filling in the fshandle_t structure is the users'
- * responsibility when the file is initially opened. */
+ * FS_fopen() fills in the fshandle_t structure, if it is filled in by
+ * hand the zip member must be NULL. */
+
+long FS_fopen(const char *filename, fshandle_t *fh, unsigned int *path_id)
+{
+	FILE *f;
+	long length;
+
+	memset(fh, 0, sizeof(*fh));
+	length = (long) COM_FindFile(filename, NULL, &f, path_id);
+	if (length == -1 || !f)
+		return -1;
+
+	fh->file = f;
+	fh->pak = file_from_pak;
+	fh->length = length;
+#ifdef USE_ZLIB
+	if (com_fileentry && com_fileentry->deflated)
+	{
+		fh->zip = FS_ZipOpen(com_fileentry);
+		if (!fh->zip) {
+			fclose(f);
+			return -1;
+		}
+		return length;
+	}
+#endif
+	fh->start = ftell(f);
+	return length;
+}
 
 size_t FS_fread(void *ptr, size_t size, size_t nmemb, fshandle_t *fh)
 {
@@ -2276,6 +3860,16 @@ size_t FS_fread(void *ptr, size_t size, size_t nmemb, fshandle_t *fh)
 	byte_size = nmemb * size;
 	if (byte_size > fh->length - fh->pos)	/* just read to end */
 		byte_size = fh->length - fh->pos;
+#ifdef USE_ZLIB
+	if (fh->zip)
+	{
+		if (fh->zip->outpos != fh->start + fh->pos &&
+		    !FS_ZipSeek(fh, fh->start + fh->pos))
+			return 0;
+		bytes_read = FS_ZipRead(fh, ptr, byte_size);
+	}
+	else
+#endif
 	bytes_read = fread(ptr, 1, byte_size, fh->file);
 	fh->pos += bytes_read;
 
@@ -2326,6 +3920,11 @@ int FS_fseek(fshandle_t *fh, long offset, int whence)
 	if (offset > fh->length)	/* just seek to end */
 		offset = fh->length;
 
+	if (fh->zip) {	/* the next read gets there */
+		fh->pos = offset;
+		return 0;
+	}
+
 	ret = fseek(fh->file, fh->start + offset, SEEK_SET);
 	if (ret < 0)
 		return ret;
@@ -2340,6 +3939,10 @@ int FS_fclose(fshandle_t *fh)
 		errno = EBADF;
 		return -1;
 	}
+#ifdef USE_ZLIB
+	if (fh->zip)
+		FS_ZipClose(fh);
+#endif
 	return fclose(fh->file);
 }
 
@@ -2356,7 +3959,8 @@ void FS_rewind(fshandle_t *fh)
 {
 	if (!fh) return;
 	clearerr(fh->file);
-	fseek(fh->file, fh->start, SEEK_SET);
+	if (!fh->zip)
+		fseek(fh->file, fh->start, SEEK_SET);
 	fh->pos = 0;
 }
 
@@ -2388,6 +3992,12 @@ int FS_fgetc(fshandle_t *fh)
 	}
 	if (fh->pos >= fh->length)
 		return EOF;
+	if (fh->zip) {
+		unsigned char c;
+		if (FS_fread(&c, 1, 1, fh) != 1)
+			return EOF;
+		return c;
+	}
 	fh->pos += 1;
 	return fgetc(fh->file);
 }
@@ -2402,6 +4012,17 @@ char *FS_fgets(char *s, int size, fshandle_t *fh)
 	if (size > (fh->length - fh->pos) + 1)
 		size = (fh->length - fh->pos) + 1;
 
+	if (fh->zip) {
+		int i, c = 0;
+		for (i = 0; i < size - 1 && c != '\n'; i++) {
+			if ((c = FS_fgetc(fh)) == EOF)
+				break;
+			s[i] = c;
+		}
+		s[i] = '\0';
+		return i ? s : NULL;
+	}
+
 	ret = fgets(s, size, fh->file);
 	fh->pos = ftell(fh->file) - fh->start;
 
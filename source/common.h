@@ -154,6 +154,10 @@ extern char *q_strupr (char *str);
 extern int q_snprintf (char *str, size_t size, const char *format, ...) FUNC_PRINTF(3,4);
 extern int q_vsnprintf(char *str, size_t size, const char *format, va_list args) FUNC_PRINTF(3,0);
 
+/* FNV-1a hash of a string, for hash tables keyed by name, or of a block of data */
+extern unsigned int COM_HashString (const char *s);
+extern unsigned int COM_HashBlock (const void *data, int length);
+
 //============================================================================
 
 extern	char		com_token[1024];
@@ -200,6 +204,9 @@ typedef struct
 {
 	char	name[MAX_QPATH];
 	int		filepos, filelen;
+	int		hashnext;		// next file in the same hash chain, -1 for none
+	qboolean	deflated;	// pk3 entry stored compressed
+	int		packedlen;		// size of the data in the pack
 } packfile_t;
 
 typedef struct pack_s
@@ -208,6 +215,10 @@ typedef struct pack_s
 	int		handle;
 	int		numfiles;
 	packfile_t	*files;
+	int		*hashtable;		// first file of each chain, -1 for none
+	int		hashmask;
+	const byte	*mapped;	// the whole pak, NULL if it couldn't be mapped
+	int		mappedsize;
 } pack_t;
 
 typedef struct searchpath_s
@@ -217,6 +228,7 @@ typedef struct searchpath_s
 					// <userdir>/game1 have the same id.
 	char	filename[MAX_OSPATH];
 	pack_t	*pack;			// only one of filename / pack will be used
+	struct fsindex_s	*index;	// directory listings read so far
 	struct searchpath_s	*next;
 } searchpath_t;
 
@@ -234,6 +246,11 @@ void COM_WriteFile (const char *filename, const void *data, int len);
 int COM_OpenFile (const char *filename, int *handle, unsigned int *path_id);
 int COM_FOpenFile (const char *filename, FILE **file, unsigned int *path_id);
 qboolean COM_FileExists (const char *filename, unsigned int *path_id);
+void COM_FileCreated (const char *path);
+// tells the file system the engine wrote the file at path, so that it
+// is found even if its directory listing was read before.
+void COM_RescanFiles (void);
+// forgets every directory listing, for files changed behind our back.
 void COM_CloseFile (int h);
 
 // these procedures open a file using COM_FindFile and loads it into a proper
@@ -256,6 +273,30 @@ void COM_LoadCacheFile (const char *path, struct cache_user_s *cu,
 byte *COM_LoadMallocFile (const char *path, unsigned int *path_id);
 	// allocates the buffer on the system mem (malloc).
 
+// a read only view of a whole file, straight into a mapped pak or file
+// where possible. Not 0 terminated, unlike what COM_LoadFile returns.
+typedef struct
+{
+	const byte	*data;
+	int		length;
+	const void	*mapping;	// what to unmap, if the file had to be mapped
+	int		mapsize;
+	byte	*copy;			// what to free, if it had to be read
+} mappedfile_t;
+
+qboolean COM_MapFile (const char *path, mappedfile_t *mf, unsigned int *path_id);
+
+// Starts reading files the caller is about to load, on other threads.
+// COM_LoadFile and COM_MapFile pick them up, COM_PrefetchFlush drops the
+// ones that weren't.
+void COM_Prefetch (const char *path);
+void COM_PrefetchFlush (void);
+double COM_PrefetchWaitTime (void);
+
+extern struct cvar_s	fs_prefetch;
+qboolean COM_MapOSFile (const char *path, mappedfile_t *mf);
+void COM_UnmapFile (mappedfile_t *mf);
+
 // Opens the given path directly, ignoring search paths.
 // Returns NULL on failure, or else a '\0'-terminated malloc'ed buffer.
 // Loads in "t" mode so CRLF to LF translation is performed on Windows.
@@ -277,8 +318,9 @@ const char *COM_ParseStringNewline(const char *buffer);
 /* The following FS_*() stdio replacements are necessary if one is
  * to perform non-sequential reads on files reopened on pak files
  * because we need the bookkeeping about file start/end positions.
- * Allocating and filling in the fshandle_t structure is the users'
- * responsibility when the file is initially opened. */
+ * FS_fopen() fills in the fshandle_t structure, if it is filled in by
+ * hand the zip member must be NULL. A deflated pk3 entry is inflated as
+ * it is read, and its start is a position in the inflated data. */
 
 typedef struct _fshandle_t
 {
@@ -287,8 +329,11 @@ typedef struct _fshandle_t
 	long start;	/* file or data start position */
 	long length;	/* file or data size */
 	long pos;	/* current position relative to start */
+	struct fszip_s *zip;	/* inflate state of a deflated entry */
 } fshandle_t;
 
+long FS_fopen(const char *filename, fshandle_t *fh, unsigned int *path_id);
+
 size_t FS_fread(void *ptr, size_t size, size_t nmemb, fshandle_t *fh);
 int FS_fseek(fshandle_t *fh, long offset, int whence);
 long FS_ftell(fshandle_t *fh);
@@ -31,11 +31,15 @@ char	loadname[32];	// for hunk tags
 char fbr_mask_name[64]; // for fullbrights
 
 void Mod_LoadSpriteModel (qmodel_t *mod, void *buffer);
-void Mod_LoadBrushModel (qmodel_t *mod, void *buffer);
+void Mod_LoadBrushModel (qmodel_t *mod, const void *buffer);
 void Mod_LoadAliasModel (qmodel_t *mod, void *buffer);
 qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash);
+static void *Mod_CachedData (qmodel_t *mod);
 
 cvar_t	external_ents = {"external_ents", "1", CVAR_ARCHIVE};
+cvar_t	mod_retain = {"mod_retain", "64", CVAR_NONE};	// megabytes of models kept across maps
+
+static int	mod_mapcount;	// map changes so far, for the retained model LRU
 
 static byte	*mod_novis;
 static int	mod_novis_capacity;
@@ -59,6 +63,7 @@ void Mod_Init (void)
 {
 	Cvar_RegisterVariable (&gl_subdivide_size);
 	Cvar_RegisterVariable (&external_ents);
+	Cvar_RegisterVariable (&mod_retain);
 
 	//johnfitz -- create notexture miptex
 	r_notexture_mip = (texture_t *) Hunk_AllocName (sizeof(texture_t), "r_notexture_mip");
@@ -81,12 +86,15 @@ Caches the data if needed
 void *Mod_Extradata (qmodel_t *mod)
 {
 	void	*r;
+	memtag_t	oldtag;
 
-	r = Cache_Check (&mod->cache);
+	r = Mod_CachedData (mod);
 	if (r)
 		return r;
 
+	oldtag = Mem_SetTag (MEM_MODELS);
 	Mod_LoadModel (mod, true);
+	Mem_SetTag (oldtag);
 
 	if (!mod->cache.data)
 		Sys_Error ("Mod_Extradata: caching failed");
@@ -209,6 +217,161 @@ byte *Mod_NoVisPVS (qmodel_t *model)
 	return mod_novis;
 }
 
+/*
+===============================================================================
+
+					MODEL RETENTION
+
+While mod_retain is set, alias and sprite models are loaded into Mem_Alloc'd
+memory instead of the cache and the hunk, and Mod_ClearAll leaves them loaded
+with their textures and vertex buffers. At each map change Mod_TrimRetained
+frees the ones that have gone unused longest until the rest fit in mod_retain
+megabytes. The first time a map asks for a retained model its file is hashed
+again, and the model is reloaded if the file has changed.
+
+===============================================================================
+*/
+
+/*
+===============
+Mod_CachedData
+
+The model's data if it is loaded. Retained models aren't in the cache.
+===============
+*/
+static void *Mod_CachedData (qmodel_t *mod)
+{
+	if (mod->retained)
+		return mod->cache.data;
+	return Cache_Check (&mod->cache);
+}
+
+/*
+===============
+Mod_RetainData
+
+Called by the alias and sprite loaders with the finished model. Keeps a copy
+of it for the model if models are being retained, or returns NULL.
+===============
+*/
+static void *Mod_RetainData (qmodel_t *mod, const void *data, int size)
+{
+	void	*copy;
+
+	if (mod_retain.value <= 0)
+		return NULL;
+	copy = Mem_Alloc (MEM_MODELS, size);
+	if (!copy)
+		return NULL;
+	memcpy (copy, data, size);
+
+	mod->cache.data = copy;
+	mod->retained = true;
+	mod->retainsize = size;
+	return copy;
+}
+
+/*
+===============
+Mod_BufferSize
+
+Bytes of the vertex buffers GLMesh uploaded for an alias model
+===============
+*/
+static int Mod_BufferSize (qmodel_t *mod)
+{
+	const aliashdr_t	*hdr;
+
+	if (mod->type != mod_alias || !mod->meshvbo)
+		return 0;
+	hdr = (const aliashdr_t *) mod->cache.data;
+	return mod->vbostofs + hdr->numverts_vbo * sizeof(meshst_t) + hdr->numindexes * sizeof(unsigned short);
+}
+
+/*
+===============
+Mod_FreeRetained
+===============
+*/
+static void Mod_FreeRetained (qmodel_t *mod)
+{
+	if (mod->meshvbo || mod->meshindexesvbo)
+	{
+		GL_DeleteBuffersFunc (1, &mod->meshvbo);
+		GL_DeleteBuffersFunc (1, &mod->meshindexesvbo);
+		mod->meshvbo = mod->meshindexesvbo = 0;
+		GL_ClearBufferBindings ();
+	}
+	TexMgr_FreeTexturesForOwner (mod);
+
+	Mem_Free (mod->cache.data);
+	mod->cache.data = NULL;
+	mod->retained = false;
+	mod->retainsize = 0;
+	mod->needload = true;
+}
+
+/*
+===============
+Mod_CheckRetained
+
+False if the file a retained model was loaded from has changed or gone
+===============
+*/
+static qboolean Mod_CheckRetained (qmodel_t *mod)
+{
+	mappedfile_t	mf;
+	unsigned int	path_id;
+	qboolean	same;
+
+	same = COM_MapFile (mod->name, &mf, &path_id) && path_id == mod->path_id &&
+		COM_HashBlock (mf.data, mf.length) == mod->filehash;
+	COM_UnmapFile (&mf);
+	return same;
+}
+
+/*
+===============
+Mod_TrimRetained
+
+Frees the least recently used retained models until the rest fit in the
+budget. Called between maps, when none of them are in use.
+===============
+*/
+static void Mod_TrimRetained (void)
+{
+	int		i, count, freed;
+	double	total, budget;
+	qmodel_t	*mod, *oldest;
+
+	count = 0;
+	total = 0;
+	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
+	{
+		if (mod->retained)
+		{
+			count++;
+			total += mod->retainsize;
+		}
+	}
+
+	budget = q_max (mod_retain.value, 0) * 1024 * 1024;
+	for (freed = 0; total > budget; freed++)
+	{
+		oldest = NULL;
+		for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
+		{
+			if (mod->retained && (!oldest || mod->usedmap < oldest->usedmap))
+				oldest = mod;
+		}
+		total -= oldest->retainsize;
+		Mod_FreeRetained (oldest);
+	}
+
+	if (count)
+		Con_DPrintf ("Retained %i models, %.1f MB, freed %i\n", count - freed, total / (1024 * 1024), freed);
+}
+
 /*
 ===================
 Mod_ClearAll
@@ -220,11 +383,14 @@ void Mod_ClearAll (void)
 	qmodel_t	*mod;
 
 	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
-		if (mod->type != mod_alias)
+		if (mod->type != mod_alias && !mod->retained)
 		{
 			mod->needload = true;
 			TexMgr_FreeTexturesForOwner (mod); //johnfitz
 		}
+
+	mod_mapcount++;
+	Mod_TrimRetained ();
 }
 
 void Mod_ResetAll (void)
@@ -237,7 +403,9 @@ void Mod_ResetAll (void)
 	
 	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
 	{
-		if (!mod->needload) //otherwise Mod_ClearAll() did it already
+		if (mod->retained)
+			Mod_FreeRetained (mod);
+		else if (!mod->needload) //otherwise Mod_ClearAll() did it already
 			TexMgr_FreeTexturesForOwner (mod);
 		memset(mod, 0, sizeof(qmodel_t));
 	}
@@ -291,9 +459,36 @@ void Mod_TouchModel (const char *name)
 
 	if (!mod->needload)
 	{
+		mod->usedmap = mod_mapcount;
 		if (mod->type == mod_alias)
-			Cache_Check (&mod->cache);
+			Mod_CachedData (mod);
+	}
+}
+
+/*
+==================
+Mod_Prefetch
+
+Starts reading a model that is about to be loaded, unless it is loaded
+==================
+*/
+void Mod_Prefetch (const char *name)
+{
+	qmodel_t	*mod;
+
+	if (name[0] == '*')
+		return;		// a submodel of a brush model
+
+	mod = Mod_FindName (name);
+	if (mod->retained)
+	{
+		if (mod->checkedmap == mod_mapcount)
+			return;		// Mod_LoadModel reads it only to check it
 	}
+	else if (!mod->needload && (mod->type != mod_alias || Cache_Check (&mod->cache)))
+		return;
+
+	COM_Prefetch (name);
 }
 
 /*
@@ -308,10 +503,24 @@ qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 	byte	*buf;
 	byte	stackbuf[1024];		// avoid dirtying the cache heap
 	int	mod_type;
+	unsigned int	filehash;
+	mappedfile_t	mf;
+
+	mod->usedmap = mod_mapcount;
 
 	if (!mod->needload)
 	{
-		if (mod->type == mod_alias)
+		if (mod->retained)
+		{
+			if (mod->checkedmap == mod_mapcount)
+				return mod;
+			mod->checkedmap = mod_mapcount;
+			if (Mod_CheckRetained (mod))
+				return mod;
+			Con_DPrintf ("%s has changed, reloading\n", mod->name);
+			Mod_FreeRetained (mod);
+		}
+		else if (mod->type == mod_alias)
 		{
 			if (Cache_Check (&mod->cache))
 				return mod;
@@ -329,11 +538,12 @@ qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 	}
 
 //
-// load the file
+// load the file. Brush models are parsed straight from the mapped file,
+// the alias and sprite loaders change what they load so get a copy
 //
-	buf = COM_LoadStackFile (mod->name, stackbuf, sizeof(stackbuf), & mod->path_id);
-	if (!buf)
+	if (!COM_MapFile (mod->name, &mf, & mod->path_id) || mf.length < 4)
 	{
+		COM_UnmapFile (&mf);
 		buf = COM_LoadStackFile ("models/missing_model.mdl", stackbuf, sizeof(stackbuf), NULL);
 		if (buf){
 			Con_Printf ("Missing model %s substituted\n", mod->name);
@@ -357,20 +567,30 @@ qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 // call the apropriate loader
 	mod->needload = false;
 
-	mod_type = (buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24));
-	switch (mod_type)
+	mod_type = (mf.data[0] | (mf.data[1] << 8) | (mf.data[2] << 16) | (mf.data[3] << 24));
+	if (mod_type == IDPOLYHEADER || mod_type == IDSPRITEHEADER)
 	{
-	case IDPOLYHEADER:
-		Mod_LoadAliasModel (mod, buf);
-		break;
-
-	case IDSPRITEHEADER:
-		Mod_LoadSpriteModel (mod, buf);
-		break;
+		filehash = (mod_retain.value > 0) ? COM_HashBlock (mf.data, mf.length) : 0;
+		buf = (mf.length < (int) sizeof(stackbuf)) ? stackbuf : (byte *) Hunk_TempAlloc (mf.length + 1);
+		memcpy (buf, mf.data, mf.length);
+		buf[mf.length] = 0;
+		COM_UnmapFile (&mf);
+		if (mod_type == IDPOLYHEADER)
+			Mod_LoadAliasModel (mod, buf);
+		else
+			Mod_LoadSpriteModel (mod, buf);
 
-	default:
-		Mod_LoadBrushModel (mod, buf);
-		break;
+		if (mod->retained)
+		{
+			mod->filehash = filehash;
+			mod->checkedmap = mod_mapcount;
+			mod->retainsize += TexMgr_SizeForOwner (mod) + Mod_BufferSize (mod);
+		}
+	}
+	else
+	{
+		Mod_LoadBrushModel (mod, mf.data);
+		COM_UnmapFile (&mf);
 	}
 
 	return mod;
@@ -386,10 +606,15 @@ Loads in a model for the given name
 qmodel_t *Mod_ForName (const char *name, qboolean crash)
 {
 	qmodel_t	*mod;
+	memtag_t	oldtag;
 	
 	mod = Mod_FindName (name);
 
-	return Mod_LoadModel (mod, crash);
+	oldtag = Mem_SetTag (MEM_MODELS);
+	mod = Mod_LoadModel (mod, crash);
+	Mem_SetTag (oldtag);
+
+	return mod;
 }
 
 
@@ -497,8 +722,8 @@ extern int		texture_mode;
 
 void Mod_LoadTextures (lump_t *l)
 {
-	int		i, j, pixels, num, maxanim, altmax;
-	miptex_t	*mt;
+	int		i, j, pixels, num, maxanim, altmax, dataofs;
+	miptex_t	*mt, mtswapped;
 	texture_t	*tx, *tx2;
 	texture_t	*anims[10];
 	texture_t	*altanims[10];
@@ -523,15 +748,14 @@ void Mod_LoadTextures (lump_t *l)
 	else
 	{
 		m = (dmiptexlump_t *)(mod_base + l->fileofs);
-		m->nummiptex = LittleLong (m->nummiptex);
-		nummiptex = m->nummiptex;
+		nummiptex = LittleLong (m->nummiptex);
 	}
 	//johnfitz
 
 	loadmodel->numtextures = nummiptex + 2; //johnfitz -- need 2 dummy texture chains for missing textures
 	loadmodel->textures = (texture_t **) Hunk_AllocName (loadmodel->numtextures * sizeof(*loadmodel->textures) , loadname);
 	
-	loading_num_step = loading_num_step + m->nummiptex;
+	loading_num_step = loading_num_step + nummiptex;
 
 	// motolegacy - load referenced WAD3 files for HLBSP, from DQuake+ 
 	if (loadmodel->bspversion == HL_BSPVERSION)
@@ -539,26 +763,29 @@ void Mod_LoadTextures (lump_t *l)
 
 	for (i=0 ; i<nummiptex ; i++)
 	{
-		m->dataofs[i] = LittleLong(m->dataofs[i]);
-		if (m->dataofs[i] == -1)
+		dataofs = LittleLong (m->dataofs[i]);
+		if (dataofs == -1)
 			continue;
-		mt = (miptex_t *)((byte *)m + m->dataofs[i]);
-		mt->width = LittleLong (mt->width);
-		mt->height = LittleLong (mt->height);
+	// the lump is in the mapped file, so the header is swapped in a copy;
+	// mt still points at the miptex for the pixels that follow it
+		mt = (miptex_t *)((byte *)m + dataofs);
+		memcpy (&mtswapped, mt, sizeof(mtswapped));
+		mtswapped.width = LittleLong (mtswapped.width);
+		mtswapped.height = LittleLong (mtswapped.height);
 		for (j=0 ; j<MIPLEVELS ; j++)
-			mt->offsets[j] = LittleLong (mt->offsets[j]);
+			mtswapped.offsets[j] = LittleLong (mtswapped.offsets[j]);
 
-		if ( (mt->width & 15) || (mt->height & 15) )
+		if ( (mtswapped.width & 15) || (mtswapped.height & 15) )
 			Sys_Error ("Texture %s is not 16 aligned", mt->name);
-		pixels = mt->width*mt->height/64*85;
+		pixels = mtswapped.width*mtswapped.height/64*85;
 		tx = (texture_t *) Hunk_AllocName (sizeof(texture_t) +pixels, loadname );
 		loadmodel->textures[i] = tx;
 
 		memcpy (tx->name, mt->name, sizeof(tx->name));
-		tx->width = mt->width;
-		tx->height = mt->height;
+		tx->width = mtswapped.width;
+		tx->height = mtswapped.height;
 		for (j=0 ; j<MIPLEVELS ; j++)
-			tx->offsets[j] = mt->offsets[j] + sizeof(texture_t) - sizeof(miptex_t);
+			tx->offsets[j] = mtswapped.offsets[j] + sizeof(texture_t) - sizeof(miptex_t);
 		// the pixels immediately follow the structures
 
 		// ericw -- check for pixels extending past the end of the lump.
@@ -666,7 +893,7 @@ void Mod_LoadTextures (lump_t *l)
                             if (loadmodel->bspversion == HL_BSPVERSION) {
                                 byte *data;
 
-                                data = WAD3_LoadTexture(mt);
+                                data = WAD3_LoadTexture(&mtswapped, (byte *)mt);
 
                                 q_snprintf (texturename, sizeof(texturename), "%s:%s", loadmodel->name, tx->name);
                                 offset = (src_offset_t)(mt+1) - (src_offset_t)mod_base;
@@ -2157,17 +2384,20 @@ void Mod_BoundsFromClipNode (qmodel_t *mod, int hull, int nodenum)
 Mod_LoadBrushModel
 =================
 */
-void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
+void Mod_LoadBrushModel (qmodel_t *mod, const void *buffer)
 {
 	int			i, j;
 	int			bsp2;
-	dheader_t	*header;
+	dheader_t	*header, swapped;
 	dmodel_t 	*bm;
 	float		radius; //johnfitz
 
 	loadmodel->type = mod_brush;
 
-	header = (dheader_t *)buffer;
+// buffer is the mapped file and must not be written, so the header is
+// swapped in a copy
+	memcpy (&swapped, buffer, sizeof(swapped));
+	header = &swapped;
 
 	mod->bspversion = LittleLong (header->version);
 
@@ -2191,7 +2421,7 @@ void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 	}
 
 // swap all the lumps
-	mod_base = (byte *)header;
+	mod_base = (byte *)buffer;
 
 	for (i = 0; i < (int) sizeof(dheader_t) / 4; i++)
 		((int *)header)[i] = LittleLong ( ((int *)header)[i]);
@@ -2974,10 +3204,13 @@ void Mod_LoadAliasModel (qmodel_t *mod, void *buffer)
 	end = Hunk_LowMark ();
 	total = end - start;
 
-	Cache_Alloc (&mod->cache, total, loadname);
-	if (!mod->cache.data)
-		return;
-	memcpy (mod->cache.data, pheader, total);
+	if (!Mod_RetainData (mod, pheader, total))
+	{
+		Cache_Alloc (&mod->cache, total, loadname);
+		if (!mod->cache.data)
+			return;
+		memcpy (mod->cache.data, pheader, total);
+	}
 
 	Hunk_FreeToLowMark (start);
 }
@@ -3101,6 +3334,33 @@ void * Mod_LoadSpriteGroup (void * pin, mspriteframe_t **ppframe, int framenum)
 }
 
 
+/*
+=================
+Mod_RelocateSprite
+
+Fixes up the pointers of a sprite that has been copied from old
+=================
+*/
+static void Mod_RelocateSprite (msprite_t *psprite, const byte *old)
+{
+	ptrdiff_t		delta;
+	mspritegroup_t	*group;
+	int				i, j;
+
+	delta = (byte *)psprite - old;
+	for (i=0 ; i<psprite->numframes ; i++)
+	{
+		psprite->frames[i].frameptr = (mspriteframe_t *)((byte *)psprite->frames[i].frameptr + delta);
+		if (psprite->frames[i].type == SPR_SINGLE)
+			continue;
+
+		group = (mspritegroup_t *)psprite->frames[i].frameptr;
+		group->intervals = (float *)((byte *)group->intervals + delta);
+		for (j=0 ; j<group->numframes ; j++)
+			group->frames[j] = (mspriteframe_t *)((byte *)group->frames[j] + delta);
+	}
+}
+
 /*
 =================
 Mod_LoadSpriteModel
@@ -3111,9 +3371,10 @@ void Mod_LoadSpriteModel (qmodel_t *mod, void *buffer)
 	int					i;
 	int					version;
 	dsprite_t			*pin;
-	msprite_t			*psprite;
+	msprite_t			*psprite, *copy;
 	int					numframes;
 	int					size;
+	int					start, header;
 	dspriteframetype_t	*pframetype;
 
 	pin = (dsprite_t *)buffer;
@@ -3128,7 +3389,9 @@ void Mod_LoadSpriteModel (qmodel_t *mod, void *buffer)
 
 	size = sizeof (msprite_t) + (numframes - 1) * sizeof (psprite->frames);
 
+	start = Hunk_LowMark ();
 	psprite = (msprite_t *) Hunk_AllocName (size, loadname);
+	header = Hunk_LowMark () - start - ((size + 15) & ~15);
 
 	mod->cache.data = psprite;
 
@@ -3174,6 +3437,16 @@ void Mod_LoadSpriteModel (qmodel_t *mod, void *buffer)
 	}
 
 	mod->type = mod_sprite;
+
+//
+// a retained sprite is moved off the hunk in one piece
+//
+	copy = (msprite_t *) Mod_RetainData (mod, psprite, Hunk_LowMark () - start - header);
+	if (copy)
+	{
+		Mod_RelocateSprite (copy, (byte *)psprite);
+		Hunk_FreeToLowMark (start);
+	}
 }
 
 //=============================================================================
@@ -3191,7 +3464,10 @@ void Mod_Print (void)
 	Con_SafePrintf ("Cached models:\n"); //johnfitz -- safeprint instead of print
 	for (i=0, mod=mod_known ; i < mod_numknown ; i++, mod++)
 	{
-		Con_SafePrintf ("%8p : %s\n", mod->cache.data, mod->name); //johnfitz -- safeprint instead of print
+		if (mod->retained)
+			Con_SafePrintf ("%8p : %s, retained %i KB\n", mod->cache.data, mod->name, mod->retainsize / 1024);
+		else
+			Con_SafePrintf ("%8p : %s\n", mod->cache.data, mod->name); //johnfitz -- safeprint instead of print
 	}
 	Con_Printf ("%i models\n",mod_numknown); //johnfitz -- print the total too
 }
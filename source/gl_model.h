@@ -511,6 +511,15 @@ typedef struct qmodel_s
 	int			vboxyzofs;      // offset in vbo of hdr->numposes*hdr->numverts_vbo meshxyz_t
 	int			vbostofs;       // offset in vbo of hdr->numverts_vbo meshst_t
 
+//
+// alias and sprite models kept across map changes, see Mod_ClearAll
+//
+	qboolean	retained;		// cache.data is Mem_Alloc'd, not in the cache
+	unsigned int	filehash;	// COM_HashBlock of the file it was loaded from
+	int			retainsize;		// bytes of data, textures and vertex buffers
+	int			usedmap;		// mod_mapcount when it was last loaded or used
+	int			checkedmap;		// mod_mapcount when filehash was last checked
+
 //
 // additional model data
 //
@@ -526,6 +535,7 @@ void	Mod_ResetAll (void); // for gamedir changes (Host_Game_f)
 qmodel_t *Mod_ForName (const char *name, qboolean crash);
 void	*Mod_Extradata (qmodel_t *mod);	// handles caching
 void	Mod_TouchModel (const char *name);
+void	Mod_Prefetch (const char *name);
 
 mleaf_t *Mod_PointInLeaf (float *p, qmodel_t *model);
 byte	*Mod_LeafPVS (mleaf_t *leaf, qmodel_t *model);
@@ -426,7 +426,7 @@ void QMB_AllocParticles (void)
     }
 
 	// can't alloc on Hunk, using native memory
-	particles = (particle_t *) malloc (r_numparticles * sizeof(particle_t));
+	particles = (particle_t *) Mem_Alloc (MEM_PARTICLES, r_numparticles * sizeof(particle_t));
 }
 
 extern float loading_num_step;
@@ -1555,7 +1555,7 @@ void QMB_ClearParticles (void)
 	if (!qmb_initialized)
 		return;
 
-	free (particles);		// free
+	Mem_Free (particles);		// free
 	QMB_AllocParticles ();	// and alloc again
 	particle_count = 0;
 	memset (particles, 0, r_numparticles * sizeof(particle_t));
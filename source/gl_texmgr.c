@@ -444,6 +444,30 @@ void TexMgr_FreeTexturesForOwner (qmodel_t *owner)
 	}
 }
 
+/*
+================
+TexMgr_SizeForOwner
+
+Bytes of texture memory the owner's textures take, at 32 bits a texel
+================
+*/
+int TexMgr_SizeForOwner (qmodel_t *owner)
+{
+	gltexture_t	*glt;
+	float	texels = 0;
+
+	for (glt = active_gltextures; glt; glt = glt->next)
+	{
+		if (glt->owner != owner)
+			continue;
+		if (glt->flags & TEXPREF_MIPMAP)
+			texels += glt->width * glt->height * 4.0f / 3.0f;
+		else
+			texels += glt->width * glt->height;
+	}
+	return (int)texels * 4;
+}
+
 /*
 ================
 TexMgr_DeleteTextureObjects
@@ -1313,6 +1337,7 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 	unsigned short crc;
 	gltexture_t *glt;
 	int mark;
+	memtag_t oldtag;
 
 	if (isDedicated)
 		return NULL;
@@ -1357,6 +1382,7 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 	glt->source_crc = crc;
 
 	//upload it
+	oldtag = Mem_SetTag (MEM_TEXTURES);
 	mark = Hunk_LowMark();
 
 	switch (glt->source_format)
@@ -1374,6 +1400,7 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 	}
 
 	Hunk_FreeToLowMark(mark);
+	Mem_SetTag (oldtag);
 
 	return glt;
 }
@@ -326,6 +326,7 @@ void Host_WriteConfiguration (void)
 		//johnfitz
 
 		fclose (f);
+		COM_FileCreated (va("%s/config.cfg", com_gamedir));
 	}
 }
 
@@ -480,6 +481,7 @@ void Host_ShutdownServer(qboolean crash)
 	if (!sv.active)
 		return;
 
+	SV_RecordStop ();
 	sv.active = false;
 
 // stop all client sounds immediately
@@ -554,8 +556,9 @@ void Host_ClearMemory (void)
 	Mod_ClearAll ();
 /* host_hunklevel MUST be set at this point */
 	Hunk_FreeToLowMark (host_hunklevel);
+	Hunk_Trim ();
 	cls.signon = 0;
-	free(sv.edicts); // ericw -- sv.edicts switched to use malloc()
+	Mem_Free (sv.edicts); // ericw -- sv.edicts switched to use malloc()
 	memset (&sv, 0, sizeof(sv));
 	memset (&cl, 0, sizeof(cl));
 
@@ -649,6 +652,10 @@ void Host_ServerFrame (void)
 {
 	int		i, active; //johnfitz
 	edict_t	*ent; //johnfitz
+	memtag_t	oldtag;
+
+	oldtag = Mem_SetTag (MEM_QC);
+	SV_RecordFrameBegin ();
 
 // run the world state
 	pr_global_struct->frametime = host_frametime;
@@ -683,8 +690,16 @@ void Host_ServerFrame (void)
 	}
 //johnfitz
 
+	SV_RecordFrameEnd ();
+
 // send all messages to the clients
 	SV_SendClientMessages ();
+
+// free this frame's temp strings
+	PR_StringsFrame ();
+	Frame_Reset (FRAME_SERVER);
+
+	Mem_SetTag (oldtag);
 }
 
 /*
@@ -788,6 +803,9 @@ void _Host_Frame (float time)
 					pass1+pass2+pass3, pass1, pass2, pass3);
 	}
 
+	Mem_Frame ();
+	Frame_Reset (FRAME_CLIENT);
+
 	host_framecount++;
 
 }
@@ -828,28 +846,50 @@ void Host_Frame (float time)
 	Con_Printf ("serverprofile: %2i clients %2i msec\n",  c,  m);
 }
 
+static const char *host_preload[] =
+{
+	"models/player.mdl",
+
+	"models/ai/zb%.mdl",
+	"models/ai/zbc%.mdl",
+	"models/ai/zfull.mdl",
+	"models/ai/zcfull.mdl",
+	"models/ai/zh^.mdl",
+	"models/ai/zhc^.mdl",
+	"models/ai/zal(.mdl",
+	"models/ai/zalc(.mdl",
+	"models/ai/zar(.mdl",
+	"models/ai/zarc(.mdl",
+
+	"models/weapons/knife/v_knife.mdl",
+	"models/weapons/m1911/v_colt.mdl",
+	"models/pu/instakill!.mdl",
+	"models/pu/maxammo!.mdl",
+	"models/pu/nuke!.mdl",
+	"models/pu/carpenter!.mdl",
+	"models/pu/x2!.mdl"
+};
+
+/*
+====================
+Preload
+
+The models every map uses. They are prefetched as soon as the filesystem
+is up, and read while the rest of the engine starts.
+====================
+*/
 void Preload (void)
 {
-	Mod_ForName ("models/player.mdl", true);
-
-	Mod_ForName("models/ai/zb%.mdl", true);
-	Mod_ForName("models/ai/zbc%.mdl", true);
-	Mod_ForName ("models/ai/zfull.mdl",true);
-	Mod_ForName ("models/ai/zcfull.mdl",true);
-	Mod_ForName ("models/ai/zh^.mdl",true);
-	Mod_ForName ("models/ai/zhc^.mdl",true);
-	Mod_ForName ("models/ai/zal(.mdl",true);
-	Mod_ForName ("models/ai/zalc(.mdl",true);
-	Mod_ForName ("models/ai/zar(.mdl",true);
-	Mod_ForName ("models/ai/zarc(.mdl",true);
-
-	Mod_ForName ("models/weapons/knife/v_knife.mdl", true);
-	Mod_ForName ("models/weapons/m1911/v_colt.mdl", true);
-	Mod_ForName ("models/pu/instakill!.mdl", true);
-	Mod_ForName ("models/pu/maxammo!.mdl", true);
-	Mod_ForName ("models/pu/nuke!.mdl", true);
-	Mod_ForName ("models/pu/carpenter!.mdl", true);
-	Mod_ForName ("models/pu/x2!.mdl", true);
+	double	start, waited;
+	int		i;
+
+	start = Sys_PreciseTime ();
+	waited = COM_PrefetchWaitTime ();
+	for (i = 0; i < (int)(sizeof(host_preload) / sizeof(host_preload[0])); i++)
+		Mod_ForName (host_preload[i], true);
+	COM_PrefetchFlush ();
+	Con_DPrintf ("Preloaded %i models in %.1f ms, %.1f ms waiting on reads\n", i,
+		(Sys_PreciseTime () - start) * 1000, (COM_PrefetchWaitTime () - waited) * 1000);
 }
 
 /*
@@ -859,6 +899,8 @@ Host_Init
 */
 void Host_Init (void)
 {
+	int		i;
+
 	if (standard_quake)
 		minimum_memory = MINIMUM_MEMORY;
 	else	minimum_memory = MINIMUM_MEMORY_LEVELPAK;
@@ -872,13 +914,15 @@ void Host_Init (void)
 	com_argc = host_parms->argc;
 	com_argv = host_parms->argv;
 
-	Memory_Init (host_parms->membase, host_parms->memsize);
+	Memory_Init (host_parms->membase, host_parms->memsize, host_parms->memreserve);
 	Cbuf_Init ();
 	Cmd_Init ();
 	LOG_Init (host_parms);
 	Cvar_Init (); //johnfitz
 	COM_Init ();
 	COM_InitFilesystem ();
+	for (i = 0; i < (int)(sizeof(host_preload) / sizeof(host_preload[0])); i++)
+		COM_Prefetch (host_preload[i]);
 	Host_InitLocal ();
 	W_LoadWadFile (); //johnfitz -- filename is now hard-coded for honesty
 	if (cls.state != ca_dedicated)
@@ -888,7 +932,9 @@ void Host_Init (void)
 	}
 	PR_Init ();
 	Mod_Init ();
+	Mem_SetTag (MEM_NET);
 	NET_Init ();
+	Mem_SetTag (MEM_MISC);
 	SV_Init ();
 
 	Con_Printf ("Exe: " __TIME__ " " __DATE__ "\n");
@@ -908,11 +954,15 @@ void Host_Init (void)
 		DemoList_Init (); //ericw
 		VID_Init ();
 		IN_Init ();
+		Mem_SetTag (MEM_TEXTURES);
 		TexMgr_Init (); //johnfitz
+		Mem_SetTag (MEM_MISC);
 		Draw_Init ();
 		SCR_Init ();
 		R_Init ();
+		Mem_SetTag (MEM_SOUNDS);
 		S_Init ();
+		Mem_SetTag (MEM_MISC);
 		CDAudio_Init ();
 		BGM_Init();
 		Sbar_Init ();
@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 
 extern cvar_t	pausable;
+extern cvar_t	sv_savebinary;
 
 int	current_skill;
 
@@ -587,12 +588,14 @@ void Host_Noclip_f (void)
 		{
 			noclip_anglehack = true;
 			sv_player->v.movetype = MOVETYPE_NOCLIP;
+			SV_MirrorSync (sv_player);
 			SV_ClientPrintf ("noclip ON\n");
 		}
 		else
 		{
 			noclip_anglehack = false;
 			sv_player->v.movetype = MOVETYPE_WALK;
+			SV_MirrorSync (sv_player);
 			SV_ClientPrintf ("noclip OFF\n");
 		}
 		break;
@@ -601,12 +604,14 @@ void Host_Noclip_f (void)
 		{
 			noclip_anglehack = true;
 			sv_player->v.movetype = MOVETYPE_NOCLIP;
+			SV_MirrorSync (sv_player);
 			SV_ClientPrintf ("noclip ON\n");
 		}
 		else
 		{
 			noclip_anglehack = false;
 			sv_player->v.movetype = MOVETYPE_WALK;
+			SV_MirrorSync (sv_player);
 			SV_ClientPrintf ("noclip OFF\n");
 		}
 		break;
@@ -655,6 +660,7 @@ void Host_SetPos_f(void)
 	{
 		noclip_anglehack = true;
 		sv_player->v.movetype = MOVETYPE_NOCLIP;
+		SV_MirrorSync (sv_player);
 		SV_ClientPrintf ("noclip ON\n");
 	}
 	
@@ -703,11 +709,13 @@ void Host_Fly_f (void)
 		if (sv_player->v.movetype != MOVETYPE_FLY)
 		{
 			sv_player->v.movetype = MOVETYPE_FLY;
+			SV_MirrorSync (sv_player);
 			SV_ClientPrintf ("flymode ON\n");
 		}
 		else
 		{
 			sv_player->v.movetype = MOVETYPE_WALK;
+			SV_MirrorSync (sv_player);
 			SV_ClientPrintf ("flymode OFF\n");
 		}
 		break;
@@ -715,11 +723,13 @@ void Host_Fly_f (void)
 		if (Q_atof(Cmd_Argv(1)))
 		{
 			sv_player->v.movetype = MOVETYPE_FLY;
+			SV_MirrorSync (sv_player);
 			SV_ClientPrintf ("flymode ON\n");
 		}
 		else
 		{
 			sv_player->v.movetype = MOVETYPE_WALK;
+			SV_MirrorSync (sv_player);
 			SV_ClientPrintf ("flymode OFF\n");
 		}
 		break;
@@ -1026,6 +1036,8 @@ void Host_Savegame_f (void)
 	FILE	*f;
 	int	i;
 	char	comment[SAVEGAME_COMMENT_LENGTH+1];
+	qboolean	binary;
+	double	start;
 
 	if (cmd_source != src_command)
 		return;
@@ -1048,9 +1060,14 @@ void Host_Savegame_f (void)
 		return;
 	}
 
-	if (Cmd_Argc() != 2)
+	binary = sv_savebinary.value != 0;
+	if (Cmd_Argc() == 3 && !strcmp(Cmd_Argv(2), "text"))
+		binary = false;
+	else if (Cmd_Argc() == 3 && !strcmp(Cmd_Argv(2), "binary"))
+		binary = true;
+	else if (Cmd_Argc() != 2)
 	{
-		Con_Printf ("save <savename> : save a game\n");
+		Con_Printf ("save <savename> [text|binary] : save a game\n");
 		return;
 	}
 
@@ -1073,6 +1090,16 @@ void Host_Savegame_f (void)
 	COM_AddExtension (name, ".sav", sizeof(name));
 
 	Con_Printf ("Saving game to %s...\n", name);
+	start = Sys_DoubleTime ();
+
+	if (binary)
+	{
+		Host_SavegameComment (comment);
+		if (SV_SaveGameBinary (name, comment))
+			Con_Printf ("done in %.1f ms.\n", (Sys_DoubleTime () - start) * 1000);
+		return;
+	}
+
 	f = fopen (name, "w");
 	if (!f)
 	{
@@ -1107,10 +1134,34 @@ void Host_Savegame_f (void)
 		fflush (f);
 	}
 	fclose (f);
-	Con_Printf ("done.\n");
+	Con_Printf ("done in %.1f ms.\n", (Sys_DoubleTime () - start) * 1000);
 }
 
 
+/*
+===============
+Host_Quicksave_f
+===============
+*/
+void Host_Quicksave_f (void)
+{
+	if (cmd_source != src_command)
+		return;
+	Cbuf_AddText ("save quick\n");
+}
+
+/*
+===============
+Host_Quickload_f
+===============
+*/
+void Host_Quickload_f (void)
+{
+	if (cmd_source != src_command)
+		return;
+	Cbuf_AddText ("load quick\n");
+}
+
 /*
 ===============
 Host_Loadgame_f
@@ -1155,6 +1206,18 @@ void Host_Loadgame_f (void)
 //	SCR_BeginLoadingPlaque ();
 
 	Con_Printf ("Loading game from %s...\n", name);
+
+	if (SV_IsBinarySave (name))
+	{
+		if (!SV_LoadGameBinary (name))
+			return;
+		if (cls.state != ca_dedicated)
+		{
+			CL_EstablishConnection ("local");
+			Host_Reconnect_f ();
+		}
+		return;
+	}
 	
 // avoid leaking if the previous Host_Loadgame_f failed with a Host_Error
 	if (start != NULL)
@@ -1248,6 +1311,7 @@ void Host_Loadgame_f (void)
 
 	sv.num_edicts = entnum;
 	sv.time = time;
+	SV_MirrorRebuild ();
 
 	free (start);
 	start = NULL;
@@ -1644,6 +1708,7 @@ void Host_Spawn_f (void)
 		ent = host_client->edict;
 
 		memset (&ent->v, 0, progs->entityfields * 4);
+		SV_MirrorSync (ent);
 		ent->v.colormap = NUM_FOR_EDICT(ent);
 		ent->v.team = (host_client->colors & 15) + 1;
 		ent->v.netname = PR_SetEngineString(host_client->name);
@@ -1746,6 +1811,27 @@ void Host_Begin_f (void)
 	host_client->spawned = true;
 }
 
+/*
+==================
+Host_Predict_f
+
+The client predicts its own movement and wants to hear which of its moves
+each update includes
+==================
+*/
+void Host_Predict_f (void)
+{
+	if (cmd_source == src_command)
+	{
+		Con_Printf ("predict is not valid from the console\n");
+		return;
+	}
+
+	host_client->predict = true;
+	host_client->movesequence = 0;
+	memset (&host_client->movevars, 0, sizeof(host_client->movevars));	// force a svc_movevars
+}
+
 //===========================================================================
 
 
@@ -2113,11 +2199,14 @@ void Host_InitCommands (void)
 	Cmd_AddCommand ("pause", Host_Pause_f);
 	Cmd_AddCommand ("spawn", Host_Spawn_f);
 	Cmd_AddCommand ("begin", Host_Begin_f);
+	Cmd_AddCommand ("predict", Host_Predict_f);
 	Cmd_AddCommand ("prespawn", Host_PreSpawn_f);
 	Cmd_AddCommand ("kick", Host_Kick_f);
 	Cmd_AddCommand ("ping", Host_Ping_f);
 	Cmd_AddCommand ("load", Host_Loadgame_f);
 	Cmd_AddCommand ("save", Host_Savegame_f);
+	Cmd_AddCommand ("quickload", Host_Quickload_f);
+	Cmd_AddCommand ("quicksave", Host_Quicksave_f);
 	Cmd_AddCommand ("give", Host_Give_f);
 
 	Cmd_AddCommand ("startdemos", Host_Startdemos_f);
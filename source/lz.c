@@ -0,0 +1,243 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+/* lz.c -- small LZ77 block codec
+
+   The stream is a list of sequences:
+	byte	token		high nibble: literal count, low nibble: match length - LZ_MINMATCH
+	[byte]*	literal count	present if the high nibble is 15, 255 means more bytes follow
+	byte[]	literals
+	short	offset		little endian, 1 .. 65535, may reach back into the dictionary
+	[byte]*	match length	present if the low nibble is 15, 255 means more bytes follow
+   The last sequence stops after its literals.
+*/
+
+#include "quakedef.h"
+
+#define	LZ_MINMATCH		4
+#define	LZ_MAXOFFSET		65535
+#define	LZ_HASH_BITS		13
+#define	LZ_HASH_SIZE		(1 << LZ_HASH_BITS)
+#define	LZ_WINDOW_MASK		0xffff
+#define	LZ_MAX_CHAIN		32
+
+static byte	lz_window[LZ_MAX_DICT + LZ_MAX_INPUT];
+static int	lz_head[LZ_HASH_SIZE];
+static int	lz_prev[LZ_WINDOW_MASK + 1];
+
+static inline unsigned int LZ_Hash (const byte *p)
+{
+	unsigned int v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static inline void LZ_Insert (int pos)
+{
+	unsigned int h = LZ_Hash (lz_window + pos);
+	lz_prev[pos & LZ_WINDOW_MASK] = lz_head[h];
+	lz_head[h] = pos;
+}
+
+static byte *LZ_WriteLength (byte *op, const byte *oend, int len)
+{
+	for ( ; len >= 255; len -= 255)
+	{
+		if (op >= oend)
+			return NULL;
+		*op++ = 255;
+	}
+	if (op >= oend)
+		return NULL;
+	*op++ = len;
+	return op;
+}
+
+static byte *LZ_WriteSequence (byte *op, const byte *oend, const byte *lit, int litlen, int offset, int matchlen)
+{
+	int	ml = matchlen ? matchlen - LZ_MINMATCH : 0;
+
+	if (op >= oend)
+		return NULL;
+	*op++ = ((litlen < 15 ? litlen : 15) << 4) | (ml < 15 ? ml : 15);
+	if (litlen >= 15 && !(op = LZ_WriteLength (op, oend, litlen - 15)))
+		return NULL;
+	if (op + litlen > oend)
+		return NULL;
+	memcpy (op, lit, litlen);
+	op += litlen;
+
+	if (!matchlen)
+		return op;
+
+	if (op + 2 > oend)
+		return NULL;
+	*op++ = offset & 0xff;
+	*op++ = offset >> 8;
+	if (ml >= 15 && !(op = LZ_WriteLength (op, oend, ml - 15)))
+		return NULL;
+	return op;
+}
+
+/*
+==============
+LZ_Compress
+
+Greedy hash chain matcher. The dictionary is placed in front of the
+input so that the first occurrence of common strings can already be
+coded as a match.
+==============
+*/
+int LZ_Compress (const byte *dict, int dictlen, const byte *in, int inlen, byte *out, int outsize)
+{
+	int		pos, anchor, total;
+	int		cand, len, bestlen, bestpos, chain;
+	byte		*op = out;
+	const byte	*oend = out + outsize;
+
+	if (dictlen > LZ_MAX_DICT || inlen > LZ_MAX_INPUT || inlen <= 0)
+		return 0;
+
+	if (dictlen)
+		memcpy (lz_window, dict, dictlen);
+	memcpy (lz_window + dictlen, in, inlen);
+	total = dictlen + inlen;
+
+	memset (lz_head, -1, sizeof(lz_head));
+	for (pos = 0; pos < dictlen && pos + LZ_MINMATCH <= total; pos++)
+		LZ_Insert (pos);
+
+	anchor = pos = dictlen;
+	while (pos + LZ_MINMATCH <= total)
+	{
+		bestlen = 0;
+		bestpos = 0;
+		cand = lz_head[LZ_Hash (lz_window + pos)];
+		for (chain = 0; cand >= 0 && chain < LZ_MAX_CHAIN; chain++)
+		{
+			if (pos - cand > LZ_MAXOFFSET)
+				break;
+			if (lz_window[cand + bestlen] == lz_window[pos + bestlen])
+			{
+				for (len = 0; pos + len < total && lz_window[cand + len] == lz_window[pos + len]; len++)
+					;
+				if (len > bestlen)
+				{
+					bestlen = len;
+					bestpos = cand;
+					if (pos + len == total)
+						break;
+				}
+			}
+			len = lz_prev[cand & LZ_WINDOW_MASK];
+			if (len >= cand)
+				break;
+			cand = len;
+		}
+
+		if (bestlen < LZ_MINMATCH)
+		{
+			LZ_Insert (pos);
+			pos++;
+			continue;
+		}
+
+		op = LZ_WriteSequence (op, oend, lz_window + anchor, pos - anchor, pos - bestpos, bestlen);
+		if (!op)
+			return 0;
+
+		for (len = 0; len < bestlen; len++, pos++)
+		{
+			if (pos + LZ_MINMATCH <= total)
+				LZ_Insert (pos);
+		}
+		anchor = pos;
+	}
+
+	op = LZ_WriteSequence (op, oend, lz_window + anchor, total - anchor, 0, 0);
+	if (!op)
+		return 0;
+
+	return op - out;
+}
+
+static const byte *LZ_ReadLength (const byte *ip, const byte *iend, int *len)
+{
+	int	b;
+
+	do
+	{
+		if (ip >= iend)
+			return NULL;
+		b = *ip++;
+		*len += b;
+	} while (b == 255);
+
+	return ip;
+}
+
+/*
+==============
+LZ_Decompress
+==============
+*/
+int LZ_Decompress (const byte *dict, int dictlen, const byte *in, int inlen, byte *out, int outsize)
+{
+	const byte	*ip = in;
+	const byte	*iend = in + inlen;
+	int		token, litlen, matchlen, offset;
+	int		outpos = 0;
+	int		src;
+
+	while (ip < iend)
+	{
+		token = *ip++;
+
+		litlen = token >> 4;
+		if (litlen == 15 && !(ip = LZ_ReadLength (ip, iend, &litlen)))
+			return -1;
+		if (ip + litlen > iend || outpos + litlen > outsize)
+			return -1;
+		memcpy (out + outpos, ip, litlen);
+		ip += litlen;
+		outpos += litlen;
+
+		if (ip == iend)
+			break;
+
+		if (ip + 2 > iend)
+			return -1;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		matchlen = (token & 15);
+		if (matchlen == 15 && !(ip = LZ_ReadLength (ip, iend, &matchlen)))
+			return -1;
+		matchlen += LZ_MINMATCH;
+
+		if (offset == 0 || offset > outpos + dictlen || outpos + matchlen > outsize)
+			return -1;
+
+		// copy byte by byte, the source may overlap the destination
+		// or start inside the dictionary
+		for (src = outpos - offset; matchlen; matchlen--, src++)
+			out[outpos++] = (src < 0) ? dict[dictlen + src] : out[src];
+	}
+
+	return outpos;
+}
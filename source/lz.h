@@ -0,0 +1,38 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef _QUAKE_LZ_H
+#define _QUAKE_LZ_H
+
+/* lz.h -- small LZ77 block codec with preset dictionary support */
+
+#define	LZ_MAX_DICT		4096
+#define	LZ_MAX_INPUT		65536
+
+// returns the compressed size, or 0 if the data did not fit in outsize
+// (i.e. it is not worth compressing)
+int LZ_Compress (const byte *dict, int dictlen, const byte *in, int inlen, byte *out, int outsize);
+
+// returns the decompressed size, or -1 if the data is corrupt or does
+// not fit in outsize. dict must match the one given to LZ_Compress.
+int LZ_Decompress (const byte *dict, int dictlen, const byte *in, int inlen, byte *out, int outsize);
+
+#endif	/* _QUAKE_LZ_H */
@@ -89,6 +89,11 @@ static void Sys_InitSDL (void)
 #define DEFAULT_MEMORY (512 * 1024 * 1024) // ericw -- was 72MB (64-bit) / 64MB (32-bit)
 #endif
 
+// address space set aside for the hunk to grow into. Only what is used
+// gets committed, so this costs nothing on 64-bit; -heapsize is then just
+// the share of it the data cache may take.
+#define DEFAULT_RESERVE ((sizeof(void *) > 4) ? (1536 * 1024 * 1024) : DEFAULT_MEMORY)
+
 static quakeparms_t	parms;
 
 // On OS X we call SDL_main from the launcher, but SDL2 doesn't redefine main
@@ -158,7 +163,27 @@ int main(int argc, char *argv[])
 			parms.memsize = Q_atoi(com_argv[t]) * 1024;
 	}
 
-	parms.membase = malloc (parms.memsize);
+	parms.memreserve = 0;
+	parms.membase = NULL;
+	if (!COM_CheckParm("-nohunkreserve"))
+	{
+		t = DEFAULT_RESERVE;
+		if (COM_CheckParm("-hunkreserve"))
+		{
+			t = COM_CheckParm("-hunkreserve") + 1;
+			t = (t < com_argc) ? q_min(Q_atoi(com_argv[t]), 2047) * 1024 * 1024 : DEFAULT_RESERVE;	// hunk offsets are ints
+		}
+		if (t > 0)
+		{
+			parms.memreserve = q_max(t, parms.memsize);
+			parms.membase = Sys_ReserveMemory (parms.memreserve);
+		}
+		if (!parms.membase)
+			parms.memreserve = 0;
+	}
+
+	if (!parms.membase)
+		parms.membase = malloc (parms.memsize);
 
 	if (!parms.membase)
 		Sys_Error ("Not enough memory free; check disk space\n");
@@ -45,6 +45,7 @@ struct qsockaddr
 #define NETFLAG_NAK		0x00040000
 #define NETFLAG_EOM		0x00080000
 #define NETFLAG_UNRELIABLE	0x00100000
+#define NETFLAG_COMPRESSED	0x00200000	// reliable message body is LZ coded, see NET_EXT_COMPRESS
 #define NETFLAG_CTL		0x80000000
 
 #if (NETFLAG_LENGTH_MASK & NET_MAXMESSAGE) != NET_MAXMESSAGE
@@ -53,6 +54,12 @@ struct qsockaddr
 
 #define NET_PROTOCOL_VERSION	3
 
+// optional connection extensions, negotiated through the trailing
+// extension long of CCREQ_CONNECT / CCREP_ACCEPT
+#define NET_EXT_COMPRESS	(1<<0)	// large reliable messages may be LZ coded
+#define NET_EXT_SUPPORTED	(NET_EXT_COMPRESS)
+#define NET_EXT_MAGIC		0x4e5a5045	// "NZPE", tells our accept reply from another fork's
+
 /**
 
 This is the network info/connection protocol.  It is used to find Quake
@@ -67,6 +74,8 @@ General notes:
 CCREQ_CONNECT
 		string	game_name		"QUAKE"
 		byte	net_protocol_version	NET_PROTOCOL_VERSION
+		long	extensions		NET_EXT_* (optional)
+		short	dictionary_crc		only if NET_EXT_COMPRESS is set
 
 CCREQ_SERVER_INFO
 		string	game_name		"QUAKE"
@@ -80,6 +89,9 @@ CCREQ_RULE_INFO
 
 CCREP_ACCEPT
 		long	port
+		long	extensions		accepted NET_EXT_* (optional)
+		long	magic			NET_EXT_MAGIC, with the extensions
+		short	dictionary_crc		with the extensions
 
 CCREP_REJECT
 		string	reason
@@ -114,6 +126,12 @@ CCREP_RULE_INFO
 		a full address and port in a string.  It is used for returning the
 		address of a server that is not running locally.
 
+		The optional trailing fields of CCREQ_CONNECT and CCREP_ACCEPT
+		are ignored by peers that predate them, so an old client or
+		server simply ends up with no extensions. A client only takes
+		the extensions of an accept whose magic and dictionary_crc
+		match, other servers may append data of their own.
+
 **/
 
 #define CCREQ_CONNECT		0x01
@@ -148,6 +166,13 @@ typedef struct qsocket_s
 	unsigned int	unreliableSendSequence;
 	int		sendMessageLength;
 	byte		sendMessage [NET_MAXMESSAGE];
+	qboolean	sendCompressed;
+	double		reliableSendTime;	// when the pending reliable message was queued
+
+	unsigned int	extensions;	// NET_EXT_* negotiated at connect time
+	int		compressedMessages;
+	int		compressedBytesIn;	// uncompressed size of the coded messages
+	int		compressedBytesOut;
 
 	unsigned int	receiveSequence;
 	unsigned int	unreliableReceiveSequence;
@@ -28,6 +28,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "net_defs.h"
 #include "net_dgrm.h"
+#include "net_lag.h"
 
 // these two macros are to make the code more readable
 #define sfunc	net_landrivers[sock->landriver]
@@ -42,6 +43,56 @@ static int packetsReceived = 0;
 static int receivedDuplicateCount = 0;
 static int shortPacketCount = 0;
 static int droppedDatagrams;
+static int compressedMessagesSent = 0;
+static int compressedMessagesReceived = 0;
+static int compressedBytesIn = 0;
+static int compressedBytesOut = 0;
+static int decompressErrors = 0;
+static int bytesSent = 0;
+static int bytesReceived = 0;
+static int reliableAcked = 0;
+static double reliableAckTime = 0;
+static double reliableAckTimeMax = 0;
+
+static cvar_t	net_compress = {"net_compress", "1", CVAR_NONE};
+static cvar_t	net_compress_threshold = {"net_compress_threshold", "512", CVAR_NONE};
+
+/* preset dictionary for NET_EXT_COMPRESS: strings that show up in almost
+ * every NZP signon (precache lists, baselines, stufftext), so that even the
+ * first occurrence of them codes as a match. Both ends must use the same
+ * dictionary, its crc is exchanged at connect time. The most frequent
+ * strings go last, where the offsets are shortest. */
+static const char net_lzdict[] =
+	"sounds/misc/buy.wav\0sounds/misc/ching.wav\0sounds/misc/denybuy.wav\0"
+	"sounds/misc/power_on.wav\0sounds/misc/lamp_on.wav\0sounds/misc/perk_loop.wav\0"
+	"sounds/weapons/colt/magin.wav\0sounds/weapons/colt/magout.wav\0sounds/weapons/colt/shoot.wav\0"
+	"sounds/weapons/knife/knife.wav\0sounds/weapons/knife/knife_hit.wav\0"
+	"sounds/weapons/grenade/explode.wav\0sounds/weapons/grenade/throw.wav\0sounds/weapons/grenade/prime.wav\0"
+	"sounds/pu/drop.wav\0sounds/pu/pickup.wav\0sounds/pu/powerup.wav\0"
+	"sounds/pu/instakill.wav\0sounds/pu/maxammo.wav\0sounds/pu/nuke.wav\0sounds/pu/carpenter.wav\0sounds/pu/double_points.wav\0"
+	"sounds/rounds/eround.wav\0sounds/rounds/nround.wav\0sounds/rounds/splash.wav\0"
+	"sounds/player/footstep1.wav\0sounds/player/footstep2.wav\0sounds/player/footstep3.wav\0sounds/player/footstep4.wav\0"
+	"sounds/player/land.wav\0sounds/player/jump.wav\0sounds/player/pain4.wav\0"
+	"sounds/zombie/a0.wav\0sounds/zombie/a1.wav\0sounds/zombie/w0.wav\0sounds/zombie/w1.wav\0"
+	"sounds/zombie/d0.wav\0sounds/zombie/d1.wav\0sounds/zombie/t0.wav\0sounds/zombie/t1.wav\0"
+	"sounds/zombie/s0.wav\0sounds/zombie/s1.wav\0sounds/zombie/r0.wav\0sounds/zombie/r1.wav\0"
+	"sounds/menu/enter.wav\0sounds/menu/navigate.wav\0sounds/null.wav\0"
+	"models/weapons/m1911/v_colt.mdl\0models/weapons/m1911/g_colt.mdl\0"
+	"models/weapons/knife/v_knife.mdl\0models/weapons/grenade/v_grenade.mdl\0models/weapons/grenade/g_grenade.mdl\0"
+	"models/pu/instakill!.mdl\0models/pu/maxammo!.mdl\0models/pu/nuke!.mdl\0models/pu/carpenter!.mdl\0models/pu/x2!.mdl\0"
+	"models/machines/quick_revive.mdl\0models/machines/juggernog.mdl\0models/machines/speed_cola.mdl\0models/machines/double_tap.mdl\0"
+	"models/props/teddy.mdl\0models/props/sly_door.mdl\0models/misc/bolt.mdl\0models/misc/bolt2.mdl\0models/player.mdl\0"
+	"models/ai/zal(.mdl\0models/ai/zalc(.mdl\0models/ai/zar(.mdl\0models/ai/zarc(.mdl\0"
+	"models/ai/zh^.mdl\0models/ai/zhc^.mdl\0models/ai/zb%.mdl\0models/ai/zbc%.mdl\0"
+	"models/ai/zfull.mdl\0models/ai/zcfull.mdl\0"
+	"progs/player.mdl\0progs/flame.mdl\0progs/flame2.mdl\0progs/bolt1.mdl\0progs/bolt3.mdl\0"
+	"mmnmmommommnonmmonqnmmo\0abcdefghijklmnopqrstuvwxyzyxwvutsrqponmlkjihgfedcba\0"
+	"mmmmmaaaaammmmmaaaaaabcdefgabcdefg\0mamamamamama\0jklmnopqrstuvwxyzyxwvutsrqponmlkj\0"
+	"nmonqnmomnmomomno\0mmmaaaabcdefgmmmmaaaammmaamm\0aaaaaaaazzzzzzzz\0mmamammmmammamamaaamammma\0"
+	"abcdefghijklmnopqrrqponmlkjihgfedcba\0m\0a\0z\0"
+	"maps/\0.bsp\0.mdl\0.spr\0.wav\0";
+
+static unsigned short	net_lzdictcrc;
 
 static struct
 {
@@ -129,6 +180,40 @@ static void NET_Ban_f (void)
 #endif	// BAN_TEST
 
 
+/*
+==================
+Datagram_PackMessage
+
+Copies a reliable message into the socket's send buffer, LZ coding it
+if the peer negotiated NET_EXT_COMPRESS and that makes it smaller.
+==================
+*/
+static void Datagram_PackMessage (qsocket_t *sock, sizebuf_t *data)
+{
+	int	len = 0;
+
+	if ((sock->extensions & NET_EXT_COMPRESS) && data->cursize >= (int)net_compress_threshold.value)
+		len = LZ_Compress ((const byte *)net_lzdict, sizeof(net_lzdict) - 1, data->data, data->cursize, sock->sendMessage, data->cursize - 1);
+
+	if (len > 0)
+	{
+		sock->sendMessageLength = len;
+		sock->sendCompressed = true;
+		sock->compressedMessages++;
+		sock->compressedBytesIn += data->cursize;
+		sock->compressedBytesOut += len;
+		compressedMessagesSent++;
+		compressedBytesIn += data->cursize;
+		compressedBytesOut += len;
+		return;
+	}
+
+	Q_memcpy(sock->sendMessage, data->data, data->cursize);
+	sock->sendMessageLength = data->cursize;
+	sock->sendCompressed = false;
+}
+
+
 int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 {
 	unsigned int	packetLen;
@@ -146,12 +231,11 @@ int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 		Sys_Error("SendMessage: called with canSend == false\n");
 #endif
 
-	Q_memcpy(sock->sendMessage, data->data, data->cursize);
-	sock->sendMessageLength = data->cursize;
+	Datagram_PackMessage (sock, data);
 
-	if (data->cursize <= MAX_DATAGRAM)
+	if (sock->sendMessageLength <= MAX_DATAGRAM)
 	{
-		dataLen = data->cursize;
+		dataLen = sock->sendMessageLength;
 		eom = NETFLAG_EOM;
 	}
 	else
@@ -160,18 +244,22 @@ int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 		eom = 0;
 	}
 	packetLen = NET_HEADERSIZE + dataLen;
+	if (sock->sendCompressed)
+		eom |= NETFLAG_COMPRESSED;
 
 	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
 	packetBuffer.sequence = BigLong(sock->sendSequence++);
 	Q_memcpy (packetBuffer.data, sock->sendMessage, dataLen);
 
 	sock->canSend = false;
+	sock->reliableSendTime = net_time;
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+	if (NetLag_Write (sock, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
 		return -1;
 
 	sock->lastSendTime = net_time;
 	packetsSent++;
+	bytesSent += packetLen;
 	return 1;
 }
 
@@ -193,6 +281,8 @@ static int SendMessageNext (qsocket_t *sock)
 		eom = 0;
 	}
 	packetLen = NET_HEADERSIZE + dataLen;
+	if (sock->sendCompressed)
+		eom |= NETFLAG_COMPRESSED;
 
 	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
 	packetBuffer.sequence = BigLong(sock->sendSequence++);
@@ -200,11 +290,12 @@ static int SendMessageNext (qsocket_t *sock)
 
 	sock->sendNext = false;
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+	if (NetLag_Write (sock, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
 		return -1;
 
 	sock->lastSendTime = net_time;
 	packetsSent++;
+	bytesSent += packetLen;
 	return 1;
 }
 
@@ -226,6 +317,8 @@ static int ReSendMessage (qsocket_t *sock)
 		eom = 0;
 	}
 	packetLen = NET_HEADERSIZE + dataLen;
+	if (sock->sendCompressed)
+		eom |= NETFLAG_COMPRESSED;
 
 	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
 	packetBuffer.sequence = BigLong(sock->sendSequence - 1);
@@ -233,11 +326,12 @@ static int ReSendMessage (qsocket_t *sock)
 
 	sock->sendNext = false;
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+	if (NetLag_Write (sock, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
 		return -1;
 
 	sock->lastSendTime = net_time;
 	packetsReSent++;
+	bytesSent += packetLen;
 	return 1;
 }
 
@@ -275,10 +369,11 @@ int Datagram_SendUnreliableMessage (qsocket_t *sock, sizebuf_t *data)
 	packetBuffer.sequence = BigLong(sock->unreliableSendSequence++);
 	Q_memcpy (packetBuffer.data, data->data, data->cursize);
 
-	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+	if (NetLag_Write (sock, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
 		return -1;
 
 	packetsSent++;
+	bytesSent += packetLen;
 	return 1;
 }
 
@@ -298,7 +393,7 @@ int	Datagram_GetMessage (qsocket_t *sock)
 
 	while (1)
 	{
-		length = (unsigned int) sfunc.Read(sock->socket, (byte *)&packetBuffer,
+		length = (unsigned int) NetLag_Read(sock, (byte *)&packetBuffer,
 							NET_DATAGRAMSIZE, &readaddr);
 
 	//	if ((rand() & 255) > 220)
@@ -336,6 +431,7 @@ int	Datagram_GetMessage (qsocket_t *sock)
 
 		sequence = BigLong(packetBuffer.sequence);
 		packetsReceived++;
+		bytesReceived += length;
 
 		if (flags & NETFLAG_UNRELIABLE)
 		{
@@ -390,6 +486,9 @@ int	Datagram_GetMessage (qsocket_t *sock)
 			{
 				sock->sendMessageLength = 0;
 				sock->canSend = true;
+				reliableAcked++;
+				reliableAckTime += net_time - sock->reliableSendTime;
+				reliableAckTimeMax = q_max(reliableAckTimeMax, net_time - sock->reliableSendTime);
 			}
 			continue;
 		}
@@ -398,7 +497,7 @@ int	Datagram_GetMessage (qsocket_t *sock)
 		{
 			packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
 			packetBuffer.sequence = BigLong(sequence);
-			sfunc.Write (sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE, &readaddr);
+			NetLag_Write (sock, (byte *)&packetBuffer, NET_HEADERSIZE, &readaddr);
 
 			if (sequence != sock->receiveSequence)
 			{
@@ -409,6 +508,34 @@ int	Datagram_GetMessage (qsocket_t *sock)
 
 			length -= NET_HEADERSIZE;
 
+			if ((flags & NETFLAG_EOM) && (flags & NETFLAG_COMPRESSED))
+			{
+				int	n = -1;
+
+				Q_memcpy(sock->receiveMessage + sock->receiveMessageLength, packetBuffer.data, length);
+				length += sock->receiveMessageLength;
+				sock->receiveMessageLength = 0;
+
+				SZ_Clear(&net_message);
+				if (sock->extensions & NET_EXT_COMPRESS)
+					n = LZ_Decompress ((const byte *)net_lzdict, sizeof(net_lzdict) - 1, sock->receiveMessage, length,
+							net_message.data, net_message.maxsize);
+				if (n <= 0)
+				{
+					decompressErrors++;
+					Con_Printf("Bad compressed message from %s\n", sock->address);
+					return -1;
+				}
+				net_message.cursize = n;
+				sock->compressedMessages++;
+				sock->compressedBytesIn += n;
+				sock->compressedBytesOut += length;
+				compressedMessagesReceived++;
+
+				ret = 1;
+				break;
+			}
+
 			if (flags & NETFLAG_EOM)
 			{
 				SZ_Clear(&net_message);
@@ -438,6 +565,14 @@ static void PrintStats(qsocket_t *s)
 	Con_Printf("canSend = %4u   \n", s->canSend);
 	Con_Printf("sendSeq = %4u   ", s->sendSequence);
 	Con_Printf("recvSeq = %4u   \n", s->receiveSequence);
+	if (s->extensions & NET_EXT_COMPRESS)
+	{
+		Con_Printf("compressed = %4i  ", s->compressedMessages);
+		Con_Printf("%i -> %i bytes", s->compressedBytesIn, s->compressedBytesOut);
+		if (s->compressedBytesIn)
+			Con_Printf(" (%.1f%%)", 100.0 * s->compressedBytesOut / s->compressedBytesIn);
+		Con_Printf("\n");
+	}
 	Con_Printf("\n");
 }
 
@@ -457,6 +592,18 @@ static void NET_Stats_f (void)
 		Con_Printf("receivedDuplicateCount     = %i\n", receivedDuplicateCount);
 		Con_Printf("shortPacketCount           = %i\n", shortPacketCount);
 		Con_Printf("droppedDatagrams           = %i\n", droppedDatagrams);
+		Con_Printf("compressedMessagesSent     = %i\n", compressedMessagesSent);
+		Con_Printf("compressedMessagesReceived = %i\n", compressedMessagesReceived);
+		Con_Printf("compressedBytes            = %i -> %i", compressedBytesIn, compressedBytesOut);
+		if (compressedBytesIn)
+			Con_Printf(" (%.1f%%)", 100.0 * compressedBytesOut / compressedBytesIn);
+		Con_Printf("\n");
+		Con_Printf("decompressErrors           = %i\n", decompressErrors);
+		Con_Printf("bytesSent                  = %i\n", bytesSent);
+		Con_Printf("bytesReceived              = %i\n", bytesReceived);
+		if (reliableAcked)
+			Con_Printf("reliable ack time avg/max  = %.1f / %.1f ms\n", reliableAckTime * 1000.0 / reliableAcked, reliableAckTimeMax * 1000.0);
+		NetLag_PrintStats ();
 	}
 	else if (strcmp(Cmd_Argv(1), "*") == 0)
 	{
@@ -790,6 +937,10 @@ int Datagram_Init (void)
 	myDriverLevel = net_driverlevel;
 
 	Cmd_AddCommand ("net_stats", NET_Stats_f);
+	Cvar_RegisterVariable (&net_compress);
+	Cvar_RegisterVariable (&net_compress_threshold);
+	NetLag_Init ();
+	net_lzdictcrc = CRC_Block ((const byte *)net_lzdict, sizeof(net_lzdict) - 1);
 
 	if (safemode || COM_CheckParm("-nolan"))
 		return -1;
@@ -838,6 +989,7 @@ void Datagram_Shutdown (void)
 
 void Datagram_Close (qsocket_t *sock)
 {
+	NetLag_Close(sock);
 	sfunc.Close_Socket(sock->socket);
 }
 
@@ -854,6 +1006,20 @@ void Datagram_Listen (qboolean state)
 }
 
 
+/*
+=================
+_Datagram_WriteExtensions
+
+The trailing fields of CCREP_ACCEPT
+=================
+*/
+static void _Datagram_WriteExtensions (unsigned int extensions)
+{
+	MSG_WriteLong(&net_message, extensions);
+	MSG_WriteLong(&net_message, NET_EXT_MAGIC);
+	MSG_WriteShort(&net_message, net_lzdictcrc);
+}
+
 static qsocket_t *_Datagram_CheckNewConnections (void)
 {
 	struct qsockaddr clientaddr;
@@ -866,6 +1032,7 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 	int			command;
 	int			control;
 	int			ret;
+	unsigned int	extensions;
 
 	acceptsock = dfunc.CheckNewConnections();
 	if (acceptsock == INVALID_SOCKET)
@@ -996,6 +1163,18 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 		return NULL;
 	}
 
+	// optional extensions, older clients don't send them
+	extensions = 0;
+	if (msg_readcount + 4 <= net_message.cursize)
+	{
+		extensions = MSG_ReadLong() & NET_EXT_SUPPORTED;
+		if (extensions & NET_EXT_COMPRESS)
+		{
+			if (!net_compress.value || (unsigned short)MSG_ReadShort() != net_lzdictcrc || msg_badread)
+				extensions &= ~NET_EXT_COMPRESS;
+		}
+	}
+
 #ifdef BAN_TEST
 	// check for a ban
 	if (clientaddr.qsa_family == AF_INET)
@@ -1035,6 +1214,7 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 				MSG_WriteByte(&net_message, CCREP_ACCEPT);
 				dfunc.GetSocketAddr(s->socket, &newaddr);
 				MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+				_Datagram_WriteExtensions (s->extensions);
 				*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 				dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
 				SZ_Clear(&net_message);
@@ -1083,6 +1263,7 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 	sock->socket = newsock;
 	sock->landriver = net_landriverlevel;
 	sock->addr = clientaddr;
+	sock->extensions = extensions;
 	Q_strcpy(sock->address, dfunc.AddrToString(&clientaddr));
 
 	// send him back the info about the server connection he has been allocated
@@ -1092,6 +1273,7 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 	MSG_WriteByte(&net_message, CCREP_ACCEPT);
 	dfunc.GetSocketAddr(newsock, &newaddr);
 	MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+	_Datagram_WriteExtensions (extensions);
 //	MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
 	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 	dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
@@ -1240,6 +1422,7 @@ static qsocket_t *_Datagram_Connect (const char *host)
 	int			reps;
 	double		start_time;
 	int			control;
+	unsigned int	extensions;
 	const char		*reason;
 
 	// see if we can resolve the host name
@@ -1276,6 +1459,13 @@ static qsocket_t *_Datagram_Connect (const char *host)
 		MSG_WriteByte(&net_message, CCREQ_CONNECT);
 		MSG_WriteString(&net_message, "QUAKE");
 		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+		if (net_compress.value)
+		{
+			MSG_WriteLong(&net_message, NET_EXT_COMPRESS);
+			MSG_WriteShort(&net_message, net_lzdictcrc);
+		}
+		else
+			MSG_WriteLong(&net_message, 0);
 		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 		dfunc.Write (newsock, net_message.data, net_message.cursize, &sendaddr);
 		SZ_Clear(&net_message);
@@ -1363,6 +1553,16 @@ static qsocket_t *_Datagram_Connect (const char *host)
 	{
 		Q_memcpy(&sock->addr, &sendaddr, sizeof(struct qsockaddr));
 		dfunc.SetSocketPort (&sock->addr, MSG_ReadLong());
+		// the extensions only count if the server is one of ours, with
+		// the same dictionary
+		if (msg_readcount + 10 <= net_message.cursize)
+		{
+			extensions = MSG_ReadLong();
+			if (MSG_ReadLong() == NET_EXT_MAGIC && (unsigned short)MSG_ReadShort() == net_lzdictcrc)
+				sock->extensions = extensions & (net_compress.value ? NET_EXT_SUPPORTED : 0);
+		}
+		if (sock->extensions & NET_EXT_COMPRESS)
+			Con_DPrintf ("Server accepted message compression\n");
 	}
 	else
 	{
@@ -0,0 +1,278 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// net_lag.c -- network impairment emulator
+//
+// Sits between net_dgrm.c and the lan drivers for the packets of a
+// connected qsocket. Both directions are impaired: outgoing packets are
+// held back before they reach sfunc.Write, incoming packets are drained
+// from sfunc.Read into the same queue and handed out once they are due.
+// So net_fakelag is added once per direction, and a link between two
+// engines that both have it set sees four times the value in round trip.
+//
+// The in-process loopback driver (net_loop.c) does not use datagrams,
+// connect to "localhost" to route a listen server through UDP instead.
+
+#include "q_stdinc.h"
+#include "arch_def.h"
+#include "net_sys.h"
+#include "quakedef.h"
+#include "net_defs.h"
+#include "net_lag.h"
+
+#define sfunc	net_landrivers[sock->landriver]
+
+static cvar_t	net_fakelag = {"net_fakelag", "0", CVAR_NONE};		// ms, per direction
+static cvar_t	net_fakejitter = {"net_fakejitter", "0", CVAR_NONE};	// ms, +/- around net_fakelag
+static cvar_t	net_fakeloss = {"net_fakeloss", "0", CVAR_NONE};	// percent
+static cvar_t	net_fakedup = {"net_fakedup", "0", CVAR_NONE};		// percent
+static cvar_t	net_fakereorder = {"net_fakereorder", "0", CVAR_NONE};	// percent
+
+typedef struct lagpacket_s
+{
+	struct lagpacket_s	*next;
+	double			time;		// when it is handed on
+	qsocket_t		*sock;
+	qboolean		outgoing;
+	struct qsockaddr	addr;
+	int			length;
+	byte			data[1];	// variable sized
+} lagpacket_t;
+
+static lagpacket_t	*lag_queue;	// sorted by time
+
+/* statistic counters */
+static int lagQueued = 0;
+static int lagDropped = 0;
+static int lagDuplicated = 0;
+static int lagReordered = 0;
+
+static qboolean NetLag_Active (void)
+{
+	return net_fakelag.value || net_fakejitter.value || net_fakeloss.value ||
+		net_fakedup.value || net_fakereorder.value;
+}
+
+// xorshift of its own, so that the emulator doesn't take numbers from the
+// rand() sequence QC and the replay recorder use
+static unsigned int	lag_random;
+
+static double NetLag_Random (void)
+{
+	lag_random ^= lag_random << 13;
+	lag_random ^= lag_random >> 17;
+	lag_random ^= lag_random << 5;
+	return lag_random * (1.0 / 4294967296.0);
+}
+
+static qboolean NetLag_Chance (float percent)
+{
+	return percent > 0 && NetLag_Random () * 100.0 < percent;
+}
+
+static void NetLag_Insert (lagpacket_t *p)
+{
+	lagpacket_t	**link;
+
+	// stable insert, equal times keep the order they were sent in
+	for (link = &lag_queue; *link; link = &(*link)->next)
+	{
+		if ((*link)->time > p->time)
+			break;
+	}
+	p->next = *link;
+	*link = p;
+	lagQueued++;
+}
+
+static void NetLag_Queue (qsocket_t *sock, qboolean outgoing, const byte *data, int length, const struct qsockaddr *addr)
+{
+	lagpacket_t	*p;
+	double		delay;
+	int		copies;
+
+	if (NetLag_Chance (net_fakeloss.value))
+	{
+		lagDropped++;
+		return;
+	}
+
+	copies = 1;
+	if (NetLag_Chance (net_fakedup.value))
+	{
+		lagDuplicated++;
+		copies = 2;
+	}
+
+	while (copies--)
+	{
+		delay = net_fakelag.value;
+		if (net_fakejitter.value)
+			delay += net_fakejitter.value * (NetLag_Random () * 2.0 - 1.0);
+		if (NetLag_Chance (net_fakereorder.value))
+		{
+			// hold it back long enough for the next few packets to overtake it
+			delay += 20 + net_fakejitter.value + net_fakelag.value * 0.5;
+			lagReordered++;
+		}
+		if (delay < 0)
+			delay = 0;
+
+		p = (lagpacket_t *) Mem_Alloc (MEM_NET, sizeof(lagpacket_t) + length);
+		if (!p)
+			Sys_Error ("NetLag_Queue: out of memory");
+		p->time = net_time + delay * 0.001;
+		p->sock = sock;
+		p->outgoing = outgoing;
+		p->addr = *addr;
+		p->length = length;
+		memcpy (p->data, data, length);
+		NetLag_Insert (p);
+	}
+}
+
+/*
+====================
+NetLag_Flush
+
+Hands the due outgoing packets of sock to the lan driver
+====================
+*/
+static void NetLag_Flush (qsocket_t *sock)
+{
+	lagpacket_t	**link, *p;
+
+	for (link = &lag_queue; (p = *link) != NULL && p->time <= net_time; )
+	{
+		if (p->sock != sock || !p->outgoing)
+		{
+			link = &p->next;
+			continue;
+		}
+		*link = p->next;
+		sfunc.Write (sock->socket, p->data, p->length, &p->addr);
+		Mem_Free (p);
+	}
+}
+
+/*
+====================
+NetLag_Read
+====================
+*/
+int NetLag_Read (qsocket_t *sock, byte *buf, int len, struct qsockaddr *addr)
+{
+	static byte	packet[NET_DATAGRAMSIZE];
+	struct qsockaddr from;
+	lagpacket_t	**link, *p;
+	int		ret;
+
+	if (!lag_queue && !NetLag_Active ())
+		return sfunc.Read (sock->socket, buf, len, addr);
+
+	NetLag_Flush (sock);
+
+	// drain the driver, a real error is passed on right away
+	while ((ret = sfunc.Read (sock->socket, packet, sizeof(packet), &from)) > 0)
+		NetLag_Queue (sock, false, packet, ret, &from);
+	if (ret == -1)
+		return -1;
+
+	for (link = &lag_queue; (p = *link) != NULL && p->time <= net_time; link = &p->next)
+	{
+		if (p->sock != sock || p->outgoing)
+			continue;
+		*link = p->next;
+		ret = q_min (p->length, len);
+		memcpy (buf, p->data, ret);
+		*addr = p->addr;
+		Mem_Free (p);
+		return ret;
+	}
+
+	return 0;
+}
+
+/*
+====================
+NetLag_Write
+====================
+*/
+int NetLag_Write (qsocket_t *sock, byte *buf, int len, struct qsockaddr *addr)
+{
+	if (!NetLag_Active ())
+		return sfunc.Write (sock->socket, buf, len, addr);
+
+	NetLag_Queue (sock, true, buf, len, addr);
+	NetLag_Flush (sock);
+	return len;
+}
+
+/*
+====================
+NetLag_Close
+
+Forgets everything that is still queued for sock
+====================
+*/
+void NetLag_Close (qsocket_t *sock)
+{
+	lagpacket_t	**link, *p;
+
+	for (link = &lag_queue; (p = *link) != NULL; )
+	{
+		if (p->sock != sock)
+		{
+			link = &p->next;
+			continue;
+		}
+		*link = p->next;
+		Mem_Free (p);
+	}
+}
+
+void NetLag_PrintStats (void)
+{
+	lagpacket_t	*p;
+	int		pending;
+
+	if (!lagQueued && !NetLag_Active ())
+		return;
+
+	for (pending = 0, p = lag_queue; p; p = p->next)
+		pending++;
+
+	Con_Printf("fakelag queued/pending     = %i / %i\n", lagQueued, pending);
+	Con_Printf("fakelag dropped            = %i\n", lagDropped);
+	Con_Printf("fakelag duplicated         = %i\n", lagDuplicated);
+	Con_Printf("fakelag reordered          = %i\n", lagReordered);
+}
+
+void NetLag_Init (void)
+{
+	Cvar_RegisterVariable (&net_fakelag);
+	Cvar_RegisterVariable (&net_fakejitter);
+	Cvar_RegisterVariable (&net_fakeloss);
+	Cvar_RegisterVariable (&net_fakedup);
+	Cvar_RegisterVariable (&net_fakereorder);
+
+	lag_random = (unsigned int)(Sys_DoubleTime () * 1000) | 1;
+}
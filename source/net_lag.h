@@ -0,0 +1,34 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef __NET_LAG_H
+#define __NET_LAG_H
+
+// net_lag.h -- network impairment emulator between the datagram
+// driver and the lan drivers (net_fakelag, net_fakeloss, ...)
+
+void	NetLag_Init (void);
+int	NetLag_Read (qsocket_t *sock, byte *buf, int len, struct qsockaddr *addr);
+int	NetLag_Write (qsocket_t *sock, byte *buf, int len, struct qsockaddr *addr);
+void	NetLag_Close (qsocket_t *sock);
+void	NetLag_PrintStats (void);
+
+#endif	/* __NET_LAG_H */
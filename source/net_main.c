@@ -117,6 +117,12 @@ qsocket_t *NET_NewQSocket (void)
 	sock->sendSequence = 0;
 	sock->unreliableSendSequence = 0;
 	sock->sendMessageLength = 0;
+	sock->sendCompressed = false;
+	sock->reliableSendTime = 0;
+	sock->extensions = 0;
+	sock->compressedMessages = 0;
+	sock->compressedBytesIn = 0;
+	sock->compressedBytesOut = 0;
 	sock->receiveSequence = 0;
 	sock->unreliableReceiveSequence = 0;
 	sock->receiveMessageLength = 0;
@@ -0,0 +1,683 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pmove.c -- player movement shared by the server and client prediction
+//
+// PM_PlayerThink is what SV_ClientThink runs for every client and
+// PM_PlayerMove what SV_Physics_Client runs for walking, flying and noclipping
+// ones, so the server and a predicting client move players with the very same
+// code. The server's trace callback collects what was hit, and runs the
+// impacts once the move is done.
+
+#include "quakedef.h"
+
+/*
+==================
+PM_Friction
+
+==================
+*/
+static void PM_Friction (pmove_t *pm)
+{
+	const movevars_t	*mv = pm->movevars;
+	float	*vel;
+	float	speed, newspeed, control;
+	vec3_t	start, stop;
+	float	friction;
+	pmtrace_t	trace;
+
+	vel = pm->velocity;
+
+	speed = sqrt(vel[0]*vel[0] +vel[1]*vel[1]);
+	if (!speed)
+		return;
+
+// if the leading edge is over a dropoff, increase friction
+	start[0] = stop[0] = pm->origin[0] + vel[0]/speed*16;
+	start[1] = stop[1] = pm->origin[1] + vel[1]/speed*16;
+	start[2] = pm->origin[2] + mv->mins[2];
+	stop[2] = start[2] - 34;
+
+	pm->trace (start, vec3_origin, vec3_origin, stop, &trace);
+
+	if (trace.fraction == 1.0)
+		friction = mv->friction*mv->edgefriction;
+	else
+		friction = mv->friction;
+
+// apply friction
+	control = speed < mv->stopspeed ? mv->stopspeed : speed;
+	newspeed = speed - pm->frametime*control*friction;
+
+	if (newspeed < 0)
+		newspeed = 0;
+	newspeed /= speed;
+
+	vel[0] = vel[0] * newspeed;
+	vel[1] = vel[1] * newspeed;
+	vel[2] = vel[2] * newspeed;
+}
+
+/*
+==============
+PM_Accelerate
+==============
+*/
+static void PM_Accelerate (pmove_t *pm, float wishspeed, const vec3_t wishdir)
+{
+	int			i;
+	float		addspeed, accelspeed, currentspeed;
+
+	currentspeed = DotProduct (pm->velocity, wishdir);
+	addspeed = wishspeed - currentspeed;
+	if (addspeed <= 0)
+		return;
+	accelspeed = pm->movevars->accelerate*pm->frametime*wishspeed;
+	if (accelspeed > addspeed)
+		accelspeed = addspeed;
+
+	for (i=0 ; i<3 ; i++)
+		pm->velocity[i] += accelspeed*wishdir[i];
+}
+
+static void PM_AirAccelerate (pmove_t *pm, float wishspeed, vec3_t wishveloc)
+{
+	int			i;
+	float		addspeed, wishspd, accelspeed, currentspeed;
+
+	wishspd = VectorNormalize (wishveloc);
+	if (wishspd > 30)
+		wishspd = 30;
+	currentspeed = DotProduct (pm->velocity, wishveloc);
+	addspeed = wishspd - currentspeed;
+	if (addspeed <= 0)
+		return;
+	accelspeed = pm->movevars->accelerate*wishspeed * pm->frametime;
+	if (accelspeed > addspeed)
+		accelspeed = addspeed;
+
+	for (i=0 ; i<3 ; i++)
+		pm->velocity[i] += accelspeed*wishveloc[i];
+}
+
+/*
+===================
+PM_WaterMove
+
+===================
+*/
+static void PM_WaterMove (pmove_t *pm)
+{
+	const movevars_t	*mv = pm->movevars;
+	int		i;
+	vec3_t	forward, right, up;
+	vec3_t	wishvel;
+	float	speed, newspeed, wishspeed, addspeed, accelspeed;
+
+//
+// user intentions
+//
+	AngleVectors (pm->v_angle, forward, right, up);
+
+	for (i=0 ; i<3 ; i++)
+		wishvel[i] = forward[i]*pm->cmd.forwardmove + right[i]*pm->cmd.sidemove;
+
+	if (!pm->cmd.forwardmove && !pm->cmd.sidemove && !pm->cmd.upmove)
+		wishvel[2] -= 60;		// drift towards bottom
+	else
+		wishvel[2] += pm->cmd.upmove;
+
+	wishspeed = VectorLength(wishvel);
+	if (wishspeed > mv->maxspeed)
+	{
+		VectorScale (wishvel, mv->maxspeed/wishspeed, wishvel);
+		wishspeed = mv->maxspeed;
+	}
+	wishspeed *= 0.7;
+
+//
+// water friction
+//
+	speed = VectorLength (pm->velocity);
+	if (speed)
+	{
+		newspeed = speed - pm->frametime * speed * mv->friction;
+		if (newspeed < 0)
+			newspeed = 0;
+		VectorScale (pm->velocity, newspeed/speed, pm->velocity);
+	}
+	else
+		newspeed = 0;
+
+//
+// water acceleration
+//
+	if (!wishspeed)
+		return;
+
+	addspeed = wishspeed - newspeed;
+	if (addspeed <= 0)
+		return;
+
+	VectorNormalize (wishvel);
+	accelspeed = mv->accelerate * wishspeed * pm->frametime;
+	if (accelspeed > addspeed)
+		accelspeed = addspeed;
+
+	for (i=0 ; i<3 ; i++)
+		pm->velocity[i] += accelspeed * wishvel[i];
+}
+
+/*
+===================
+PM_NoclipMove -- johnfitz
+
+new, alternate noclip. old noclip is still handled in PM_AirMove
+===================
+*/
+static void PM_NoclipMove (pmove_t *pm)
+{
+	vec3_t	forward, right, up;
+	float	*velocity = pm->velocity;
+
+	AngleVectors (pm->v_angle, forward, right, up);
+
+	velocity[0] = forward[0]*pm->cmd.forwardmove + right[0]*pm->cmd.sidemove;
+	velocity[1] = forward[1]*pm->cmd.forwardmove + right[1]*pm->cmd.sidemove;
+	velocity[2] = forward[2]*pm->cmd.forwardmove + right[2]*pm->cmd.sidemove;
+	velocity[2] += pm->cmd.upmove*2; //doubled to match running speed
+
+	if (VectorLength (velocity) > pm->movevars->maxspeed)
+	{
+		VectorNormalize (velocity);
+		VectorScale (velocity, pm->movevars->maxspeed, velocity);
+	}
+}
+
+/*
+===================
+PM_AirMove
+===================
+*/
+static void PM_AirMove (pmove_t *pm)
+{
+	int			i;
+	vec3_t		forward, right, up;
+	vec3_t		wishvel, wishdir;
+	float		wishspeed;
+	float		fmove, smove;
+
+	AngleVectors (pm->angles, forward, right, up);
+
+	fmove = pm->cmd.forwardmove;
+	smove = pm->cmd.sidemove;
+
+// hack to not let you back into teleporter
+	if ((pm->flags & PMF_NOBACKMOVE) && fmove < 0)
+		fmove = 0;
+
+	for (i=0 ; i<3 ; i++)
+		wishvel[i] = forward[i]*fmove + right[i]*smove;
+
+	if (pm->movetype != MOVETYPE_WALK)
+		wishvel[2] = pm->cmd.upmove;
+	else
+		wishvel[2] = 0;
+
+	VectorCopy (wishvel, wishdir);
+	wishspeed = VectorNormalize(wishdir);
+	if (wishspeed > pm->movevars->maxspeed)
+	{
+		VectorScale (wishvel, pm->movevars->maxspeed/wishspeed, wishvel);
+		wishspeed = pm->movevars->maxspeed;
+	}
+
+	if (pm->movetype == MOVETYPE_NOCLIP)
+	{	// noclip
+		VectorCopy (wishvel, pm->velocity);
+	}
+	else if (pm->flags & PMF_ONGROUND)
+	{
+		PM_Friction (pm);
+		PM_Accelerate (pm, wishspeed, wishdir);
+	}
+	else
+	{	// not on ground, so little effect on velocity
+		PM_AirAccelerate (pm, wishspeed, wishvel);
+	}
+}
+
+/*
+===================
+PM_PlayerThink
+
+the move fields specify an intended velocity in pix/sec
+the angle fields specify an exact angular motion in degrees
+===================
+*/
+void PM_PlayerThink (pmove_t *pm)
+{
+	//johnfitz -- alternate noclip
+	if (pm->movetype == MOVETYPE_NOCLIP && (pm->movevars->flags & MVF_ALTNOCLIP))
+		PM_NoclipMove (pm);
+	else if (pm->waterlevel >= 2 && pm->movetype != MOVETYPE_NOCLIP)
+		PM_WaterMove (pm);
+	else
+		PM_AirMove (pm);
+	//johnfitz
+}
+
+/*
+===============================================================================
+
+PLAYER PHYSICS
+
+===============================================================================
+*/
+
+/*
+============
+PM_FlyMove
+
+The basic solid body movement clip that slides along multiple planes
+Returns the clipflags if the velocity was modified (hit something solid)
+1 = floor
+2 = wall / step
+4 = dead stop
+If steptrace is not NULL, the trace of any vertical wall hit will be stored
+============
+*/
+#define	MAX_CLIP_PLANES	5
+int PM_FlyMove (pmove_t *pm, float time, pmtrace_t *steptrace)
+{
+	const movevars_t	*mv = pm->movevars;
+	int			bumpcount, numbumps;
+	vec3_t		dir;
+	float		d;
+	int			numplanes;
+	vec3_t		planes[MAX_CLIP_PLANES];
+	vec3_t		primal_velocity, original_velocity, new_velocity;
+	int			i, j;
+	pmtrace_t	trace;
+	vec3_t		end;
+	float		time_left;
+	int			blocked;
+
+	numbumps = 4;
+
+	blocked = 0;
+	VectorCopy (pm->velocity, original_velocity);
+	VectorCopy (pm->velocity, primal_velocity);
+	numplanes = 0;
+
+	time_left = time;
+
+	for (bumpcount=0 ; bumpcount<numbumps ; bumpcount++)
+	{
+		if (!pm->velocity[0] && !pm->velocity[1] && !pm->velocity[2])
+			break;
+
+		for (i=0 ; i<3 ; i++)
+			end[i] = pm->origin[i] + time_left * pm->velocity[i];
+
+		pm->trace (pm->origin, mv->mins, mv->maxs, end, &trace);
+
+		if (trace.allsolid)
+		{	// entity is trapped in another solid
+			VectorCopy (vec3_origin, pm->velocity);
+			return 3;
+		}
+
+		if (trace.fraction > 0)
+		{	// actually covered some distance
+			VectorCopy (trace.endpos, pm->origin);
+			VectorCopy (pm->velocity, original_velocity);
+			numplanes = 0;
+		}
+
+		if (trace.fraction == 1)
+			 break;		// moved the entire distance
+
+		if (trace.normal[2] > 0.7)
+		{
+			blocked |= 1;		// floor
+			pm->flags |= PMF_ONGROUND;
+		}
+		if (!trace.normal[2])
+		{
+			blocked |= 2;		// step
+			if (steptrace)
+				*steptrace = trace;	// save for player extrafriction
+		}
+
+		time_left -= time_left * trace.fraction;
+
+	// cliped to another plane
+		if (numplanes >= MAX_CLIP_PLANES)
+		{	// this shouldn't really happen
+			VectorCopy (vec3_origin, pm->velocity);
+			return 3;
+		}
+
+		VectorCopy (trace.normal, planes[numplanes]);
+		numplanes++;
+
+//
+// modify original_velocity so it parallels all of the clip planes
+//
+		for (i=0 ; i<numplanes ; i++)
+		{
+			ClipVelocity (original_velocity, planes[i], new_velocity, 1);
+			for (j=0 ; j<numplanes ; j++)
+				if (j != i)
+				{
+					if (DotProduct (new_velocity, planes[j]) < 0)
+						break;	// not ok
+				}
+			if (j == numplanes)
+				break;
+		}
+
+		if (i != numplanes)
+		{	// go along this plane
+			VectorCopy (new_velocity, pm->velocity);
+		}
+		else
+		{	// go along the crease
+			if (numplanes != 2)
+			{
+				VectorCopy (vec3_origin, pm->velocity);
+				return 7;
+			}
+			CrossProduct (planes[0], planes[1], dir);
+			d = DotProduct (dir, pm->velocity);
+			VectorScale (dir, d, pm->velocity);
+		}
+
+//
+// if original velocity is against the original velocity, stop dead
+// to avoid tiny occilations in sloping corners
+//
+		if (DotProduct (pm->velocity, primal_velocity) <= 0)
+		{
+			VectorCopy (vec3_origin, pm->velocity);
+			return blocked;
+		}
+	}
+
+	return blocked;
+}
+
+/*
+============
+PM_PushPlayer
+
+Does not change the velocity at all
+============
+*/
+void PM_PushPlayer (pmove_t *pm, const vec3_t push, pmtrace_t *trace)
+{
+	vec3_t	end;
+
+	VectorAdd (pm->origin, push, end);
+	pm->trace (pm->origin, pm->movevars->mins, pm->movevars->maxs, end, trace);
+	VectorCopy (trace->endpos, pm->origin);
+}
+
+/*
+=============
+PM_CheckWater
+=============
+*/
+static qboolean PM_CheckWater (pmove_t *pm)
+{
+	const movevars_t	*mv = pm->movevars;
+	vec3_t	point;
+	int		cont;
+
+	point[0] = pm->origin[0];
+	point[1] = pm->origin[1];
+	point[2] = pm->origin[2] + mv->mins[2] + 1;
+
+	pm->waterlevel = 0;
+	pm->watertype = CONTENTS_EMPTY;
+	cont = pm->pointcontents (point);
+	if (cont <= CONTENTS_WATER)
+	{
+		pm->watertype = cont;
+		pm->waterlevel = 1;
+		point[2] = pm->origin[2] + (mv->mins[2] + mv->maxs[2])*0.5;
+		cont = pm->pointcontents (point);
+		if (cont <= CONTENTS_WATER)
+		{
+			pm->waterlevel = 2;
+			point[2] = pm->origin[2] + pm->viewheight;
+			cont = pm->pointcontents (point);
+			if (cont <= CONTENTS_WATER)
+				pm->waterlevel = 3;
+		}
+	}
+
+	return pm->waterlevel > 1;
+}
+
+/*
+============
+PM_WallFriction
+
+============
+*/
+void PM_WallFriction (pmove_t *pm, pmtrace_t *trace)
+{
+	vec3_t		forward, right, up;
+	float		d, i;
+	vec3_t		into, side;
+
+	AngleVectors (pm->v_angle, forward, right, up);
+	d = DotProduct (trace->normal, forward);
+
+	d += 0.5;
+	if (d >= 0)
+		return;
+
+// cut the tangential velocity
+	i = DotProduct (trace->normal, pm->velocity);
+	VectorScale (trace->normal, i, into);
+	VectorSubtract (pm->velocity, into, side);
+
+	pm->velocity[0] = side[0] * (1 + d);
+	pm->velocity[1] = side[1] * (1 + d);
+}
+
+/*
+=====================
+PM_TryUnstick
+
+Player has come to a dead stop, possibly due to the problem with limited
+float precision at some angle joins in the BSP hull.
+
+Try fixing by pushing one pixel in each direction.
+======================
+*/
+static int PM_TryUnstick (pmove_t *pm, const vec3_t oldvel)
+{
+	int		i;
+	vec3_t	oldorg;
+	vec3_t	dir;
+	int		clip;
+	pmtrace_t	steptrace;
+
+	VectorCopy (pm->origin, oldorg);
+	VectorCopy (vec3_origin, dir);
+
+	for (i=0 ; i<8 ; i++)
+	{
+// try pushing a little in an axial direction
+		switch (i)
+		{
+			case 0:	dir[0] = 2; dir[1] = 0; break;
+			case 1:	dir[0] = 0; dir[1] = 2; break;
+			case 2:	dir[0] = -2; dir[1] = 0; break;
+			case 3:	dir[0] = 0; dir[1] = -2; break;
+			case 4:	dir[0] = 2; dir[1] = 2; break;
+			case 5:	dir[0] = -2; dir[1] = 2; break;
+			case 6:	dir[0] = 2; dir[1] = -2; break;
+			case 7:	dir[0] = -2; dir[1] = -2; break;
+		}
+
+		PM_PushPlayer (pm, dir, &steptrace);
+
+// retry the original move
+		pm->velocity[0] = oldvel[0];
+		pm->velocity[1] = oldvel[1];
+		pm->velocity[2] = 0;
+		clip = PM_FlyMove (pm, 0.1, &steptrace);
+
+		if ( fabs(oldorg[1] - pm->origin[1]) > 4
+		|| fabs(oldorg[0] - pm->origin[0]) > 4 )
+			return clip;
+
+// go back to the original pos and try again
+		VectorCopy (oldorg, pm->origin);
+	}
+
+	VectorCopy (vec3_origin, pm->velocity);
+	return 7;		// still not moving
+}
+
+/*
+=====================
+PM_WalkMove
+======================
+*/
+#define	STEPSIZE	18
+static void PM_WalkMove (pmove_t *pm)
+{
+	vec3_t		upmove, downmove;
+	vec3_t		oldorg, oldvel;
+	vec3_t		nosteporg, nostepvel;
+	int			clip;
+	int			oldonground;
+	pmtrace_t	steptrace, downtrace;
+
+//
+// do a regular slide move unless it looks like you ran into a step
+//
+	oldonground = pm->flags & PMF_ONGROUND;
+	pm->flags &= ~PMF_ONGROUND;
+
+	VectorCopy (pm->origin, oldorg);
+	VectorCopy (pm->velocity, oldvel);
+
+	clip = PM_FlyMove (pm, pm->frametime, &steptrace);
+
+	if ( !(clip & 2) )
+		return;		// move didn't block on a step
+
+	if (!oldonground && pm->waterlevel == 0)
+		return;		// don't stair up while jumping
+
+	if (pm->movevars->flags & MVF_NOSTEP)
+		return;
+
+	if (pm->flags & PMF_WATERJUMP)
+		return;
+
+	VectorCopy (pm->origin, nosteporg);
+	VectorCopy (pm->velocity, nostepvel);
+
+//
+// try moving up and forward to go up a step
+//
+	VectorCopy (oldorg, pm->origin);	// back to start pos
+
+	VectorCopy (vec3_origin, upmove);
+	VectorCopy (vec3_origin, downmove);
+	upmove[2] = STEPSIZE;
+	downmove[2] = -STEPSIZE + oldvel[2]*pm->frametime;
+
+// move up
+	PM_PushPlayer (pm, upmove, &downtrace);
+
+// move forward
+	pm->velocity[0] = oldvel[0];
+	pm->velocity[1] = oldvel[1];
+	pm->velocity[2] = 0;
+	clip = PM_FlyMove (pm, pm->frametime, &steptrace);
+
+// check for stuckness, possibly due to the limited precision of floats
+// in the clipping hulls
+	if (clip)
+	{
+		if ( fabs(oldorg[1] - pm->origin[1]) < 0.03125
+		&& fabs(oldorg[0] - pm->origin[0]) < 0.03125 )
+		{	// stepping up didn't make any progress
+			clip = PM_TryUnstick (pm, oldvel);
+		}
+	}
+
+// extra friction based on view angle
+	if ( clip & 2 )
+		PM_WallFriction (pm, &steptrace);
+
+// move down
+	PM_PushPlayer (pm, downmove, &downtrace);
+
+	if (downtrace.fraction < 1 && downtrace.normal[2] > 0.7)
+	{
+		pm->flags |= PMF_ONGROUND;
+	}
+	else
+	{
+// if the push down didn't end up on good ground, use the move without
+// the step up.  This happens near wall / slope combinations, and can
+// cause the player to hop up higher on a slope too steep to climb
+		VectorCopy (nosteporg, pm->origin);
+		VectorCopy (nostepvel, pm->velocity);
+	}
+}
+
+/*
+================
+PM_PlayerMove
+================
+*/
+void PM_PlayerMove (pmove_t *pm)
+{
+	switch (pm->movetype)
+	{
+	case MOVETYPE_WALK:
+		if (!PM_CheckWater (pm) && !(pm->flags & PMF_WATERJUMP))
+			pm->velocity[2] -= pm->movevars->entgravity * pm->movevars->gravity * pm->frametime;
+		PM_WalkMove (pm);
+		break;
+
+	case MOVETYPE_FLY:
+		PM_FlyMove (pm, pm->frametime, NULL);
+		break;
+
+	case MOVETYPE_NOCLIP:
+		VectorMA (pm->origin, pm->frametime, pm->velocity, pm->origin);
+		break;
+
+	default:
+		break;
+	}
+}
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef _QUAKE_PMOVE_H
+#define _QUAKE_PMOVE_H
+
+/* pmove.h -- player movement code shared by the server and client prediction */
+
+// movevars_t flags
+#define	MVF_ALTNOCLIP		(1<<0)	// sv_altnoclip
+#define	MVF_NOSTEP			(1<<1)	// sv_nostep
+
+// server tunables that affect player movement, sent with svc_movevars
+typedef struct
+{
+	float	gravity;		// sv_gravity
+	float	entgravity;		// player's .gravity multiplier
+	float	friction;
+	float	edgefriction;
+	float	stopspeed;
+	float	maxspeed;
+	float	accelerate;
+	vec3_t	mins, maxs;		// player's bounding box
+	int		flags;			// MVF_*
+} movevars_t;
+
+// pmove_t flags, also sent with svc_moveack
+#define	PMF_ONGROUND		(1<<0)
+#define	PMF_WATERJUMP		(1<<1)
+#define	PMF_NOBACKMOVE		(1<<2)	// teleport_time hack: can't back into a teleporter
+
+typedef struct
+{
+	qboolean	allsolid;
+	qboolean	startsolid;
+	float		fraction;
+	vec3_t		endpos;
+	vec3_t		normal;			// plane normal at impact
+} pmtrace_t;
+
+typedef struct pmove_s
+{
+// state, modified by the move
+	vec3_t		origin;
+	vec3_t		velocity;
+	int			flags;			// PMF_*
+	int			waterlevel;
+	int			watertype;
+
+// input
+	usercmd_t	cmd;
+	vec3_t		v_angle;		// view angles the command was issued with
+	vec3_t		angles;			// body angles (1/3 pitch), used for walking
+	int			movetype;
+	float		viewheight;		// view_ofs[2], for the waterlevel 3 check
+	float		frametime;
+	const movevars_t	*movevars;
+
+// collision callbacks; the server clips against everything but monsters,
+// the client against the world and brush models it knows about
+	void		(*trace) (const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, pmtrace_t *trace);
+	int			(*pointcontents) (const vec3_t p);
+} pmove_t;
+
+void PM_PlayerThink (pmove_t *pm);
+// turns the usercmd into a wish velocity (the SV_ClientThink part of a move)
+
+void PM_PlayerMove (pmove_t *pm);
+// gravity, water level and sliding/stepping collision for a walking, flying
+// or noclipping player (the SV_Physics_Client part of a move, without
+// touches or pushes)
+
+// the pieces of PM_PlayerMove that sv_phys.c also moves monsters with
+int PM_FlyMove (pmove_t *pm, float time, pmtrace_t *steptrace);
+void PM_PushPlayer (pmove_t *pm, const vec3_t push, pmtrace_t *trace);
+void PM_WallFriction (pmove_t *pm, pmtrace_t *trace);
+
+#endif	/* _QUAKE_PMOVE_H */
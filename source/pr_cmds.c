@@ -23,15 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "q_ctype.h"
 
-#define	STRINGTEMP_BUFFERS		1024
-#define	STRINGTEMP_LENGTH		1024
-static	char	pr_string_temp[STRINGTEMP_BUFFERS][STRINGTEMP_LENGTH];
-static	byte	pr_string_tempindex = 0;
-
-static char *PR_GetTempString (void)
-{
-	return pr_string_temp[(STRINGTEMP_BUFFERS-1) & ++pr_string_tempindex];
-}
+#define	STRINGTEMP_LENGTH		1024	// fgets line limit
 
 #define	RETURN_EDICT(e) (((int *)pr_globals)[OFS_RETURN] = EDICT_TO_PROG(e))
 
@@ -50,28 +42,44 @@ extern	char		*pr_strings;
 ===============================================================================
 */
 
+#define	VARSTRING_MAX	1023	// what the old static buffer held, kept as a limit for messages
+
+// the arguments from first on, joined in the server frame arena
 static char *PF_VarString (int	first)
 {
-	int		i;
-	static char out[1024];
-	size_t s;
+	int		i, s;
+	int		len[MAX_PARMS];
+	const char	*str[MAX_PARMS];
+	char	*out;
+
+	s = 0;
+	for (i = first; i < pr_argc; i++)
+	{
+		str[i] = PR_GetStringLength (G_INT(OFS_PARM0+i*3), &len[i]);
+		s += len[i];
+	}
 
-	out[0] = 0;
+	out = (char *) Frame_Alloc (FRAME_SERVER, q_min (s, VARSTRING_MAX) + 1);
 	s = 0;
 	for (i = first; i < pr_argc; i++)
 	{
-		s = q_strlcat(out, G_STRING((OFS_PARM0+i*3)), sizeof(out));
-		if (s >= sizeof(out))
+		if (s + len[i] > VARSTRING_MAX)
 		{
+			memcpy (out + s, str[i], VARSTRING_MAX - s);
+			out[VARSTRING_MAX] = 0;
 			Con_Warning("PF_VarString: overflow (string truncated)\n");
 			return out;
 		}
+		memcpy (out + s, str[i], len[i]);
+		s += len[i];
 	}
+	out[s] = 0;
+
 	if (s > 255)
 	{
 		if (!dev_overflows.varstring || dev_overflows.varstring + CONSOLE_RESPAM_TIME < realtime)
 		{
-			Con_DWarning("PF_VarString: %i characters exceeds standard limit of 255 (max = %d).\n", (int) s, (int)(sizeof(out) - 1));
+			Con_DWarning("PF_VarString: %i characters exceeds standard limit of 255.\n", s);
 			dev_overflows.varstring = realtime;
 		}
 	}
@@ -993,7 +1001,7 @@ static int PF_newcheckclient (int check)
 	if (checkpvs == NULL || pvsbytes > checkpvs_capacity)
 	{
 		checkpvs_capacity = pvsbytes;
-		checkpvs = (byte *) realloc (checkpvs, checkpvs_capacity);
+		checkpvs = (byte *) Mem_Realloc (MEM_QC, checkpvs, checkpvs_capacity);
 		if (!checkpvs)
 			Sys_Error ("PF_newcheckclient: realloc() failed on %d bytes", checkpvs_capacity);
 	}
@@ -1160,19 +1168,20 @@ static void PF_findradius (void)
 	rad = G_FLOAT(OFS_PARM1);
 	rad *= rad;
 
-	ent = NEXT_EDICT(sv.edicts);
-	for (i = 1; i < sv.num_edicts; i++, ent = NEXT_EDICT(ent))
+	SV_MirrorFlush ();
+	for (i = 1; i < sv.num_edicts; i++)
 	{
-		if (ent->free)
+		if (sv_mirror.free[i])
 			continue;
-		if (ent->v.solid == SOLID_NOT)
+		if (sv_mirror.solid[i] == SOLID_NOT)
 			continue;
 		for (j = 0; j < 3; j++)
-			eorg[j] = org[j] - (ent->v.origin[j] + (ent->v.mins[j] + ent->v.maxs[j]) * 0.5);
+			eorg[j] = org[j] - (sv_mirror.origin[i][j] + sv_mirror.extent[i][j] * 0.5);
 		
 		if (DotProduct(eorg, eorg) > rad)
 			continue;
 
+		ent = EDICT_NUM(i);
 		ent->v.chain = EDICT_TO_PROG(chain);
 		chain = ent;
 	}
@@ -1193,15 +1202,14 @@ static void PF_dprint (void)
 static void PF_ftos (void)
 {
 	float	v;
-	char	*s;
+	char	s[64];
 
 	v = G_FLOAT(OFS_PARM0);
-	s = PR_GetTempString();
 	if (v == (int)v)
 		sprintf (s, "%d",(int)v);
 	else
-		sprintf (s, "%5.1f",v);
-	G_INT(OFS_RETURN) = PR_SetEngineString(s);
+		q_snprintf (s, sizeof(s), "%5.1f",v);
+	G_INT(OFS_RETURN) = PR_SetTempString(s);
 }
 
 static void PF_fabs (void)
@@ -1213,21 +1221,18 @@ static void PF_fabs (void)
 
 static void PF_vtos (void)
 {
-	char	*s;
+	char	s[160];
 
-	s = PR_GetTempString();
-	sprintf (s, "'%5.1f %5.1f %5.1f'", G_VECTOR(OFS_PARM0)[0], G_VECTOR(OFS_PARM0)[1], G_VECTOR(OFS_PARM0)[2]);
-	G_INT(OFS_RETURN) = PR_SetEngineString(s);
+	q_snprintf (s, sizeof(s), "'%5.1f %5.1f %5.1f'", G_VECTOR(OFS_PARM0)[0], G_VECTOR(OFS_PARM0)[1], G_VECTOR(OFS_PARM0)[2]);
+	G_INT(OFS_RETURN) = PR_SetTempString(s);
 }
 
 void PF_etos (void)
 {
-	char *s;
-	
-	s = PR_GetTempString();
-	
+	char	s[32];
+
 	sprintf (s, "entity %i", G_EDICTNUM(OFS_PARM0));
-	G_INT(OFS_RETURN) = s - pr_strings;
+	G_INT(OFS_RETURN) = PR_SetTempString(s);
 }
 
 static void PF_Spawn (void)
@@ -1482,8 +1487,6 @@ void PF_SetPlayerName(void)
 	MSG_WriteString (&client->message, s);
 }
 
-#define MaxZombies 24
-
 /*
 =================
 PF_MaxZombies
@@ -1645,7 +1648,7 @@ static void PF_precache_sound (void)
 	{
 		if (!sv.sound_precache[i])
 		{
-			sv.sound_precache[i] = s;
+			sv.sound_precache[i] = PR_GetKeptString (G_INT(OFS_PARM0));
 			return;
 		}
 		if (!strcmp(sv.sound_precache[i], s))
@@ -1670,7 +1673,7 @@ static void PF_precache_model (void)
 	{
 		if (!sv.model_precache[i])
 		{
-			sv.model_precache[i] = s;
+			sv.model_precache[i] = PR_GetKeptString (G_INT(OFS_PARM0));
 			sv.models[i] = Mod_ForName (s, true);
 			return;
 		}
@@ -1785,6 +1788,7 @@ void(float style, string value) lightstyle
 */
 static void PF_lightstyle (void)
 {
+	static char	copies[MAX_LIGHTSTYLES][64];
 	int		style;
 	const char	*val;
 	client_t	*client;
@@ -1800,8 +1804,17 @@ static void PF_lightstyle (void)
 		return;
 	}
 
-// change the string in sv
-	sv.lightstyles[style] = val;
+// change the string in sv. Temp strings don't last, so anything but a
+// progs string is copied
+	if (PR_IsProgsString (G_INT(OFS_PARM1)))
+		sv.lightstyles[style] = val;
+	else if (strlen (val) < sizeof(copies[style]))
+	{
+		strcpy (copies[style], val);
+		sv.lightstyles[style] = copies[style];
+	}
+	else
+		sv.lightstyles[style] = PR_GetKeptString (G_INT(OFS_PARM1));
 
 // send message to all clients on this server
 	if (sv.state != ss_active)
@@ -2036,25 +2049,24 @@ void PF_GetSoundLen (void)
 	name = G_STRING(OFS_PARM0);
 
     char	namebuffer[256];
-	byte	*data;
+	mappedfile_t	mf;
 	wavinfo_t	info;
-	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
 
 //Con_Printf ("S_LoadSound: %x\n", (int)stackbuf);
 // load it in
     Q_strcpy(namebuffer, "");
     Q_strcat(namebuffer, name);
 
-	data = COM_LoadStackFile(namebuffer, stackbuf, sizeof(stackbuf), NULL);
-
-	if (!data)
+	// only the header is read, so the file is mapped rather than loaded
+	if (!COM_MapFile(namebuffer, &mf, NULL))
 	{
 		Con_Printf ("Couldn't load %s\n", namebuffer);
 		G_FLOAT(OFS_RETURN) = -1;
 		return;
 	}
 
-	info = GetWavinfo (name, data, com_filesize);
+	info = GetWavinfo (name, mf.data, mf.length);
+	COM_UnmapFile (&mf);
 	if (info.channels != 1)
 	{
 		Con_Printf ("%s is a stereo sample\n",name);
@@ -3304,8 +3316,7 @@ void PF_fgets (void)
 	int		i;
 	int		count;
 	char	buffer;
-	char 	*s;
-	s = PR_GetTempString();
+	char 	s[STRINGTEMP_LENGTH];
 
 	h = (int)G_FLOAT(OFS_PARM0);
 
@@ -3335,8 +3346,9 @@ void PF_fgets (void)
 			count = Sys_FileRead(h, &buffer, 1);	// skip
 		}
 	};
+	s[i] = 0;
 
-	G_INT(OFS_RETURN) = PR_SetEngineString(s);
+	G_INT(OFS_RETURN) = PR_SetTempString(s);
 }
 
 /*
@@ -3364,16 +3376,7 @@ string strzone (string)
 */
 void PF_strzone (void)
 {
-	char *m, *p;
-	char *s;
-	s = PR_GetTempString();
-
-	m = G_STRING(OFS_PARM0);
-	p = Z_Malloc(strlen(m) + 1);
-	strcpy(p, m);
-	strcpy(s, p);
-
-	G_INT(OFS_RETURN) = PR_SetEngineString(s);
+	G_INT(OFS_RETURN) = PR_ZoneString(G_STRING(OFS_PARM0));
 }
 
 /*
@@ -3385,9 +3388,7 @@ string strunzone (string)
 */
 void PF_strunzone (void)
 {
-	// naievil -- no more.
-	//Z_Free(G_STRING(OFS_PARM0));
-	pr_string_tempindex--;
+	PR_FreeZoneString(G_INT(OFS_PARM0));
 	G_INT(OFS_PARM0) = OFS_NULL; // empty the def
 };
 
@@ -3400,30 +3401,22 @@ string strtrim (string)
 */
 void PF_strtrim (void)
 {
-	const char *str = G_STRING (OFS_PARM0);
-	const char *end;
-	char       *news;
-	size_t      len;
+	const char *str, *start, *end;
+	int         len;
+
+	str = PR_GetStringLength (G_INT (OFS_PARM0), &len);
 
 	// figure out the new start
-	while (*str == ' ' || *str == '\t' || *str == '\n' || *str == '\r')
-		str++;
+	start = str;
+	while (*start == ' ' || *start == '\t' || *start == '\n' || *start == '\r')
+		start++;
 
 	// figure out the new end.
-	end = str + strlen (str);
-	while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
+	end = str + len;
+	while (end > start && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
 		end--;
 
-	// copy that substring into a tempstring.
-	len = end - str;
-	if (len >= STRINGTEMP_LENGTH)
-		len = STRINGTEMP_LENGTH - 1;
-
-	news = PR_GetTempString ();
-	memcpy (news, str, len);
-	news[len] = 0;
-
-	G_INT (OFS_RETURN) = PR_SetEngineString (news);
+	G_INT (OFS_RETURN) = PR_TempSubString (G_INT (OFS_PARM0), start - str, end - start);
 };
 
 /*
@@ -3435,12 +3428,15 @@ string strtolower (string)
 */
 void PF_strtolower (void)
 {
-	const char *in = G_STRING (OFS_PARM0);
-	char       *out, *result = PR_GetTempString ();
-	for (out = result; *in && out < result + STRINGTEMP_LENGTH - 1;)
+	const char *in;
+	char       *out;
+	int         len, num;
+
+	in = PR_GetStringLength (G_INT (OFS_PARM0), &len);
+	num = PR_NewTempString (len, &out);
+	while (len--)
 		*out++ = q_tolower (*in++);
-	*out = 0;
-	G_INT (OFS_RETURN) = PR_SetEngineString (result);
+	G_INT (OFS_RETURN) = num;
 }
 
 /*
@@ -3467,8 +3463,10 @@ float strlen (string)
 */
 void PF_strlen (void)
 {
-	char *p = G_STRING(OFS_PARM0);
-	G_FLOAT(OFS_RETURN) = strlen(p);
+	int len;
+
+	PR_GetStringLength (G_INT(OFS_PARM0), &len);
+	G_FLOAT(OFS_RETURN) = len;
 }
 
 /*
@@ -3482,84 +3480,57 @@ void PF_substring (void)
 {
 	int		offset, length;
 	int		maxoffset;
-	char	*p;
-	char 	*s;
-
-	s = PR_GetTempString();
 
-
-	p = G_STRING(OFS_PARM0);
+	PR_GetStringLength (G_INT(OFS_PARM0), &maxoffset);
 	offset = (int)G_FLOAT(OFS_PARM1); // for some reason, Quake doesn't like G_INT
 	length = (int)G_FLOAT(OFS_PARM2);
 
 	// cap values
-	maxoffset = strlen(p);
 	if (offset > maxoffset)
 	{
 		offset = maxoffset;
 	}
 	if (offset < 0)
 		offset = 0;
-	if (length >= STRINGTEMP_LENGTH)
-		length = STRINGTEMP_LENGTH-1;
+	if (length > maxoffset - offset)
+		length = maxoffset - offset;
 	if (length < 0)
 		length = 0;
 
-	p += offset;
-	strncpy(s, p, length);
-	G_INT(OFS_RETURN) = PR_SetEngineString(s);
+	G_INT(OFS_RETURN) = PR_TempSubString (G_INT(OFS_PARM0), offset, length);
 }
 
 /*
 =================
 PF_strcat
 
-string strcat (string, string)
+string strcat (string, string, ...)
+
+Takes up to 8 strings, so that a line can be built in one call rather
+than by appending to it a piece at a time.
 =================
 */
 
-char	M_pr_string_temp[STRINGTEMP_LENGTH];	
-// 2001-10-25 Enhanced temp string handling by Maddes
-
 static void PF_strcat (void)
 {
-	char *s1, *s2, *s;
-	int		maxlen;	
-	// 2001-10-25 Enhanced temp string handling by Maddes
-
-	s1 = G_STRING(OFS_PARM0);
-	s2 = G_STRING(OFS_PARM1);
-	s = PR_GetTempString();
-
+	const char	*in[8];
+	int		len[8];
+	char	*s;
+	int		i, total, num;
 
-	// 2001-10-25 Enhanced temp string handling by Maddes  start
-	M_pr_string_temp[0] = 0;
-	if (strlen(s1) < STRINGTEMP_LENGTH)
-	{
-		strcpy(M_pr_string_temp, s1);
-	}
-	else
+	for (i = total = 0; i < pr_argc; i++)
 	{
-		strncpy(M_pr_string_temp, s1, STRINGTEMP_LENGTH);
-		M_pr_string_temp[STRINGTEMP_LENGTH-1] = 0;
+		in[i] = PR_GetStringLength (G_INT(OFS_PARM0 + i * 3), &len[i]);
+		total += len[i];
 	}
 
-	maxlen = STRINGTEMP_LENGTH - strlen(M_pr_string_temp) - 1;	// -1 is EndOfString
-	if (maxlen > 0)
+	num = PR_NewTempString (total, &s);
+	for (i = 0; i < pr_argc; i++)
 	{
-		if (maxlen > strlen(s2))
-		{
-			strcat (M_pr_string_temp, s2);
-		}
-		else
-		{
-			strncat (M_pr_string_temp, s2, maxlen);
-			M_pr_string_temp[STRINGTEMP_LENGTH-1] = 0;
-		}
+		memcpy (s, in[i], len[i]);
+		s += len[i];
 	}
-
-	strcpy(s, M_pr_string_temp);
-	G_INT(OFS_RETURN) = PR_SetEngineString(s);
+	G_INT(OFS_RETURN) = num;
 }
 
 /*
@@ -3610,16 +3581,124 @@ void PF_stov (void)
 PF_tokenize
 
 float tokenize (string) = #441
+
+Splits the string the way Cmd_TokenizeString and COM_Parse do, up to the
+first newline, but into tokens of its own: the console's arguments are
+left alone and nothing is allocated per token. The tokens are copied
+once, each followed by a 0, and argv hands out views of them.
 =================
 */
 //KRIMZON_SV_PARSECLIENTCOMMAND added both of these
 // refined to work on psp on 2017-DEC-09
 // ...and then again on switch on 2019-MAY-03
+#define	MAX_QCTOKENS	80	// same as the console's MAX_ARGS
+
+static struct
+{
+	char	*text;				// the tokens, each followed by a 0
+	int		textsize, textused;
+	int		num;
+	int		start[MAX_QCTOKENS];
+	int		len[MAX_QCTOKENS];
+	int		string[MAX_QCTOKENS];	// argv's string number, 0 if not made yet
+	char	*temptext;			// copy of text that lasts the frame
+	int		generation;			// pr_tempgeneration for string[] and temptext
+} pr_tokens;
+
+static void PR_AddToken (const char *s, int len)
+{
+	if (pr_tokens.textused + len + 1 > pr_tokens.textsize)
+	{
+		pr_tokens.textsize = q_max (pr_tokens.textsize * 2, pr_tokens.textused + len + 256);
+		pr_tokens.text = (char *) Mem_Realloc (MEM_QC, pr_tokens.text, pr_tokens.textsize);
+		if (!pr_tokens.text)
+			Sys_Error ("PF_tokenize: out of memory");
+	}
+	if (pr_tokens.num < MAX_QCTOKENS)
+	{
+		pr_tokens.start[pr_tokens.num] = pr_tokens.textused;
+		pr_tokens.len[pr_tokens.num] = len;
+		pr_tokens.string[pr_tokens.num] = 0;
+		pr_tokens.num++;
+		memcpy (pr_tokens.text + pr_tokens.textused, s, len);
+		pr_tokens.textused += len;
+		pr_tokens.text[pr_tokens.textused++] = 0;
+	}
+}
+
 void PF_tokenize (void)
 {
-	char *m = G_STRING(OFS_PARM0);
-	Cmd_TokenizeString(m);
-	G_FLOAT(OFS_RETURN) = Cmd_Argc();
+	const char	*data, *start;
+	int			c;
+
+	data = G_STRING(OFS_PARM0);
+	pr_tokens.num = 0;
+	pr_tokens.textused = 0;
+	pr_tokens.temptext = NULL;
+
+	while (1)
+	{
+	// skip whitespace up to a newline, which ends the command
+		while ((c = *data) != 0 && c <= ' ' && c != '\n')
+			data++;
+		if (c == '\n' || !c)
+			break;
+
+	// from here on as COM_Parse, which goes past newlines after a comment
+skipwhite:
+		while ((c = *data) <= ' ')
+		{
+			if (!c)
+				goto done;
+			data++;
+		}
+		if (c == '/' && data[1] == '/')
+		{
+			while (*data && *data != '\n')
+				data++;
+			goto skipwhite;
+		}
+		if (c == '/' && data[1] == '*')
+		{
+			data += 2;
+			while (*data && !(*data == '*' && data[1] == '/'))
+				data++;
+			if (*data)
+				data += 2;
+			goto skipwhite;
+		}
+
+	// quoted strings
+		if (c == '\"')
+		{
+			start = ++data;
+			while (*data && *data != '\"')
+				data++;
+			PR_AddToken (start, data - start);
+			if (*data)
+				data++;
+			continue;
+		}
+
+	// single characters
+		if (c == '{' || c == '}'|| c == '('|| c == ')' || c == '\'' || c == ':')
+		{
+			PR_AddToken (data, 1);
+			data++;
+			continue;
+		}
+
+	// a regular word
+		start = data;
+		do
+		{
+			c = *++data;
+		} while (c > 32 && c != '{' && c != '}' && c != '(' && c != ')' && c != '\'');
+		PR_AddToken (start, data - start);
+	}
+
+done:
+	G_FLOAT(OFS_RETURN) = pr_tokens.num;
 };
 
 /*
@@ -3631,13 +3710,31 @@ string argv (float num) = #442
 */
 void PF_ArgV  (void)
 {
-	char tempc[256];
-	char *s; 
-	s = PR_GetTempString();
+	int		i = G_FLOAT(OFS_PARM0);
+
+	if (i < 0 || i >= pr_tokens.num)
+	{
+		G_INT(OFS_RETURN) = 0;	// ""
+		return;
+	}
 
-	strcpy(tempc, Cmd_Argv(G_FLOAT(OFS_PARM0)));
-	strcpy(s, tempc);
-	G_INT(OFS_RETURN) = PR_SetEngineString(s);
+// string numbers and the temp copy go at the end of the frame
+	if (pr_tokens.generation != pr_tempgeneration)
+	{
+		memset (pr_tokens.string, 0, sizeof(pr_tokens.string));
+		pr_tokens.temptext = NULL;
+		pr_tokens.generation = pr_tempgeneration;
+	}
+	if (!pr_tokens.string[i])
+	{
+		if (!pr_tokens.temptext)
+		{
+			PR_TempString (pr_tokens.textused, &pr_tokens.temptext);
+			memcpy (pr_tokens.temptext, pr_tokens.text, pr_tokens.textused);
+		}
+		pr_tokens.string[i] = PR_TempStringView (pr_tokens.temptext + pr_tokens.start[i], pr_tokens.len[i]);
+	}
+	G_INT(OFS_RETURN) = pr_tokens.string[i];
 }
 
 static builtin_t pr_builtin[] =
@@ -26,13 +26,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 dprograms_t		*progs;
 dfunction_t		*pr_functions;
 
-char		*pr_strings;
-static	int		pr_stringssize;
-static	const char	**pr_knownstrings;
-static	int		pr_maxknownstrings;
-static	int		pr_numknownstrings;
-static	ddef_t		*pr_fielddefs;
-static	ddef_t		*pr_globaldefs;
+ddef_t		*pr_fielddefs;
+ddef_t		*pr_globaldefs;
 
 qboolean	pr_alpha_supported; //johnfitz
 
@@ -57,19 +52,23 @@ int		type_size[8] = {
 static ddef_t	*ED_FieldAtOfs (int ofs);
 static qboolean	ED_ParseEpair (void *base, ddef_t *key, const char *s);
 
-#define	MAX_FIELD_LEN	64
-#define	GEFV_CACHESIZE	2
+// name lookup tables, built by PR_LoadProgs. Open addressing, each slot
+// holds a def/function index + 1, 0 for empty
+typedef struct
+{
+	int			*slots;
+	int			mask;
+	const byte	*base;		// first def or function
+	int			stride;
+	int			nameofs;	// of s_name
+} edhash_t;
 
-typedef struct {
-	ddef_t	*pcache;
-	char	field[MAX_FIELD_LEN];
-} gefv_cache;
+static edhash_t	ed_fieldhash, ed_globalhash, ed_functionhash;
 
-static gefv_cache	gefvCache[GEFV_CACHESIZE] =
-{
-		{ NULL,	"" },
-		{ NULL,	"" }
-};
+// offset to def tables for ED_FieldAtOfs/ED_GlobalAtOfs
+static ddef_t	**ed_fieldatofs, **ed_globalatofs;
+
+extfields_t	pr_extfields;
 
 cvar_t	nomonsters = {"nomonsters", "0", CVAR_NONE};
 cvar_t	gamecfg = {"gamecfg", "0", CVAR_NONE};
@@ -94,6 +93,7 @@ void ED_ClearEdict (edict_t *e)
 {
 	memset (&e->v, 0, progs->entityfields * 4);
 	e->free = false;
+	SV_MirrorSync (e);
 }
 
 /*
@@ -130,6 +130,7 @@ edict_t *ED_Alloc (void)
 	sv.num_edicts++;
 	e = EDICT_NUM(i);
 	memset(e, 0, pr_edict_size); // ericw -- switched sv.edicts to malloc(), so we are accessing uninitialized memory and must fully zero it, not just ED_ClearEdict
+	SV_MirrorSync (e);
 
 	return e;
 }
@@ -163,65 +164,139 @@ void ED_Free (edict_t *ed)
 	ed->alpha = ENTALPHA_DEFAULT; //johnfitz -- reset alpha for next entity
 
 	ed->freetime = sv.time;
+	SV_MirrorSync (ed);
 }
 
 //===========================================================================
 
 /*
 ============
-ED_GlobalAtOfs
+ED_HashName
 ============
 */
-static ddef_t *ED_GlobalAtOfs (int ofs)
+static const char *ED_HashName (const edhash_t *h, int i)
 {
-	ddef_t		*def;
-	int			i;
+	return PR_GetString (*(const int *)(h->base + i * h->stride + h->nameofs));
+}
 
-	for (i = 0; i < progs->numglobaldefs; i++)
+/*
+============
+ED_BuildHash
+
+Tables are at most half full. Where several entries share a name the
+first one is found, as with the old linear searches.
+============
+*/
+static void ED_BuildHash (edhash_t *h, const void *base, int count, int stride, int nameofs)
+{
+	int		i, slot, size;
+
+	for (size = 16; size < count * 2; size <<= 1)
+		;
+	h->slots = (int *) Hunk_AllocName (size * sizeof(int), "edhash");
+	h->mask = size - 1;
+	h->base = (const byte *)base;
+	h->stride = stride;
+	h->nameofs = nameofs;
+
+	for (i = 0; i < count; i++)
 	{
-		def = &pr_globaldefs[i];
-		if (def->ofs == ofs)
-			return def;
+		slot = COM_HashString (ED_HashName (h, i)) & h->mask;
+		while (h->slots[slot])
+			slot = (slot + 1) & h->mask;
+		h->slots[slot] = i + 1;
 	}
-	return NULL;
 }
 
 /*
 ============
-ED_FieldAtOfs
+ED_HashFind
+
+Returns the index of the entry called name, or -1
 ============
 */
-static ddef_t *ED_FieldAtOfs (int ofs)
+static int ED_HashFind (const edhash_t *h, const char *name)
 {
-	ddef_t		*def;
-	int			i;
+	int		slot;
 
-	for (i = 0; i < progs->numfielddefs; i++)
+	if (!h->slots)
+		return -1;
+
+	for (slot = COM_HashString (name) & h->mask; h->slots[slot]; slot = (slot + 1) & h->mask)
 	{
-		def = &pr_fielddefs[i];
-		if (def->ofs == ofs)
-			return def;
+		if (!strcmp (ED_HashName (h, h->slots[slot] - 1), name))
+			return h->slots[slot] - 1;
 	}
-	return NULL;
+	return -1;
 }
 
 /*
 ============
-ED_FindField
+ED_BuildLookups
+
+Called by PR_LoadProgs once the defs are byte swapped
 ============
 */
-static ddef_t *ED_FindField (const char *name)
+static void ED_BuildLookups (void)
 {
-	ddef_t		*def;
-	int			i;
+	int		i;
 
-	for (i = 0; i < progs->numfielddefs; i++)
+	ED_BuildHash (&ed_fieldhash, pr_fielddefs, progs->numfielddefs, sizeof(ddef_t), offsetof(ddef_t, s_name));
+	ED_BuildHash (&ed_globalhash, pr_globaldefs, progs->numglobaldefs, sizeof(ddef_t), offsetof(ddef_t, s_name));
+	ED_BuildHash (&ed_functionhash, pr_functions, progs->numfunctions, sizeof(dfunction_t), offsetof(dfunction_t, s_name));
+
+// first def at each offset, as the linear search found
+	ed_fieldatofs = (ddef_t **) Hunk_AllocName (progs->entityfields * sizeof(ddef_t *), "edhash");
+	for (i = progs->numfielddefs - 1; i >= 0; i--)
 	{
-		def = &pr_fielddefs[i];
-		if ( !strcmp(PR_GetString(def->s_name), name) )
-			return def;
+		if ((unsigned short)pr_fielddefs[i].ofs < progs->entityfields)
+			ed_fieldatofs[(unsigned short)pr_fielddefs[i].ofs] = &pr_fielddefs[i];
 	}
-	return NULL;
+	ed_globalatofs = (ddef_t **) Hunk_AllocName (progs->numglobals * sizeof(ddef_t *), "edhash");
+	for (i = progs->numglobaldefs - 1; i >= 0; i--)
+	{
+		if ((unsigned short)pr_globaldefs[i].ofs < progs->numglobals)
+			ed_globalatofs[(unsigned short)pr_globaldefs[i].ofs] = &pr_globaldefs[i];
+	}
+
+	pr_extfields.alpha = ED_FindFieldOffset ("alpha");
+	pr_extfields.gravity = ED_FindFieldOffset ("gravity");
+}
+
+/*
+============
+ED_GlobalAtOfs
+============
+*/
+static ddef_t *ED_GlobalAtOfs (int ofs)
+{
+	if (ofs < 0 || ofs >= progs->numglobals)
+		return NULL;
+	return ed_globalatofs[ofs];
+}
+
+/*
+============
+ED_FieldAtOfs
+============
+*/
+static ddef_t *ED_FieldAtOfs (int ofs)
+{
+	if (ofs < 0 || ofs >= progs->entityfields)
+		return NULL;
+	return ed_fieldatofs[ofs];
+}
+
+/*
+============
+ED_FindField
+============
+*/
+static ddef_t *ED_FindField (const char *name)
+{
+	int		i = ED_HashFind (&ed_fieldhash, name);
+
+	return (i < 0) ? NULL : &pr_fielddefs[i];
 }
 
 
@@ -232,16 +307,9 @@ ED_FindGlobal
 */
 static ddef_t *ED_FindGlobal (const char *name)
 {
-	ddef_t		*def;
-	int			i;
+	int		i = ED_HashFind (&ed_globalhash, name);
 
-	for (i = 0; i < progs->numglobaldefs; i++)
-	{
-		def = &pr_globaldefs[i];
-		if ( !strcmp(PR_GetString(def->s_name), name) )
-			return def;
-	}
-	return NULL;
+	return (i < 0) ? NULL : &pr_globaldefs[i];
 }
 
 
@@ -252,52 +320,37 @@ ED_FindFunction
 */
 static dfunction_t *ED_FindFunction (const char *fn_name)
 {
-	dfunction_t		*func;
-	int				i;
+	int		i = ED_HashFind (&ed_functionhash, fn_name);
 
-	for (i = 0; i < progs->numfunctions; i++)
-	{
-		func = &pr_functions[i];
-		if ( !strcmp(PR_GetString(func->s_name), fn_name) )
-			return func;
-	}
-	return NULL;
+	return (i < 0) ? NULL : &pr_functions[i];
 }
 
 /*
 ============
-GetEdictFieldValue
+ED_FindFieldOffset
+
+Returns the offset of the field in entvars_t, in ints, or -1 if the progs
+have no such field. For use with GetEdictFieldValueAt.
 ============
 */
-eval_t *GetEdictFieldValue(edict_t *ed, const char *field)
+int ED_FindFieldOffset (const char *name)
 {
-	ddef_t			*def = NULL;
-	int				i;
-	static int		rep = 0;
-
-	for (i = 0; i < GEFV_CACHESIZE; i++)
-	{
-		if (!strcmp(field, gefvCache[i].field))
-		{
-			def = gefvCache[i].pcache;
-			goto Done;
-		}
-	}
+	ddef_t	*def = ED_FindField (name);
 
-	def = ED_FindField (field);
-
-	if (strlen(field) < MAX_FIELD_LEN)
-	{
-		gefvCache[rep].pcache = def;
-		strcpy (gefvCache[rep].field, field);
-		rep ^= 1;
-	}
+	return def ? def->ofs : -1;
+}
 
-Done:
-	if (!def)
-		return NULL;
+/*
+============
+GetEdictFieldValue
 
-	return (eval_t *)((char *)&ed->v + def->ofs*4);
+Looks the field up every time, GetEdictFieldValueAt with an offset from
+ED_FindFieldOffset is better for anything done per frame
+============
+*/
+eval_t *GetEdictFieldValue(edict_t *ed, const char *field)
+{
+	return GetEdictFieldValueAt (ed, ED_FindFieldOffset (field));
 }
 
 
@@ -994,6 +1047,7 @@ void ED_LoadFromFile (const char *data)
 		else
 			ent = ED_Alloc ();
 		data = ED_ParseEdict (data, ent);
+		SV_MirrorSync (ent);
 
 //
 // immediately call spawn function
@@ -1035,10 +1089,6 @@ void PR_LoadProgs (void)
 	int			i;
 	dfunction_t	*f;
 
-	// flush the non-C variable lookup cache
-	for (i = 0; i < GEFV_CACHESIZE; i++)
-		gefvCache[i].field[0] = 0;
-
 	CRC_Init (&pr_crc);
 
 	progs = (dprograms_t *)COM_LoadHunkFile ("progs.dat", NULL);
@@ -1066,14 +1116,7 @@ void PR_LoadProgs (void)
 		Host_Error ("progs.dat strings go past end of file\n");
 
 	// initialize the strings
-	pr_numknownstrings = 0;
-	pr_maxknownstrings = 0;
-	pr_stringssize = progs->numstrings;
-
-	if (pr_knownstrings)
-		Z_Free ((void *)pr_knownstrings);
-	pr_knownstrings = NULL;
-	PR_SetEngineString("");
+	PR_ClearStrings (progs->numstrings);
 
 	pr_globaldefs = (ddef_t *)((byte *)progs + progs->ofs_globaldefs);
 	pr_fielddefs = (ddef_t *)((byte *)progs + progs->ofs_fielddefs);
@@ -1127,6 +1170,12 @@ void PR_LoadProgs (void)
 	for (i = 0; i < progs->numglobals; i++)
 		((int *)pr_globals)[i] = LittleLong (((int *)pr_globals)[i]);
 
+	ED_BuildLookups ();
+	PR_DecodeStatements ();
+	PR_OptimizeStatements ();
+	PR_JitReset ();
+	PR_ProfLoad ();
+
 	pr_edict_size = progs->entityfields * 4 + sizeof(edict_t) - sizeof(entvars_t);
 	// round off to next highest whole word address (esp for Alpha)
 	// this ensures that pointers in the engine data area are always
@@ -1148,10 +1197,17 @@ PR_Init
 */
 void PR_Init (void)
 {
+	extern cvar_t	pr_peephole;
+
 	Cmd_AddCommand ("edict", ED_PrintEdict_f);
 	Cmd_AddCommand ("edicts", ED_PrintEdicts);
 	Cmd_AddCommand ("edictcount", ED_Count);
 	Cmd_AddCommand ("profile", PR_Profile_f);
+	Cmd_AddCommand ("pr_bench", PR_Bench_f);
+	PR_JitInit ();
+	PR_ProfInit ();
+	PR_InitStrings ();
+	Cvar_RegisterVariable (&pr_peephole);
 	Cvar_RegisterVariable (&nomonsters);
 	Cvar_RegisterVariable (&gamecfg);
 	Cvar_RegisterVariable (&scratch1);
@@ -1184,120 +1240,3 @@ int NUM_FOR_EDICT(edict_t *e)
 		Host_Error ("NUM_FOR_EDICT: bad pointer");
 	return b;
 }
-
-//===========================================================================
-
-
-#define	PR_STRING_ALLOCSLOTS	256
-
-static void PR_AllocStringSlots (void)
-{
-	pr_maxknownstrings += PR_STRING_ALLOCSLOTS;
-	Con_DPrintf2("PR_AllocStringSlots: realloc'ing for %d slots\n", pr_maxknownstrings);
-	pr_knownstrings = (const char **) Z_Realloc ((void *)pr_knownstrings, pr_maxknownstrings * sizeof(char *));
-}
-
-const char *PR_GetString (int num)
-{
-	// Naievil -- rewrote this... not sure why it was generating out of bounds errors!
-	// 		The below commented code used to overwrite the memory on NX...probably due to a 
-	// 		bad compiler?
-	if (num >= 0) {
-		if (num < pr_stringssize) {
-			return (pr_strings + num);
-		}
-	} else {
-		if (num < 0) {
-			if (num >= (-1 * pr_numknownstrings)) {
-				if (!pr_knownstrings[-1 - num]) {
-					Host_Error ("PR_GetString: attempt to get a non-existant string %d\n", num);
-					return "";
-				}
-				return pr_knownstrings[-1 - num];
-			}
-		} else {
-			Host_Error("PR_GetString: invalid string offset %d\n", num);
-			return "";
-		}
-	}
-
-	// if ((num >= 0) && (num < pr_stringssize))
-	// 	return pr_strings + num;
-	// else if ((num < 0) && (num >= -pr_numknownstrings))
-	// {
-	// 	if (!pr_knownstrings[-1 - num])
-	// 	{
-	// 		Host_Error ("PR_GetString: attempt to get a non-existant string %d\n", num);
-	// 		return "";
-	// 	}
-	// 	return pr_knownstrings[-1 - num];
-	// }
-	// else
-	// {
-	// 	Host_Error("PR_GetString: invalid string offset %d, not in pr_stringssize of %d and not >= %d\n", num, pr_stringssize, -1*pr_numknownstrings);
-	// 	return "";
-	// }
-
-	return "";
-}
-
-int PR_SetEngineString (const char *s)
-{
-	int		i;
-
-	if (!s)
-		return 0;
-#if 0	/* can't: sv.model_precache & sv.sound_precache points to pr_strings */
-	if (s >= pr_strings && s <= pr_strings + pr_stringssize)
-		Host_Error("PR_SetEngineString: \"%s\" in pr_strings area\n", s);
-#else
-	if (s >= pr_strings && s <= pr_strings + pr_stringssize - 2)
-		return (int)(s - pr_strings);
-#endif
-	for (i = 0; i < pr_numknownstrings; i++)
-	{
-		if (pr_knownstrings[i] == s)
-			return -1 - i;
-	}
-	// new unknown engine string
-	//Con_DPrintf ("PR_SetEngineString: new engine string %p\n", s);
-#if 0
-	for (i = 0; i < pr_numknownstrings; i++)
-	{
-		if (!pr_knownstrings[i])
-			break;
-	}
-#endif
-//	if (i >= pr_numknownstrings)
-//	{
-		if (i >= pr_maxknownstrings)
-			PR_AllocStringSlots();
-		pr_numknownstrings++;
-//	}
-	pr_knownstrings[i] = s;
-	return -1 - i;
-}
-
-int PR_AllocString (int size, char **ptr)
-{
-	int		i;
-
-	if (!size)
-		return 0;
-	for (i = 0; i < pr_numknownstrings; i++)
-	{
-		if (!pr_knownstrings[i])
-			break;
-	}
-//	if (i >= pr_numknownstrings)
-//	{
-		if (i >= pr_maxknownstrings)
-			PR_AllocStringSlots();
-		pr_numknownstrings++;
-//	}
-	pr_knownstrings[i] = (char *)Hunk_AllocName(size, "string");
-	if (ptr)
-		*ptr = (char *) pr_knownstrings[i];
-	return -1 - i;
-}
-
@@ -35,6 +35,36 @@ static int		pr_depth;
 static int		localstack[LOCALSTACK_SIZE];
 static int		localstack_used;
 
+static int		pr_nesting;		// PR_ExecuteProgram recursion through builtins
+
+// per function, set up by PR_DecodeStatements
+typedef struct
+{
+	int		savelocals;		// words PR_EnterFunction saves, 0 for a leaf no other function shares locals with
+	int		parmwords;		// parameter words if they are laid out like OFS_PARM0..., else -1
+	int		reloadstart;	// first non-parameter local of a leaf that doesn't save
+	int		reloadwords;
+	int		*initlocals;	// their values when the progs were loaded
+} prfuncinfo_t;
+
+static prfuncinfo_t	*pr_funcinfo;
+static int			pr_cachedcalls;		// builtin call sites resolved by PR_DecodeStatements
+
+// pr_bench state
+static struct
+{
+	qboolean	active;
+	double		endtime;
+	double		time;			// spent in outermost PR_ExecuteProgram calls
+	double		statements;
+	int			calls;
+	int			startframe;
+	int			builtins;		// builtin calls from QC
+	int			cachedbuiltins;	// through a resolved call site
+	int			functions;		// QC to QC calls
+	int			leafcalls;		// of those, to leaves with no locals to save
+} prbench;
+
 qboolean	pr_trace;
 dfunction_t	*pr_xfunction;
 int		pr_xstatement;
@@ -129,9 +159,6 @@ static const char *pr_opnames[] =
 	"BITOR"
 };
 
-const char *PR_GlobalString (int ofs);
-const char *PR_GlobalStringNoContents (int ofs);
-
 
 //=============================================================================
 
@@ -269,6 +296,7 @@ void PR_RunError (const char *error, ...)
 	Con_Printf("%s\n", string);
 
 	pr_depth = 0;	// dump the stack so host_error can shutdown functions
+	pr_nesting = 0;
 
 	Host_Error("Program error");
 }
@@ -282,7 +310,9 @@ Returns the new program statement counter
 */
 static int PR_EnterFunction (dfunction_t *f)
 {
-	int	i, j, c, o;
+	prfuncinfo_t	*info = &pr_funcinfo[f - pr_functions];
+	int	*globals = (int *)pr_globals;
+	int	i, c, o;
 
 	pr_stack[pr_depth].s = pr_xstatement;
 	pr_stack[pr_depth].f = pr_xfunction;
@@ -291,26 +321,38 @@ static int PR_EnterFunction (dfunction_t *f)
 		PR_RunError("stack overflow");
 
 	// save off any locals that the new function steps on
-	c = f->locals;
+	c = info->savelocals;
 	if (localstack_used + c > LOCALSTACK_SIZE)
 		PR_RunError("PR_ExecuteProgram: locals stack overflow\n");
 
-	for (i = 0; i < c ; i++)
-		localstack[localstack_used + i] = ((int *)pr_globals)[f->parm_start + i];
+	memcpy (&localstack[localstack_used], &globals[f->parm_start], c * sizeof(int));
 	localstack_used += c;
+	// a leaf's last call left its locals behind rather than restoring them
+	if (info->reloadwords)
+		memcpy (&globals[info->reloadstart], info->initlocals, info->reloadwords * sizeof(int));
+	if (prbench.active)
+	{
+		prbench.functions++;
+		if (!c)
+			prbench.leafcalls++;
+	}
 
 	// copy parameters
-	o = f->parm_start;
-	for (i = 0; i < f->numparms; i++)
+	if (info->parmwords >= 0)
+		memcpy (&globals[f->parm_start], &globals[OFS_PARM0], info->parmwords * sizeof(int));
+	else
 	{
-		for (j = 0; j < f->parm_size[i]; j++)
+		o = f->parm_start;
+		for (i = 0; i < f->numparms; i++)
 		{
-			((int *)pr_globals)[o] = ((int *)pr_globals)[OFS_PARM0 + i*3 + j];
-			o++;
+			memcpy (&globals[o], &globals[OFS_PARM0 + i*3], f->parm_size[i] * sizeof(int));
+			o += f->parm_size[i];
 		}
 	}
 
 	pr_xfunction = f;
+	if (pr_profiling)
+		PR_ProfEnter (f);
 	return f->first_statement - 1;	// offset the s++
 }
 
@@ -321,19 +363,21 @@ PR_LeaveFunction
 */
 static int PR_LeaveFunction (void)
 {
-	int	i, c;
+	int	c;
 
 	if (pr_depth <= 0)
 		Host_Error("prog stack underflow");
 
+	if (pr_profiling)
+		PR_ProfLeave ();
+
 	// Restore locals from the stack
-	c = pr_xfunction->locals;
+	c = pr_funcinfo[pr_xfunction - pr_functions].savelocals;
 	localstack_used -= c;
 	if (localstack_used < 0)
 		PR_RunError("PR_ExecuteProgram: locals stack underflow");
 
-	for (i = 0; i < c; i++)
-		((int *)pr_globals)[pr_xfunction->parm_start + i] = localstack[localstack_used + i];
+	memcpy (&((int *)pr_globals)[pr_xfunction->parm_start], &localstack[localstack_used], c * sizeof(int));
 
 	// up stack
 	pr_depth--;
@@ -342,25 +386,362 @@ static int PR_LeaveFunction (void)
 }
 
 
+/*
+===============================================================================
+
+STATEMENT DECODING
+
+Each dstatement_t is widened at load time into a prstatement_t with its
+operands resolved to global pointers and, where the compiler supports
+computed goto, the address of its handler in PR_Interpret. Statement n of
+pr_decoded is always statement n of pr_statements, so pr_xstatement, stack
+traces and the profile keep working on statement numbers.
+
+===============================================================================
+*/
+
+#if defined(__GNUC__) && !defined(PR_NO_COMPUTED_GOTO)
+#define	PR_COMPUTED_GOTO	/* labels as values */
+#endif
+
+prstatement_t	*pr_decoded;
+
+cvar_t	pr_peephole = {"pr_peephole", "1", CVAR_NONE};	// superinstructions, from the next progs load
+
+static int	pr_fused[OPX_NUMOPS - OP_NUMOPS];	// by the last PR_OptimizeStatements
+
+#ifdef PR_COMPUTED_GOTO
+static const void	*pr_oplabels[OPX_NUMOPS];
+static const void	*pr_badoplabel;
+#endif
+
+static void PR_Interpret (prstatement_t *st, int exitdepth);
+
 /*
 ====================
-PR_ExecuteProgram
+PR_AnalyzeFunctions
+
+Fills in pr_funcinfo. A leaf function (one without calls) can't be entered
+again while it runs, so unless another function's locals overlap its own
+(fteqcc can do that) there is nothing PR_EnterFunction needs to save. It
+only has to put back the initial values of the locals that aren't
+parameters, which saving and restoring them used to keep.
+====================
+*/
+static void PR_AnalyzeFunctions (void)
+{
+	dfunction_t	*f;
+	byte	*users;		// functions with locals at each global, up to 2
+	int		*startof;	// function starting at each statement, or -1
+	qboolean	*calls;
+	int		*init;
+	int		i, j, cur, total;
+
+	pr_funcinfo = (prfuncinfo_t *) Hunk_AllocName (progs->numfunctions * sizeof(prfuncinfo_t), "prfuncs");
+	users = (byte *) calloc (progs->numglobals, 1);
+	startof = (int *) malloc (progs->numstatements * sizeof(int));
+	calls = (qboolean *) calloc (progs->numfunctions, sizeof(qboolean));
+	if (!users || !startof || !calls)
+		Sys_Error ("PR_AnalyzeFunctions: out of memory");
+
+	for (i = 0; i < progs->numstatements; i++)
+		startof[i] = -1;
+	for (i = 0, f = pr_functions; i < progs->numfunctions; i++, f++)
+	{
+		if (f->first_statement <= 0 || f->first_statement >= progs->numstatements)
+			continue;
+		startof[f->first_statement] = i;
+		for (j = f->parm_start; j < f->parm_start + f->locals && j < progs->numglobals; j++)
+		{
+			if (users[j] < 2)
+				users[j]++;
+		}
+	}
+
+	for (i = 0, cur = -1; i < progs->numstatements; i++)
+	{
+		if (startof[i] != -1)
+			cur = startof[i];
+		if (cur != -1 && pr_statements[i].op >= OP_CALL0 && pr_statements[i].op <= OP_CALL8)
+			calls[cur] = true;
+	}
+
+	total = 0;
+	for (i = 0, f = pr_functions; i < progs->numfunctions; i++, f++)
+	{
+		pr_funcinfo[i].savelocals = f->locals;
+		pr_funcinfo[i].reloadwords = 0;
+		pr_funcinfo[i].initlocals = NULL;
+		if (f->first_statement > 0 && !calls[i])
+		{
+			for (j = f->parm_start; j < f->parm_start + f->locals; j++)
+			{
+				if (j >= progs->numglobals || users[j] != 1)
+					break;
+			}
+			if (j == f->parm_start + f->locals)
+				pr_funcinfo[i].savelocals = 0;
+		}
+
+	// parameters are in consecutive globals from parm_start, as are
+	// OFS_PARM0... if all but the last take a vector's 3 words
+		pr_funcinfo[i].parmwords = 0;
+		for (j = 0; j < f->numparms && j < MAX_PARMS; j++)
+		{
+			if (j > 0 && f->parm_size[j - 1] != 3)
+			{
+				pr_funcinfo[i].parmwords = -1;
+				break;
+			}
+			pr_funcinfo[i].parmwords += f->parm_size[j];
+		}
+
+		if (!pr_funcinfo[i].savelocals)
+		{
+			pr_funcinfo[i].reloadstart = f->parm_start;
+			for (j = 0; j < f->numparms && j < MAX_PARMS; j++)
+				pr_funcinfo[i].reloadstart += f->parm_size[j];
+			pr_funcinfo[i].reloadwords = q_max (f->parm_start + f->locals - pr_funcinfo[i].reloadstart, 0);
+			total += pr_funcinfo[i].reloadwords;
+		}
+	}
+
+	init = (int *) Hunk_AllocName (q_max (total, 1) * sizeof(int), "prlocals");
+	for (i = 0; i < progs->numfunctions; i++)
+	{
+		if (!pr_funcinfo[i].reloadwords)
+			continue;
+		pr_funcinfo[i].initlocals = init;
+		memcpy (init, &((int *)pr_globals)[pr_funcinfo[i].reloadstart], pr_funcinfo[i].reloadwords * sizeof(int));
+		init += pr_funcinfo[i].reloadwords;
+	}
+
+	free (users);
+	free (startof);
+	free (calls);
+}
+
+/*
+====================
+PR_ResolveCall
+
+Call sites whose function global holds a builtin when the progs are loaded
+call it directly, for as long as the global still holds that function
+====================
+*/
+static void PR_ResolveCall (prstatement_t *d)
+{
+	dfunction_t	*f;
+	int		fnum, i;
+
+	fnum = d->a->function;
+	if (fnum <= 0 || fnum >= progs->numfunctions)
+		return;
+	f = &pr_functions[fnum];
+	i = -f->first_statement;
+	if (i <= 0 || i >= pr_numbuiltins)
+		return;
+
+	d->op = OPX_CALL_BUILTIN;
+	d->jump = fnum;
+	d->builtin = pr_builtins[i];
+	pr_cachedcalls++;
+}
+
+/*
+====================
+PR_DecodeStatements
 
-The interpretation main loop
+Called by PR_LoadProgs once the statements have been byte swapped
 ====================
 */
-#define OPA ((eval_t *)&pr_globals[(unsigned short)st->a])
-#define OPB ((eval_t *)&pr_globals[(unsigned short)st->b])
-#define OPC ((eval_t *)&pr_globals[(unsigned short)st->c])
+void PR_DecodeStatements (void)
+{
+	dstatement_t	*s;
+	prstatement_t	*d;
+	int		i;
+
+#ifdef PR_COMPUTED_GOTO
+	if (!pr_badoplabel)
+		PR_Interpret (NULL, 0);	// fills in pr_oplabels
+#endif
+
+	pr_nesting = 0;
+	PR_AnalyzeFunctions ();
+	pr_decoded = (prstatement_t *) Hunk_AllocName (progs->numstatements * sizeof(prstatement_t), "prdecode");
+	pr_cachedcalls = 0;
+
+	for (i = 0, s = pr_statements, d = pr_decoded; i < progs->numstatements; i++, s++, d++)
+	{
+		d->op = s->op;
+		switch (s->op)
+		{
+		case OP_IF:
+		case OP_IFNOT:
+			d->a = (eval_t *)&pr_globals[(unsigned short)s->a];
+			d->jump = s->b;
+			break;
+		case OP_GOTO:
+			d->jump = s->a;
+			break;
+		default:
+			d->a = (eval_t *)&pr_globals[(unsigned short)s->a];
+			d->b = (eval_t *)&pr_globals[(unsigned short)s->b];
+			d->c = (eval_t *)&pr_globals[(unsigned short)s->c];
+			break;
+		}
+		if (s->op >= OP_CALL0 && s->op <= OP_CALL8)
+			PR_ResolveCall (d);
+#ifdef PR_COMPUTED_GOTO
+		d->handler = (s->op < OP_NUMOPS) ? pr_oplabels[d->op] : pr_badoplabel;
+#endif
+	}
+}
+
+/*
+====================
+PR_Fuse
+
+Turns statement s into superinstruction op if the next one is one of
+second and reads result, the global the first one writes
+====================
+*/
+static qboolean PR_Fuse (int s, int op, int second1, int second2, eval_t *result)
+{
+	prstatement_t	*d = &pr_decoded[s];
+	int		next;
+
+	if (s + 1 >= progs->numstatements)
+		return false;
+	next = pr_decoded[s + 1].op;
+	if (next < second1 || next > second2)
+		return false;
+
+	switch (op)
+	{
+	case OPX_ADDRESS_STOREP:
+	case OPX_ADDRESS_STOREP_V:
+		if (d[1].b != result)
+			return false;
+		break;
+	case OPX_LOAD_IF:
+	case OPX_LOAD_IFNOT:
+		if (d[1].a != result)
+			return false;
+		break;
+	default:	// ADD_V is commutative
+		if (d[1].a != result && d[1].b != result)
+			return false;
+		break;
+	}
+
+	d->op = op;
+#ifdef PR_COMPUTED_GOTO
+	d->handler = pr_oplabels[op];
+#endif
+	pr_fused[op - OP_NUMOPS]++;
+	return true;
+}
+
+/*
+====================
+PR_OptimizeStatements
+
+Peephole pass over pr_decoded, called by PR_LoadProgs after
+PR_DecodeStatements. Pairs of statements that qcc emits for the same
+source construct are turned into one superinstruction, which saves a
+dispatch and lets the second half use what the first one computed without
+going back through the globals. Statement numbers do not change, the
+second statement of a pair simply isn't dispatched to unless something
+branches to it.
+====================
+*/
+void PR_OptimizeStatements (void)
+{
+	prstatement_t	*d;
+	int		i, total;
+
+	memset (pr_fused, 0, sizeof(pr_fused));
+	if (!pr_peephole.value)
+		return;
 
+	for (i = 0, d = pr_decoded; i < progs->numstatements; i++, d++)
+	{
+		switch (d->op)
+		{
+		case OP_ADDRESS:	// self.field = x
+			if (PR_Fuse (i, OPX_ADDRESS_STOREP, OP_STOREP_F, OP_STOREP_F, d->c) ||
+				PR_Fuse (i, OPX_ADDRESS_STOREP, OP_STOREP_S, OP_STOREP_FNC, d->c) ||
+				PR_Fuse (i, OPX_ADDRESS_STOREP_V, OP_STOREP_V, OP_STOREP_V, d->c))
+				i++, d++;
+			break;
+		case OP_LOAD_F:		// if (self.field)
+		case OP_LOAD_S:
+		case OP_LOAD_ENT:
+		case OP_LOAD_FLD:
+		case OP_LOAD_FNC:
+			if (PR_Fuse (i, OPX_LOAD_IF, OP_IF, OP_IF, d->c) ||
+				PR_Fuse (i, OPX_LOAD_IFNOT, OP_IFNOT, OP_IFNOT, d->c))
+				i++, d++;
+			break;
+		case OP_MUL_FV:		// org + f * dir
+			if (PR_Fuse (i, OPX_MUL_FV_ADD_V, OP_ADD_V, OP_ADD_V, d->c))
+				i++, d++;
+			break;
+		case OP_MUL_VF:
+			if (PR_Fuse (i, OPX_MUL_VF_ADD_V, OP_ADD_V, OP_ADD_V, d->c))
+				i++, d++;
+			break;
+		}
+	}
+
+	for (i = total = 0; i < OPX_NUMOPS - OP_NUMOPS; i++)
+		total += pr_fused[i];
+	Con_DPrintf ("%i statement pairs fused\n", total);
+}
+
+/*
+====================
+PR_RunFunction
+
+Runs f natively if pr_jit has code for it, else interprets it
+====================
+*/
+static void PR_RunFunction (dfunction_t *f)
+{
+	prstatement_t	*st;
+	prnative_t	native;
+	int		exitdepth, steps;
+
+	pr_nesting++;
+
+// make a stack frame
+	exitdepth = pr_depth;
+	st = &pr_decoded[PR_EnterFunction(f)];
+
+	if (pr_jitactive && (native = PR_JitFunction (f)) != NULL)
+	{
+		steps = pr_jitsteps;
+		pr_jitsteps = 0;
+		native ();
+		pr_jitsteps = steps;
+		PR_LeaveFunction ();
+	}
+	else
+		PR_Interpret (st, exitdepth);
+
+	pr_nesting--;
+}
+
+/*
+====================
+PR_ExecuteProgram
+====================
+*/
 void PR_ExecuteProgram (func_t fnum)
 {
-	eval_t		*ptr;
-	dstatement_t	*st;
-	dfunction_t	*f, *newf;
-	int profile, startprofile;
-	edict_t		*ed;
-	int		exitdepth;
+	dfunction_t	*f;
+	double		start;
 
 	if (!fnum || fnum >= progs->numfunctions)
 	{
@@ -373,201 +754,312 @@ void PR_ExecuteProgram (func_t fnum)
 
 	pr_trace = false;
 
-// make a stack frame
-	exitdepth = pr_depth;
+	if (!pr_nesting && pr_profiling)
+		PR_ProfTopLevel ();
 
-	st = &pr_statements[PR_EnterFunction(f)];
-	startprofile = profile = 0;
+	if (!pr_nesting && PR_JitVerify (fnum))
+		return;
+
+	if (!prbench.active || pr_nesting)
+	{
+		PR_RunFunction (f);
+		return;
+	}
 
-    while (1)
-    {
-	st++;	/* next statement */
+	start = Sys_DoubleTime ();
+	PR_RunFunction (f);
+	prbench.time += Sys_DoubleTime () - start;
+	prbench.calls++;
+	if (realtime >= prbench.endtime)
+		PR_Bench_f ();
+}
+
+/*
+====================
+PR_Interpret
+
+The interpretation main loop. st is the statement before the first one to
+run, exitdepth the pr_depth to return at.
+
+Statements are only counted where control flow leaves a straight run of
+them (taken branches, calls and returns), and the runaway check is only
+done at backward branches and calls, the only ways to loop.
+====================
+*/
+#define OPA (st->a)
+#define OPB (st->b)
+#define OPC (st->c)
+
+#ifdef PR_COMPUTED_GOTO
+#define	OPCODE(op)	lbl_##op
+#define	NEXT		do { st++; if (trace) PR_PrintStatement (pr_statements + (st - pr_decoded)); goto *st->handler; } while (0)
+#else
+#define	OPCODE(op)	case op
+#define	NEXT		goto next
+#endif
 
-	if (++profile > 400000)
+#define	SKIP()		do { st++; if (trace) PR_PrintStatement (pr_statements + (st - pr_decoded)); } while (0)
+
+#define	COUNT_RUN()	(profile += (int)(st - runstart) + 1)	/* statements from runstart through st */
+
+#define	RUNAWAY_CHECK()									\
+	if (profile > PR_RUNAWAY)							\
+	{													\
+		pr_xstatement = st - pr_decoded;				\
+		PR_RunError ("runaway loop error");				\
+	}
+
+#define	JUMP(ofs)										\
+	do {												\
+		COUNT_RUN ();									\
+		if ((ofs) <= 0)									\
+			RUNAWAY_CHECK ();							\
+		runstart = st + (ofs);							\
+		st = runstart - 1;	/* NEXT does the st++ */	\
+	} while (0)
+
+static void PR_Interpret (prstatement_t *st, int exitdepth)
+{
+	eval_t		*ptr;
+	prstatement_t	*runstart;
+	dfunction_t	*newf;
+	int		profile, startprofile;
+	qboolean	trace;
+	edict_t		*ed;
+	int		i;
+
+#ifdef PR_COMPUTED_GOTO
+	static const void *const labels[OPX_NUMOPS] =
 	{
-		pr_xstatement = st - pr_statements;
-		PR_RunError("runaway loop error");
+		&&OPCODE(OP_DONE),
+		&&OPCODE(OP_MUL_F), &&OPCODE(OP_MUL_V), &&OPCODE(OP_MUL_FV), &&OPCODE(OP_MUL_VF),
+		&&OPCODE(OP_DIV_F),
+		&&OPCODE(OP_ADD_F), &&OPCODE(OP_ADD_V),
+		&&OPCODE(OP_SUB_F), &&OPCODE(OP_SUB_V),
+		&&OPCODE(OP_EQ_F), &&OPCODE(OP_EQ_V), &&OPCODE(OP_EQ_S), &&OPCODE(OP_EQ_E), &&OPCODE(OP_EQ_FNC),
+		&&OPCODE(OP_NE_F), &&OPCODE(OP_NE_V), &&OPCODE(OP_NE_S), &&OPCODE(OP_NE_E), &&OPCODE(OP_NE_FNC),
+		&&OPCODE(OP_LE), &&OPCODE(OP_GE), &&OPCODE(OP_LT), &&OPCODE(OP_GT),
+		&&OPCODE(OP_LOAD_F), &&OPCODE(OP_LOAD_V), &&OPCODE(OP_LOAD_S),
+		&&OPCODE(OP_LOAD_ENT), &&OPCODE(OP_LOAD_FLD), &&OPCODE(OP_LOAD_FNC),
+		&&OPCODE(OP_ADDRESS),
+		&&OPCODE(OP_STORE_F), &&OPCODE(OP_STORE_V), &&OPCODE(OP_STORE_S),
+		&&OPCODE(OP_STORE_ENT), &&OPCODE(OP_STORE_FLD), &&OPCODE(OP_STORE_FNC),
+		&&OPCODE(OP_STOREP_F), &&OPCODE(OP_STOREP_V), &&OPCODE(OP_STOREP_S),
+		&&OPCODE(OP_STOREP_ENT), &&OPCODE(OP_STOREP_FLD), &&OPCODE(OP_STOREP_FNC),
+		&&OPCODE(OP_RETURN),
+		&&OPCODE(OP_NOT_F), &&OPCODE(OP_NOT_V), &&OPCODE(OP_NOT_S), &&OPCODE(OP_NOT_ENT), &&OPCODE(OP_NOT_FNC),
+		&&OPCODE(OP_IF), &&OPCODE(OP_IFNOT),
+		&&OPCODE(OP_CALL0), &&OPCODE(OP_CALL1), &&OPCODE(OP_CALL2), &&OPCODE(OP_CALL3), &&OPCODE(OP_CALL4),
+		&&OPCODE(OP_CALL5), &&OPCODE(OP_CALL6), &&OPCODE(OP_CALL7), &&OPCODE(OP_CALL8),
+		&&OPCODE(OP_STATE),
+		&&OPCODE(OP_GOTO),
+		&&OPCODE(OP_AND), &&OPCODE(OP_OR),
+		&&OPCODE(OP_BITAND), &&OPCODE(OP_BITOR),
+		&&OPCODE(OPX_ADDRESS_STOREP), &&OPCODE(OPX_ADDRESS_STOREP_V),
+		&&OPCODE(OPX_LOAD_IF), &&OPCODE(OPX_LOAD_IFNOT),
+		&&OPCODE(OPX_MUL_FV_ADD_V), &&OPCODE(OPX_MUL_VF_ADD_V),
+		&&OPCODE(OPX_CALL_BUILTIN)
+	};
+
+	if (!st)
+	{	// PR_DecodeStatements wants the handler addresses
+		memcpy (pr_oplabels, labels, sizeof(labels));
+		pr_badoplabel = &&badop;
+		return;
 	}
+#endif
+
+	runstart = st + 1;
+	startprofile = profile = 0;
+	trace = pr_trace;
 
-	if (pr_trace)
-		PR_PrintStatement(st);
+	NEXT;
 
+#ifndef PR_COMPUTED_GOTO
+next:
+	st++;
+	if (trace)
+		PR_PrintStatement (pr_statements + (st - pr_decoded));
 	switch (st->op)
 	{
-	case OP_ADD_F:
+#endif
+
+	OPCODE(OP_ADD_F):
 		OPC->_float = OPA->_float + OPB->_float;
-		break;
-	case OP_ADD_V:
+		NEXT;
+	OPCODE(OP_ADD_V):
 		OPC->vector[0] = OPA->vector[0] + OPB->vector[0];
 		OPC->vector[1] = OPA->vector[1] + OPB->vector[1];
 		OPC->vector[2] = OPA->vector[2] + OPB->vector[2];
-		break;
+		NEXT;
 
-	case OP_SUB_F:
+	OPCODE(OP_SUB_F):
 		OPC->_float = OPA->_float - OPB->_float;
-		break;
-	case OP_SUB_V:
+		NEXT;
+	OPCODE(OP_SUB_V):
 		OPC->vector[0] = OPA->vector[0] - OPB->vector[0];
 		OPC->vector[1] = OPA->vector[1] - OPB->vector[1];
 		OPC->vector[2] = OPA->vector[2] - OPB->vector[2];
-		break;
+		NEXT;
 
-	case OP_MUL_F:
+	OPCODE(OP_MUL_F):
 		OPC->_float = OPA->_float * OPB->_float;
-		break;
-	case OP_MUL_V:
+		NEXT;
+	OPCODE(OP_MUL_V):
 		OPC->_float = OPA->vector[0] * OPB->vector[0] +
 			      OPA->vector[1] * OPB->vector[1] +
 			      OPA->vector[2] * OPB->vector[2];
-		break;
-	case OP_MUL_FV:
+		NEXT;
+	OPCODE(OP_MUL_FV):
 		OPC->vector[0] = OPA->_float * OPB->vector[0];
 		OPC->vector[1] = OPA->_float * OPB->vector[1];
 		OPC->vector[2] = OPA->_float * OPB->vector[2];
-		break;
-	case OP_MUL_VF:
+		NEXT;
+	OPCODE(OP_MUL_VF):
 		OPC->vector[0] = OPB->_float * OPA->vector[0];
 		OPC->vector[1] = OPB->_float * OPA->vector[1];
 		OPC->vector[2] = OPB->_float * OPA->vector[2];
-		break;
+		NEXT;
 
-	case OP_DIV_F:
+	OPCODE(OP_DIV_F):
 		OPC->_float = OPA->_float / OPB->_float;
-		break;
+		NEXT;
 
-	case OP_BITAND:
+	OPCODE(OP_BITAND):
 		OPC->_float = (int)OPA->_float & (int)OPB->_float;
-		break;
+		NEXT;
 
-	case OP_BITOR:
+	OPCODE(OP_BITOR):
 		OPC->_float = (int)OPA->_float | (int)OPB->_float;
-		break;
+		NEXT;
 
-	case OP_GE:
+	OPCODE(OP_GE):
 		OPC->_float = OPA->_float >= OPB->_float;
-		break;
-	case OP_LE:
+		NEXT;
+	OPCODE(OP_LE):
 		OPC->_float = OPA->_float <= OPB->_float;
-		break;
-	case OP_GT:
+		NEXT;
+	OPCODE(OP_GT):
 		OPC->_float = OPA->_float > OPB->_float;
-		break;
-	case OP_LT:
+		NEXT;
+	OPCODE(OP_LT):
 		OPC->_float = OPA->_float < OPB->_float;
-		break;
-	case OP_AND:
+		NEXT;
+	OPCODE(OP_AND):
 		OPC->_float = OPA->_float && OPB->_float;
-		break;
-	case OP_OR:
+		NEXT;
+	OPCODE(OP_OR):
 		OPC->_float = OPA->_float || OPB->_float;
-		break;
+		NEXT;
 
-	case OP_NOT_F:
+	OPCODE(OP_NOT_F):
 		OPC->_float = !OPA->_float;
-		break;
-	case OP_NOT_V:
+		NEXT;
+	OPCODE(OP_NOT_V):
 		OPC->_float = !OPA->vector[0] && !OPA->vector[1] && !OPA->vector[2];
-		break;
-	case OP_NOT_S:
+		NEXT;
+	OPCODE(OP_NOT_S):
 		OPC->_float = !OPA->string || !*PR_GetString(OPA->string);
-		break;
-	case OP_NOT_FNC:
+		NEXT;
+	OPCODE(OP_NOT_FNC):
 		OPC->_float = !OPA->function;
-		break;
-	case OP_NOT_ENT:
+		NEXT;
+	OPCODE(OP_NOT_ENT):
 		OPC->_float = (PROG_TO_EDICT(OPA->edict) == sv.edicts);
-		break;
+		NEXT;
 
-	case OP_EQ_F:
+	OPCODE(OP_EQ_F):
 		OPC->_float = OPA->_float == OPB->_float;
-		break;
-	case OP_EQ_V:
+		NEXT;
+	OPCODE(OP_EQ_V):
 		OPC->_float = (OPA->vector[0] == OPB->vector[0]) &&
 			      (OPA->vector[1] == OPB->vector[1]) &&
 			      (OPA->vector[2] == OPB->vector[2]);
-		break;
-	case OP_EQ_S:
+		NEXT;
+	OPCODE(OP_EQ_S):
 		OPC->_float = !strcmp(PR_GetString(OPA->string), PR_GetString(OPB->string));
-		break;
-	case OP_EQ_E:
+		NEXT;
+	OPCODE(OP_EQ_E):
 		OPC->_float = OPA->_int == OPB->_int;
-		break;
-	case OP_EQ_FNC:
+		NEXT;
+	OPCODE(OP_EQ_FNC):
 		OPC->_float = OPA->function == OPB->function;
-		break;
+		NEXT;
 
-	case OP_NE_F:
+	OPCODE(OP_NE_F):
 		OPC->_float = OPA->_float != OPB->_float;
-		break;
-	case OP_NE_V:
+		NEXT;
+	OPCODE(OP_NE_V):
 		OPC->_float = (OPA->vector[0] != OPB->vector[0]) ||
 			      (OPA->vector[1] != OPB->vector[1]) ||
 			      (OPA->vector[2] != OPB->vector[2]);
-		break;
-	case OP_NE_S:
+		NEXT;
+	OPCODE(OP_NE_S):
 		OPC->_float = strcmp(PR_GetString(OPA->string), PR_GetString(OPB->string));
-		break;
-	case OP_NE_E:
+		NEXT;
+	OPCODE(OP_NE_E):
 		OPC->_float = OPA->_int != OPB->_int;
-		break;
-	case OP_NE_FNC:
+		NEXT;
+	OPCODE(OP_NE_FNC):
 		OPC->_float = OPA->function != OPB->function;
-		break;
+		NEXT;
 
-	case OP_STORE_F:
-	case OP_STORE_ENT:
-	case OP_STORE_FLD:	// integers
-	case OP_STORE_S:
-	case OP_STORE_FNC:	// pointers
+	OPCODE(OP_STORE_F):
+	OPCODE(OP_STORE_ENT):
+	OPCODE(OP_STORE_FLD):	// integers
+	OPCODE(OP_STORE_S):
+	OPCODE(OP_STORE_FNC):	// pointers
 		OPB->_int = OPA->_int;
-		break;
-	case OP_STORE_V:
+		NEXT;
+	OPCODE(OP_STORE_V):
 		OPB->vector[0] = OPA->vector[0];
 		OPB->vector[1] = OPA->vector[1];
 		OPB->vector[2] = OPA->vector[2];
-		break;
+		NEXT;
 
-	case OP_STOREP_F:
-	case OP_STOREP_ENT:
-	case OP_STOREP_FLD:	// integers
-	case OP_STOREP_S:
-	case OP_STOREP_FNC:	// pointers
+	OPCODE(OP_STOREP_F):
+	OPCODE(OP_STOREP_ENT):
+	OPCODE(OP_STOREP_FLD):	// integers
+	OPCODE(OP_STOREP_S):
+	OPCODE(OP_STOREP_FNC):	// pointers
 		ptr = (eval_t *)((byte *)sv.edicts + OPB->_int);
 		ptr->_int = OPA->_int;
-		break;
-	case OP_STOREP_V:
+		NEXT;
+	OPCODE(OP_STOREP_V):
 		ptr = (eval_t *)((byte *)sv.edicts + OPB->_int);
 		ptr->vector[0] = OPA->vector[0];
 		ptr->vector[1] = OPA->vector[1];
 		ptr->vector[2] = OPA->vector[2];
-		break;
+		NEXT;
 
-	case OP_ADDRESS:
+	OPCODE(OP_ADDRESS):
 		ed = PROG_TO_EDICT(OPA->edict);
 #ifdef PARANOID
 		NUM_FOR_EDICT(ed);	// Make sure it's in range
 #endif
 		if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
 		{
-			pr_xstatement = st - pr_statements;
+			pr_xstatement = st - pr_decoded;
 			PR_RunError("assignment to world entity");
 		}
 		OPC->_int = (byte *)((int *)&ed->v + OPB->_int) - (byte *)sv.edicts;
-		break;
-
-	case OP_LOAD_F:
-	case OP_LOAD_FLD:
-	case OP_LOAD_ENT:
-	case OP_LOAD_S:
-	case OP_LOAD_FNC:
+		if (SV_MirrorField (OPB->_int))
+			SV_MirrorTouch (ed);	// for the STOREP that follows
+		NEXT;
+
+	OPCODE(OP_LOAD_F):
+	OPCODE(OP_LOAD_FLD):
+	OPCODE(OP_LOAD_ENT):
+	OPCODE(OP_LOAD_S):
+	OPCODE(OP_LOAD_FNC):
 		ed = PROG_TO_EDICT(OPA->edict);
 #ifdef PARANOID
 		NUM_FOR_EDICT(ed);	// Make sure it's in range
 #endif
 		OPC->_int = ((eval_t *)((int *)&ed->v + OPB->_int))->_int;
-		break;
+		NEXT;
 
-	case OP_LOAD_V:
+	OPCODE(OP_LOAD_V):
 		ed = PROG_TO_EDICT(OPA->edict);
 #ifdef PARANOID
 		NUM_FOR_EDICT(ed);	// Make sure it's in range
@@ -576,79 +1068,262 @@ void PR_ExecuteProgram (func_t fnum)
 		OPC->vector[0] = ptr->vector[0];
 		OPC->vector[1] = ptr->vector[1];
 		OPC->vector[2] = ptr->vector[2];
-		break;
+		NEXT;
 
-	case OP_IFNOT:
+	OPCODE(OP_IFNOT):
 		if (!OPA->_int)
-			st += st->b - 1;	/* -1 to offset the st++ */
-		break;
+			JUMP(st->jump);
+		NEXT;
 
-	case OP_IF:
+	OPCODE(OP_IF):
 		if (OPA->_int)
-			st += st->b - 1;	/* -1 to offset the st++ */
-		break;
-
-	case OP_GOTO:
-		st += st->a - 1;		/* -1 to offset the st++ */
-		break;
-
-	case OP_CALL0:
-	case OP_CALL1:
-	case OP_CALL2:
-	case OP_CALL3:
-	case OP_CALL4:
-	case OP_CALL5:
-	case OP_CALL6:
-	case OP_CALL7:
-	case OP_CALL8:
+			JUMP(st->jump);
+		NEXT;
+
+	OPCODE(OP_GOTO):
+		JUMP(st->jump);
+		NEXT;
+
+	OPCODE(OP_CALL0):
+	OPCODE(OP_CALL1):
+	OPCODE(OP_CALL2):
+	OPCODE(OP_CALL3):
+	OPCODE(OP_CALL4):
+	OPCODE(OP_CALL5):
+	OPCODE(OP_CALL6):
+	OPCODE(OP_CALL7):
+	OPCODE(OP_CALL8):
+		pr_argc = st->op - OP_CALL0;
+	call:
+		COUNT_RUN ();
+		RUNAWAY_CHECK ();
 		pr_xfunction->profile += profile - startprofile;
 		startprofile = profile;
-		pr_xstatement = st - pr_statements;
-		pr_argc = st->op - OP_CALL0;
+		pr_xstatement = st - pr_decoded;
 		if (!OPA->function)
 			PR_RunError("NULL function");
 		newf = &pr_functions[OPA->function];
 		if (newf->first_statement < 0)
 		{ // Built-in function
-			int i = -newf->first_statement;
+			i = -newf->first_statement;
 			if (i >= pr_numbuiltins)
 				PR_RunError("Bad builtin call number %d", i);
-			pr_builtins[i]();
-			break;
+			if (prbench.active)
+				prbench.builtins++;
+			if (pr_profiling)
+			{
+				PR_ProfEnter (newf);
+				pr_builtins[i]();
+				PR_ProfLeave ();
+			}
+			else
+				pr_builtins[i]();
+			trace = pr_trace;	// traceon/traceoff
+			runstart = st + 1;
+			NEXT;
 		}
 		// Normal function
-		st = &pr_statements[PR_EnterFunction(newf)];
-		break;
+		if (pr_jitactive && PR_JitFunction (newf))
+		{	// has native code
+			PR_RunFunction (newf);
+			trace = pr_trace;
+			runstart = st + 1;
+			NEXT;
+		}
+		st = &pr_decoded[PR_EnterFunction(newf)];
+		runstart = st + 1;
+		NEXT;
 
-	case OP_DONE:
-	case OP_RETURN:
+	OPCODE(OP_DONE):
+	OPCODE(OP_RETURN):
+		COUNT_RUN ();
 		pr_xfunction->profile += profile - startprofile;
 		startprofile = profile;
-		pr_xstatement = st - pr_statements;
-		pr_globals[OFS_RETURN] = pr_globals[(unsigned short)st->a];
-		pr_globals[OFS_RETURN + 1] = pr_globals[(unsigned short)st->a + 1];
-		pr_globals[OFS_RETURN + 2] = pr_globals[(unsigned short)st->a + 2];
-		st = &pr_statements[PR_LeaveFunction()];
+		pr_xstatement = st - pr_decoded;
+		pr_globals[OFS_RETURN] = OPA->vector[0];
+		pr_globals[OFS_RETURN + 1] = OPA->vector[1];
+		pr_globals[OFS_RETURN + 2] = OPA->vector[2];
+		st = &pr_decoded[PR_LeaveFunction()];
 		if (pr_depth == exitdepth)
 		{ // Done
+			if (prbench.active)
+				prbench.statements += profile;
 			return;
 		}
-		break;
+		runstart = st + 1;
+		NEXT;
+
+	OPCODE(OPX_CALL_BUILTIN):	// see PR_ResolveCall
+		pr_argc = pr_statements[st - pr_decoded].op - OP_CALL0;
+		if (OPA->function != st->jump || pr_profiling)
+			goto call;
+		COUNT_RUN ();
+		RUNAWAY_CHECK ();
+		pr_xfunction->profile += profile - startprofile;
+		startprofile = profile;
+		pr_xstatement = st - pr_decoded;
+		if (prbench.active)
+		{
+			prbench.builtins++;
+			prbench.cachedbuiltins++;
+		}
+		st->builtin ();
+		trace = pr_trace;
+		runstart = st + 1;
+		NEXT;
+
+// superinstructions, see PR_OptimizeStatements. SKIP moves st on to the
+// second statement of the pair
+	OPCODE(OPX_ADDRESS_STOREP):
+	OPCODE(OPX_ADDRESS_STOREP_V):
+		ed = PROG_TO_EDICT(OPA->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);	// Make sure it's in range
+#endif
+		if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
+		{
+			pr_xstatement = st - pr_decoded;
+			PR_RunError("assignment to world entity");
+		}
+		ptr = (eval_t *)((int *)&ed->v + OPB->_int);
+		OPC->_int = (byte *)ptr - (byte *)sv.edicts;
+		if (SV_MirrorField (OPB->_int))
+			SV_MirrorTouch (ed);
+		if (st->op == OPX_ADDRESS_STOREP_V)
+		{
+			SKIP ();
+			ptr->vector[0] = OPA->vector[0];
+			ptr->vector[1] = OPA->vector[1];
+			ptr->vector[2] = OPA->vector[2];
+			NEXT;
+		}
+		SKIP ();
+		ptr->_int = OPA->_int;
+		NEXT;
 
-	case OP_STATE:
+	OPCODE(OPX_LOAD_IF):
+		ed = PROG_TO_EDICT(OPA->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);	// Make sure it's in range
+#endif
+		i = ((eval_t *)((int *)&ed->v + OPB->_int))->_int;
+		OPC->_int = i;
+		SKIP ();
+		if (i)
+			JUMP(st->jump);
+		NEXT;
+	OPCODE(OPX_LOAD_IFNOT):
+		ed = PROG_TO_EDICT(OPA->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);	// Make sure it's in range
+#endif
+		i = ((eval_t *)((int *)&ed->v + OPB->_int))->_int;
+		OPC->_int = i;
+		SKIP ();
+		if (!i)
+			JUMP(st->jump);
+		NEXT;
+
+	OPCODE(OPX_MUL_FV_ADD_V):
+		OPC->vector[0] = OPA->_float * OPB->vector[0];
+		OPC->vector[1] = OPA->_float * OPB->vector[1];
+		OPC->vector[2] = OPA->_float * OPB->vector[2];
+		SKIP ();
+		OPC->vector[0] = OPA->vector[0] + OPB->vector[0];
+		OPC->vector[1] = OPA->vector[1] + OPB->vector[1];
+		OPC->vector[2] = OPA->vector[2] + OPB->vector[2];
+		NEXT;
+	OPCODE(OPX_MUL_VF_ADD_V):
+		OPC->vector[0] = OPB->_float * OPA->vector[0];
+		OPC->vector[1] = OPB->_float * OPA->vector[1];
+		OPC->vector[2] = OPB->_float * OPA->vector[2];
+		SKIP ();
+		OPC->vector[0] = OPA->vector[0] + OPB->vector[0];
+		OPC->vector[1] = OPA->vector[1] + OPB->vector[1];
+		OPC->vector[2] = OPA->vector[2] + OPB->vector[2];
+		NEXT;
+
+	OPCODE(OP_STATE):
 		ed = PROG_TO_EDICT(pr_global_struct->self);
 		ed->v.nextthink = pr_global_struct->time + 0.1;
 		ed->v.frame = OPA->_float;
 		ed->v.think = OPB->function;
-		break;
+		NEXT;
 
+#ifdef PR_COMPUTED_GOTO
+badop:
+#else
 	default:
-		pr_xstatement = st - pr_statements;
+#endif
+		pr_xstatement = st - pr_decoded;
 		PR_RunError("Bad opcode %i", st->op);
+
+#ifndef PR_COMPUTED_GOTO
 	}
-    }	/* end of while(1) loop */
+	goto next;	/* not reached */
+#endif
 }
 #undef OPA
 #undef OPB
 #undef OPC
+#undef OPCODE
+#undef NEXT
+#undef SKIP
+#undef COUNT_RUN
+#undef RUNAWAY_CHECK
+#undef JUMP
 
+/*
+====================
+PR_Bench_f
+
+pr_bench [seconds] : measures QuakeC execution for the given time (10 by
+default) of normal play and prints the rate statements run at. The time
+includes builtins.
+====================
+*/
+void PR_Bench_f (void)
+{
+	int		frames;
+
+	if (!prbench.active)
+	{
+		if (cmd_source != src_command)
+			return;
+		if (!sv.active)
+		{
+			Con_Printf ("Not running a local server.\n");
+			return;
+		}
+		memset (&prbench, 0, sizeof(prbench));
+		prbench.endtime = realtime + (Cmd_Argc() > 1 ? q_max(Q_atof(Cmd_Argv(1)), 1) : 10);
+		prbench.startframe = host_framecount;
+		prbench.active = true;
+		Con_Printf ("Measuring QuakeC for %.0f seconds...\n", prbench.endtime - realtime);
+		return;
+	}
+
+	prbench.active = false;
+	frames = q_max (host_framecount - prbench.startframe, 1);
+
+#ifdef PR_COMPUTED_GOTO
+	Con_Printf ("dispatch   : computed goto\n");
+#else
+	Con_Printf ("dispatch   : switch\n");
+#endif
+	Con_Printf ("fused pairs: %i store, %i branch, %i vector\n",
+		pr_fused[OPX_ADDRESS_STOREP - OP_NUMOPS] + pr_fused[OPX_ADDRESS_STOREP_V - OP_NUMOPS],
+		pr_fused[OPX_LOAD_IF - OP_NUMOPS] + pr_fused[OPX_LOAD_IFNOT - OP_NUMOPS],
+		pr_fused[OPX_MUL_FV_ADD_V - OP_NUMOPS] + pr_fused[OPX_MUL_VF_ADD_V - OP_NUMOPS]);
+	Con_Printf ("call sites : %i builtin calls resolved\n", pr_cachedcalls);
+	Con_Printf ("frames     : %i\n", frames);
+	Con_Printf ("calls      : %i (%.1f per frame)\n", prbench.calls, (double)prbench.calls / frames);
+	Con_Printf ("builtins   : %i (%.1f per frame, %i%% resolved)\n", prbench.builtins, (double)prbench.builtins / frames,
+		prbench.builtins ? (int)((double)prbench.cachedbuiltins * 100 / prbench.builtins) : 0);
+	Con_Printf ("functions  : %i (%.1f per frame, %i%% leaves)\n", prbench.functions, (double)prbench.functions / frames,
+		prbench.functions ? (int)((double)prbench.leafcalls * 100 / prbench.functions) : 0);
+	Con_Printf ("statements : %.0f (%.0f per frame)\n", prbench.statements, prbench.statements / frames);
+	Con_Printf ("time       : %.3f ms per frame\n", prbench.time * 1000 / frames);
+	if (prbench.statements)
+		Con_Printf ("rate       : %.2f ns per statement\n", prbench.time * 1e9 / prbench.statements);
+}
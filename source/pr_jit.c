@@ -0,0 +1,1278 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_jit.c -- x86-64 native code for QuakeC functions
+//
+// With pr_jit 1 each QuakeC function is translated to machine code the
+// first time it is called. The native code only runs the function body:
+// PR_ExecuteProgram still does PR_EnterFunction/PR_LeaveFunction around
+// it, so the locals stack, pr_xfunction and stack traces are the same as
+// with the interpreter. rbx holds pr_globals, r12 sv.edicts and r13 the
+// runaway counter. Calls, string compares and other rare statements go
+// through C helpers that are passed the statement number, which also keeps
+// pr_xstatement right for PR_RunError. A function with anything the
+// compiler can't handle is left to the interpreter.
+//
+// pr_jitverify 1 runs every top level QuakeC call twice, once interpreted
+// and once native, from the same globals and edicts, and reports any
+// difference. Builtins run twice in that mode, so it is for testing only.
+
+#include "quakedef.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define	PR_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+static void PR_Jit_f (cvar_t *var);
+
+cvar_t	pr_jit = {"pr_jit", "0", CVAR_NONE};
+cvar_t	pr_jitverify = {"pr_jitverify", "0", CVAR_NONE};
+
+qboolean	pr_jitactive;		// pr_jit is on and supported
+int			pr_jitsteps;		// runaway counter of the running native function
+
+static struct
+{
+	int		compiled;
+	int		failed;
+	int		codebytes;
+	int		verified;			// pr_jitverify calls
+	int		mismatches;
+} jitstats;
+
+static qboolean	pr_jitverifying;
+
+#ifdef PR_JIT_SUPPORTED
+
+#define	JIT_CHUNKSIZE	(1024*1024)
+
+typedef struct jitchunk_s
+{
+	struct jitchunk_s	*next;
+	byte		*base;
+	size_t		size;
+	size_t		used;
+} jitchunk_t;
+
+typedef struct
+{
+	byte	*data;
+	int		size;
+	int		maxsize;
+} jitbuf_t;
+
+typedef struct
+{
+	int		pos;		// of the rel32
+	int		target;		// statement, or -1 for the epilogue
+} jitfixup_t;
+
+static jitchunk_t	*jit_chunks;
+static prnative_t	*jit_code;		// for each function, NULL if not compiled
+static byte			*jit_failed;	// for each function, true if it can't be
+static int			*jit_funcend;	// first statement after each function
+static byte			*jit_written;	// for each global, true if anything can store to it
+static const char	*jit_lastfailure;
+
+/*
+===============================================================================
+
+CODE EMISSION
+
+===============================================================================
+*/
+
+static void J_Byte (jitbuf_t *jb, int b)
+{
+	if (jb->size == jb->maxsize)
+	{
+		jb->maxsize = jb->maxsize ? jb->maxsize * 2 : 4096;
+		jb->data = (byte *) realloc (jb->data, jb->maxsize);
+		if (!jb->data)
+			Sys_Error ("J_Byte: out of memory");
+	}
+	jb->data[jb->size++] = b;
+}
+
+static void J_Long (jitbuf_t *jb, int l)
+{
+	J_Byte (jb, l & 255);
+	J_Byte (jb, (l >> 8) & 255);
+	J_Byte (jb, (l >> 16) & 255);
+	J_Byte (jb, (l >> 24) & 255);
+}
+
+static void J_Quad (jitbuf_t *jb, const void *p)
+{
+	uint64_t	q = (uint64_t)(uintptr_t)p;
+
+	J_Long (jb, (int)(q & 0xffffffff));
+	J_Long (jb, (int)(q >> 32));
+}
+
+static void J_Patch (jitbuf_t *jb, int pos, int l)
+{
+	jb->data[pos] = l & 255;
+	jb->data[pos+1] = (l >> 8) & 255;
+	jb->data[pos+2] = (l >> 16) & 255;
+	jb->data[pos+3] = (l >> 24) & 255;
+}
+
+// register numbers in ModRM
+#define	R_EAX	0
+#define	R_ECX	1
+#define	R_EDX	2
+#define	R_XMM0	0
+#define	R_XMM1	1
+
+/*
+===============
+J_Global
+
+opcode bytes (1 to 3, prefixes included) followed by a [rbx + ofs*4]
+operand, i.e. the global at ofs
+===============
+*/
+static void J_Global (jitbuf_t *jb, int len, int b0, int b1, int b2, int reg, int ofs)
+{
+	J_Byte (jb, b0);
+	if (len > 1)
+		J_Byte (jb, b1);
+	if (len > 2)
+		J_Byte (jb, b2);
+	J_Byte (jb, 0x80 | (reg << 3) | 3);	// mod 10, rm rbx
+	J_Long (jb, ofs * 4);
+}
+
+#define	MOV_LOAD(jb,r,o)	J_Global (jb, 1, 0x8b, 0, 0, r, o)			// mov r32, [g]
+#define	MOV_STORE(jb,r,o)	J_Global (jb, 1, 0x89, 0, 0, r, o)			// mov [g], r32
+#define	MOVSS_LOAD(jb,x,o)	J_Global (jb, 3, 0xf3, 0x0f, 0x10, x, o)	// movss xmm, [g]
+#define	MOVSS_STORE(jb,x,o)	J_Global (jb, 3, 0xf3, 0x0f, 0x11, x, o)	// movss [g], xmm
+#define	SSEOP(jb,op,x,o)	J_Global (jb, 3, 0xf3, 0x0f, op, x, o)		// addss/subss/mulss/divss xmm, [g]
+#define	UCOMISS(jb,x,o)		J_Global (jb, 2, 0x0f, 0x2e, 0, x, o)		// ucomiss xmm, [g]
+#define	CVTTSS2SI(jb,r,o)	J_Global (jb, 3, 0xf3, 0x0f, 0x2c, r, o)	// cvttss2si r32, [g]
+#define	CMP_LOAD(jb,r,o)	J_Global (jb, 1, 0x3b, 0, 0, r, o)			// cmp r32, [g]
+
+#define	SSE_ADD		0x58
+#define	SSE_MUL		0x59
+#define	SSE_SUB		0x5c
+#define	SSE_DIV		0x5e
+
+#define	SETA		0x97
+#define	SETAE		0x93
+#define	SETE		0x94
+#define	SETNE		0x95
+#define	SETP		0x9a
+#define	SETNP		0x9b
+
+// cmp dword [g], 0
+static void J_CmpZero (jitbuf_t *jb, int ofs)
+{
+	J_Global (jb, 1, 0x83, 0, 0, 7, ofs);
+	J_Byte (jb, 0);
+}
+
+// setcc r8
+static void J_Set (jitbuf_t *jb, int cc, int reg)
+{
+	J_Byte (jb, 0x0f);
+	J_Byte (jb, cc);
+	J_Byte (jb, 0xc0 | reg);
+}
+
+// mov edi, imm32 ; mov rax, imm64 ; call rax
+static void J_CallHelper (jitbuf_t *jb, void (*func) (int), int arg)
+{
+	J_Byte (jb, 0xbf);
+	J_Long (jb, arg);
+	J_Byte (jb, 0x48);
+	J_Byte (jb, 0xb8);
+	J_Quad (jb, (const void *)func);
+	J_Byte (jb, 0xff);
+	J_Byte (jb, 0xd0);
+}
+#define	CALLHELPER_SIZE		17
+
+// mov r12, &sv.edicts ; mov r12, [r12]
+static void J_LoadEdicts (jitbuf_t *jb)
+{
+	J_Byte (jb, 0x49);
+	J_Byte (jb, 0xbc);
+	J_Quad (jb, &sv.edicts);
+	J_Byte (jb, 0x4d);
+	J_Byte (jb, 0x8b);
+	J_Byte (jb, 0x24);
+	J_Byte (jb, 0x24);
+}
+
+// al (0 or 1) to a float in global ofs
+static void J_StoreBool (jitbuf_t *jb, int ofs)
+{
+	J_Byte (jb, 0x0f);	// movzx eax, al
+	J_Byte (jb, 0xb6);
+	J_Byte (jb, 0xc0);
+	J_Byte (jb, 0xf3);	// cvtsi2ss xmm0, eax
+	J_Byte (jb, 0x0f);
+	J_Byte (jb, 0x2a);
+	J_Byte (jb, 0xc0);
+	MOVSS_STORE (jb, R_XMM0, ofs);
+}
+
+// al = (global ofs != 0.0), as the float compare C does; uses xmm1 = 0
+static void J_FloatTrue (jitbuf_t *jb, int ofs, int reg)
+{
+	MOVSS_LOAD (jb, R_XMM0, ofs);
+	J_Byte (jb, 0x0f);	// ucomiss xmm0, xmm1
+	J_Byte (jb, 0x2e);
+	J_Byte (jb, 0xc1);
+	J_Set (jb, SETNE, reg);
+	J_Set (jb, SETP, R_ECX);
+	J_Byte (jb, 0x08);	// or reg8, cl
+	J_Byte (jb, 0xc8 | reg);
+}
+
+// xorps xmm1, xmm1
+static void J_ZeroXmm1 (jitbuf_t *jb)
+{
+	J_Byte (jb, 0x0f);
+	J_Byte (jb, 0x57);
+	J_Byte (jb, 0xc9);
+}
+
+/*
+===============================================================================
+
+HELPERS CALLED FROM NATIVE CODE
+
+===============================================================================
+*/
+
+static void PR_JitCall (int s)
+{
+	prstatement_t	*st = &pr_decoded[s];
+	dfunction_t	*newf;
+	int		i;
+
+	pr_xstatement = s;
+	pr_argc = pr_statements[s].op - OP_CALL0;
+	if (st->op == OPX_CALL_BUILTIN && st->a->function == st->jump && !pr_profiling)
+	{
+		st->builtin ();
+		return;
+	}
+	if (!st->a->function)
+		PR_RunError ("NULL function");
+	newf = &pr_functions[st->a->function];
+	if (newf->first_statement < 0)
+	{ // Built-in function
+		i = -newf->first_statement;
+		if (i >= pr_numbuiltins)
+			PR_RunError ("Bad builtin call number %d", i);
+		if (pr_profiling)
+		{
+			PR_ProfEnter (newf);
+			pr_builtins[i] ();
+			PR_ProfLeave ();
+		}
+		else
+			pr_builtins[i] ();
+		return;
+	}
+	PR_ExecuteProgram (st->a->function);
+}
+
+static void PR_JitState (int s)
+{
+	prstatement_t	*st = &pr_decoded[s];
+	edict_t		*ed;
+
+	ed = PROG_TO_EDICT(pr_global_struct->self);
+	ed->v.nextthink = pr_global_struct->time + 0.1;
+	ed->v.frame = st->a->_float;
+	ed->v.think = st->b->function;
+}
+
+static void PR_JitOp (int s)
+{
+	prstatement_t	*st = &pr_decoded[s];
+
+	switch (st->op)
+	{
+	case OP_EQ_S:
+		st->c->_float = !strcmp(PR_GetString(st->a->string), PR_GetString(st->b->string));
+		break;
+	case OP_NE_S:
+		st->c->_float = strcmp(PR_GetString(st->a->string), PR_GetString(st->b->string));
+		break;
+	case OP_NOT_S:
+		st->c->_float = !st->a->string || !*PR_GetString(st->a->string);
+		break;
+	case OP_NOT_V:
+		st->c->_float = !st->a->vector[0] && !st->a->vector[1] && !st->a->vector[2];
+		break;
+	case OP_EQ_V:
+		st->c->_float = (st->a->vector[0] == st->b->vector[0]) &&
+				(st->a->vector[1] == st->b->vector[1]) &&
+				(st->a->vector[2] == st->b->vector[2]);
+		break;
+	case OP_NE_V:
+		st->c->_float = (st->a->vector[0] != st->b->vector[0]) ||
+				(st->a->vector[1] != st->b->vector[1]) ||
+				(st->a->vector[2] != st->b->vector[2]);
+		break;
+	default:
+		pr_xstatement = s;
+		PR_RunError ("PR_JitOp: bad opcode %i", st->op);
+	}
+}
+
+static void PR_JitRunaway (int s)
+{
+	pr_xstatement = s;
+	PR_RunError ("runaway loop error");
+}
+
+static void PR_JitWorldAssign (int s)
+{
+	pr_xstatement = s;
+	PR_RunError ("assignment to world entity");
+}
+
+static void PR_JitMirrorTouch (int s)
+{
+	SV_MirrorTouch (PROG_TO_EDICT (G_INT (pr_statements[s].a)));
+}
+
+/*
+===============================================================================
+
+COMPILER
+
+===============================================================================
+*/
+
+/*
+===============
+PR_JitBranch
+
+Conditional (cc is the jcc opcode byte, 0 for always) branch to statement
+target. Backward branches add the loop length to the runaway counter
+first, like the interpreter counts statements.
+===============
+*/
+static void PR_JitBranch (jitbuf_t *jb, jitfixup_t *fixups, int *numfixups, int s, int target, int cc)
+{
+	int		loop;
+
+	if (target > s)
+	{
+		if (cc)
+		{
+			J_Byte (jb, 0x0f);
+			J_Byte (jb, cc);
+		}
+		else
+			J_Byte (jb, 0xe9);
+		fixups[*numfixups].pos = jb->size;
+		fixups[*numfixups].target = target;
+		(*numfixups)++;
+		J_Long (jb, 0);
+		return;
+	}
+
+	if (cc)
+	{	// skip the loop back if the condition is false: jncc rel8
+		J_Byte (jb, (cc ^ 1) - 0x10);
+		J_Byte (jb, 8 + 8 + 2 + CALLHELPER_SIZE + 5);
+	}
+
+	loop = s - target + 1;
+	J_Byte (jb, 0x41);		// add dword [r13+0], loop
+	J_Byte (jb, 0x81);
+	J_Byte (jb, 0x45);
+	J_Byte (jb, 0x00);
+	J_Long (jb, loop);
+	J_Byte (jb, 0x41);		// cmp dword [r13+0], PR_RUNAWAY
+	J_Byte (jb, 0x81);
+	J_Byte (jb, 0x7d);
+	J_Byte (jb, 0x00);
+	J_Long (jb, PR_RUNAWAY);
+	J_Byte (jb, 0x7e);		// jle over the error
+	J_Byte (jb, CALLHELPER_SIZE);
+	J_CallHelper (jb, PR_JitRunaway, s);
+
+	J_Byte (jb, 0xe9);
+	fixups[*numfixups].pos = jb->size;
+	fixups[*numfixups].target = target;
+	(*numfixups)++;
+	J_Long (jb, 0);
+}
+
+/*
+===============
+PR_JitCompile
+
+Returns false if the function has something that isn't handled
+===============
+*/
+static qboolean PR_JitCompile (int fnum, jitbuf_t *jb)
+{
+	dfunction_t	*f = &pr_functions[fnum];
+	dstatement_t	*st;
+	jitfixup_t	*fixups;
+	int		*nativeofs;
+	int		first, end, s, i, numfixups, target;
+	int		a, b, c, voff;
+	qboolean	ok;
+
+	first = f->first_statement;
+	end = jit_funcend[fnum];
+	if (first <= 0 || end <= first)
+	{
+		jit_lastfailure = "no statements";
+		return false;
+	}
+
+	nativeofs = (int *) malloc ((end - first) * sizeof(int));
+	fixups = (jitfixup_t *) malloc ((end - first) * sizeof(jitfixup_t));
+	if (!nativeofs || !fixups)
+		Sys_Error ("PR_JitCompile: out of memory");
+	numfixups = 0;
+	voff = (int)offsetof(edict_t, v);
+	ok = true;
+
+// prologue
+	J_Byte (jb, 0x53);			// push rbx
+	J_Byte (jb, 0x41);			// push r12
+	J_Byte (jb, 0x54);
+	J_Byte (jb, 0x41);			// push r13
+	J_Byte (jb, 0x55);
+	J_Byte (jb, 0x48);			// mov rbx, pr_globals
+	J_Byte (jb, 0xbb);
+	J_Quad (jb, pr_globals);
+	J_LoadEdicts (jb);
+	J_Byte (jb, 0x49);			// mov r13, &pr_jitsteps
+	J_Byte (jb, 0xbd);
+	J_Quad (jb, &pr_jitsteps);
+
+	for (s = first; s < end && ok; s++)
+	{
+		nativeofs[s - first] = jb->size;
+		st = &pr_statements[s];
+		a = (unsigned short)st->a;
+		b = (unsigned short)st->b;
+		c = (unsigned short)st->c;
+
+		switch (st->op)
+		{
+		case OP_ADD_F:
+		case OP_SUB_F:
+		case OP_MUL_F:
+		case OP_DIV_F:
+			MOVSS_LOAD (jb, R_XMM0, a);
+			SSEOP (jb, st->op == OP_ADD_F ? SSE_ADD : st->op == OP_SUB_F ? SSE_SUB : st->op == OP_MUL_F ? SSE_MUL : SSE_DIV, R_XMM0, b);
+			MOVSS_STORE (jb, R_XMM0, c);
+			break;
+
+		case OP_ADD_V:
+		case OP_SUB_V:
+			for (i = 0; i < 3; i++)
+			{
+				MOVSS_LOAD (jb, R_XMM0, a + i);
+				SSEOP (jb, st->op == OP_ADD_V ? SSE_ADD : SSE_SUB, R_XMM0, b + i);
+				MOVSS_STORE (jb, R_XMM0, c + i);
+			}
+			break;
+
+		case OP_MUL_V:	// (a0*b0 + a1*b1) + a2*b2, in the order C does it
+			MOVSS_LOAD (jb, R_XMM0, a);
+			SSEOP (jb, SSE_MUL, R_XMM0, b);
+			for (i = 1; i < 3; i++)
+			{
+				MOVSS_LOAD (jb, R_XMM1, a + i);
+				SSEOP (jb, SSE_MUL, R_XMM1, b + i);
+				J_Byte (jb, 0xf3);	// addss xmm0, xmm1
+				J_Byte (jb, 0x0f);
+				J_Byte (jb, SSE_ADD);
+				J_Byte (jb, 0xc1);
+			}
+			MOVSS_STORE (jb, R_XMM0, c);
+			break;
+
+		case OP_MUL_FV:
+		case OP_MUL_VF:
+			for (i = 0; i < 3; i++)
+			{
+				MOVSS_LOAD (jb, R_XMM0, st->op == OP_MUL_FV ? a : b);
+				SSEOP (jb, SSE_MUL, R_XMM0, st->op == OP_MUL_FV ? b + i : a + i);
+				MOVSS_STORE (jb, R_XMM0, c + i);
+			}
+			break;
+
+		case OP_BITAND:
+		case OP_BITOR:
+			CVTTSS2SI (jb, R_EAX, a);
+			CVTTSS2SI (jb, R_ECX, b);
+			J_Byte (jb, st->op == OP_BITAND ? 0x21 : 0x09);	// and/or eax, ecx
+			J_Byte (jb, 0xc8);
+			J_Byte (jb, 0xf3);	// cvtsi2ss xmm0, eax
+			J_Byte (jb, 0x0f);
+			J_Byte (jb, 0x2a);
+			J_Byte (jb, 0xc0);
+			MOVSS_STORE (jb, R_XMM0, c);
+			break;
+
+		case OP_GE:
+		case OP_GT:
+			MOVSS_LOAD (jb, R_XMM0, a);
+			UCOMISS (jb, R_XMM0, b);
+			J_Set (jb, st->op == OP_GE ? SETAE : SETA, R_EAX);
+			J_StoreBool (jb, c);
+			break;
+		case OP_LE:
+		case OP_LT:
+			MOVSS_LOAD (jb, R_XMM0, b);
+			UCOMISS (jb, R_XMM0, a);
+			J_Set (jb, st->op == OP_LE ? SETAE : SETA, R_EAX);
+			J_StoreBool (jb, c);
+			break;
+
+		case OP_EQ_F:
+		case OP_NE_F:
+			MOVSS_LOAD (jb, R_XMM0, a);
+			UCOMISS (jb, R_XMM0, b);
+			J_Set (jb, st->op == OP_EQ_F ? SETE : SETNE, R_EAX);
+			J_Set (jb, st->op == OP_EQ_F ? SETNP : SETP, R_ECX);
+			J_Byte (jb, st->op == OP_EQ_F ? 0x20 : 0x08);	// and/or al, cl
+			J_Byte (jb, 0xc8);
+			J_StoreBool (jb, c);
+			break;
+
+		case OP_NOT_F:
+			J_ZeroXmm1 (jb);
+			J_FloatTrue (jb, a, R_EAX);
+			J_Byte (jb, 0x34);	// xor al, 1
+			J_Byte (jb, 0x01);
+			J_StoreBool (jb, c);
+			break;
+
+		case OP_AND:
+		case OP_OR:
+			J_ZeroXmm1 (jb);
+			J_FloatTrue (jb, a, R_EAX);
+			J_FloatTrue (jb, b, R_EDX);
+			J_Byte (jb, st->op == OP_AND ? 0x20 : 0x08);	// and/or al, dl
+			J_Byte (jb, 0xd0);
+			J_StoreBool (jb, c);
+			break;
+
+		case OP_EQ_E:
+		case OP_EQ_FNC:
+		case OP_NE_E:
+		case OP_NE_FNC:
+			MOV_LOAD (jb, R_EAX, a);
+			CMP_LOAD (jb, R_EAX, b);
+			J_Set (jb, (st->op == OP_EQ_E || st->op == OP_EQ_FNC) ? SETE : SETNE, R_EAX);
+			J_StoreBool (jb, c);
+			break;
+
+		case OP_NOT_FNC:
+		case OP_NOT_ENT:
+			J_CmpZero (jb, a);
+			J_Set (jb, SETE, R_EAX);
+			J_StoreBool (jb, c);
+			break;
+
+		case OP_EQ_S:
+		case OP_NE_S:
+		case OP_NOT_S:
+		case OP_NOT_V:
+		case OP_EQ_V:
+		case OP_NE_V:
+			J_CallHelper (jb, PR_JitOp, s);
+			break;
+
+		case OP_STORE_F:
+		case OP_STORE_ENT:
+		case OP_STORE_FLD:
+		case OP_STORE_S:
+		case OP_STORE_FNC:
+			MOV_LOAD (jb, R_EAX, a);
+			MOV_STORE (jb, R_EAX, b);
+			break;
+		case OP_STORE_V:
+			for (i = 0; i < 3; i++)
+			{
+				MOV_LOAD (jb, R_EAX, a + i);
+				MOV_STORE (jb, R_EAX, b + i);
+			}
+			break;
+
+		case OP_STOREP_F:
+		case OP_STOREP_ENT:
+		case OP_STOREP_FLD:
+		case OP_STOREP_S:
+		case OP_STOREP_FNC:
+		case OP_STOREP_V:
+			MOV_LOAD (jb, R_EAX, b);
+			J_Byte (jb, 0x48);	// movsxd rax, eax
+			J_Byte (jb, 0x63);
+			J_Byte (jb, 0xc0);
+			for (i = 0; i < (st->op == OP_STOREP_V ? 3 : 1); i++)
+			{
+				MOV_LOAD (jb, R_ECX, a + i);
+				J_Byte (jb, 0x41);	// mov [r12+rax+i*4], ecx
+				J_Byte (jb, 0x89);
+				J_Byte (jb, 0x4c);
+				J_Byte (jb, 0x04);
+				J_Byte (jb, i * 4);
+			}
+			break;
+
+		case OP_ADDRESS:
+			MOV_LOAD (jb, R_EAX, a);
+			J_Byte (jb, 0x85);	// test eax, eax
+			J_Byte (jb, 0xc0);
+			J_Byte (jb, 0x75);	// jnz over the world check
+			J_Byte (jb, 10 + 6 + 2 + CALLHELPER_SIZE + 2);
+			J_Byte (jb, 0x48);	// mov rax, &sv.state
+			J_Byte (jb, 0xb8);
+			J_Quad (jb, &sv.state);
+			J_Byte (jb, 0x81);	// cmp dword [rax], ss_active
+			J_Byte (jb, 0x38);
+			J_Long (jb, ss_active);
+			J_Byte (jb, 0x75);	// jne over the error
+			J_Byte (jb, CALLHELPER_SIZE);
+			J_CallHelper (jb, PR_JitWorldAssign, s);
+			J_Byte (jb, 0x31);	// xor eax, eax
+			J_Byte (jb, 0xc0);
+			MOV_LOAD (jb, R_ECX, b);
+			J_Byte (jb, 0x8d);	// lea eax, [rax+rcx*4+voff]
+			J_Byte (jb, 0x84);
+			J_Byte (jb, 0x88);
+			J_Long (jb, voff);
+			MOV_STORE (jb, R_EAX, c);
+			if (b < progs->numglobals && !jit_written[b])
+			{
+				// a constant field operand can be decided now rather
+				// than when the code runs
+				if (SV_MirrorField (G_INT (b)))
+					J_CallHelper (jb, PR_JitMirrorTouch, s);
+				break;
+			}
+			MOV_LOAD (jb, R_ECX, b);
+			J_Byte (jb, 0x81);	// cmp ecx, SV_MIRRORFIELDS
+			J_Byte (jb, 0xf9);
+			J_Long (jb, SV_MIRRORFIELDS);
+			J_Byte (jb, 0x73);	// jae over the touch
+			J_Byte (jb, 10 + 4 + 2 + CALLHELPER_SIZE);
+			J_Byte (jb, 0x48);	// mov rax, sv_mirrorfield
+			J_Byte (jb, 0xb8);
+			J_Quad (jb, sv_mirrorfield);
+			J_Byte (jb, 0x80);	// cmp byte [rax+rcx], 0
+			J_Byte (jb, 0x3c);
+			J_Byte (jb, 0x08);
+			J_Byte (jb, 0x00);
+			J_Byte (jb, 0x74);	// je over the touch
+			J_Byte (jb, CALLHELPER_SIZE);
+			J_CallHelper (jb, PR_JitMirrorTouch, s);
+			break;
+
+		case OP_LOAD_F:
+		case OP_LOAD_FLD:
+		case OP_LOAD_ENT:
+		case OP_LOAD_S:
+		case OP_LOAD_FNC:
+		case OP_LOAD_V:
+			MOV_LOAD (jb, R_EAX, a);
+			J_Byte (jb, 0x48);	// movsxd rax, eax
+			J_Byte (jb, 0x63);
+			J_Byte (jb, 0xc0);
+			MOV_LOAD (jb, R_ECX, b);
+			J_Byte (jb, 0x48);	// movsxd rcx, ecx
+			J_Byte (jb, 0x63);
+			J_Byte (jb, 0xc9);
+			J_Byte (jb, 0x49);	// lea rax, [r12+rax]
+			J_Byte (jb, 0x8d);
+			J_Byte (jb, 0x04);
+			J_Byte (jb, 0x04);
+			for (i = 0; i < (st->op == OP_LOAD_V ? 3 : 1); i++)
+			{
+				J_Byte (jb, 0x8b);	// mov edx, [rax+rcx*4+voff]
+				J_Byte (jb, 0x94);
+				J_Byte (jb, 0x88);
+				J_Long (jb, voff + i * 4);
+				MOV_STORE (jb, R_EDX, c + i);
+			}
+			break;
+
+		case OP_IF:
+		case OP_IFNOT:
+			target = s + st->b;
+			if (target < first || target >= end)
+			{
+				jit_lastfailure = "branch out of the function";
+				ok = false;
+				break;
+			}
+			J_CmpZero (jb, a);
+			PR_JitBranch (jb, fixups, &numfixups, s, target, st->op == OP_IF ? 0x85 : 0x84);
+			break;
+
+		case OP_GOTO:
+			target = s + st->a;
+			if (target < first || target >= end)
+			{
+				jit_lastfailure = "branch out of the function";
+				ok = false;
+				break;
+			}
+			PR_JitBranch (jb, fixups, &numfixups, s, target, 0);
+			break;
+
+		case OP_CALL0:
+		case OP_CALL1:
+		case OP_CALL2:
+		case OP_CALL3:
+		case OP_CALL4:
+		case OP_CALL5:
+		case OP_CALL6:
+		case OP_CALL7:
+		case OP_CALL8:
+			J_CallHelper (jb, PR_JitCall, s);
+			J_LoadEdicts (jb);
+			break;
+
+		case OP_STATE:
+			J_CallHelper (jb, PR_JitState, s);
+			break;
+
+		case OP_DONE:
+		case OP_RETURN:
+			for (i = 0; i < 3; i++)
+			{
+				MOV_LOAD (jb, R_EAX, a + i);
+				MOV_STORE (jb, R_EAX, OFS_RETURN + i);
+			}
+			J_Byte (jb, 0xe9);
+			fixups[numfixups].pos = jb->size;
+			fixups[numfixups].target = -1;
+			numfixups++;
+			J_Long (jb, 0);
+			break;
+
+		default:
+			jit_lastfailure = "unsupported opcode";
+			ok = false;
+			break;
+		}
+	}
+
+	if (ok)
+	{
+	// falling off the end is a return of whatever is in OFS_RETURN
+		i = jb->size;
+		J_Byte (jb, 0x41);		// pop r13
+		J_Byte (jb, 0x5d);
+		J_Byte (jb, 0x41);		// pop r12
+		J_Byte (jb, 0x5c);
+		J_Byte (jb, 0x5b);		// pop rbx
+		J_Byte (jb, 0xc3);		// ret
+
+		for (s = 0; s < numfixups; s++)
+		{
+			target = fixups[s].target < 0 ? i : nativeofs[fixups[s].target - first];
+			J_Patch (jb, fixups[s].pos, target - (fixups[s].pos + 4));
+		}
+	}
+
+	free (nativeofs);
+	free (fixups);
+	return ok;
+}
+
+/*
+===============
+PR_JitInstall
+
+Copies compiled code into executable memory
+===============
+*/
+static prnative_t PR_JitInstall (const byte *code, int size)
+{
+	jitchunk_t	*chunk;
+	byte		*p;
+	size_t		len;
+
+	len = (size + 15) & ~15;
+	chunk = jit_chunks;
+	if (!chunk || chunk->used + len > chunk->size)
+	{
+		chunk = (jitchunk_t *) calloc (1, sizeof(jitchunk_t));
+		if (!chunk)
+			Sys_Error ("PR_JitInstall: out of memory");
+		chunk->size = q_max (JIT_CHUNKSIZE, (len + 4095) & ~4095);
+		chunk->base = (byte *) mmap (NULL, chunk->size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (chunk->base == MAP_FAILED)
+		{
+			free (chunk);
+			return NULL;
+		}
+		chunk->next = jit_chunks;
+		jit_chunks = chunk;
+	}
+
+	p = chunk->base + chunk->used;
+	if (mprotect (chunk->base, chunk->size, PROT_READ | PROT_WRITE))
+		return NULL;
+	memcpy (p, code, size);
+	mprotect (chunk->base, chunk->size, PROT_READ | PROT_EXEC);
+	chunk->used += len;
+	jitstats.codebytes += size;
+
+	return (prnative_t)(void *)p;
+}
+
+/*
+===============
+PR_JitFunction
+
+Returns the native code for f, compiling it on the first call, or NULL if
+the interpreter has to run it
+===============
+*/
+prnative_t PR_JitFunction (dfunction_t *f)
+{
+	static jitbuf_t	jb;
+	int		fnum;
+
+	fnum = f - pr_functions;
+	if (jit_code[fnum])
+		return jit_code[fnum];
+	if (jit_failed[fnum] || f->first_statement < 0)
+		return NULL;
+
+	jb.size = 0;
+	if (PR_JitCompile (fnum, &jb))
+		jit_code[fnum] = PR_JitInstall (jb.data, jb.size);
+	if (!jit_code[fnum])
+	{
+		jit_failed[fnum] = true;
+		jitstats.failed++;
+		Con_DPrintf ("PR_JitFunction: %s left to the interpreter: %s\n", PR_GetString(f->s_name), jit_lastfailure ? jit_lastfailure : "no memory");
+		return NULL;
+	}
+	jitstats.compiled++;
+	return jit_code[fnum];
+}
+
+static void PR_JitMarkWritten (int ofs, int count)
+{
+	for ( ; count > 0; ofs++, count--)
+	{
+		if (ofs >= 0 && ofs < progs->numglobals)
+			jit_written[ofs] = true;
+	}
+}
+
+/*
+============
+PR_JitFindWrites
+
+Marks every global that statements, calls, the engine or a savegame
+can change, so that only true constants are folded into the code
+============
+*/
+static void PR_JitFindWrites (void)
+{
+	dstatement_t	*st;
+	dfunction_t		*f;
+	ddef_t			*def;
+	int		i;
+
+	PR_JitMarkWritten (0, sizeof(globalvars_t) / 4);
+	for (i = 0, st = pr_statements; i < progs->numstatements; i++, st++)
+	{
+		switch (st->op)
+		{
+		case OP_STORE_F:
+		case OP_STORE_V:
+		case OP_STORE_S:
+		case OP_STORE_ENT:
+		case OP_STORE_FLD:
+		case OP_STORE_FNC:
+			PR_JitMarkWritten ((unsigned short)st->b, 3);
+			break;
+		case OP_STOREP_F:
+		case OP_STOREP_V:
+		case OP_STOREP_S:
+		case OP_STOREP_ENT:
+		case OP_STOREP_FLD:
+		case OP_STOREP_FNC:
+		case OP_IF:
+		case OP_IFNOT:
+		case OP_GOTO:
+		case OP_CALL0:
+		case OP_CALL1:
+		case OP_CALL2:
+		case OP_CALL3:
+		case OP_CALL4:
+		case OP_CALL5:
+		case OP_CALL6:
+		case OP_CALL7:
+		case OP_CALL8:
+		case OP_DONE:
+		case OP_RETURN:
+		case OP_STATE:
+			break;
+		default:
+			PR_JitMarkWritten ((unsigned short)st->c, 3);
+			break;
+		}
+	}
+	for (i = 0, f = pr_functions; i < progs->numfunctions; i++, f++)
+		PR_JitMarkWritten (f->parm_start, f->locals);
+	for (i = 0, def = pr_globaldefs; i < progs->numglobaldefs; i++, def++)
+	{
+		if (def->type & DEF_SAVEGLOBAL)
+			PR_JitMarkWritten (def->ofs, (def->type & ~DEF_SAVEGLOBAL) == ev_vector ? 3 : 1);
+	}
+}
+
+static int PR_JitSortFunctions (const void *a, const void *b)
+{
+	return pr_functions[*(const int *)a].first_statement - pr_functions[*(const int *)b].first_statement;
+}
+
+/*
+===============
+PR_JitReset
+
+Throws away all native code, called when progs are loaded
+===============
+*/
+void PR_JitReset (void)
+{
+	jitchunk_t	*chunk, *next;
+	int		*order;
+	int		i, j, end;
+
+	for (chunk = jit_chunks; chunk; chunk = next)
+	{
+		next = chunk->next;
+		munmap (chunk->base, chunk->size);
+		free (chunk);
+	}
+	jit_chunks = NULL;
+	memset (&jitstats, 0, sizeof(jitstats));
+	pr_jitverifying = false;
+	PR_Jit_f (&pr_jit);
+
+	free (jit_code);
+	free (jit_failed);
+	free (jit_funcend);
+	free (jit_written);
+	jit_code = (prnative_t *) calloc (progs->numfunctions, sizeof(prnative_t));
+	jit_failed = (byte *) calloc (progs->numfunctions, 1);
+	jit_funcend = (int *) calloc (progs->numfunctions, sizeof(int));
+	jit_written = (byte *) calloc (progs->numglobals, 1);
+	order = (int *) malloc (progs->numfunctions * sizeof(int));
+	if (!jit_code || !jit_failed || !jit_funcend || !jit_written || !order)
+		Sys_Error ("PR_JitReset: out of memory");
+	PR_JitFindWrites ();
+
+// a function runs up to the next one's first statement
+	for (i = 0; i < progs->numfunctions; i++)
+		order[i] = i;
+	qsort (order, progs->numfunctions, sizeof(int), PR_JitSortFunctions);
+	for (i = 0; i < progs->numfunctions; i++)
+	{
+		end = progs->numstatements;
+		for (j = i + 1; j < progs->numfunctions; j++)
+		{
+			if (pr_functions[order[j]].first_statement > pr_functions[order[i]].first_statement)
+			{
+				end = pr_functions[order[j]].first_statement;
+				break;
+			}
+		}
+		jit_funcend[order[i]] = end;
+	}
+	free (order);
+}
+
+#else	/* !PR_JIT_SUPPORTED */
+
+prnative_t PR_JitFunction (dfunction_t *f)
+{
+	return NULL;
+}
+
+void PR_JitReset (void)
+{
+	memset (&jitstats, 0, sizeof(jitstats));
+	pr_jitverifying = false;
+}
+
+#endif	/* PR_JIT_SUPPORTED */
+
+/*
+===============================================================================
+
+VERIFICATION
+
+===============================================================================
+*/
+
+typedef struct
+{
+	int			*globals;
+	byte		*edicts;
+	int			num_edicts;
+	byte		*areanodes;
+	int			globalsize, edictsize, areasize;	// what the buffers were allocated for
+	const char	*lightstyles[MAX_LIGHTSTYLES];
+	int			datagram, reliable, signon;
+	int			messages[MAX_SCOREBOARD];
+	int			knownstrings;
+	zombie_ai	zombies[MaxZombies];
+	short		closest[MAX_EDICTS];
+	unsigned int	seed;
+} jitsnapshot_t;
+
+static jitsnapshot_t	jit_before, jit_after;
+
+static void PR_JitSnapshot (jitsnapshot_t *snap, qboolean restore)
+{
+	int		i, areasize;
+	void	*areanodes;
+
+	areanodes = SV_AreaNodeState (&areasize);
+
+// the progs and max_edicts can change between maps
+	if (snap->globalsize != progs->numglobals * 4 || snap->edictsize != sv.max_edicts * pr_edict_size ||
+		snap->areasize != areasize)
+	{
+		free (snap->globals);
+		free (snap->edicts);
+		free (snap->areanodes);
+		snap->globalsize = progs->numglobals * 4;
+		snap->edictsize = sv.max_edicts * pr_edict_size;
+		snap->areasize = areasize;
+		snap->globals = (int *) malloc (snap->globalsize);
+		snap->edicts = (byte *) malloc (snap->edictsize);
+		snap->areanodes = (byte *) malloc (snap->areasize);
+		if (!snap->globals || !snap->edicts || !snap->areanodes)
+			Sys_Error ("PR_JitSnapshot: out of memory");
+	}
+
+	if (!restore)
+	{
+		memcpy (snap->globals, pr_globals, snap->globalsize);
+		memcpy (snap->edicts, sv.edicts, snap->edictsize);
+		memcpy (snap->areanodes, areanodes, snap->areasize);
+		memcpy (snap->lightstyles, sv.lightstyles, sizeof(snap->lightstyles));
+		memcpy (snap->zombies, zombie_list, sizeof(snap->zombies));
+		memcpy (snap->closest, closest_waypoints, sizeof(snap->closest));
+		snap->num_edicts = sv.num_edicts;
+		snap->datagram = sv.datagram.cursize;
+		snap->reliable = sv.reliable_datagram.cursize;
+		snap->signon = sv.signon.cursize;
+		for (i = 0; i < svs.maxclients; i++)
+			snap->messages[i] = svs.clients[i].message.cursize;
+		snap->knownstrings = PR_KnownStringsMark ();
+		return;
+	}
+
+	memcpy (pr_globals, snap->globals, snap->globalsize);
+	memcpy (sv.edicts, snap->edicts, snap->edictsize);
+	memcpy (areanodes, snap->areanodes, snap->areasize);
+	memcpy ((void *)sv.lightstyles, snap->lightstyles, sizeof(snap->lightstyles));
+	memcpy (zombie_list, snap->zombies, sizeof(snap->zombies));
+	memcpy (closest_waypoints, snap->closest, sizeof(snap->closest));
+	sv.num_edicts = snap->num_edicts;
+	sv.datagram.cursize = snap->datagram;
+	sv.reliable_datagram.cursize = snap->reliable;
+	sv.signon.cursize = snap->signon;
+	for (i = 0; i < svs.maxclients; i++)
+		svs.clients[i].message.cursize = snap->messages[i];
+	PR_KnownStringsRelease (snap->knownstrings);
+	SV_MirrorRebuild ();	// the edicts changed under the mirror
+}
+
+static const char *PR_JitFieldName (int ofs)
+{
+	int		i;
+
+	for (i = 1; i < progs->numfielddefs; i++)
+	{
+		if (pr_fielddefs[i].ofs == ofs)
+			return PR_GetString (pr_fielddefs[i].s_name);
+	}
+	return "?";
+}
+
+/*
+===============
+PR_JitSameWord
+
+Any two NaNs compare equal, their sign and payload depend on the operand
+order the C compiler happened to pick for the interpreter
+===============
+*/
+static qboolean PR_JitSameWord (int a, int b)
+{
+	if (a == b)
+		return true;
+	return (a & 0x7f800000) == 0x7f800000 && (a & 0x007fffff) &&
+		(b & 0x7f800000) == 0x7f800000 && (b & 0x007fffff);
+}
+
+/*
+===============
+PR_JitCompare
+
+Compares the state after the native run with jit_after, the state after
+the interpreted one
+===============
+*/
+static qboolean PR_JitCompare (func_t fnum)
+{
+	const char	*name = PR_GetString (pr_functions[fnum].s_name);
+	int		i, j, *v, *w;
+
+	if (sv.num_edicts != jit_after.num_edicts)
+	{
+		Con_Printf ("pr_jitverify: %s: num_edicts %i, interpreter %i\n", name, sv.num_edicts, jit_after.num_edicts);
+		return false;
+	}
+
+	for (i = 0; i < progs->numglobals; i++)
+	{
+		if (!PR_JitSameWord (((int *)pr_globals)[i], jit_after.globals[i]))
+		{
+			Con_Printf ("pr_jitverify: %s: global %s is %08x, interpreter %08x\n", name,
+				PR_GlobalStringNoContents (i), ((int *)pr_globals)[i], jit_after.globals[i]);
+			return false;
+		}
+	}
+
+	for (i = 0; i < sv.num_edicts; i++)
+	{
+		v = (int *)&EDICT_NUM(i)->v;
+		w = (int *)&((edict_t *)(jit_after.edicts + i * pr_edict_size))->v;
+		if (EDICT_NUM(i)->free != ((edict_t *)(jit_after.edicts + i * pr_edict_size))->free)
+		{
+			Con_Printf ("pr_jitverify: %s: edict %i free differs\n", name, i);
+			return false;
+		}
+		for (j = 0; j < progs->entityfields; j++)
+		{
+			if (!PR_JitSameWord (v[j], w[j]))
+			{
+				Con_Printf ("pr_jitverify: %s: edict %i .%s is %08x, interpreter %08x\n", name, i,
+					PR_JitFieldName (j), v[j], w[j]);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+===============
+PR_JitVerify
+
+Called by PR_ExecuteProgram for top level calls while pr_jitverify is set.
+Returns false if the call should just run as usual.
+===============
+*/
+qboolean PR_JitVerify (func_t fnum)
+{
+	unsigned int	seed;
+
+	if (!pr_jitverify.value || !pr_jitactive || pr_jitverifying || !sv.edicts)
+		return false;
+
+	pr_jitverifying = true;
+	seed = rand ();
+
+	PR_JitSnapshot (&jit_before, false);
+
+	pr_jitactive = false;
+	srand (seed);
+	PR_ExecuteProgram (fnum);
+	PR_JitSnapshot (&jit_after, false);
+
+	PR_JitSnapshot (&jit_before, true);
+	pr_jitactive = true;
+	srand (seed);
+	PR_ExecuteProgram (fnum);
+
+	jitstats.verified++;
+	if (!PR_JitCompare (fnum))
+		jitstats.mismatches++;
+
+	pr_jitverifying = false;
+	return true;
+}
+
+/*
+===============
+PR_JitStats_f
+===============
+*/
+static void PR_JitStats_f (void)
+{
+#ifdef PR_JIT_SUPPORTED
+	Con_Printf ("pr_jit     : %s\n", pr_jitactive ? "on" : "off");
+#else
+	Con_Printf ("pr_jit     : not supported on this platform\n");
+#endif
+	Con_Printf ("compiled   : %i functions, %i bytes\n", jitstats.compiled, jitstats.codebytes);
+	Con_Printf ("interpreted: %i functions\n", jitstats.failed);
+	Con_Printf ("verified   : %i calls, %i mismatches\n", jitstats.verified, jitstats.mismatches);
+}
+
+static void PR_Jit_f (cvar_t *var)
+{
+#ifdef PR_JIT_SUPPORTED
+	pr_jitactive = pr_jit.value != 0;
+#else
+	if (pr_jit.value)
+		Con_Printf ("pr_jit is not supported on this platform\n");
+	pr_jitactive = false;
+#endif
+}
+
+/*
+===============
+PR_JitInit
+===============
+*/
+void PR_JitInit (void)
+{
+	Cvar_RegisterVariable (&pr_jit);
+	Cvar_SetCallback (&pr_jit, PR_Jit_f);
+	Cvar_RegisterVariable (&pr_jitverify);
+	Cmd_AddCommand ("pr_jitstats", PR_JitStats_f);
+}
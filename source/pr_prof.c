@@ -0,0 +1,621 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_prof.c -- hierarchical QuakeC profiler
+//
+// While pr_profiling is set, PR_EnterFunction/PR_LeaveFunction and the
+// builtin call sites report every call here. Calls are accumulated in a
+// calling context tree, one node per distinct call path, with the number
+// of calls and the wall clock time spent inside (inclusive) and outside of
+// callees (exclusive). Per function totals and caller/callee edges are
+// derived from the tree when a report is written. With profiling off the
+// only cost is the pr_profiling test at each call.
+
+#include "quakedef.h"
+
+qboolean	pr_profiling;
+
+#define	PROF_MAXNODES	65536	// call paths, further new ones are charged to the caller
+#define	PROF_MAXDEPTH	256		// QC frames, builtins and QC called from builtins
+
+typedef struct
+{
+	int		func;			// pr_functions index, 0 for the root
+	int		parent;
+	int		child;			// first callee, -1 if none
+	int		sibling;		// next callee of parent, -1 if none
+	int		calls;
+	double	inclusive;		// seconds
+	double	exclusive;
+} profnode_t;
+
+typedef struct
+{
+	int		node;
+	double	start;
+	double	childtime;		// inclusive time of finished callees
+} profframe_t;
+
+static profnode_t	*prof_nodes;
+static int			prof_numnodes;
+static int			prof_maxnodes;		// allocated
+static int			prof_lostnodes;		// calls charged to the caller for lack of nodes
+
+static profframe_t	prof_stack[PROF_MAXDEPTH];
+static int			prof_depth;			// frames above the root
+static int			prof_skipped;		// frames not pushed, the stack being full
+
+static double		prof_started;		// Sys_PreciseTime of the last start
+static double		prof_duration;		// of earlier start/stop periods
+static unsigned short	prof_crc;		// progs the nodes refer to
+
+/*
+===============
+PR_ProfClear
+===============
+*/
+static void PR_ProfClear (void)
+{
+	prof_numnodes = 1;
+	if (!prof_nodes)
+	{
+		prof_maxnodes = 1024;
+		prof_nodes = (profnode_t *) malloc (prof_maxnodes * sizeof(profnode_t));
+		if (!prof_nodes)
+			Sys_Error ("PR_ProfClear: out of memory");
+	}
+	memset (&prof_nodes[0], 0, sizeof(profnode_t));
+	prof_nodes[0].parent = -1;
+	prof_nodes[0].child = -1;
+	prof_nodes[0].sibling = -1;
+
+	prof_lostnodes = 0;
+	prof_depth = 0;
+	prof_skipped = 0;
+	prof_stack[0].node = 0;
+	prof_duration = 0;
+	prof_started = Sys_PreciseTime ();
+	prof_crc = pr_crc;
+}
+
+/*
+===============
+PR_ProfChild
+
+Returns the node for a call of func made from node parent
+===============
+*/
+static int PR_ProfChild (int parent, int func)
+{
+	profnode_t	*n;
+	int		i;
+
+	for (i = prof_nodes[parent].child; i != -1; i = prof_nodes[i].sibling)
+	{
+		if (prof_nodes[i].func == func)
+			return i;
+	}
+
+	if (prof_numnodes == prof_maxnodes)
+	{
+		if (prof_maxnodes == PROF_MAXNODES)
+		{
+			prof_lostnodes++;
+			return parent;
+		}
+		prof_maxnodes = q_min (prof_maxnodes * 2, PROF_MAXNODES);
+		prof_nodes = (profnode_t *) realloc (prof_nodes, prof_maxnodes * sizeof(profnode_t));
+		if (!prof_nodes)
+			Sys_Error ("PR_ProfChild: out of memory");
+	}
+
+	i = prof_numnodes++;
+	n = &prof_nodes[i];
+	memset (n, 0, sizeof(*n));
+	n->func = func;
+	n->parent = parent;
+	n->child = -1;
+	n->sibling = prof_nodes[parent].child;
+	prof_nodes[parent].child = i;
+	return i;
+}
+
+/*
+===============
+PR_ProfEnter
+
+f is being called, QC function or builtin
+===============
+*/
+void PR_ProfEnter (dfunction_t *f)
+{
+	profframe_t	*fr;
+
+	if (prof_depth == PROF_MAXDEPTH - 1)
+	{
+		prof_skipped++;
+		return;
+	}
+
+	fr = &prof_stack[prof_depth + 1];
+	fr->node = PR_ProfChild (prof_stack[prof_depth].node, (int)(f - pr_functions));
+	fr->childtime = 0;
+	prof_depth++;
+	fr->start = Sys_PreciseTime ();	// last, so the bookkeeping isn't charged to f
+}
+
+/*
+===============
+PR_ProfLeave
+
+The function of the last PR_ProfEnter returns
+===============
+*/
+void PR_ProfLeave (void)
+{
+	double		elapsed;
+	profframe_t	*fr;
+	profnode_t	*n;
+
+	if (prof_skipped)
+	{
+		prof_skipped--;
+		return;
+	}
+	if (!prof_depth)	// started while QC was running
+		return;
+
+	fr = &prof_stack[prof_depth];
+	elapsed = Sys_PreciseTime () - fr->start;
+	n = &prof_nodes[fr->node];
+	n->calls++;
+	n->inclusive += elapsed;
+	n->exclusive += elapsed - fr->childtime;
+
+	prof_depth--;
+	prof_stack[prof_depth].childtime += elapsed;
+}
+
+/*
+===============
+PR_ProfTopLevel
+
+Called at the start of every outermost PR_ExecuteProgram. Anything still
+on the stack was left behind by a Host_Error and is dropped.
+===============
+*/
+void PR_ProfTopLevel (void)
+{
+	prof_depth = 0;
+	prof_skipped = 0;
+	prof_stack[0].childtime = 0;
+}
+
+/*
+===============
+PR_ProfLoad
+
+Called by PR_LoadProgs, the nodes are only valid for the progs they were
+recorded with
+===============
+*/
+void PR_ProfLoad (void)
+{
+	if (prof_nodes && prof_crc != pr_crc)
+	{
+		PR_ProfClear ();
+		if (pr_profiling)
+			Con_Printf ("pr_profile: progs changed, profile cleared\n");
+	}
+}
+
+/*
+===============================================================================
+
+REPORTS
+
+===============================================================================
+*/
+
+typedef struct
+{
+	int		func;
+	int		calls;
+	double	inclusive;		// not counting recursive calls twice
+	double	exclusive;
+} proffunc_t;
+
+typedef struct
+{
+	int		caller, callee;
+	int		calls;
+	double	inclusive;
+} profedge_t;
+
+/*
+===============
+PR_ProfName
+===============
+*/
+static const char *PR_ProfName (int func)
+{
+	if (!func)
+		return "<engine>";
+	return PR_GetString (pr_functions[func].s_name);
+}
+
+/*
+===============
+PR_ProfRecursive
+
+true if the function of node n is also on the path above it
+===============
+*/
+static qboolean PR_ProfRecursive (int n)
+{
+	int		i, func = prof_nodes[n].func;
+
+	for (i = prof_nodes[n].parent; i > 0; i = prof_nodes[i].parent)
+	{
+		if (prof_nodes[i].func == func)
+			return true;
+	}
+	return false;
+}
+
+/*
+===============
+PR_ProfFunctions
+
+Per function totals in a malloc'd array, sorted by exclusive time
+===============
+*/
+static int PR_ProfSortFunc (const void *a, const void *b)
+{
+	const proffunc_t	*fa = (const proffunc_t *)a, *fb = (const proffunc_t *)b;
+
+	if (fa->exclusive != fb->exclusive)
+		return fa->exclusive < fb->exclusive ? 1 : -1;
+	return fa->func - fb->func;
+}
+
+static proffunc_t *PR_ProfFunctions (int *count)
+{
+	proffunc_t	*funcs, *fn;
+	profnode_t	*n;
+	int		i, num;
+
+	funcs = (proffunc_t *) calloc (progs->numfunctions, sizeof(proffunc_t));
+	if (!funcs)
+		Sys_Error ("PR_ProfFunctions: out of memory");
+
+	for (i = 1, n = &prof_nodes[1]; i < prof_numnodes; i++, n++)
+	{
+		fn = &funcs[n->func];
+		fn->calls += n->calls;
+		fn->exclusive += n->exclusive;
+		if (!PR_ProfRecursive (i))
+			fn->inclusive += n->inclusive;
+	}
+
+	for (i = num = 0; i < progs->numfunctions; i++)
+	{
+		if (!funcs[i].calls)
+			continue;
+		funcs[num] = funcs[i];
+		funcs[num].func = i;
+		num++;
+	}
+	qsort (funcs, num, sizeof(proffunc_t), PR_ProfSortFunc);
+
+	*count = num;
+	return funcs;
+}
+
+/*
+===============
+PR_ProfEdges
+
+Caller/callee totals in a malloc'd array
+===============
+*/
+static int PR_ProfSortEdge (const void *a, const void *b)
+{
+	const profedge_t	*ea = (const profedge_t *)a, *eb = (const profedge_t *)b;
+
+	if (ea->caller != eb->caller)
+		return ea->caller - eb->caller;
+	return ea->callee - eb->callee;
+}
+
+static profedge_t *PR_ProfEdges (int *count)
+{
+	profedge_t	*edges;
+	profnode_t	*n;
+	int		i, num;
+
+	edges = (profedge_t *) malloc (q_max (prof_numnodes, 1) * sizeof(profedge_t));
+	if (!edges)
+		Sys_Error ("PR_ProfEdges: out of memory");
+
+	for (i = 1, num = 0, n = &prof_nodes[1]; i < prof_numnodes; i++, n++)
+	{
+		if (!n->calls)
+			continue;
+		edges[num].caller = prof_nodes[n->parent].func;
+		edges[num].callee = n->func;
+		edges[num].calls = n->calls;
+		edges[num].inclusive = n->inclusive;
+		num++;
+	}
+	qsort (edges, num, sizeof(profedge_t), PR_ProfSortEdge);
+
+// merge the same edge reached through different paths
+	for (i = 1, *count = q_min (num, 1); i < num; i++)
+	{
+		if (edges[i].caller == edges[*count - 1].caller && edges[i].callee == edges[*count - 1].callee)
+		{
+			edges[*count - 1].calls += edges[i].calls;
+			edges[*count - 1].inclusive += edges[i].inclusive;
+		}
+		else
+			edges[(*count)++] = edges[i];
+	}
+	return edges;
+}
+
+/*
+===============
+PR_ProfDuration
+===============
+*/
+static double PR_ProfDuration (void)
+{
+	if (pr_profiling)
+		return prof_duration + Sys_PreciseTime () - prof_started;
+	return prof_duration;
+}
+
+/*
+===============
+PR_ProfReport
+===============
+*/
+static void PR_ProfReport (int count)
+{
+	proffunc_t	*funcs;
+	double		total;
+	int		i, num;
+
+	funcs = PR_ProfFunctions (&num);
+	total = PR_ProfDuration ();
+
+	Con_Printf ("%.1f s profiled, %i call paths\n", total, prof_numnodes - 1);
+	Con_Printf ("      calls   incl ms   excl ms  excl%%  function\n");
+	for (i = 0; i < num && i < count; i++)
+	{
+		Con_Printf ("%11i %9.2f %9.2f %5.1f%%  %s%s\n", funcs[i].calls,
+			funcs[i].inclusive * 1000, funcs[i].exclusive * 1000,
+			total > 0 ? funcs[i].exclusive * 100 / total : 0,
+			PR_ProfName (funcs[i].func), pr_functions[funcs[i].func].first_statement < 0 ? " (builtin)" : "");
+	}
+	if (prof_lostnodes)
+		Con_Printf ("%i calls charged to their caller, out of call path nodes\n", prof_lostnodes);
+
+	free (funcs);
+}
+
+/*
+===============
+PR_ProfFolded
+
+Writes one "root;caller;callee exclusive_ns" line per call path, the input
+flamegraph.pl and similar tools take
+===============
+*/
+static void PR_ProfFoldedNode (FILE *f, int node, char *path, int len, int size)
+{
+	profnode_t	*n = &prof_nodes[node];
+	const char	*name;
+	int		i, newlen;
+
+	name = PR_ProfName (n->func);
+	newlen = len + q_snprintf (path + len, size - len, "%s%s%s", len ? ";" : "", name,
+		pr_functions[n->func].first_statement < 0 ? "[builtin]" : "");
+	if (newlen >= size)
+		newlen = size - 1;
+
+	if (n->exclusive > 0)
+		fprintf (f, "%s %.0f\n", path, n->exclusive * 1e9);
+
+	for (i = n->child; i != -1; i = prof_nodes[i].sibling)
+		PR_ProfFoldedNode (f, i, path, newlen, size);
+	path[len] = 0;
+}
+
+static void PR_ProfFolded (FILE *f)
+{
+	char	path[4096];
+	int		i;
+
+	path[0] = 0;
+	for (i = prof_nodes[0].child; i != -1; i = prof_nodes[i].sibling)
+		PR_ProfFoldedNode (f, i, path, 0, sizeof(path));
+}
+
+/*
+===============
+PR_ProfJSON
+===============
+*/
+static void PR_ProfJSONString (FILE *f, const char *s)
+{
+	fputc ('"', f);
+	for ( ; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fprintf (f, "\\%c", *s);
+		else if ((unsigned char)*s < ' ')
+			fprintf (f, "\\u%04x", (unsigned char)*s);
+		else
+			fputc (*s, f);
+	}
+	fputc ('"', f);
+}
+
+static void PR_ProfJSON (FILE *f)
+{
+	proffunc_t	*funcs;
+	profedge_t	*edges;
+	int		i, numfuncs, numedges;
+
+	funcs = PR_ProfFunctions (&numfuncs);
+	edges = PR_ProfEdges (&numedges);
+
+	fprintf (f, "{\n\t\"duration_ns\": %.0f,\n\t\"call_paths\": %i,\n\t\"functions\": [\n",
+		PR_ProfDuration () * 1e9, prof_numnodes - 1);
+	for (i = 0; i < numfuncs; i++)
+	{
+		fprintf (f, "\t\t{\"name\": ");
+		PR_ProfJSONString (f, PR_ProfName (funcs[i].func));
+		fprintf (f, ", \"builtin\": %s, \"calls\": %i, \"inclusive_ns\": %.0f, \"exclusive_ns\": %.0f}%s\n",
+			pr_functions[funcs[i].func].first_statement < 0 ? "true" : "false",
+			funcs[i].calls, funcs[i].inclusive * 1e9, funcs[i].exclusive * 1e9,
+			i < numfuncs - 1 ? "," : "");
+	}
+	fprintf (f, "\t],\n\t\"edges\": [\n");
+	for (i = 0; i < numedges; i++)
+	{
+		fprintf (f, "\t\t{\"caller\": ");
+		PR_ProfJSONString (f, PR_ProfName (edges[i].caller));
+		fprintf (f, ", \"callee\": ");
+		PR_ProfJSONString (f, PR_ProfName (edges[i].callee));
+		fprintf (f, ", \"calls\": %i, \"inclusive_ns\": %.0f}%s\n",
+			edges[i].calls, edges[i].inclusive * 1e9, i < numedges - 1 ? "," : "");
+	}
+	fprintf (f, "\t]\n}\n");
+
+	free (funcs);
+	free (edges);
+}
+
+/*
+===============
+PR_ProfWrite
+===============
+*/
+static void PR_ProfWrite (const char *filename, void (*write) (FILE *f))
+{
+	char	name[MAX_OSPATH];
+	FILE	*f;
+
+	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, filename);
+	f = fopen (name, "w");
+	if (!f)
+	{
+		Con_Printf ("pr_profile: couldn't write %s\n", name);
+		return;
+	}
+	write (f);
+	fclose (f);
+	Con_Printf ("Wrote %s\n", name);
+}
+
+/*
+===============
+PR_ProfRecorded
+===============
+*/
+static qboolean PR_ProfRecorded (void)
+{
+	if (!prof_nodes || !progs || prof_crc != pr_crc)
+	{
+		Con_Printf ("pr_profile: nothing recorded for these progs\n");
+		return false;
+	}
+	return true;
+}
+
+/*
+===============
+PR_ProfileCmd_f
+
+pr_profile start|stop|clear|report [count]|folded [file]|json [file]
+===============
+*/
+static void PR_ProfileCmd_f (void)
+{
+	const char	*cmd = Cmd_Argv (1);
+
+	if (!strcmp (cmd, "start"))
+	{
+		if (pr_profiling)
+			return;
+		if (!prof_nodes || prof_crc != pr_crc)
+			PR_ProfClear ();
+		prof_started = Sys_PreciseTime ();
+		PR_ProfTopLevel ();
+		pr_profiling = true;
+		Con_Printf ("QuakeC profiling started\n");
+	}
+	else if (!strcmp (cmd, "stop"))
+	{
+		if (!pr_profiling)
+			return;
+		prof_duration = PR_ProfDuration ();
+		pr_profiling = false;
+		Con_Printf ("QuakeC profiling stopped\n");
+	}
+	else if (!strcmp (cmd, "clear"))
+	{
+		if (prof_nodes)
+			PR_ProfClear ();
+	}
+	else if (!strcmp (cmd, "report"))
+	{
+		if (PR_ProfRecorded ())
+			PR_ProfReport (Cmd_Argc() > 2 ? Q_atoi (Cmd_Argv (2)) : 20);
+	}
+	else if (!strcmp (cmd, "folded"))
+	{
+		if (PR_ProfRecorded ())
+			PR_ProfWrite (Cmd_Argc() > 2 ? Cmd_Argv (2) : "qcprofile.folded", PR_ProfFolded);
+	}
+	else if (!strcmp (cmd, "json"))
+	{
+		if (PR_ProfRecorded ())
+			PR_ProfWrite (Cmd_Argc() > 2 ? Cmd_Argv (2) : "qcprofile.json", PR_ProfJSON);
+	}
+	else
+	{
+		Con_Printf ("usage: pr_profile start|stop|clear|report [count]|folded [file]|json [file]\n");
+		Con_Printf ("profiling is %s\n", pr_profiling ? "on" : "off");
+	}
+}
+
+/*
+===============
+PR_ProfInit
+===============
+*/
+void PR_ProfInit (void)
+{
+	Cmd_AddCommand ("pr_profile", PR_ProfileCmd_f);
+}
@@ -0,0 +1,1053 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_strings.c -- QuakeC string heap
+//
+// A string_t >= 0 is an offset into the progs string table. Negative
+// values -1, -2, ... index a slot table of strings the engine made:
+//
+// engine	pointers into engine memory, interned by address so that
+//			setting the same one again gives the same number
+// hunk		map lifetime, for strings parsed from the entity lump or a save
+// temp		builtin results (ftos, strcat...) bump allocated from an arena
+//			that is reset at the end of every server frame. Temps still
+//			referenced from a global or a string field at that point are
+//			promoted to the zone heap and freed again once nothing
+//			refers to them.
+// zone		strzone'd strings, size class free lists carved from the hunk,
+//			until strunzone or the next map
+//
+// Slots freed during a frame are only reused after the frame, so string
+// numbers handed out while QC runs depend only on what QC did.
+
+#include "quakedef.h"
+
+char		*pr_strings;
+static int	pr_stringssize;
+
+int			pr_tempgeneration;	// changes when temp string numbers are reused
+
+enum
+{
+	PRSTR_FREE,
+	PRSTR_ENGINE,
+	PRSTR_HUNK,
+	PRSTR_TEMP,
+	PRSTR_PROMOTED,		// a temp that outlived its frame
+	PRSTR_ZONE
+};
+
+static const char *pr_strkindnames[] = {"free", "engine", "hunk", "temp", "promoted", "zone"};
+
+typedef struct
+{
+	const char	*s;
+	int			len;		// strlen, -1 if not known
+	short		kind;
+	short		sizeclass;	// zone and promoted: free list, -1 for Z_Malloc'd
+	int			hashnext;	// next slot in the same bucket, -1 at the end
+	int			seen;		// last reference scan that found it
+} prstring_t;
+
+#define	PRSTR_ALLOCSLOTS	256
+#define	PRSTR_MINCLASS		16		// smallest zone buffer
+#define	PRSTR_NUMCLASSES	7		// 16 to 1024 bytes, larger ones are Z_Malloc'd
+#define	PRSTR_CHUNK			16384	// hunk allocation the small buffers are carved from
+#define	PRSTR_TEMPBLOCK		65536
+
+static prstring_t	*pr_knownstrings;
+static int			pr_numknownstrings;		// slots in use or on the free stack
+static int			pr_maxknownstrings;
+
+static int		*pr_freeslots;			// stack of slot numbers
+static int		pr_numfreeslots;
+
+static int		*pr_strhash;			// address hash buckets, first slot or -1
+static int		pr_strhashmask;
+
+// temps of this frame, promoted ones, strunzone'd slots to free after the frame
+typedef struct
+{
+	int		*slots;
+	int		num, max;
+} prslotlist_t;
+
+static prslotlist_t	pr_temps, pr_promoted, pr_pendingfree, pr_marklog;
+
+// temp arena
+typedef struct tempblock_s
+{
+	struct tempblock_s	*next;
+	int		size, used;
+} tempblock_t;
+
+static struct
+{
+	tempblock_t	hdr;
+	char		data[PRSTR_TEMPBLOCK];
+} pr_tempfirst;
+static tempblock_t	*pr_tempcur = &pr_tempfirst.hdr;
+
+// zone heap
+static char		*pr_zonefree[PRSTR_NUMCLASSES];
+static byte		*pr_zonechunk;
+static int		pr_zonechunkleft;
+
+static int		*pr_stringfields;		// entity fields of type string
+static int		pr_numstringfields;
+static qboolean	pr_stringfieldsvalid;
+static int		pr_strscan;
+
+// PR_KnownStringsMark state
+static struct
+{
+	qboolean	active;
+	int			numslots, numfree, numtemps, numpending;
+	tempblock_t	*tempcur;
+	int			tempused;
+} pr_strmark;
+
+static struct
+{
+	int		engine, enginelookups;
+	int		temps, temppeak, tempframe, views;
+	double	tempbytes;
+	int		tempbytespeak, tempbytesframe;
+	int		promoted;
+	int		zoneallocs, zonefrees, zonelive, zonebytes;
+	int		hunk, hunkbytes;
+} pr_strstats;
+
+/*
+===============================================================================
+
+SLOTS
+
+===============================================================================
+*/
+
+/*
+============
+PR_SlotListAdd
+============
+*/
+static void PR_SlotListAdd (prslotlist_t *list, int slot)
+{
+	if (list->num == list->max)
+	{
+		list->max = q_max (list->max * 2, 256);
+		list->slots = (int *) Mem_Realloc (MEM_QC, list->slots, list->max * sizeof(int));
+		if (!list->slots)
+			Sys_Error ("PR_SlotListAdd: out of memory");
+	}
+	list->slots[list->num++] = slot;
+}
+
+/*
+============
+PR_StringHash
+============
+*/
+static int PR_StringHash (const char *s)
+{
+	uintptr_t	p = (uintptr_t)s;
+
+	return (int)(p ^ (p >> 9) ^ (p >> 19)) & pr_strhashmask;
+}
+
+static void PR_HashLink (int slot)
+{
+	int		b = PR_StringHash (pr_knownstrings[slot].s);
+
+	pr_knownstrings[slot].hashnext = pr_strhash[b];
+	pr_strhash[b] = slot;
+}
+
+static void PR_HashUnlink (int slot)
+{
+	int		*link = &pr_strhash[PR_StringHash (pr_knownstrings[slot].s)];
+
+	while (*link != -1)
+	{
+		if (*link == slot)
+		{
+			*link = pr_knownstrings[slot].hashnext;
+			return;
+		}
+		link = &pr_knownstrings[*link].hashnext;
+	}
+}
+
+/*
+============
+PR_Rehash
+
+Keeps the buckets at least half as many as the slots
+============
+*/
+static void PR_Rehash (void)
+{
+	int		i, size;
+
+	for (size = 1024; size < pr_maxknownstrings / 2; size <<= 1)
+		;
+	if (pr_strhash && size == pr_strhashmask + 1)
+		return;
+
+	pr_strhash = (int *) Mem_Realloc (MEM_QC, pr_strhash, size * sizeof(int));
+	if (!pr_strhash)
+		Sys_Error ("PR_Rehash: out of memory");
+	pr_strhashmask = size - 1;
+	for (i = 0; i < size; i++)
+		pr_strhash[i] = -1;
+	for (i = 0; i < pr_numknownstrings; i++)
+	{
+		if (pr_knownstrings[i].kind != PRSTR_FREE)
+			PR_HashLink (i);
+	}
+}
+
+/*
+============
+PR_AllocStringSlots
+============
+*/
+static void PR_AllocStringSlots (void)
+{
+	pr_maxknownstrings += PRSTR_ALLOCSLOTS;
+	Con_DPrintf2("PR_AllocStringSlots: realloc'ing for %d slots\n", pr_maxknownstrings);
+	pr_knownstrings = (prstring_t *) Z_Realloc (pr_knownstrings, pr_maxknownstrings * sizeof(prstring_t));
+	pr_freeslots = (int *) Z_Realloc (pr_freeslots, pr_maxknownstrings * sizeof(int));
+	PR_Rehash ();
+}
+
+/*
+============
+PR_NewString
+
+Takes a slot for s and returns its string number
+============
+*/
+static int PR_NewString (const char *s, int len, int kind)
+{
+	prstring_t	*str;
+	int		i;
+
+	if (pr_numfreeslots)
+		i = pr_freeslots[--pr_numfreeslots];
+	else
+	{
+		if (pr_numknownstrings == pr_maxknownstrings)
+			PR_AllocStringSlots ();
+		i = pr_numknownstrings++;
+	}
+
+	str = &pr_knownstrings[i];
+	str->s = s;
+	str->len = len;
+	str->kind = kind;
+	str->sizeclass = -1;
+	str->seen = pr_strscan;
+	PR_HashLink (i);
+
+	if (pr_strmark.active)
+		PR_SlotListAdd (&pr_marklog, i);
+	return -1 - i;
+}
+
+/*
+============
+PR_FindString
+
+Slot of the string at address s, or -1
+============
+*/
+static int PR_FindString (const char *s)
+{
+	int		i;
+
+	for (i = pr_strhash[PR_StringHash (s)]; i != -1; i = pr_knownstrings[i].hashnext)
+	{
+		if (pr_knownstrings[i].s == s)
+			return i;
+	}
+	return -1;
+}
+
+/*
+===============================================================================
+
+ZONE HEAP
+
+===============================================================================
+*/
+
+static int PR_SizeClass (int size)
+{
+	int		c;
+
+	for (c = 0; c < PRSTR_NUMCLASSES; c++)
+	{
+		if (size <= (PRSTR_MINCLASS << c))
+			return c;
+	}
+	return -1;
+}
+
+/*
+============
+PR_ZoneAlloc
+============
+*/
+static char *PR_ZoneAlloc (int size, short *sizeclass)
+{
+	char	*p;
+	int		c, bytes;
+
+	c = PR_SizeClass (size);
+	*sizeclass = c;
+	if (c < 0)
+		return (char *) Z_Malloc (size);
+
+	if (pr_zonefree[c])
+	{
+		p = pr_zonefree[c];
+		pr_zonefree[c] = *(char **)p;
+		return p;
+	}
+
+	bytes = PRSTR_MINCLASS << c;
+	if (pr_zonechunkleft < bytes)
+	{
+		pr_zonechunk = (byte *) Hunk_AllocName (PRSTR_CHUNK, "strzone");
+		pr_zonechunkleft = PRSTR_CHUNK;
+	}
+	p = (char *)pr_zonechunk;
+	pr_zonechunk += bytes;
+	pr_zonechunkleft -= bytes;
+	return p;
+}
+
+static void PR_ZoneFree (char *p, int sizeclass)
+{
+	if (sizeclass < 0)
+	{
+		Z_Free (p);
+		return;
+	}
+	*(char **)p = pr_zonefree[sizeclass];
+	pr_zonefree[sizeclass] = p;
+}
+
+/*
+============
+PR_ReleaseSlot
+============
+*/
+static void PR_ReleaseSlot (int i)
+{
+	prstring_t	*str = &pr_knownstrings[i];
+
+	PR_HashUnlink (i);
+	if (str->kind == PRSTR_ZONE || str->kind == PRSTR_PROMOTED)
+	{
+		PR_ZoneFree ((char *)str->s, str->sizeclass);
+		if (str->kind == PRSTR_ZONE)
+		{
+			pr_strstats.zonelive--;
+			pr_strstats.zonebytes -= str->len + 1;
+		}
+	}
+	str->s = "";
+	str->len = 0;
+	str->kind = PRSTR_FREE;
+}
+
+/*
+============
+PR_FreeSlot
+============
+*/
+static void PR_FreeSlot (int i)
+{
+	if (pr_knownstrings[i].kind == PRSTR_FREE)
+		return;
+	PR_ReleaseSlot (i);
+	pr_freeslots[pr_numfreeslots++] = i;
+}
+
+/*
+============
+PR_MoveString
+
+Copies the string of slot i to new storage of the given kind, keeping
+its number
+============
+*/
+static void PR_MoveString (int i, int kind)
+{
+	prstring_t	*str = &pr_knownstrings[i];
+	char		*p;
+	int			len;
+
+	len = (str->len >= 0) ? str->len : (int)strlen (str->s);
+	if (kind == PRSTR_HUNK)
+	{
+		p = (char *) Hunk_AllocName (len + 1, "string");
+		pr_strstats.hunk++;
+		pr_strstats.hunkbytes += len + 1;
+	}
+	else
+		p = PR_ZoneAlloc (len + 1, &str->sizeclass);
+	memcpy (p, str->s, len + 1);
+
+	PR_HashUnlink (i);
+	str->s = p;
+	str->len = len;
+	str->kind = kind;
+	PR_HashLink (i);
+}
+
+/*
+===============================================================================
+
+PUBLIC INTERFACE
+
+===============================================================================
+*/
+
+/*
+============
+PR_GetString
+============
+*/
+const char *PR_GetString (int num)
+{
+	// Naievil -- rewrote this... not sure why it was generating out of bounds errors!
+	// 		The old version used to overwrite the memory on NX...probably due to a
+	// 		bad compiler? Out of range numbers give an empty string.
+	if (num >= 0)
+	{
+		if (num < pr_stringssize)
+			return pr_strings + num;
+	}
+	else if (num >= -pr_numknownstrings)
+		return pr_knownstrings[-1 - num].s;	// "" once freed
+
+	return "";
+}
+
+/*
+============
+PR_IsProgsString
+
+true if num is an offset into the progs string table, i.e. the same for
+every instance of the same progs.dat
+============
+*/
+qboolean PR_IsProgsString (int num)
+{
+	return num >= 0 && num < pr_stringssize;
+}
+
+/*
+============
+PR_SetEngineString
+
+Number for a string the engine owns. The same address always gives the
+same number.
+============
+*/
+int PR_SetEngineString (const char *s)
+{
+	int		i;
+
+	if (!s)
+		return 0;
+#if 0	/* can't: sv.model_precache & sv.sound_precache points to pr_strings */
+	if (s >= pr_strings && s <= pr_strings + pr_stringssize)
+		Host_Error("PR_SetEngineString: \"%s\" in pr_strings area\n", s);
+#else
+	if (s >= pr_strings && s <= pr_strings + pr_stringssize - 2)
+		return (int)(s - pr_strings);
+#endif
+
+	pr_strstats.enginelookups++;
+	if ((i = PR_FindString (s)) != -1)
+		return -1 - i;
+
+	// new unknown engine string
+	//Con_DPrintf ("PR_SetEngineString: new engine string %p\n", s);
+	pr_strstats.engine++;
+	return PR_NewString (s, -1, PRSTR_ENGINE);
+}
+
+/*
+============
+PR_AllocString
+
+A buffer of size bytes that lasts until the next map
+============
+*/
+int PR_AllocString (int size, char **ptr)
+{
+	char	*p;
+
+	if (!size)
+		return 0;
+	p = (char *) Hunk_AllocName (size, "string");
+	pr_strstats.hunk++;
+	pr_strstats.hunkbytes += size;
+	if (ptr)
+		*ptr = p;
+	return PR_NewString (p, -1, PRSTR_HUNK);
+}
+
+/*
+============
+PR_TempString
+
+A buffer of size bytes that lasts until the end of the server frame, or
+for as long as a global or an entity field still holds its number then
+============
+*/
+int PR_TempString (int size, char **ptr)
+{
+	tempblock_t	*b = pr_tempcur;
+	char		*p;
+	int			num;
+
+	if (b->used + size > b->size)
+	{
+		b = (tempblock_t *) Mem_Alloc (MEM_QC, sizeof(tempblock_t) + q_max (size, PRSTR_TEMPBLOCK));
+		if (!b)
+			Sys_Error ("PR_TempString: out of memory");
+		b->next = NULL;
+		b->size = q_max (size, PRSTR_TEMPBLOCK);
+		b->used = 0;
+		pr_tempcur->next = b;
+		pr_tempcur = b;
+	}
+	p = (char *)(b + 1) + b->used;
+	b->used += size;
+
+	pr_strstats.temps++;
+	pr_strstats.tempframe++;
+	pr_strstats.tempbytes += size;
+	pr_strstats.tempbytesframe += size;
+	if (ptr)
+		*ptr = p;
+	num = PR_NewString (p, -1, PRSTR_TEMP);
+	PR_SlotListAdd (&pr_temps, -1 - num);
+	return num;
+}
+
+/*
+============
+PR_SetTempString
+
+Temp copy of s, see PR_TempString
+============
+*/
+int PR_SetTempString (const char *s)
+{
+	char	*p;
+	int		len, num;
+
+	len = strlen (s);
+	num = PR_NewTempString (len, &p);
+	memcpy (p, s, len);
+	return num;
+}
+
+/*
+============
+PR_NewTempString
+
+A temp of len characters for the caller to fill in. The terminating 0 is
+already there and the length is known to PR_GetStringLength.
+============
+*/
+int PR_NewTempString (int len, char **ptr)
+{
+	int		num;
+
+	num = PR_TempString (len + 1, ptr);
+	(*ptr)[len] = 0;
+	pr_knownstrings[-1 - num].len = len;
+	return num;
+}
+
+/*
+============
+PR_TempStringView
+
+A temp for the len characters at s, which are followed by a 0 and stay as
+they are until the end of the frame. Nothing is copied unless the number
+is still held then and the string is promoted.
+============
+*/
+int PR_TempStringView (const char *s, int len)
+{
+	int		num;
+
+	num = PR_NewString (s, len, PRSTR_TEMP);
+	PR_SlotListAdd (&pr_temps, -1 - num);
+	pr_strstats.temps++;
+	pr_strstats.tempframe++;
+	pr_strstats.views++;
+	return num;
+}
+
+/*
+============
+PR_TempSubString
+
+The len characters of string num from start on, which the caller has
+checked are in range. The tail of a hunk or temp string, whose memory
+lasts the frame, is a view of it rather than a copy; zone and promoted
+buffers can be freed sooner.
+============
+*/
+int PR_TempSubString (int num, int start, int len)
+{
+	const char	*s;
+	char		*p;
+	int			total, kind;
+
+	s = PR_GetStringLength (num, &total);
+	if (start > 0 && start + len == total)
+	{
+		kind = (num < 0 && num >= -pr_numknownstrings) ? pr_knownstrings[-1 - num].kind : PRSTR_HUNK;
+		if (kind == PRSTR_HUNK || kind == PRSTR_TEMP)
+			return PR_TempStringView (s + start, len);
+	}
+
+	num = PR_NewTempString (len, &p);
+	memcpy (p, s + start, len);
+	return num;
+}
+
+/*
+============
+PR_GetStringLength
+
+PR_GetString, with the length of the string. It is remembered for the
+strings made for QC; engine strings can change under their number.
+============
+*/
+const char *PR_GetStringLength (int num, int *len)
+{
+	prstring_t	*str;
+	const char	*s;
+
+	if (num < 0 && num >= -pr_numknownstrings)
+	{
+		str = &pr_knownstrings[-1 - num];
+		if (str->kind != PRSTR_ENGINE)
+		{
+			if (str->len < 0)
+				str->len = strlen (str->s);
+			*len = str->len;
+			return str->s;
+		}
+	}
+
+	s = PR_GetString (num);
+	*len = strlen (s);
+	return s;
+}
+
+/*
+============
+PR_ZoneString
+
+strzone: a copy of s that lasts until PR_FreeZoneString or the next map
+============
+*/
+int PR_ZoneString (const char *s)
+{
+	short	sizeclass;
+	char	*p;
+	int		len, num;
+
+	len = strlen (s);
+	p = PR_ZoneAlloc (len + 1, &sizeclass);
+	memcpy (p, s, len + 1);
+	num = PR_NewString (p, len, PRSTR_ZONE);
+	pr_knownstrings[-1 - num].sizeclass = sizeclass;
+
+	pr_strstats.zoneallocs++;
+	pr_strstats.zonelive++;
+	pr_strstats.zonebytes += len + 1;
+	return num;
+}
+
+/*
+============
+PR_FreeZoneString
+
+strunzone. Only strings from PR_ZoneString are freed, at the end of the
+frame. Anything else is left alone.
+============
+*/
+void PR_FreeZoneString (int num)
+{
+	if (num >= 0 || num < -pr_numknownstrings)
+		return;
+	if (pr_knownstrings[-1 - num].kind != PRSTR_ZONE)
+		return;
+	pr_strstats.zonefrees++;
+	PR_SlotListAdd (&pr_pendingfree, -1 - num);
+}
+
+/*
+============
+PR_GetKeptString
+
+For the engine keeping a QC string pointer, like the precache lists and
+lightstyles. A temp is moved to the hunk so the pointer stays valid for
+the rest of the map.
+============
+*/
+const char *PR_GetKeptString (int num)
+{
+	prstring_t	*str;
+	char		*old;
+	int			oldkind, oldclass;
+
+	if (num < 0 && num >= -pr_numknownstrings)
+	{
+		str = &pr_knownstrings[-1 - num];
+		if (str->kind == PRSTR_TEMP || str->kind == PRSTR_PROMOTED)
+		{
+			old = (char *)str->s;
+			oldkind = str->kind;
+			oldclass = str->sizeclass;
+			PR_MoveString (-1 - num, PRSTR_HUNK);
+			if (oldkind == PRSTR_PROMOTED)
+				PR_ZoneFree (old, oldclass);
+		}
+	}
+	return PR_GetString (num);
+}
+
+/*
+============
+PR_ReferenceString
+
+Found in a global or a string field during the end of frame scan
+============
+*/
+static void PR_ReferenceString (int num)
+{
+	prstring_t	*str;
+
+	if (num >= 0 || num < -pr_numknownstrings)
+		return;
+	str = &pr_knownstrings[-1 - num];
+	if (str->kind == PRSTR_TEMP)
+	{
+		PR_MoveString (-1 - num, PRSTR_PROMOTED);
+		PR_SlotListAdd (&pr_promoted, -1 - num);
+		pr_strstats.promoted++;
+	}
+	str->seen = pr_strscan;
+}
+
+/*
+============
+PR_ResetTemps
+============
+*/
+static void PR_ResetTemps (void)
+{
+	tempblock_t	*b, *next;
+
+	for (b = pr_tempfirst.hdr.next; b; b = next)
+	{
+		next = b->next;
+		Mem_Free (b);
+	}
+	pr_tempfirst.hdr.next = NULL;
+	pr_tempfirst.hdr.used = 0;
+	pr_tempcur = &pr_tempfirst.hdr;
+	pr_tempgeneration++;
+}
+
+/*
+============
+PR_StringsFrame
+
+Called at the end of every server frame. Promotes the temps that are still
+referenced, frees the rest and resets the arena.
+============
+*/
+void PR_StringsFrame (void)
+{
+	edict_t		*ed;
+	int			i, j;
+
+	if (!progs || (!pr_temps.num && !pr_promoted.num && !pr_pendingfree.num))
+		return;
+
+	if (pr_temps.num || pr_promoted.num)
+	{
+		if (!pr_stringfieldsvalid)
+		{
+			pr_stringfields = (int *) Mem_Realloc (MEM_QC, pr_stringfields, q_max (progs->numfielddefs, 1) * sizeof(int));
+			if (!pr_stringfields)
+				Sys_Error ("PR_StringsFrame: out of memory");
+			for (i = pr_numstringfields = 0; i < progs->numfielddefs; i++)
+			{
+				if ((pr_fielddefs[i].type & ~DEF_SAVEGLOBAL) == ev_string)
+					pr_stringfields[pr_numstringfields++] = pr_fielddefs[i].ofs;
+			}
+			pr_stringfieldsvalid = true;
+		}
+
+	// all globals, string arrays have no defs for their elements. A float
+	// that happens to look like a string number only keeps a string a
+	// frame longer.
+		pr_strscan++;
+		for (i = 0; i < progs->numglobals; i++)
+			PR_ReferenceString (((int *)pr_globals)[i]);
+		for (i = 0; i < sv.num_edicts; i++)
+		{
+			ed = EDICT_NUM(i);
+			if (ed->free)
+				continue;
+			for (j = 0; j < pr_numstringfields; j++)
+				PR_ReferenceString (((int *)&ed->v)[pr_stringfields[j]]);
+		}
+
+		for (i = 0; i < pr_temps.num; i++)
+		{
+			if (pr_knownstrings[pr_temps.slots[i]].kind == PRSTR_TEMP)
+				PR_FreeSlot (pr_temps.slots[i]);
+		}
+
+	// promoted strings nothing refers to any more
+		for (i = j = 0; i < pr_promoted.num; i++)
+		{
+			if (pr_knownstrings[pr_promoted.slots[i]].kind != PRSTR_PROMOTED)
+				continue;	// kept by the engine
+			if (pr_knownstrings[pr_promoted.slots[i]].seen != pr_strscan)
+				PR_FreeSlot (pr_promoted.slots[i]);
+			else
+				pr_promoted.slots[j++] = pr_promoted.slots[i];
+		}
+		pr_promoted.num = j;
+	}
+
+	for (i = 0; i < pr_pendingfree.num; i++)
+		PR_FreeSlot (pr_pendingfree.slots[i]);
+	pr_pendingfree.num = 0;
+
+	pr_strstats.temppeak = q_max (pr_strstats.temppeak, pr_strstats.tempframe);
+	pr_strstats.tempbytespeak = q_max (pr_strstats.tempbytespeak, pr_strstats.tempbytesframe);
+	pr_strstats.tempframe = pr_strstats.tempbytesframe = 0;
+	pr_temps.num = 0;
+
+	PR_ResetTemps ();
+}
+
+/*
+============
+PR_KnownStringsMark / PR_KnownStringsRelease
+
+Forget the strings made since the mark, so that a rerun from saved state
+gets the same string numbers (pr_jitverify). Hunk memory isn't reclaimed.
+============
+*/
+int PR_KnownStringsMark (void)
+{
+	pr_strmark.active = true;
+	pr_strmark.numslots = pr_numknownstrings;
+	pr_strmark.numfree = pr_numfreeslots;
+	pr_strmark.numtemps = pr_temps.num;
+	pr_strmark.numpending = pr_pendingfree.num;
+	pr_strmark.tempcur = pr_tempcur;
+	pr_strmark.tempused = pr_tempcur->used;
+	pr_marklog.num = 0;
+	return pr_numknownstrings;
+}
+
+void PR_KnownStringsRelease (int mark)
+{
+	tempblock_t	*b, *next;
+	int		i;
+
+	if (!pr_strmark.active)
+		return;
+
+// in reverse, so slots taken from the free stack go back where they were
+	for (i = pr_marklog.num - 1; i >= 0; i--)
+	{
+		PR_ReleaseSlot (pr_marklog.slots[i]);
+		if (pr_marklog.slots[i] < pr_strmark.numslots)
+			pr_freeslots[pr_numfreeslots++] = pr_marklog.slots[i];
+	}
+	pr_numknownstrings = pr_strmark.numslots;
+	pr_temps.num = pr_strmark.numtemps;
+	pr_pendingfree.num = pr_strmark.numpending;
+
+	for (b = pr_strmark.tempcur->next; b; b = next)
+	{
+		next = b->next;
+		Mem_Free (b);
+	}
+	pr_strmark.tempcur->next = NULL;
+	pr_strmark.tempcur->used = pr_strmark.tempused;
+	pr_tempcur = pr_strmark.tempcur;
+	pr_tempgeneration++;
+
+	pr_strmark.active = false;
+}
+
+/*
+============
+PR_StringLeaks
+
+Prints the strzone'd strings that were never strunzone'd
+============
+*/
+static void PR_StringLeaks (int maxlist, qboolean developer)
+{
+	prstring_t	*str;
+	int		i, count, bytes, promoted;
+
+	for (i = count = bytes = promoted = 0; i < pr_numknownstrings; i++)
+	{
+		str = &pr_knownstrings[i];
+		if (str->kind == PRSTR_PROMOTED)
+			promoted++;
+		if (str->kind != PRSTR_ZONE)
+			continue;
+		if (count < maxlist)
+		{
+			if (developer)
+				Con_DPrintf ("  %i: \"%.40s\"\n", -1 - i, str->s);
+			else
+				Con_Printf ("  %i: \"%.40s\"\n", -1 - i, str->s);
+		}
+		count++;
+		bytes += str->len + 1;
+	}
+
+	if (developer)
+	{
+		if (count || promoted)
+			Con_DPrintf ("QC strings: %i zoned strings (%i bytes) never unzoned, %i temps held over\n", count, bytes, promoted);
+	}
+	else
+		Con_Printf ("%i zoned strings (%i bytes) live, %i temps held over\n", count, bytes, promoted);
+}
+
+/*
+============
+PR_ClearStrings
+
+Called by PR_LoadProgs before anything uses strings. Reports what the
+previous map leaked (pr_strings leaks lists them while it runs) and
+starts over.
+============
+*/
+void PR_ClearStrings (int stringssize)
+{
+	int		i;
+
+	if (pr_numknownstrings)
+		PR_StringLeaks (0, true);	// counts only, the strings were on the old hunk
+
+// Z_Malloc'd zone strings are the only memory that outlives the hunk
+	for (i = 0; i < pr_numknownstrings; i++)
+	{
+		if ((pr_knownstrings[i].kind == PRSTR_ZONE || pr_knownstrings[i].kind == PRSTR_PROMOTED) &&
+			pr_knownstrings[i].sizeclass < 0)
+			Z_Free ((void *)pr_knownstrings[i].s);
+	}
+
+	PR_ResetTemps ();
+	pr_temps.num = pr_promoted.num = pr_pendingfree.num = 0;
+	memset (pr_zonefree, 0, sizeof(pr_zonefree));
+	pr_zonechunk = NULL;
+	pr_zonechunkleft = 0;
+	pr_stringfieldsvalid = false;
+	pr_strmark.active = false;
+	memset (&pr_strstats, 0, sizeof(pr_strstats));
+
+	pr_stringssize = stringssize;
+	pr_numknownstrings = 0;
+	pr_numfreeslots = 0;
+	if (!pr_knownstrings)
+		PR_AllocStringSlots ();
+	for (i = 0; i <= pr_strhashmask; i++)
+		pr_strhash[i] = -1;
+	PR_SetEngineString("");
+}
+
+/*
+============
+PR_Strings_f
+
+pr_strings [leaks] : allocation statistics of the QC string heap
+============
+*/
+static void PR_Strings_f (void)
+{
+	int		i, kinds[PRSTR_ZONE + 1];
+
+	if (!progs)
+		return;
+
+	if (Cmd_Argc() > 1 && !strcmp (Cmd_Argv(1), "leaks"))
+	{
+		PR_StringLeaks (1000, false);
+		return;
+	}
+
+	memset (kinds, 0, sizeof(kinds));
+	for (i = 0; i < pr_numknownstrings; i++)
+		kinds[pr_knownstrings[i].kind]++;
+
+	Con_Printf ("slots      :");
+	for (i = 0; i <= PRSTR_ZONE; i++)
+		Con_Printf (" %i %s", kinds[i], pr_strkindnames[i]);
+	Con_Printf (" (%i allocated)\n", pr_maxknownstrings);
+	Con_Printf ("engine     : %i strings, %i lookups\n", pr_strstats.engine, pr_strstats.enginelookups);
+	Con_Printf ("temp       : %i (%i views), %.1f KB this map\n", pr_strstats.temps, pr_strstats.views, pr_strstats.tempbytes / 1024);
+	Con_Printf ("temp peak  : %i, %.1f KB in a frame\n", pr_strstats.temppeak, pr_strstats.tempbytespeak / 1024.0);
+	Con_Printf ("promoted   : %i this map, %i live\n", pr_strstats.promoted, pr_promoted.num);
+	Con_Printf ("zone       : %i live, %i bytes (%i strzone, %i strunzone)\n",
+		pr_strstats.zonelive, pr_strstats.zonebytes, pr_strstats.zoneallocs, pr_strstats.zonefrees);
+	Con_Printf ("hunk       : %i strings, %i bytes\n", pr_strstats.hunk, pr_strstats.hunkbytes);
+}
+
+/*
+============
+PR_InitStrings
+============
+*/
+void PR_InitStrings (void)
+{
+	pr_tempfirst.hdr.size = PRSTR_TEMPBLOCK;
+	Cmd_AddCommand ("pr_strings", PR_Strings_f);
+}
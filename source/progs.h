@@ -63,6 +63,8 @@ typedef struct edict_s
 extern	dprograms_t	*progs;
 extern	dfunction_t	*pr_functions;
 extern	dstatement_t	*pr_statements;
+extern	ddef_t		*pr_fielddefs;
+extern	ddef_t		*pr_globaldefs;
 extern	globalvars_t	*pr_global_struct;
 extern	float		*pr_globals;	/* same as pr_global_struct */
 
@@ -74,9 +76,87 @@ void PR_Init (void);
 void PR_ExecuteProgram (func_t fnum);
 void PR_LoadProgs (void);
 
+#define	OP_NUMOPS	(OP_BITOR + 1)
+
+// engine-private opcodes, only ever found in pr_decoded. The
+// superinstructions run their own statement and the next, which is left
+// untouched so that branches landing on it still work
+enum
+{
+	OPX_ADDRESS_STOREP = OP_NUMOPS,	// ADDRESS, STOREP_F/S/ENT/FLD/FNC through it
+	OPX_ADDRESS_STOREP_V,			// ADDRESS, STOREP_V through it
+	OPX_LOAD_IF,					// LOAD_F/S/ENT/FLD/FNC, IF on the result
+	OPX_LOAD_IFNOT,					// LOAD_F/S/ENT/FLD/FNC, IFNOT on the result
+	OPX_MUL_FV_ADD_V,				// MUL_FV, ADD_V of the product
+	OPX_MUL_VF_ADD_V,				// MUL_VF, ADD_V of the product
+	OPX_CALL_BUILTIN,				// CALLn of the builtin resolved at load time
+	OPX_NUMOPS
+};
+
+// statements decoded at load time by PR_DecodeStatements, one for each
+// dstatement_t so that statement numbers stay the same
+typedef struct prstatement_s
+{
+	const void	*handler;	// interpreter label, with computed goto
+	eval_t		*a, *b, *c;	// operands resolved to global pointers
+	int			op;
+	int			jump;		// IF/IFNOT/GOTO branch offset, OPX_CALL_BUILTIN function
+	void		(*builtin) (void);	// OPX_CALL_BUILTIN
+} prstatement_t;
+
+extern	prstatement_t	*pr_decoded;
+
+void PR_DecodeStatements (void);
+void PR_OptimizeStatements (void);
+void PR_Bench_f (void);
+
+#define	PR_RUNAWAY	400000	/* statements per PR_ExecuteProgram */
+
+// pr_prof.c
+extern	qboolean	pr_profiling;
+
+void PR_ProfInit (void);
+void PR_ProfLoad (void);
+void PR_ProfEnter (dfunction_t *f);
+void PR_ProfLeave (void);
+void PR_ProfTopLevel (void);
+
+// pr_jit.c
+typedef void (*prnative_t) (void);
+
+extern	qboolean	pr_jitactive;
+extern	int			pr_jitsteps;
+
+void PR_JitInit (void);
+void PR_JitReset (void);
+prnative_t PR_JitFunction (dfunction_t *f);
+qboolean PR_JitVerify (func_t fnum);
+
+// pr_strings.c
+extern	char		*pr_strings;
+extern	int			pr_tempgeneration;
+
+void PR_InitStrings (void);
+void PR_ClearStrings (int stringssize);
+void PR_StringsFrame (void);
 const char *PR_GetString (int num);
+const char *PR_GetStringLength (int num, int *len);
+const char *PR_GetKeptString (int num);
 int PR_SetEngineString (const char *s);
 int PR_AllocString (int bufferlength, char **ptr);
+int PR_TempString (int bufferlength, char **ptr);
+int PR_SetTempString (const char *s);
+int PR_NewTempString (int len, char **ptr);
+int PR_TempStringView (const char *s, int len);
+int PR_TempSubString (int num, int start, int len);
+int PR_ZoneString (const char *s);
+void PR_FreeZoneString (int num);
+qboolean PR_IsProgsString (int num);
+int PR_KnownStringsMark (void);
+void PR_KnownStringsRelease (int mark);
+
+const char *PR_GlobalString (int ofs);
+const char *PR_GlobalStringNoContents (int ofs);
 
 void PR_Profile_f (void);
 
@@ -139,7 +219,19 @@ FUNC_NORETURN void PR_RunError (const char *error, ...) FUNC_PRINTF(1,2);
 void ED_PrintEdicts (void);
 void ED_PrintNum (int ent);
 
+// offsets of optional fields the engine reads if the progs have them,
+// -1 if not. Resolved by PR_LoadProgs.
+typedef struct
+{
+	int		alpha;
+	int		gravity;
+} extfields_t;
+
+extern	extfields_t	pr_extfields;
+
+int ED_FindFieldOffset (const char *name);
 eval_t *GetEdictFieldValue(edict_t *ed, const char *field);
+#define	GetEdictFieldValueAt(ed, ofs)	((ofs) < 0 ? (eval_t *)NULL : (eval_t *)((int *)&(ed)->v + (ofs)))
 
 #endif	/* _QUAKE_PROGS_H */
 
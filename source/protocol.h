@@ -230,6 +230,13 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define svc_lockviewmodel		55
 #define svc_rumble				56 		// [short] low frequency [short] high frequency [short] duration (ms)
 
+// client-side movement prediction, only sent to clients that asked with "predict"
+#define	svc_movevars			57	// [float] gravity [float] entgravity [float] friction
+									// [float] edgefriction [float] stopspeed [float] maxspeed
+									// [float] accelerate [short3] mins [short3] maxs [byte] MVF_* flags
+#define	svc_moveack				58	// [long] last clc_moveseq applied [byte] movetype [byte] PMF_* flags
+									// [byte] waterlevel [float3] origin [float3] velocity
+
 
 //
 // client to server
@@ -239,6 +246,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define	clc_disconnect	2
 #define	clc_move		3		// [usercmd_t]
 #define	clc_stringcmd	4		// [string] message
+#define	clc_moveseq		5		// [long] sequence number of the clc_move that follows
 
 //
 // temp entity events
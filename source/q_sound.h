@@ -105,6 +105,7 @@ void S_UnblockSound (void);
 
 sfx_t *S_PrecacheSound (const char *sample);
 void S_TouchSound (const char *sample);
+void S_PrefetchSound (const char *sample);
 void S_ClearPrecache (void);
 void S_BeginPrecaching (void);
 void S_EndPrecaching (void);
@@ -182,7 +183,7 @@ extern	cvar_t		bgmvolume;
 void S_LocalSound (const char *name);
 sfxcache_t *S_LoadSound (sfx_t *s);
 
-wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength);
+wavinfo_t GetWavinfo (const char *name, const byte *wav, int wavlength);
 
 void SND_InitScaletable (void);
 
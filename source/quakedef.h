@@ -270,6 +270,9 @@ typedef struct
 	char	**argv;
 	void	*membase;
 	int	memsize;
+	int	memreserve;	// address space reserved at membase, committed
+				// as the hunk grows. 0 if membase is memsize
+				// bytes of ordinary memory.
 	int	numcpus;
 	int	errstate;
 } quakeparms_t;
@@ -282,10 +285,12 @@ typedef struct
 #include "cvar.h"
 
 #include "protocol.h"
+#include "pmove.h"
 #include "net.h"
 
 #include "cmd.h"
 #include "crc.h"
+#include "lz.h"
 
 #include "progs.h"
 #include "server.h"
@@ -423,6 +428,9 @@ typedef struct
 	int zombienum;
 } zombie_ai;
 
+#define MaxZombies 24
+extern zombie_ai zombie_list[MaxZombies];
+
 typedef struct
 {
 	vec3_t origin;
@@ -112,6 +112,11 @@ typedef struct client_s
 // client known data for deltas
 	int				old_points;
 	int				old_kills;
+
+// client-side movement prediction
+	qboolean		predict;			// send svc_movevars/svc_moveack
+	int				movesequence;		// last clc_moveseq received
+	movevars_t		movevars;			// last svc_movevars sent
 } client_t;
 
 
@@ -215,12 +220,14 @@ void SV_SetIdealPitch (void);
 void SV_AddUpdates (void);
 
 void SV_ClientThink (void);
+void SV_PlayerMoveVars (edict_t *ent, movevars_t *mv);
 void SV_AddClientToServer (struct qsocket_s	*ret);
 
 void SV_ClientPrintf (const char *fmt, ...) FUNC_PRINTF(1,2);
 void SV_BroadcastPrintf (const char *fmt, ...) FUNC_PRINTF(1,2);
 
 void SV_Physics (void);
+int ClipVelocity (vec3_t in, vec3_t normal, vec3_t out, float overbounce);
 
 qboolean SV_CheckBottom (edict_t *ent);
 qboolean SV_movestep (edict_t *ent, vec3_t move, qboolean relink);
@@ -234,6 +241,50 @@ void SV_RunClients (void);
 void SV_SaveSpawnparms ();
 void SV_SpawnServer (const char *server);
 
+qboolean SV_SaveGameBinary (const char *name, const char *comment);
+qboolean SV_IsBinarySave (const char *name);
+qboolean SV_LoadGameBinary (const char *name);
+
+void SV_CleanupEnts (void);
+
+void SV_InitReplay (void);
+void SV_RecordStop (void);
+void SV_RecordFrameBegin (void);
+void SV_RecordFrameEnd (void);
+void SV_RecordClientMove (void);
+void SV_RecordClientCommand (const char *text);
+void SV_RecordCommand (const char *text);
+
+// sv_mirror.c
+typedef struct
+{
+	byte	*free;
+	float	*solid;
+	float	*movetype;
+	float	*modelindex;
+	float	*effects;
+	vec3_t	*origin;
+	vec3_t	*extent;		// mins + maxs
+	vec3_t	*absmin;		// as of the last SV_LinkEdict
+	vec3_t	*absmax;
+	byte	*dirty;
+	int		*dirtylist;
+	int		numdirty;
+	int		maxedicts;
+} edmirror_t;
+
+extern	edmirror_t	sv_mirror;
+
+#define	SV_MIRRORFIELDS		(sizeof(entvars_t) / 4)
+extern	byte	sv_mirrorfield[SV_MIRRORFIELDS];	// 1 for field offsets that are mirrored
+#define	SV_MirrorField(ofs)	((unsigned)(ofs) < SV_MIRRORFIELDS && sv_mirrorfield[ofs])
+
+void SV_MirrorInit (void);
+void SV_MirrorSync (edict_t *ent);
+void SV_MirrorTouch (edict_t *ent);
+void SV_MirrorFlush (void);
+void SV_MirrorRebuild (void);
+
 void SV_MoveToOrigin (void);
 
 #endif	/* _QUAKE_SERVER_H */
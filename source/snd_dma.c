@@ -313,6 +313,25 @@ void S_TouchSound (const char *name)
 	Cache_Check (&sfx->cache);
 }
 
+/*
+==================
+S_PrefetchSound
+
+Starts reading a sound S_PrecacheSound is about to load
+==================
+*/
+void S_PrefetchSound (const char *name)
+{
+	sfx_t	*sfx;
+
+	if (!sound_started || nosound.value || !precache.value)
+		return;
+
+	sfx = S_FindName (name);
+	if (!Cache_Check (&sfx->cache))
+		COM_Prefetch (sfx->name);
+}
+
 /*
 ==================
 S_PrecacheSound
@@ -27,7 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 ResampleSfx
 ================
 */
-static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
+static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, const byte *data)
 {
 	int		outcount;
 	int		srcsample;
@@ -72,7 +72,7 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 			srcsample = samplefrac >> 8;
 			samplefrac += fracstep;
 			if (inwidth == 2)
-				sample = LittleShort ( ((short *)data)[srcsample] );
+				sample = LittleShort ( ((const short *)data)[srcsample] );
 			else
 				sample = (int)( (unsigned char)(data[srcsample]) - 128) << 8;
 			if (sc->width == 2)
@@ -93,12 +93,12 @@ S_LoadSound
 sfxcache_t *S_LoadSound (sfx_t *s)
 {
 	char	namebuffer[256];
-	byte	*data;
+	mappedfile_t	mf;
 	wavinfo_t	info;
 	int		len;
 	float	stepscale;
 	sfxcache_t	*sc;
-	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
+	memtag_t	oldtag;
 
 // see if still in memory
 	sc = (sfxcache_t *) Cache_Check (&s->cache);
@@ -113,24 +113,24 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 
 //	Con_Printf ("loading %s\n",namebuffer);
 
-	data = COM_LoadStackFile(namebuffer, stackbuf, sizeof(stackbuf), NULL);
-
-	if (!data)
+	if (!COM_MapFile(namebuffer, &mf, NULL))
 	{
 		Con_Printf ("Couldn't load %s\n", namebuffer);
 		return NULL;
 	}
 
-	info = GetWavinfo (s->name, data, com_filesize);
+	info = GetWavinfo (s->name, mf.data, mf.length);
 	if (info.channels != 1)
 	{
 		Con_Printf ("%s is a stereo sample\n",s->name);
+		COM_UnmapFile (&mf);
 		return NULL;
 	}
 
 	if (info.width != 1 && info.width != 2)
 	{
 		Con_Printf("%s is not 8 or 16 bit\n", s->name);
+		COM_UnmapFile (&mf);
 		return NULL;
 	}
 
@@ -144,12 +144,18 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 		if (strcmp(s->name, "sounds/null.wav")) {
 			Con_Printf("%s has zero samples\n", s->name);
 		}
+		COM_UnmapFile (&mf);
 		return NULL;
 	}
 
+	oldtag = Mem_SetTag (MEM_SOUNDS);
 	sc = (sfxcache_t *) Cache_Alloc ( &s->cache, len + sizeof(sfxcache_t), s->name);
+	Mem_SetTag (oldtag);
 	if (!sc)
+	{
+		COM_UnmapFile (&mf);
 		return NULL;
+	}
 
 	sc->length = info.samples;
 	sc->loopstart = info.loopstart;
@@ -157,7 +163,8 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	sc->width = info.width;
 	sc->stereo = info.channels;
 
-	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
+	ResampleSfx (s, sc->speed, sc->width, mf.data + info.dataofs);
+	COM_UnmapFile (&mf);
 
 	return sc;
 }
@@ -172,10 +179,10 @@ WAV loading
 ===============================================================================
 */
 
-static byte	*data_p;
-static byte	*iff_end;
-static byte	*last_chunk;
-static byte	*iff_data;
+static const byte	*data_p;
+static const byte	*iff_end;
+static const byte	*last_chunk;
+static const byte	*iff_data;
 static int	iff_chunk_len;
 
 static short GetLittleShort (void)
@@ -219,7 +226,7 @@ static void FindNextChunk (const char *name)
 		}
 		last_chunk = data_p + ((iff_chunk_len + 1) & ~1);
 		data_p -= 8;
-		if (!Q_strncmp((char *)data_p, name, 4))
+		if (!Q_strncmp((const char *)data_p, name, 4))
 			return;
 	}
 }
@@ -253,7 +260,7 @@ static void DumpChunks (void)
 GetWavinfo
 ============
 */
-wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
+wavinfo_t GetWavinfo (const char *name, const byte *wav, int wavlength)
 {
 	wavinfo_t	info;
 	int	i;
@@ -270,7 +277,7 @@ wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
 
 // find "RIFF" chunk
 	FindChunk("RIFF");
-	if (!(data_p && !Q_strncmp((char *)data_p + 8, "WAVE", 4)))
+	if (!(data_p && !Q_strncmp((const char *)data_p + 8, "WAVE", 4)))
 	{
 		Con_Printf("%s missing RIFF/WAVE chunks\n", name);
 		return info;
@@ -316,7 +323,7 @@ wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
 		FindNextChunk ("LIST");
 		if (data_p)
 		{
-			if (!strncmp((char *)data_p + 28, "mark", 4))
+			if (!strncmp((const char *)data_p + 28, "mark", 4))
 			{	// this is not a proper parse, but it works with cooledit...
 				data_p += 24;
 				i = GetLittleLong();	// samples in loop
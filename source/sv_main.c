@@ -86,6 +86,7 @@ void SV_Init (void)
 	extern	cvar_t	sv_idealpitchscale;
 	extern	cvar_t	sv_aim;
 	extern	cvar_t	sv_altnoclip; //johnfitz
+	extern	cvar_t	sv_savebinary;
 
 	sv.edicts = NULL; // ericw -- sv.edicts switched to use malloc()
 
@@ -104,9 +105,12 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_nostep);
 	Cvar_RegisterVariable (&sv_freezenonclients);
 	Cvar_RegisterVariable (&sv_altnoclip); //johnfitz
+	Cvar_RegisterVariable (&sv_savebinary);
 
 	Cmd_AddCommand ("sv_protocol", &SV_Protocol_f); //johnfitz
 
+	SV_InitReplay ();
+
 	for (i=0 ; i<MAX_MODELS ; i++)
 		sprintf (localmodels[i], "*%i", i);
 
@@ -568,21 +572,26 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 	pvs = SV_FatPVS (org, sv.worldmodel);
 
 // send over all entities (excpet the client) that touch the pvs
+// the tests that reject most of them only read sv_mirror
+	SV_MirrorFlush ();
 	ent = NEXT_EDICT(sv.edicts);
 	for (e=1 ; e<sv.num_edicts ; e++, ent = NEXT_EDICT(ent))
 	{
 		
-		if (ent->v.effects == EF_NODRAW) //sB adding back NODRAW for limbs
+		if (sv_mirror.effects[e] == EF_NODRAW) //sB adding back NODRAW for limbs
 			continue;
 
 		if (ent != clent)	// clent is ALLWAYS sent
 		{
 			// ignore ents without visible models
-			if (!ent->v.modelindex || !PR_GetString(ent->v.model)[0])
+			if (!sv_mirror.modelindex[e])
 				continue;
 
 			//johnfitz -- don't send model>255 entities if protocol is 15
-			if (sv.protocol == PROTOCOL_NETQUAKE && (int)ent->v.modelindex & 0xFF00)
+			if (sv.protocol == PROTOCOL_NETQUAKE && (int)sv_mirror.modelindex[e] & 0xFF00)
+				continue;
+
+			if (!PR_GetString(ent->v.model)[0])
 				continue;
 
 			// ignore if not touching a PV leaf
@@ -662,7 +671,7 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 		{
 			// TODO: find a cleaner place to put this code
 			eval_t	*val;
-			val = GetEdictFieldValue(ent, "alpha");
+			val = GetEdictFieldValueAt(ent, pr_extfields.alpha);
 			if (val)
 				ent->alpha = ENTALPHA_ENCODE(val->_float);
 		}
@@ -774,10 +783,15 @@ void SV_CleanupEnts (void)
 	int		e;
 	edict_t	*ent;
 
-	ent = NEXT_EDICT(sv.edicts);
-	for (e=1 ; e<sv.num_edicts ; e++, ent = NEXT_EDICT(ent))
+	SV_MirrorFlush ();
+	for (e=1 ; e<sv.num_edicts ; e++)
 	{
-		ent->v.effects = (int)ent->v.effects & ~EF_MUZZLEFLASH;
+		if (sv_mirror.effects[e] != (float)((int)sv_mirror.effects[e] & ~EF_MUZZLEFLASH))
+		{
+			ent = EDICT_NUM(e);
+			ent->v.effects = (int)ent->v.effects & ~EF_MUZZLEFLASH;
+			SV_MirrorSync (ent);
+		}
 	}
 }
 
@@ -1009,6 +1023,60 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg)
 	//johnfitz
 }
 
+/*
+=======================
+SV_WriteMoveAck
+
+Tells a predicting client which of its moves this update includes and where
+exactly they left the player. Movement tunables go out reliably whenever
+they change.
+=======================
+*/
+static void SV_WriteMoveAck (client_t *client, sizebuf_t *msg)
+{
+	edict_t		*ent = client->edict;
+	movevars_t	mv;
+	int			i, flags;
+
+	SV_PlayerMoveVars (ent, &mv);
+	if (memcmp (&mv, &client->movevars, sizeof(mv)))
+	{
+		client->movevars = mv;
+
+		MSG_WriteByte (&client->message, svc_movevars);
+		MSG_WriteFloat (&client->message, mv.gravity);
+		MSG_WriteFloat (&client->message, mv.entgravity);
+		MSG_WriteFloat (&client->message, mv.friction);
+		MSG_WriteFloat (&client->message, mv.edgefriction);
+		MSG_WriteFloat (&client->message, mv.stopspeed);
+		MSG_WriteFloat (&client->message, mv.maxspeed);
+		MSG_WriteFloat (&client->message, mv.accelerate);
+		for (i = 0; i < 3; i++)
+			MSG_WriteShort (&client->message, (int)mv.mins[i]);
+		for (i = 0; i < 3; i++)
+			MSG_WriteShort (&client->message, (int)mv.maxs[i]);
+		MSG_WriteByte (&client->message, mv.flags);
+	}
+
+	flags = 0;
+	if ((int)ent->v.flags & FL_ONGROUND)
+		flags |= PMF_ONGROUND;
+	if ((int)ent->v.flags & FL_WATERJUMP)
+		flags |= PMF_WATERJUMP;
+	if (sv.time < ent->v.teleport_time)
+		flags |= PMF_NOBACKMOVE;
+
+	MSG_WriteByte (msg, svc_moveack);
+	MSG_WriteLong (msg, client->movesequence);
+	MSG_WriteByte (msg, (int)ent->v.movetype);
+	MSG_WriteByte (msg, flags);
+	MSG_WriteByte (msg, (int)ent->v.waterlevel);
+	for (i = 0; i < 3; i++)
+		MSG_WriteFloat (msg, ent->v.origin[i]);
+	for (i = 0; i < 3; i++)
+		MSG_WriteFloat (msg, ent->v.velocity[i]);
+}
+
 /*
 =======================
 SV_SendClientDatagram
@@ -1034,6 +1102,9 @@ qboolean SV_SendClientDatagram (client_t *client)
 // add the client specific data to the datagram
 	SV_WriteClientdataToMessage (client->edict, &msg);
 
+	if (client->predict)
+		SV_WriteMoveAck (client, &msg);
+
 	SV_WriteEntitiesToClient (client->edict, &msg);
 
 // copy the server datagram if there is space
@@ -1418,6 +1489,8 @@ void SV_SpawnServer (const char *server)
 	static char	dummy[8] = { 0,0,0,0,0,0,0,0 };
 	edict_t		*ent;
 	int			i;
+	memtag_t	oldtag;
+	double		start, worldtime;
 
 	// let's not have any servers with no name
 	if (hostname.string[0] == 0)
@@ -1427,6 +1500,8 @@ void SV_SpawnServer (const char *server)
 	Con_DPrintf ("SpawnServer: %s\n",server);
 	svs.changelevel_issued = false;		// now safe to issue another
 
+	SV_RecordStop ();	// the recording can't follow a level change
+
 //
 // tell all connected clients that we are going to a new level
 //
@@ -1454,6 +1529,10 @@ void SV_SpawnServer (const char *server)
 	//memset (&sv, 0, sizeof(sv));
 	Host_ClearMemory ();
 
+	// read the map while the progs load
+	start = Sys_PreciseTime ();
+	COM_Prefetch (va("maps/%s.bsp", server));
+
 	q_strlcpy (sv.name, server, sizeof(sv.name));
 
 	sv.protocol = sv_protocol; // johnfitz
@@ -1472,7 +1551,7 @@ void SV_SpawnServer (const char *server)
 // allocate server memory
 	/* Host_ClearMemory() called above already cleared the whole sv structure */
 	sv.max_edicts = CLAMP (MIN_EDICTS,(int)max_edicts.value,MAX_EDICTS); //johnfitz -- max_edicts cvar
-	sv.edicts = (edict_t *) malloc (sv.max_edicts*pr_edict_size); // ericw -- sv.edicts switched to use malloc()
+	sv.edicts = (edict_t *) Mem_Alloc (MEM_QC, sv.max_edicts*pr_edict_size); // ericw -- sv.edicts switched to use malloc()
 
 	sv.datagram.maxsize = sizeof(sv.datagram_buf);
 	sv.datagram.cursize = 0;
@@ -1494,6 +1573,7 @@ void SV_SpawnServer (const char *server)
 		ent = EDICT_NUM(i+1);
 		svs.clients[i].edict = ent;
 	}
+	SV_MirrorInit ();
 
 	sv.state = ss_loading;
 	sv.paused = false;
@@ -1502,7 +1582,10 @@ void SV_SpawnServer (const char *server)
 
 	q_strlcpy (sv.name, server, sizeof(sv.name));
 	q_snprintf (sv.modelname, sizeof(sv.modelname), "maps/%s.bsp", server);
+	worldtime = Sys_PreciseTime ();
 	sv.worldmodel = Mod_ForName (sv.modelname, false);
+	COM_PrefetchFlush ();
+	worldtime = Sys_PreciseTime () - worldtime;
 	if (!sv.worldmodel)
 	{
 		Con_Printf ("Couldn't spawn server %s\n", sv.modelname);
@@ -1510,6 +1593,7 @@ void SV_SpawnServer (const char *server)
 		return;
 	}
 	sv.models[1] = sv.worldmodel;
+	oldtag = Mem_SetTag (MEM_QC);
 
 //
 // clear world interaction links
@@ -1535,6 +1619,7 @@ void SV_SpawnServer (const char *server)
 	ent->v.modelindex = 1;		// world model
 	ent->v.solid = SOLID_BSP;
 	ent->v.movetype = MOVETYPE_PUSH;
+	SV_MirrorSync (ent);
 
 	if (coop.value)
 		pr_global_struct->coop = coop.value;
@@ -1573,33 +1658,45 @@ void SV_SpawnServer (const char *server)
 
 	Load_Waypoint ();
 
-	Con_DPrintf ("Server spawned.\n");
+	Mem_SetTag (oldtag);
+	Con_DPrintf ("Server spawned in %.1f ms, %.1f ms of it loading %s\n",
+		(Sys_PreciseTime () - start) * 1000, worldtime * 1000, sv.modelname);
 }
 
 
 //ZOMBIE AI THINGS BELOVE THIS!!!
 #define W_MAX_TEMPSTRING 2048
 char	*w_string_temp;
+
+// the waypoint file is mapped and read from memory, rather than with a
+// Sys_FileRead for each character
+static mappedfile_t	w_file;
+static int			w_filepos;
+
 int W_fopen (void)
 {
-	int h = 0;
-
-	Sys_FileOpenRead (va("%s/maps/%s.way",com_gamedir, sv.name), &h);
-	return h;
+	w_filepos = 0;
+	return COM_MapOSFile (va("%s/maps/%s.way",com_gamedir, sv.name), &w_file) ? 0 : -1;
 }
 
 int W_fopenbeta(void)
 {
-	int h = 0;
-
-	Sys_FileOpenRead (va("%s/data/%s",com_gamedir, sv.name), &h);
-	return h;
+	w_filepos = 0;
+	return COM_MapOSFile (va("%s/data/%s",com_gamedir, sv.name), &w_file) ? 0 : -1;
 }
 
 
 void W_fclose (int h)
 {
-	Sys_FileClose(h);
+	COM_UnmapFile (&w_file);
+}
+
+static int W_getc (char *c)
+{
+	if (w_filepos >= w_file.length)
+		return 0;
+	*c = w_file.data[w_filepos++];
+	return 1;
 }
 
 char *W_fgets (int h)
@@ -1609,10 +1706,10 @@ char *W_fgets (int h)
 	int		count;
 	char	buffer;
 
-	count = Sys_FileRead(h, &buffer, 1);
+	count = W_getc(&buffer);
 	if (count && buffer == '\r')	// carriage return
 	{
-		count = Sys_FileRead(h, &buffer, 1);	// skip
+		count = W_getc(&buffer);	// skip
 	}
 	if (!count)	// EndOfFile
 	{
@@ -1628,10 +1725,10 @@ char *W_fgets (int h)
 		}
 
 		// read next character
-		count = Sys_FileRead(h, &buffer, 1);
+		count = W_getc(&buffer);
 		if (count && buffer == '\r')	// carriage return
 		{
-			count = Sys_FileRead(h, &buffer, 1);	// skip
+			count = W_getc(&buffer);	// skip
 		}
 	};
 	w_string_temp[i] = 0;
@@ -0,0 +1,205 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_mirror.c -- hot edict fields kept in arrays of their own
+//
+// An edict_t is several hundred bytes, most of it link and baseline state
+// and QC fields that a scan over all edicts never looks at. The fields
+// those scans test are copied here, one array per field, so that a scan
+// reads a few packed arrays and only touches the edicts it keeps.
+//
+// The copies are kept up to date by:
+//	SV_MirrorSync	after the engine writes an edict (linking, freeing,
+//					allocating, parsing, running its physics)
+//	SV_MirrorTouch	before QC stores to a mirrored field; OP_ADDRESS does
+//					this, the store itself follows, so the edict goes on a
+//					dirty list that SV_MirrorFlush copies at the next scan
+
+#include "quakedef.h"
+
+edmirror_t	sv_mirror;
+
+byte	sv_mirrorfield[SV_MIRRORFIELDS];
+
+static int	sv_mirrorsize;		// number of edicts the arrays hold
+
+#define	FIELD(f,n)	{(int)(offsetof (entvars_t, f) / 4), n}
+
+static const struct
+{
+	int		ofs, count;
+} sv_mirrored[] =
+{
+	FIELD (origin, 3),
+	FIELD (mins, 3),
+	FIELD (maxs, 3),
+	FIELD (absmin, 3),
+	FIELD (absmax, 3),
+	FIELD (solid, 1),
+	FIELD (movetype, 1),
+	FIELD (modelindex, 1),
+	FIELD (effects, 1)
+};
+
+#define	DIRTY_NONE		0
+#define	DIRTY_LISTED	1	// on the dirty list, already up to date again
+#define	DIRTY_STALE		2	// on the dirty list, needs copying
+
+/*
+===============
+SV_MirrorInit
+
+Called by SV_SpawnServer once the client edicts are cleared
+===============
+*/
+void SV_MirrorInit (void)
+{
+	byte	*p;
+	int		i, j, n;
+
+	for (i = 0; i < (int)(sizeof(sv_mirrored) / sizeof(sv_mirrored[0])); i++)
+	{
+		for (j = 0; j < sv_mirrored[i].count; j++)
+			sv_mirrorfield[sv_mirrored[i].ofs + j] = 1;
+	}
+
+	n = sv.max_edicts;
+	if (n > sv_mirrorsize)
+	{
+		Mem_Free (sv_mirror.solid);
+		p = (byte *) Mem_Alloc (MEM_QC, n * (2 + 4 * sizeof(float) + 4 * sizeof(vec3_t) + sizeof(int)));
+		if (!p)
+			Sys_Error ("SV_MirrorInit: couldn't allocate %i edicts", n);
+		sv_mirrorsize = n;
+
+	// the float arrays go first so that they stay aligned
+		sv_mirror.solid = (float *)p;		p += n * sizeof(float);
+		sv_mirror.movetype = (float *)p;	p += n * sizeof(float);
+		sv_mirror.modelindex = (float *)p;	p += n * sizeof(float);
+		sv_mirror.effects = (float *)p;		p += n * sizeof(float);
+		sv_mirror.origin = (vec3_t *)p;		p += n * sizeof(vec3_t);
+		sv_mirror.extent = (vec3_t *)p;		p += n * sizeof(vec3_t);
+		sv_mirror.absmin = (vec3_t *)p;		p += n * sizeof(vec3_t);
+		sv_mirror.absmax = (vec3_t *)p;		p += n * sizeof(vec3_t);
+		sv_mirror.dirtylist = (int *)p;		p += n * sizeof(int);
+		sv_mirror.free = p;					p += n;
+		sv_mirror.dirty = p;
+	}
+	sv_mirror.maxedicts = n;
+	sv_mirror.numdirty = 0;
+	memset (sv_mirror.dirty, DIRTY_NONE, n);
+	SV_MirrorRebuild ();
+}
+
+/*
+===============
+SV_MirrorSync
+
+Copies the mirrored fields of ent now
+===============
+*/
+void SV_MirrorSync (edict_t *ent)
+{
+	int		e = ((byte *)ent - (byte *)sv.edicts) / pr_edict_size;
+	int		j;
+
+	if ((unsigned)e >= (unsigned)sv_mirror.maxedicts)
+		return;
+
+	if (sv_mirror.dirty[e] == DIRTY_STALE)
+		sv_mirror.dirty[e] = DIRTY_LISTED;
+
+	sv_mirror.free[e] = ent->free;
+	sv_mirror.solid[e] = ent->v.solid;
+	sv_mirror.movetype[e] = ent->v.movetype;
+	sv_mirror.modelindex[e] = ent->v.modelindex;
+	sv_mirror.effects[e] = ent->v.effects;
+	for (j = 0; j < 3; j++)
+	{
+		sv_mirror.origin[e][j] = ent->v.origin[j];
+		sv_mirror.extent[e][j] = ent->v.mins[j] + ent->v.maxs[j];
+		sv_mirror.absmin[e][j] = ent->v.absmin[j];
+		sv_mirror.absmax[e][j] = ent->v.absmax[j];
+	}
+}
+
+/*
+===============
+SV_MirrorTouch
+
+ent is about to have a mirrored field changed behind the engine's back
+===============
+*/
+void SV_MirrorTouch (edict_t *ent)
+{
+	int		e = ((byte *)ent - (byte *)sv.edicts) / pr_edict_size;
+
+	if ((unsigned)e >= (unsigned)sv_mirror.maxedicts)
+		return;
+
+	switch (sv_mirror.dirty[e])
+	{
+	case DIRTY_NONE:
+		sv_mirror.dirtylist[sv_mirror.numdirty++] = e;
+		break;
+	case DIRTY_STALE:
+		return;
+	}
+	sv_mirror.dirty[e] = DIRTY_STALE;
+}
+
+/*
+===============
+SV_MirrorFlush
+
+Brings the touched edicts up to date, before a scan reads the arrays
+===============
+*/
+void SV_MirrorFlush (void)
+{
+	int		i, e;
+
+	for (i = 0; i < sv_mirror.numdirty; i++)
+	{
+		e = sv_mirror.dirtylist[i];
+		if (sv_mirror.dirty[e] == DIRTY_STALE)
+			SV_MirrorSync (EDICT_NUM(e));
+		sv_mirror.dirty[e] = DIRTY_NONE;
+	}
+	sv_mirror.numdirty = 0;
+}
+
+/*
+===============
+SV_MirrorRebuild
+
+Copies every edict, after a savegame has been read straight into them
+===============
+*/
+void SV_MirrorRebuild (void)
+{
+	int		e;
+
+	SV_MirrorFlush ();
+	for (e = 0; e < sv.num_edicts; e++)
+		SV_MirrorSync (EDICT_NUM(e));
+	for ( ; e < sv_mirror.maxedicts; e++)
+		sv_mirror.free[e] = true;
+}
@@ -216,151 +216,135 @@ int ClipVelocity (vec3_t in, vec3_t normal, vec3_t out, float overbounce)
 
 
 /*
-============
-SV_FlyMove
-
-The basic solid body movement clip that slides along multiple planes
-Returns the clipflags if the velocity was modified (hit something solid)
-1 = floor
-2 = wall / step
-4 = dead stop
-If steptrace is not NULL, the trace of any vertical wall hit will be stored
-============
-*/
-#define	MAX_CLIP_PLANES	5
-int SV_FlyMove (edict_t *ent, float time, trace_t *steptrace)
-{
-	int			bumpcount, numbumps;
-	vec3_t		dir;
-	float		d;
-	int			numplanes;
-	vec3_t		planes[MAX_CLIP_PLANES];
-	vec3_t		primal_velocity, original_velocity, new_velocity;
-	int			i, j;
-	trace_t		trace;
-	vec3_t		end;
-	float		time_left;
-	int			blocked;
-
-	numbumps = 4;
+===============================================================================
 
-	blocked = 0;
-	VectorCopy (ent->v.velocity, original_velocity);
-	VectorCopy (ent->v.velocity, primal_velocity);
-	numplanes = 0;
+EDICT MOVES
 
-	time_left = time;
+Players, and monsters that walk by velocity, slide and step with the pmove.c
+code. The trace callback notes what each move runs into, so the ground entity
+can be set and the impacts run once the move is done.
 
-	for (bumpcount=0 ; bumpcount<numbumps ; bumpcount++)
-	{
-		if (!ent->v.velocity[0] && !ent->v.velocity[1] && !ent->v.velocity[2])
-			break;
+===============================================================================
+*/
 
-		for (i=0 ; i<3 ; i++)
-			end[i] = ent->v.origin[i] + time_left * ent->v.velocity[i];
+#define	MAX_MOVETOUCHED	16
 
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_NOMONSTERS, ent);//Editted by blubs, we do want to ignore monsters in the trace
+static struct
+{
+	edict_t		*ent;		// being moved
+	edict_t		*ground;	// hit by the last floor trace
+	edict_t		*touched[MAX_MOVETOUCHED];
+	int			numtouched;
+} sv_move;
 
-		if (trace.allsolid)
-		{	// entity is trapped in another solid
-			VectorCopy (vec3_origin, ent->v.velocity);
-			return 3;
-		}
+/*
+==================
+SV_MoveTrace
 
-		if (trace.fraction > 0)
-		{	// actually covered some distance
-			VectorCopy (trace.endpos, ent->v.origin);
-			VectorCopy (ent->v.velocity, original_velocity);
-			numplanes = 0;
-		}
+pmove trace callback for SV_BeginMove
+==================
+*/
+static void SV_MoveTrace (const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, pmtrace_t *pmtrace)
+{
+	trace_t	trace;
+	int		i;
 
-		if (trace.fraction == 1)
-			 break;		// moved the entire distance
+	trace = SV_Move ((float *)start, (float *)mins, (float *)maxs, (float *)end, MOVE_NOMONSTERS, sv_move.ent);//Editted by blubs, we do want to ignore monsters in the trace
 
-		if (!trace.ent)
-			Sys_Error ("SV_FlyMove: !trace.ent");
+	pmtrace->allsolid = trace.allsolid;
+	pmtrace->startsolid = trace.startsolid;
+	pmtrace->fraction = trace.fraction;
+	VectorCopy (trace.endpos, pmtrace->endpos);
+	VectorCopy (trace.plane.normal, pmtrace->normal);
 
-		if (trace.plane.normal[2] > 0.7)
-		{
-			blocked |= 1;		// floor
-			if (trace.ent->v.solid == SOLID_BSP)
-			{
-				ent->v.flags =	(int)ent->v.flags | FL_ONGROUND;
-				ent->v.groundentity = EDICT_TO_PROG(trace.ent);
-			}
-		}
-		if (!trace.plane.normal[2])
-		{
-			blocked |= 2;		// step
-			if (steptrace)
-				*steptrace = trace;	// save for player extrafriction
-		}
+	if (!trace.ent || trace.allsolid || trace.fraction == 1)
+		return;
+	if (trace.plane.normal[2] > 0.7)
+		sv_move.ground = trace.ent;
+	for (i = 0; i < sv_move.numtouched; i++)
+	{
+		if (sv_move.touched[i] == trace.ent)
+			return;
+	}
+	if (sv_move.numtouched < MAX_MOVETOUCHED)
+		sv_move.touched[sv_move.numtouched++] = trace.ent;
+}
 
-//
-// run the impact function
-//
-		SV_Impact (ent, trace.ent);
-		if (ent->free)
-			break;		// removed by the impact function
+static int SV_MovePointContents (const vec3_t p)
+{
+	return SV_PointContents ((float *)p);
+}
 
+/*
+==================
+SV_BeginMove
 
-		time_left -= time_left * trace.fraction;
+Sets up pm to move ent
+==================
+*/
+static void SV_BeginMove (edict_t *ent, pmove_t *pm, movevars_t *mv)
+{
+	sv_move.ent = ent;
+	sv_move.ground = NULL;
+	sv_move.numtouched = 0;
+
+	SV_PlayerMoveVars (ent, mv);
+
+	memset (pm, 0, sizeof(*pm));
+	VectorCopy (ent->v.origin, pm->origin);
+	VectorCopy (ent->v.velocity, pm->velocity);
+	if ((int)ent->v.flags & FL_ONGROUND)
+		pm->flags |= PMF_ONGROUND;
+	if ((int)ent->v.flags & FL_WATERJUMP)
+		pm->flags |= PMF_WATERJUMP;
+	pm->waterlevel = ent->v.waterlevel;
+	pm->watertype = ent->v.watertype;
+	VectorCopy (ent->v.v_angle, pm->v_angle);
+	VectorCopy (ent->v.angles, pm->angles);
+	pm->movetype = ent->v.movetype;
+	pm->viewheight = ent->v.view_ofs[2];
+	pm->frametime = host_frametime;
+	pm->movevars = mv;
+	pm->trace = SV_MoveTrace;
+	pm->pointcontents = SV_MovePointContents;
+}
 
-	// cliped to another plane
-		if (numplanes >= MAX_CLIP_PLANES)
-		{	// this shouldn't really happen
-			VectorCopy (vec3_origin, ent->v.velocity);
-			return 3;
-		}
+/*
+==================
+SV_FinishMove
 
-		VectorCopy (trace.plane.normal, planes[numplanes]);
-		numplanes++;
+Copies the move back into ent and runs the impacts. Only bsp models count
+as ground.
+==================
+*/
+static void SV_FinishMove (edict_t *ent, pmove_t *pm)
+{
+	edict_t	*touched[MAX_MOVETOUCHED];
+	int		i, numtouched;
 
-//
-// modify original_velocity so it parallels all of the clip planes
-//
-		for (i=0 ; i<numplanes ; i++)
-		{
-			ClipVelocity (original_velocity, planes[i], new_velocity, 1);
-			for (j=0 ; j<numplanes ; j++)
-				if (j != i)
-				{
-					if (DotProduct (new_velocity, planes[j]) < 0)
-						break;	// not ok
-				}
-			if (j == numplanes)
-				break;
-		}
+	VectorCopy (pm->origin, ent->v.origin);
+	VectorCopy (pm->velocity, ent->v.velocity);
+	ent->v.waterlevel = pm->waterlevel;
+	ent->v.watertype = pm->watertype;
 
-		if (i != numplanes)
-		{	// go along this plane
-			VectorCopy (new_velocity, ent->v.velocity);
-		}
-		else
-		{	// go along the crease
-			if (numplanes != 2)
-			{
-//				Con_Printf ("clip velocity, numplanes == %i\n",numplanes);
-				VectorCopy (vec3_origin, ent->v.velocity);
-				return 7;
-			}
-			CrossProduct (planes[0], planes[1], dir);
-			d = DotProduct (dir, ent->v.velocity);
-			VectorScale (dir, d, ent->v.velocity);
-		}
-
-//
-// if original velocity is against the original velocity, stop dead
-// to avoid tiny occilations in sloping corners
-//
-		if (DotProduct (ent->v.velocity, primal_velocity) <= 0)
+	if (!(pm->flags & PMF_ONGROUND))
+		ent->v.flags = (int)ent->v.flags & ~FL_ONGROUND;
+	else if (sv_move.ground)
+	{
+		if (sv_move.ground->v.solid == SOLID_BSP)
 		{
-			VectorCopy (vec3_origin, ent->v.velocity);
-			return blocked;
+			ent->v.flags = (int)ent->v.flags | FL_ONGROUND;
+			ent->v.groundentity = EDICT_TO_PROG(sv_move.ground);
 		}
+		else
+			ent->v.flags = (int)ent->v.flags & ~FL_ONGROUND;
 	}
 
-	return blocked;
+// the touch functions can move other things
+	numtouched = sv_move.numtouched;
+	memcpy (touched, sv_move.touched, numtouched * sizeof(edict_t *));
+	for (i = 0; i < numtouched && !ent->free; i++)
+		SV_Impact (ent, touched[i]);
 }
 
 
@@ -375,7 +359,7 @@ void SV_AddGravity (edict_t *ent)
 	float	ent_gravity;
 	eval_t	*val;
 
-	val = GetEdictFieldValue(ent, "gravity");
+	val = GetEdictFieldValueAt(ent, pr_extfields.gravity);
 	if (val && val->_float)
 		ent_gravity = val->_float;
 	else
@@ -546,8 +530,10 @@ edict_t * SV_PushMove (edict_t *pusher, float movetime) //sB modified to match d
 
 		// try moving the contacted entity
 		pusher->v.solid = SOLID_NOT;
+		SV_MirrorSync (pusher);
 		SV_PushEntity (check, move, vec3_origin);
 		pusher->v.solid = oldsolid;
+		SV_MirrorSync (pusher);
 
 	// if it is still inside the pusher, block
 		block = SV_TestEntityPosition (check);
@@ -559,6 +545,7 @@ edict_t * SV_PushMove (edict_t *pusher, float movetime) //sB modified to match d
 			{	// corpse
 				check->v.mins[0] = check->v.mins[1] = 0;
 				VectorCopy (check->v.mins, check->v.maxs);
+				SV_MirrorSync (check);
 				continue;
 			}
 
@@ -690,8 +677,10 @@ edict_t * SV_PushRotate (edict_t *pusher, float movetime)
 
 		// try moving the contacted entity
 		pusher->v.solid = SOLID_NOT;
+		SV_MirrorSync (pusher);
 		SV_PushEntity (check, move, amove);
 		pusher->v.solid = oldsolid;
+		SV_MirrorSync (pusher);
 
 
 		// if it is still inside the pusher, block
@@ -708,6 +697,7 @@ edict_t * SV_PushRotate (edict_t *pusher, float movetime)
 				// corpse
 				check->v.mins[0] = check->v.mins[1] = 0;
 				VectorCopy (check->v.mins, check->v.maxs);
+				SV_MirrorSync (check);
 				continue;
 			}
 
@@ -847,232 +837,6 @@ void SV_CheckStuck (edict_t *ent)
 }
 
 
-/*
-=============
-SV_CheckWater
-=============
-*/
-qboolean SV_CheckWater (edict_t *ent)
-{
-	vec3_t	point;
-	int		cont;
-
-	point[0] = ent->v.origin[0];
-	point[1] = ent->v.origin[1];
-	point[2] = ent->v.origin[2] + ent->v.mins[2] + 1;
-
-	ent->v.waterlevel = 0;
-	ent->v.watertype = CONTENTS_EMPTY;
-	cont = SV_PointContents (point);
-	if (cont <= CONTENTS_WATER)
-	{
-		ent->v.watertype = cont;
-		ent->v.waterlevel = 1;
-		point[2] = ent->v.origin[2] + (ent->v.mins[2] + ent->v.maxs[2])*0.5;
-		cont = SV_PointContents (point);
-		if (cont <= CONTENTS_WATER)
-		{
-			ent->v.waterlevel = 2;
-			point[2] = ent->v.origin[2] + ent->v.view_ofs[2];
-			cont = SV_PointContents (point);
-			if (cont <= CONTENTS_WATER)
-				ent->v.waterlevel = 3;
-		}
-	}
-
-	return ent->v.waterlevel > 1;
-}
-
-/*
-============
-SV_WallFriction
-
-============
-*/
-void SV_WallFriction (edict_t *ent, trace_t *trace)
-{
-	vec3_t		forward, right, up;
-	float		d, i;
-	vec3_t		into, side;
-
-	AngleVectors (ent->v.v_angle, forward, right, up);
-	d = DotProduct (trace->plane.normal, forward);
-
-	d += 0.5;
-	if (d >= 0)
-		return;
-
-// cut the tangential velocity
-	i = DotProduct (trace->plane.normal, ent->v.velocity);
-	VectorScale (trace->plane.normal, i, into);
-	VectorSubtract (ent->v.velocity, into, side);
-
-	ent->v.velocity[0] = side[0] * (1 + d);
-	ent->v.velocity[1] = side[1] * (1 + d);
-}
-
-/*
-=====================
-SV_TryUnstick
-
-Player has come to a dead stop, possibly due to the problem with limited
-float precision at some angle joins in the BSP hull.
-
-Try fixing by pushing one pixel in each direction.
-
-This is a hack, but in the interest of good gameplay...
-======================
-*/
-int SV_TryUnstick (edict_t *ent, vec3_t oldvel)
-{
-	int		i;
-	vec3_t	oldorg;
-	vec3_t	dir;
-	int		clip;
-	trace_t	steptrace;
-
-	VectorCopy (ent->v.origin, oldorg);
-	VectorCopy (vec3_origin, dir);
-
-	for (i=0 ; i<8 ; i++)
-	{
-// try pushing a little in an axial direction
-		switch (i)
-		{
-			case 0:	dir[0] = 2; dir[1] = 0; break;
-			case 1:	dir[0] = 0; dir[1] = 2; break;
-			case 2:	dir[0] = -2; dir[1] = 0; break;
-			case 3:	dir[0] = 0; dir[1] = -2; break;
-			case 4:	dir[0] = 2; dir[1] = 2; break;
-			case 5:	dir[0] = -2; dir[1] = 2; break;
-			case 6:	dir[0] = 2; dir[1] = -2; break;
-			case 7:	dir[0] = -2; dir[1] = -2; break;
-		}
-
-		SV_PushEntity (ent, dir, vec3_origin);
-
-// retry the original move
-		ent->v.velocity[0] = oldvel[0];
-		ent->v. velocity[1] = oldvel[1];
-		ent->v. velocity[2] = 0;
-		clip = SV_FlyMove (ent, 0.1, &steptrace);
-
-		if ( fabs(oldorg[1] - ent->v.origin[1]) > 4
-		|| fabs(oldorg[0] - ent->v.origin[0]) > 4 )
-		{
-//Con_DPrintf ("unstuck!\n");
-			return clip;
-		}
-
-// go back to the original pos and try again
-		VectorCopy (oldorg, ent->v.origin);
-	}
-
-	VectorCopy (vec3_origin, ent->v.velocity);
-	return 7;		// still not moving
-}
-
-/*
-=====================
-SV_WalkMove
-
-Only used by players
-======================
-*/
-#define	STEPSIZE	18
-void SV_WalkMove (edict_t *ent)
-{
-	vec3_t		upmove, downmove;
-	vec3_t		oldorg, oldvel;
-	vec3_t		nosteporg, nostepvel;
-	int			clip;
-	int			oldonground;
-	trace_t		steptrace, downtrace;
-
-//
-// do a regular slide move unless it looks like you ran into a step
-//
-	oldonground = (int)ent->v.flags & FL_ONGROUND;
-	ent->v.flags = (int)ent->v.flags & ~FL_ONGROUND;
-
-	VectorCopy (ent->v.origin, oldorg);
-	VectorCopy (ent->v.velocity, oldvel);
-
-	clip = SV_FlyMove (ent, host_frametime, &steptrace);
-
-	if ( !(clip & 2) )
-		return;		// move didn't block on a step
-
-	if (!oldonground && ent->v.waterlevel == 0)
-		return;		// don't stair up while jumping
-
-	if (ent->v.movetype != MOVETYPE_WALK)
-		return;		// gibbed by a trigger
-
-	if (sv_nostep.value)
-		return;
-
-	if ( (int)sv_player->v.flags & FL_WATERJUMP )
-		return;
-
-	VectorCopy (ent->v.origin, nosteporg);
-	VectorCopy (ent->v.velocity, nostepvel);
-
-//
-// try moving up and forward to go up a step
-//
-	VectorCopy (oldorg, ent->v.origin);	// back to start pos
-
-	VectorCopy (vec3_origin, upmove);
-	VectorCopy (vec3_origin, downmove);
-	upmove[2] = STEPSIZE;
-	downmove[2] = -STEPSIZE + oldvel[2]*host_frametime;
-
-// move up
-	SV_PushEntity (ent, upmove, vec3_origin);	// FIXME: don't link?
-
-// move forward
-	ent->v.velocity[0] = oldvel[0];
-	ent->v. velocity[1] = oldvel[1];
-	ent->v. velocity[2] = 0;
-	clip = SV_FlyMove (ent, host_frametime, &steptrace);
-
-// check for stuckness, possibly due to the limited precision of floats
-// in the clipping hulls
-	if (clip)
-	{
-		if ( fabs(oldorg[1] - ent->v.origin[1]) < 0.03125
-		&& fabs(oldorg[0] - ent->v.origin[0]) < 0.03125 )
-		{	// stepping up didn't make any progress
-			clip = SV_TryUnstick (ent, oldvel);
-		}
-	}
-
-// extra friction based on view angle
-	if ( clip & 2 )
-		SV_WallFriction (ent, &steptrace);
-
-// move down
-	downtrace = SV_PushEntity (ent, downmove, vec3_origin);	// FIXME: don't link?
-
-	if (downtrace.plane.normal[2] > 0.7)
-	{
-		if (ent->v.solid == SOLID_BSP)
-		{
-			ent->v.flags =	(int)ent->v.flags | FL_ONGROUND;
-			ent->v.groundentity = EDICT_TO_PROG(downtrace.ent);
-		}
-	}
-	else
-	{
-// if the push down didn't end up on good ground, use the move without
-// the step up.  This happens near wall / slope combinations, and can
-// cause the player to hop up higher on a slope too steep to climb
-		VectorCopy (nosteporg, ent->v.origin);
-		VectorCopy (nostepvel, ent->v.velocity);
-	}
-}
-
 /*
 =================
 SV_Physics_Walk
@@ -1086,75 +850,52 @@ The following functions are duplicates from player modified for use by monsters
 ========================================================================================================================================================
 */
 
-/*
-============
-SV_PushMonsterEntity
-
-duplicate of SV_PushEntity: used for monster velocities.
-
-Does not change the entities velocity at all
-============
-*/
-trace_t SV_PushMonsterEntity (edict_t *ent, vec3_t push)
-{
-	trace_t	trace;
-	vec3_t	end;
-
-	VectorAdd (ent->v.origin, push, end);
-
-	trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_NOMONSTERS, ent);
-	
-	VectorCopy (trace.endpos, ent->v.origin);
-	//SV_LinkEdict (ent, true); we don't need to link it here
-
-	if (trace.ent)
-		SV_Impact (ent, trace.ent);
-
-	return trace;
-}
+#define	STEPSIZE	18
 
 /*
 =====================
 SV_MonsterWalkMove
 
-duplicate SV_WalkMove: Only used by monsters who move by velocity
+duplicate PM_WalkMove: Only used by monsters who move by velocity
 ======================
 */
 void SV_MonsterWalkMove (edict_t *ent)
 {
+	movevars_t	mv;
+	pmove_t		pm;
 	vec3_t		upmove, downmove;
 	vec3_t		oldorg, oldvel;
 	vec3_t		nosteporg, nostepvel;
 	int			clip;
-	int			oldonground;
-	trace_t		steptrace, downtrace;
+	pmtrace_t	steptrace, downtrace;
+
+	SV_BeginMove (ent, &pm, &mv);
 
 //
 // do a regular slide move unless it looks like you ran into a step
 //
-	oldonground = (int)ent->v.flags & FL_ONGROUND;
-	ent->v.flags = (int)ent->v.flags & ~FL_ONGROUND;
+	pm.flags &= ~PMF_ONGROUND;
 
-	VectorCopy (ent->v.origin, oldorg);
-	VectorCopy (ent->v.velocity, oldvel);
+	VectorCopy (pm.origin, oldorg);
+	VectorCopy (pm.velocity, oldvel);
 
-	clip = SV_FlyMove (ent, host_frametime, &steptrace);
+	clip = PM_FlyMove (&pm, host_frametime, &steptrace);
 
 	if ( !(clip & 2) )
+	{
+		SV_FinishMove (ent, &pm);
 		return;		// move didn't block on a step
+	}
 
 	//if (!oldonground && ent->v.waterlevel == 0)
 	//	return;		// don't stair up while jumping
 
-	if (ent->v.movetype != MOVETYPE_WALK)
-		return;		// gibbed by a trigger
-
-	VectorCopy (ent->v.origin, nosteporg);
-	VectorCopy (ent->v.velocity, nostepvel);
+	VectorCopy (pm.origin, nosteporg);
+	VectorCopy (pm.velocity, nostepvel);
 //
 // try moving up and forward to go up a step
 //
-	VectorCopy (oldorg, ent->v.origin);	// back to start pos
+	VectorCopy (oldorg, pm.origin);	// back to start pos
 
 	VectorCopy (vec3_origin, upmove);
 	VectorCopy (vec3_origin, downmove);
@@ -1162,47 +903,33 @@ void SV_MonsterWalkMove (edict_t *ent)
 	downmove[2] = -STEPSIZE + oldvel[2]*host_frametime;
 
 // move up
-	SV_PushMonsterEntity (ent, upmove);	// FIXME: don't link?
+	PM_PushPlayer (&pm, upmove, &downtrace);
 
 // move forward
-	ent->v.velocity[0] = oldvel[0];
-	ent->v. velocity[1] = oldvel[1];
-	ent->v. velocity[2] = 0;
-	clip = SV_FlyMove (ent, host_frametime, &steptrace);
-
-// check for stuckness, possibly due to the limited precision of floats
-// in the clipping hulls
-	/*if (clip)
-	{
-		if ( fabsf(oldorg[1] - ent->v.origin[1]) < 0.03125 && fabsf(oldorg[0] - ent->v.origin[0]) < 0.03125 )
-		{	// stepping up didn't make any progress
-			clip = SV_TryUnstick (ent, oldvel);
-		}
-	}*/
+	pm.velocity[0] = oldvel[0];
+	pm.velocity[1] = oldvel[1];
+	pm.velocity[2] = 0;
+	clip = PM_FlyMove (&pm, host_frametime, &steptrace);
 
 // extra friction based on view angle
 	if ( clip & 2 )
-		SV_WallFriction (ent, &steptrace);
+		PM_WallFriction (&pm, &steptrace);
 
 // move down
-	downtrace = SV_PushMonsterEntity (ent, downmove);	// FIXME: don't link?
+	PM_PushPlayer (&pm, downmove, &downtrace);
 
-	if (downtrace.plane.normal[2] > 0.7)
-	{
-		if (downtrace.ent->v.solid == SOLID_BSP)
-		{
-			ent->v.flags =	(int)ent->v.flags | FL_ONGROUND;
-			ent->v.groundentity = EDICT_TO_PROG(downtrace.ent);
-		}
-	}
+	if (downtrace.normal[2] > 0.7)
+		pm.flags |= PMF_ONGROUND;	// SV_FinishMove checks it is a bsp model
 	else
 	{
 // if the push down didn't end up on good ground, use the move without
 // the step up.  This happens near wall / slope combinations, and can
 // cause the player to hop up higher on a slope too steep to climb
-		VectorCopy (nosteporg, ent->v.origin);
-		VectorCopy (nostepvel, ent->v.velocity);
+		VectorCopy (nosteporg, pm.origin);
+		VectorCopy (nostepvel, pm.velocity);
 	}
+
+	SV_FinishMove (ent, &pm);
 }
 
 //Creating a duplicate SV_TestEntityPosition, one that does not check for monsters.
@@ -1391,6 +1118,9 @@ Player character actions
 */
 void SV_Physics_Client (edict_t	*ent, int num)
 {
+	movevars_t	mv;
+	pmove_t		pm;
+
 	if ( ! svs.clients[num-1].active )
 		return;		// unconnected slot
 
@@ -1417,12 +1147,15 @@ void SV_Physics_Client (edict_t	*ent, int num)
 		break;
 
 	case MOVETYPE_WALK:
+	case MOVETYPE_FLY:
+	case MOVETYPE_NOCLIP:
 		if (!SV_RunThink (ent))
 			return;
-		if (!SV_CheckWater (ent) && ! ((int)ent->v.flags & FL_WATERJUMP) )
-			SV_AddGravity (ent);
-		SV_CheckStuck (ent);
-		SV_WalkMove (ent);
+		if (ent->v.movetype == MOVETYPE_WALK)
+			SV_CheckStuck (ent);
+		SV_BeginMove (ent, &pm, &mv);
+		PM_PlayerMove (&pm);
+		SV_FinishMove (ent, &pm);
 		break;
 
 	case MOVETYPE_TOSS:
@@ -1430,18 +1163,6 @@ void SV_Physics_Client (edict_t	*ent, int num)
 		SV_Physics_Toss (ent);
 		break;
 
-	case MOVETYPE_FLY:
-		if (!SV_RunThink (ent))
-			return;
-		SV_FlyMove (ent, host_frametime, NULL);
-		break;
-
-	case MOVETYPE_NOCLIP:
-		if (!SV_RunThink (ent))
-			return;
-		VectorMA (ent->v.origin, host_frametime, ent->v.velocity, ent->v.origin);
-		break;
-
 	default:
 		Sys_Error ("SV_Physics_client: bad movetype %i", (int)ent->v.movetype);
 	}
@@ -1621,6 +1342,8 @@ will fall if the floor is pulled out from under them.
 void SV_Physics_Step (edict_t *ent)
 {
 	qboolean	hitsound;
+	movevars_t	mv;
+	pmove_t		pm;
 
 // freefall if not onground
 	if ( ! ((int)ent->v.flags & (FL_ONGROUND | FL_FLY | FL_SWIM) ) )
@@ -1632,7 +1355,9 @@ void SV_Physics_Step (edict_t *ent)
 
 		SV_AddGravity (ent);
 		SV_CheckVelocity (ent);
-		SV_FlyMove (ent, host_frametime, NULL);
+		SV_BeginMove (ent, &pm, &mv);
+		PM_FlyMove (&pm, host_frametime, NULL);
+		SV_FinishMove (ent, &pm);
 		SV_LinkEdict (ent, true);
 
 		if ( (int)ent->v.flags & FL_ONGROUND )	// just hit ground
@@ -1684,7 +1409,7 @@ void SV_Physics (void)
 	//for (i=0 ; i<sv.num_edicts ; i++, ent = NEXT_EDICT(ent))
 	for (i=0 ; i<entity_cap ; i++, ent = NEXT_EDICT(ent))
 	{
-		if (ent->free)
+		if (sv_mirror.free[i])
 			continue;
 
 		if (pr_global_struct->force_retouch)
@@ -1711,6 +1436,8 @@ void SV_Physics (void)
 			SV_Physics_Toss (ent);
 		else
 			Sys_Error ("SV_Physics: bad movetype %i", (int)ent->v.movetype);
+
+		SV_MirrorSync (ent);	// whatever the physics changed, while ent is in the cache
 	}
 
 	if (EndFrame)
@@ -0,0 +1,876 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_replay.c -- server frame recorder and replayer
+//
+// sv_record writes a binary savegame and then, for every server frame, the
+// inputs to the simulation: the frame time, a random seed the frame is run
+// with, client moves and commands in the order the server read them, and
+// cvars set from the console. It also writes a hash of the saved globals
+// and of every edict after the frame has run.
+//
+// sv_replay loads the savegame and reruns the frames back to back, without
+// a client connected and without sending anything, compares the hashes and
+// reports the time per frame. Given the same map and progs.dat the frames
+// should match exactly, so a mismatch after an engine change means the
+// change altered the game, and the frame times are repeatable.
+//
+// The frames follow the savegame's BS_END in the same file (all little
+// endian): "QCRP", version, client mask, then frames of { int length,
+// data } ending with a length of 0. String fields and globals are hashed by
+// their text, string numbers differ between the two runs.
+
+#include "quakedef.h"
+
+#define	REPLAY_MAGIC		"QCRP"
+#define	REPLAY_VERSION		1
+
+// frame events
+#define	RE_MOVE			1	// client move as read by SV_ReadClientMove
+#define	RE_CLIENTCMD	2	// client string command
+#define	RE_CVAR			3	// console command setting a cvar
+
+#define	REPLAY_CONSOLE	255	// client number of console events
+
+#define	RF_FOCUS		1	// svs.maxclients > 1 || key_dest == key_game
+
+typedef struct
+{
+	byte	*data;
+	int		cursize;
+	int		maxsize;
+} replaybuf_t;
+
+typedef struct
+{
+	const byte	*data;
+	int			cursize;
+	int			readcount;
+	qboolean	badread;
+} replayreader_t;
+
+static struct
+{
+	FILE		*file;
+	char		name[MAX_OSPATH];
+	int			frames;
+	int			numevents;
+	replaybuf_t	events;		// of the frame being recorded
+	replaybuf_t	console;	// cvars set since the last frame
+	int			numconsole;
+	replaybuf_t	frame;
+	double		frametime;
+	int			seed;
+	int			flags;
+} rec;
+
+static qboolean	sv_replaying;
+
+/*
+===============================================================================
+
+BUFFERS
+
+===============================================================================
+*/
+
+static void RB_Write (replaybuf_t *rb, const void *data, int length)
+{
+	if (rb->cursize + length > rb->maxsize)
+	{
+		rb->maxsize = q_max (rb->maxsize * 2, rb->cursize + length + 1024);
+		rb->data = (byte *) realloc (rb->data, rb->maxsize);
+		if (!rb->data)
+			Sys_Error ("RB_Write: out of memory");
+	}
+	memcpy (rb->data + rb->cursize, data, length);
+	rb->cursize += length;
+}
+
+static void RB_WriteByte (replaybuf_t *rb, int c)
+{
+	byte	b = c;
+
+	RB_Write (rb, &b, 1);
+}
+
+static void RB_WriteLong (replaybuf_t *rb, int c)
+{
+	c = LittleLong (c);
+	RB_Write (rb, &c, 4);
+}
+
+static void RB_WriteFloat (replaybuf_t *rb, float f)
+{
+	f = LittleFloat (f);
+	RB_Write (rb, &f, 4);
+}
+
+static void RB_WriteDouble (replaybuf_t *rb, double d)
+{
+	union { double d; int l[2]; } u;
+
+	u.d = d;
+	if (!host_bigendian)
+	{
+		RB_WriteLong (rb, u.l[0]);
+		RB_WriteLong (rb, u.l[1]);
+	}
+	else
+	{
+		RB_WriteLong (rb, u.l[1]);
+		RB_WriteLong (rb, u.l[0]);
+	}
+}
+
+static void RB_WriteString (replaybuf_t *rb, const char *s)
+{
+	RB_Write (rb, s, strlen (s) + 1);
+}
+
+static void RB_Free (replaybuf_t *rb)
+{
+	free (rb->data);
+	memset (rb, 0, sizeof(*rb));
+}
+
+static const byte *RR_Read (replayreader_t *rr, int length)
+{
+	const byte	*p;
+
+	if (length < 0 || rr->readcount + length > rr->cursize)
+	{
+		rr->badread = true;
+		rr->readcount = rr->cursize;
+		return NULL;
+	}
+	p = rr->data + rr->readcount;
+	rr->readcount += length;
+	return p;
+}
+
+static int RR_ReadByte (replayreader_t *rr)
+{
+	const byte	*p = RR_Read (rr, 1);
+
+	return p ? *p : 0;
+}
+
+static int RR_ReadLong (replayreader_t *rr)
+{
+	const byte	*p = RR_Read (rr, 4);
+
+	return p ? p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24) : 0;
+}
+
+static float RR_ReadFloat (replayreader_t *rr)
+{
+	union { int l; float f; } u;
+
+	u.l = RR_ReadLong (rr);
+	return u.f;
+}
+
+static double RR_ReadDouble (replayreader_t *rr)
+{
+	union { double d; int l[2]; } u;
+
+	if (!host_bigendian)
+	{
+		u.l[0] = RR_ReadLong (rr);
+		u.l[1] = RR_ReadLong (rr);
+	}
+	else
+	{
+		u.l[1] = RR_ReadLong (rr);
+		u.l[0] = RR_ReadLong (rr);
+	}
+	return u.d;
+}
+
+static const char *RR_ReadString (replayreader_t *rr)
+{
+	const char	*s = (const char *)rr->data + rr->readcount;
+
+	while (rr->readcount < rr->cursize)
+	{
+		if (!rr->data[rr->readcount++])
+			return s;
+	}
+	rr->badread = true;
+	return "";
+}
+
+/*
+===============================================================================
+
+STATE HASH
+
+===============================================================================
+*/
+
+#define	HASH_INIT	2166136261u
+
+static unsigned SV_HashBytes (unsigned h, const void *data, int length)
+{
+	const byte	*p = (const byte *)data;
+
+	while (length--)
+		h = (h ^ *p++) * 16777619u;
+	return h;
+}
+
+static unsigned SV_HashValue (unsigned h, int type, const int *v)
+{
+	const char	*s;
+
+	switch (type & ~DEF_SAVEGLOBAL)
+	{
+	case ev_string:
+		s = PR_GetString (*v);
+		return SV_HashBytes (h, s, strlen (s) + 1);
+	case ev_vector:
+		return SV_HashBytes (h, v, 12);
+	default:
+		return SV_HashBytes (h, v, 4);
+	}
+}
+
+/*
+===============
+SV_HashState
+
+The saved globals, and every field of every edict in use
+===============
+*/
+static void SV_HashState (unsigned *globals, unsigned *edicts)
+{
+	ddef_t	*def;
+	edict_t	*ent;
+	unsigned	h;
+	int		i, j;
+
+	h = HASH_INIT;
+	for (i = 0, def = pr_globaldefs; i < progs->numglobaldefs; i++, def++)
+	{
+		if (def->type & DEF_SAVEGLOBAL)
+			h = SV_HashValue (h, def->type, (int *)&pr_globals[def->ofs]);
+	}
+	*globals = h;
+
+	h = HASH_INIT;
+	for (i = 0; i < sv.num_edicts; i++)
+	{
+		ent = EDICT_NUM(i);
+		h = SV_HashBytes (h, &ent->free, sizeof(ent->free));
+		if (ent->free)
+			continue;
+		for (j = 1, def = pr_fielddefs + 1; j < progs->numfielddefs; j++, def++)
+			h = SV_HashValue (h, def->type, (int *)&ent->v + def->ofs);
+	}
+	*edicts = h;
+}
+
+/*
+===============================================================================
+
+RECORDING
+
+===============================================================================
+*/
+
+/*
+===============
+SV_RecordStop
+===============
+*/
+void SV_RecordStop (void)
+{
+	sv_replaying = false;	// a Host_Error ended the replay
+
+	if (!rec.file)
+		return;
+
+	rec.frame.cursize = 0;
+	RB_WriteLong (&rec.frame, 0);
+	fwrite (rec.frame.data, 1, rec.frame.cursize, rec.file);
+	if (fclose (rec.file))
+		Con_Printf ("ERROR: couldn't write %s\n", rec.name);
+	else
+		Con_Printf ("Recorded %i frames to %s\n", rec.frames, rec.name);
+	rec.file = NULL;
+
+	RB_Free (&rec.events);
+	RB_Free (&rec.console);
+	RB_Free (&rec.frame);
+}
+
+/*
+===============
+SV_RecordFrameBegin
+
+Called at the start of Host_ServerFrame. Every recorded frame runs with a
+random seed of its own, so that the client's use of rand() between frames
+doesn't matter.
+===============
+*/
+void SV_RecordFrameBegin (void)
+{
+	if (sv_replaying)
+		return;
+	if (!rec.file)
+		return;
+
+	rec.seed = rand ();
+	srand (rec.seed);
+	rec.frametime = host_frametime;
+	rec.flags = (svs.maxclients > 1 || key_dest == key_game) ? RF_FOCUS : 0;
+
+	rec.events.cursize = 0;
+	rec.numevents = rec.numconsole;
+	RB_Write (&rec.events, rec.console.data, rec.console.cursize);
+	rec.console.cursize = 0;
+	rec.numconsole = 0;
+}
+
+/*
+===============
+SV_RecordFrameEnd
+
+Called by Host_ServerFrame once the world has run, before anything is sent
+===============
+*/
+void SV_RecordFrameEnd (void)
+{
+	unsigned	globals, edicts;
+
+	if (!rec.file)
+		return;
+
+	SV_HashState (&globals, &edicts);
+
+	rec.frame.cursize = 0;
+	RB_WriteLong (&rec.frame, 0);	// length, filled in below
+	RB_WriteDouble (&rec.frame, rec.frametime);
+	RB_WriteLong (&rec.frame, rec.seed);
+	RB_WriteByte (&rec.frame, rec.flags);
+	RB_WriteLong (&rec.frame, rec.numevents);
+	RB_Write (&rec.frame, rec.events.data, rec.events.cursize);
+	RB_WriteLong (&rec.frame, (int)globals);
+	RB_WriteLong (&rec.frame, (int)edicts);
+	*(int *)rec.frame.data = LittleLong (rec.frame.cursize - 4);
+
+	if (fwrite (rec.frame.data, 1, rec.frame.cursize, rec.file) != (size_t)rec.frame.cursize)
+	{
+		Con_Printf ("ERROR: couldn't write %s, recording stopped\n", rec.name);
+		SV_RecordStop ();
+		return;
+	}
+	rec.frames++;
+}
+
+/*
+===============
+SV_RecordClientMove
+
+After SV_ReadClientMove for host_client
+===============
+*/
+void SV_RecordClientMove (void)
+{
+	edict_t	*ent = host_client->edict;
+	int		bits;
+
+	if (!rec.file)
+		return;
+
+	bits = ((int)ent->v.button0 & 1) | (((int)ent->v.button2 & 1) << 1) | (((int)ent->v.button1 & 1) << 2) |
+		(((int)ent->v.button3 & 1) << 3) | (((int)ent->v.button4 & 1) << 4) | (((int)ent->v.button5 & 1) << 5) |
+		(((int)ent->v.button6 & 1) << 6) | (((int)ent->v.button7 & 1) << 7) | (((int)ent->v.button8 & 1) << 8);
+
+	RB_WriteByte (&rec.events, RE_MOVE);
+	RB_WriteByte (&rec.events, host_client - svs.clients);
+	RB_WriteFloat (&rec.events, ent->v.v_angle[0]);
+	RB_WriteFloat (&rec.events, ent->v.v_angle[1]);
+	RB_WriteFloat (&rec.events, ent->v.v_angle[2]);
+	RB_WriteFloat (&rec.events, host_client->cmd.forwardmove);
+	RB_WriteFloat (&rec.events, host_client->cmd.sidemove);
+	RB_WriteFloat (&rec.events, host_client->cmd.upmove);
+	RB_WriteLong (&rec.events, bits);
+	RB_WriteFloat (&rec.events, ent->v.impulse);
+	rec.numevents++;
+}
+
+/*
+===============
+SV_RecordClientCommand
+
+A string command host_client is about to execute
+===============
+*/
+void SV_RecordClientCommand (const char *text)
+{
+	if (!rec.file)
+		return;
+
+	RB_WriteByte (&rec.events, RE_CLIENTCMD);
+	RB_WriteByte (&rec.events, host_client - svs.clients);
+	RB_WriteString (&rec.events, text);
+	rec.numevents++;
+}
+
+/*
+===============
+SV_RecordCommand
+
+A cvar set from the console, replayed at the start of the next frame
+===============
+*/
+void SV_RecordCommand (const char *text)
+{
+	if (!rec.file)
+		return;
+
+	RB_WriteByte (&rec.console, RE_CVAR);
+	RB_WriteByte (&rec.console, REPLAY_CONSOLE);
+	RB_WriteString (&rec.console, text);
+	rec.numconsole++;
+}
+
+/*
+===============
+SV_Record_f
+
+sv_record <name> : starts recording server frames to <name>.qcr
+sv_record stop
+===============
+*/
+static void SV_Record_f (void)
+{
+	char	comment[SAVEGAME_COMMENT_LENGTH + 1];
+	int		i, mask;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf ("sv_record <name> : record server frames\n");
+		Con_Printf ("sv_record stop\n");
+		return;
+	}
+
+	if (!strcmp (Cmd_Argv(1), "stop"))
+	{
+		if (!rec.file)
+			Con_Printf ("Not recording.\n");
+		SV_RecordStop ();
+		return;
+	}
+
+	if (!sv.active || sv_replaying)
+	{
+		Con_Printf ("Not running a local server.\n");
+		return;
+	}
+	if (svs.maxclients != 1)
+	{
+		Con_Printf ("Can't record multiplayer games.\n");
+		return;
+	}
+	if (strstr (Cmd_Argv(1), ".."))
+	{
+		Con_Printf ("Relative pathnames are not allowed.\n");
+		return;
+	}
+
+	for (i = mask = 0; i < svs.maxclients; i++)
+	{
+		if (svs.clients[i].active && svs.clients[i].spawned)
+			mask |= 1 << i;
+	}
+	if (!mask)
+	{
+		Con_Printf ("Not in the game yet.\n");
+		return;
+	}
+
+	SV_RecordStop ();
+
+	q_snprintf (rec.name, sizeof(rec.name), "%s/%s", com_gamedir, Cmd_Argv(1));
+	COM_AddExtension (rec.name, ".qcr", sizeof(rec.name));
+
+	memset (comment, ' ', SAVEGAME_COMMENT_LENGTH);
+	memcpy (comment, "recording", 9);
+	comment[SAVEGAME_COMMENT_LENGTH] = 0;
+	if (!SV_SaveGameBinary (rec.name, comment))
+		return;
+
+	rec.file = fopen (rec.name, "ab");
+	if (!rec.file)
+	{
+		Con_Printf ("ERROR: couldn't open %s\n", rec.name);
+		return;
+	}
+
+	rec.frame.cursize = 0;
+	RB_Write (&rec.frame, REPLAY_MAGIC, 4);
+	RB_WriteLong (&rec.frame, REPLAY_VERSION);
+	RB_WriteLong (&rec.frame, mask);
+	fwrite (rec.frame.data, 1, rec.frame.cursize, rec.file);
+
+	rec.frames = 0;
+	rec.events.cursize = rec.console.cursize = 0;
+	rec.numevents = rec.numconsole = 0;
+	Con_Printf ("Recording server frames to %s\n", rec.name);
+}
+
+/*
+===============================================================================
+
+REPLAY
+
+===============================================================================
+*/
+
+static int SV_CompareTimes (const void *a, const void *b)
+{
+	double	d = *(const double *)a - *(const double *)b;
+
+	return (d > 0) - (d < 0);
+}
+
+/*
+===============
+SV_ReplayFrameStart
+
+Skips the savegame in front of the frames
+===============
+*/
+static qboolean SV_ReplayFrameStart (replayreader_t *rr)
+{
+	const byte	*magic;
+	int		id, length;
+
+	RR_Read (rr, 8);	// magic, version
+	do
+	{
+		id = RR_ReadLong (rr);
+		length = RR_ReadLong (rr);
+		RR_Read (rr, length);
+	} while (id != 0 && !rr->badread);
+
+	magic = RR_Read (rr, 4);
+	return magic && !memcmp (magic, REPLAY_MAGIC, 4) && RR_ReadLong (rr) == REPLAY_VERSION;
+}
+
+/*
+===============
+SV_ReplayEvents
+
+Applies the events of client c, which follow each other in the frame
+===============
+*/
+static void SV_ReplayEvents (replayreader_t *rr, int *numevents, int c)
+{
+	edict_t	*ent;
+	int		type, client, bits, start;
+
+	while (*numevents && !rr->badread)
+	{
+		start = rr->readcount;
+		type = RR_ReadByte (rr);
+		client = RR_ReadByte (rr);
+		if (client != c)
+		{
+			rr->readcount = start;
+			return;
+		}
+		(*numevents)--;
+
+		switch (type)
+		{
+		case RE_MOVE:
+			host_client = svs.clients + client;
+			ent = host_client->edict;
+			ent->v.v_angle[0] = RR_ReadFloat (rr);
+			ent->v.v_angle[1] = RR_ReadFloat (rr);
+			ent->v.v_angle[2] = RR_ReadFloat (rr);
+			host_client->cmd.forwardmove = RR_ReadFloat (rr);
+			host_client->cmd.sidemove = RR_ReadFloat (rr);
+			host_client->cmd.upmove = RR_ReadFloat (rr);
+			bits = RR_ReadLong (rr);
+			ent->v.button0 = bits & 1;
+			ent->v.button2 = (bits & 2)>>1;
+			ent->v.button1 = (bits & 4)>>2;
+			ent->v.button3 = (bits & 8)>>3;
+			ent->v.button4 = (bits & 16)>>4;
+			ent->v.button5 = (bits & 32)>>5;
+			ent->v.button6 = (bits & 64)>>6;
+			ent->v.button7 = (bits & 128)>>7;
+			ent->v.button8 = (bits & 256)>>8;
+			ent->v.impulse = RR_ReadFloat (rr);
+			break;
+		case RE_CLIENTCMD:
+			host_client = svs.clients + client;
+			sv_player = host_client->edict;
+			Cmd_ExecuteString (RR_ReadString (rr), src_client);
+			break;
+		case RE_CVAR:
+			Cmd_ExecuteString (RR_ReadString (rr), src_command);
+			break;
+		default:
+			rr->badread = true;
+			return;
+		}
+	}
+}
+
+/*
+===============
+SV_Replay
+
+Runs the frames of a recording loaded with SV_LoadGameBinary
+===============
+*/
+static void SV_Replay (replayreader_t *rr, int mask)
+{
+	replayreader_t	fr;
+	client_t	*client;
+	double		*times, start, total;
+	unsigned	globals, edicts, recglobals, recedicts;
+	int			i, length, numevents, frames, maxframes, mismatches, first;
+	int			vamark;
+	qboolean	run;
+
+	for (i = 0, client = svs.clients; i < svs.maxclients; i++, client++)
+	{
+		if (!(mask & (1 << i)))
+			continue;
+		client->active = true;
+		client->spawned = true;
+		client->edict = EDICT_NUM(i + 1);
+		client->message.data = client->msgbuf;
+		client->message.maxsize = sizeof(client->msgbuf);
+		client->message.allowoverflow = true;
+		q_strlcpy (client->name, PR_GetString (client->edict->v.netname), sizeof(client->name));
+	}
+	sv.paused = false;
+	sv.loadgame = false;
+
+	maxframes = 1024;
+	times = (double *) malloc (maxframes * sizeof(double));
+	frames = mismatches = 0;
+	first = -1;
+	total = 0;
+// va() strings from the command that started us stay valid
+	vamark = Frame_LowMark (FRAME_CLIENT);
+
+	for (;;)
+	{
+		length = RR_ReadLong (rr);
+		if (length <= 0 || rr->badread)
+			break;
+		memset (&fr, 0, sizeof(fr));
+		fr.data = RR_Read (rr, length);
+		fr.cursize = length;
+		if (!fr.data)
+			break;
+
+		host_frametime = RR_ReadDouble (&fr);
+		srand (RR_ReadLong (&fr));
+		run = (RR_ReadByte (&fr) & RF_FOCUS) != 0;
+		numevents = RR_ReadLong (&fr);
+
+		start = Sys_PreciseTime ();
+
+	// what Host_ServerFrame does, minus the networking
+		pr_global_struct->frametime = host_frametime;
+		SV_ClearDatagram ();
+		SV_ReplayEvents (&fr, &numevents, REPLAY_CONSOLE);
+		for (i = 0, host_client = svs.clients; i < svs.maxclients; i++, host_client++)
+		{
+			if (!host_client->active)
+				continue;
+			sv_player = host_client->edict;
+			SV_ReplayEvents (&fr, &numevents, i);
+			if (!sv.paused && run && host_client->spawned)
+			{
+				host_client = svs.clients + i;	// commands may have changed it
+				sv_player = host_client->edict;
+				SV_ClientThink ();
+			}
+		}
+		if (!sv.paused && run)
+			SV_Physics ();
+
+		if (frames == maxframes)
+		{
+			maxframes *= 2;
+			times = (double *) realloc (times, maxframes * sizeof(double));
+		}
+		if (!times)
+			Sys_Error ("SV_Replay: out of memory");
+		times[frames] = Sys_PreciseTime () - start;
+		total += times[frames];
+
+		recglobals = (unsigned)RR_ReadLong (&fr);
+		recedicts = (unsigned)RR_ReadLong (&fr);
+		if (fr.badread || numevents)
+		{
+			Con_Printf ("frame %i is corrupt\n", frames);
+			break;
+		}
+		SV_HashState (&globals, &edicts);
+		if (globals != recglobals || edicts != recedicts)
+		{
+			if (first == -1)
+			{
+				first = frames;
+				Con_Printf ("frame %i (time %.3f) differs:%s%s\n", frames, sv.time,
+					globals != recglobals ? " globals" : "", edicts != recedicts ? " edicts" : "");
+			}
+			mismatches++;
+		}
+
+	// what sending the frame would have changed
+		for (i = 0, client = svs.clients; i < svs.maxclients; i++, client++)
+		{
+			if (client->active && client->spawned)
+				client->edict->v.fixangle = 0;
+			SZ_Clear (&client->message);
+		}
+		SV_CleanupEnts ();
+		SZ_Clear (&sv.reliable_datagram);
+		PR_StringsFrame ();
+		Frame_Reset (FRAME_SERVER);
+		Frame_FreeToLowMark (FRAME_CLIENT, vamark);
+
+		frames++;
+	}
+
+	Con_Printf ("%i frames, %i differ", frames, mismatches);
+	if (first != -1)
+		Con_Printf (", first at frame %i", first);
+	Con_Printf ("\n");
+	if (frames)
+	{
+		qsort (times, frames, sizeof(double), SV_CompareTimes);
+		Con_Printf ("frame time: %.3f ms average, %.3f median, %.3f 95%%, %.3f max\n",
+			total * 1000 / frames, times[frames / 2] * 1000, times[frames * 95 / 100] * 1000,
+			times[frames - 1] * 1000);
+	}
+	free (times);
+
+	for (i = 0, client = svs.clients; i < svs.maxclients; i++, client++)
+		client->active = false;
+}
+
+/*
+===============
+SV_Replay_f
+
+sv_replay <name> : reruns a recording made by sv_record
+===============
+*/
+static void SV_Replay_f (void)
+{
+	static byte	*data;	// freed on the next call if a Host_Error hits
+
+	char	name[MAX_OSPATH];
+	replayreader_t	rr;
+	FILE	*f;
+	long	size;
+	int		mask;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf ("sv_replay <name> : rerun recorded server frames\n");
+		return;
+	}
+	if (strstr (Cmd_Argv(1), ".."))
+	{
+		Con_Printf ("Relative pathnames are not allowed.\n");
+		return;
+	}
+
+	SV_RecordStop ();
+	free (data);
+	data = NULL;
+
+	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
+	COM_AddExtension (name, ".qcr", sizeof(name));
+
+	f = fopen (name, "rb");
+	if (!f)
+	{
+		Con_Printf ("ERROR: couldn't open %s\n", name);
+		return;
+	}
+	fseek (f, 0, SEEK_END);
+	size = ftell (f);
+	fseek (f, 0, SEEK_SET);
+	data = (byte *) malloc (size > 0 ? size : 1);
+	if (!data || fread (data, 1, size, f) != (size_t)size)
+	{
+		fclose (f);
+		Con_Printf ("ERROR: couldn't read %s\n", name);
+		return;
+	}
+	fclose (f);
+
+	memset (&rr, 0, sizeof(rr));
+	rr.data = data;
+	rr.cursize = size;
+	if (!SV_ReplayFrameStart (&rr))
+	{
+		Con_Printf ("%s is not a recording\n", name);
+		return;
+	}
+	mask = RR_ReadLong (&rr);
+
+	Con_Printf ("Replaying %s...\n", name);
+	if (!SV_LoadGameBinary (name))
+	{
+		return;
+	}
+
+	sv_replaying = true;
+	SV_Replay (&rr, mask);
+	sv_replaying = false;
+	free (data);
+	data = NULL;
+
+	Host_ShutdownServer (false);
+}
+
+/*
+===============
+SV_InitReplay
+===============
+*/
+void SV_InitReplay (void)
+{
+	Cmd_AddCommand ("sv_record", SV_Record_f);
+	Cmd_AddCommand ("sv_replay", SV_Replay_f);
+}
@@ -0,0 +1,874 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_save.c -- binary savegames
+//
+// The text savegame prints and reparses every non-zero field of every edict,
+// which is slow and drops the waypoint and zombie path state. The binary
+// format stores the edict fields as raw blocks instead, with string fields
+// turned into indices into a string table and entity fields into edict
+// numbers. It is only valid for the progs.dat it was written with, which is
+// checked on load; the text format remains available for anything else.
+//
+// Layout (all little endian): "QSVB", version, then sections of
+// { int id, int length, data }, ending with BS_END. Unknown sections are
+// skipped, so new state can be added without bumping the version.
+
+#include "quakedef.h"
+
+cvar_t	sv_savebinary = {"sv_savebinary", "1", CVAR_ARCHIVE};	// save writes the binary format
+
+#define	BINSAVE_MAGIC		"QSVB"
+#define	BINSAVE_VERSION		1
+
+// section ids
+#define	BS_END			0
+#define	BS_HEADER		1	// comment, map, skill, time, spawn parms, progs check
+#define	BS_STRINGS		2	// string table, must come before globals and edicts
+#define	BS_LIGHTSTYLES	3
+#define	BS_GLOBALS		4
+#define	BS_EDICTS		5
+#define	BS_WAYPOINTS	6	// open/closed state of the map's waypoints
+#define	BS_ZOMBIES		7	// zombie_list and closest_waypoints
+#define	BS_FREETIMES	8	// when each edict was freed, after BS_EDICTS
+
+// how an edict field or global is stored
+#define	FK_RAW			0
+#define	FK_STRING		1
+#define	FK_ENTITY		2
+#define	FK_NONE			255		// global not saved
+
+typedef struct
+{
+	byte	*data;
+	int		cursize;
+	int		maxsize;
+} savebuf_t;
+
+typedef struct
+{
+	const byte	*data;
+	int			cursize;
+	int			readcount;
+	qboolean	badread;
+} savereader_t;
+
+static byte		*sv_fieldkind;		// FK_* for each of progs->entityfields
+static byte		*sv_globalkind;		// FK_* for each of progs->numglobals
+
+// string table built while saving
+static struct
+{
+	savebuf_t	text;
+	int			count;
+	int			*hash;			// index + 1 of the string in each slot, 0 = empty
+	int			*offsets;		// into text
+	int			hashsize;
+} savestrings;
+
+// strings allocated while loading
+static int		*loadstrings;
+static int		numloadstrings;
+
+/*
+===============================================================================
+
+BUFFERS
+
+===============================================================================
+*/
+
+static void SB_Write (savebuf_t *sb, const void *data, int length)
+{
+	if (sb->cursize + length > sb->maxsize)
+	{
+		sb->maxsize = q_max (sb->maxsize * 2, sb->cursize + length + 4096);
+		sb->data = (byte *) realloc (sb->data, sb->maxsize);
+		if (!sb->data)
+			Sys_Error ("SB_Write: out of memory (%i bytes)", sb->maxsize);
+	}
+	memcpy (sb->data + sb->cursize, data, length);
+	sb->cursize += length;
+}
+
+static void SB_WriteByte (savebuf_t *sb, int c)
+{
+	byte	b = c;
+
+	SB_Write (sb, &b, 1);
+}
+
+static void SB_WriteLong (savebuf_t *sb, int c)
+{
+	c = LittleLong (c);
+	SB_Write (sb, &c, 4);
+}
+
+static void SB_WriteFloat (savebuf_t *sb, float f)
+{
+	f = LittleFloat (f);
+	SB_Write (sb, &f, 4);
+}
+
+static void SB_WriteDouble (savebuf_t *sb, double d)
+{
+	union { double d; int l[2]; } u;
+	int		t;
+
+	u.d = d;
+	if (host_bigendian)
+	{
+		t = u.l[0];
+		u.l[0] = LittleLong (u.l[1]);
+		u.l[1] = LittleLong (t);
+	}
+	SB_Write (sb, u.l, 8);
+}
+
+static void SB_WriteString (savebuf_t *sb, const char *s)
+{
+	SB_Write (sb, s, strlen(s) + 1);
+}
+
+static void SB_WriteSection (savebuf_t *sb, int id, const savebuf_t *section)
+{
+	SB_WriteLong (sb, id);
+	SB_WriteLong (sb, section->cursize);
+	SB_Write (sb, section->data, section->cursize);
+}
+
+static void SB_Free (savebuf_t *sb)
+{
+	free (sb->data);
+	memset (sb, 0, sizeof(*sb));
+}
+
+static const byte *SR_Read (savereader_t *sr, int length)
+{
+	const byte	*p;
+
+	if (length < 0 || sr->readcount + length > sr->cursize)
+	{
+		sr->badread = true;
+		sr->readcount = sr->cursize;
+		return NULL;
+	}
+	p = sr->data + sr->readcount;
+	sr->readcount += length;
+	return p;
+}
+
+static int SR_ReadByte (savereader_t *sr)
+{
+	const byte	*p = SR_Read (sr, 1);
+
+	return p ? *p : 0;
+}
+
+static int SR_ReadLong (savereader_t *sr)
+{
+	const byte	*p = SR_Read (sr, 4);
+
+	return p ? p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24) : 0;
+}
+
+static float SR_ReadFloat (savereader_t *sr)
+{
+	union { int l; float f; } u;
+
+	u.l = SR_ReadLong (sr);
+	return u.f;
+}
+
+static double SR_ReadDouble (savereader_t *sr)
+{
+	union { double d; int l[2]; } u;
+	int		lo, hi;
+
+	lo = SR_ReadLong (sr);
+	hi = SR_ReadLong (sr);
+	if (host_bigendian)
+	{
+		u.l[0] = hi;
+		u.l[1] = lo;
+	}
+	else
+	{
+		u.l[0] = lo;
+		u.l[1] = hi;
+	}
+	return u.d;
+}
+
+static const char *SR_ReadString (savereader_t *sr)
+{
+	const char	*s;
+	int			i;
+
+	s = (const char *)sr->data + sr->readcount;
+	for (i = sr->readcount; i < sr->cursize; i++)
+	{
+		if (!sr->data[i])
+		{
+			sr->readcount = i + 1;
+			return s;
+		}
+	}
+	sr->badread = true;
+	sr->readcount = sr->cursize;
+	return "";
+}
+
+/*
+===============================================================================
+
+FIELD TRANSLATION
+
+===============================================================================
+*/
+
+/*
+===============
+SV_BuildFieldKinds
+
+Works out which edict fields hold strings and entities, and which globals
+are saved: the same string, float and entity DEF_SAVEGLOBALs as
+ED_WriteGlobals
+===============
+*/
+static void SV_BuildFieldKinds (void)
+{
+	ddef_t	*d;
+	int		i, type;
+
+	sv_fieldkind = (byte *) realloc (sv_fieldkind, progs->entityfields);
+	sv_globalkind = (byte *) realloc (sv_globalkind, progs->numglobals);
+	if (!sv_fieldkind || !sv_globalkind)
+		Sys_Error ("SV_BuildFieldKinds: out of memory");
+	memset (sv_fieldkind, FK_RAW, progs->entityfields);
+	memset (sv_globalkind, FK_NONE, progs->numglobals);
+
+	for (i = 1; i < progs->numfielddefs; i++)
+	{
+		d = &pr_fielddefs[i];
+		if (d->ofs >= progs->entityfields)
+			continue;
+		type = d->type & ~DEF_SAVEGLOBAL;
+		if (type == ev_string)
+			sv_fieldkind[d->ofs] = FK_STRING;
+		else if (type == ev_entity)
+			sv_fieldkind[d->ofs] = FK_ENTITY;
+	}
+
+	for (i = 0; i < progs->numglobaldefs; i++)
+	{
+		d = &pr_globaldefs[i];
+		if (!(d->type & DEF_SAVEGLOBAL) || d->ofs >= progs->numglobals)
+			continue;
+		type = d->type & ~DEF_SAVEGLOBAL;
+		if (type == ev_string)
+			sv_globalkind[d->ofs] = FK_STRING;
+		else if (type == ev_entity)
+			sv_globalkind[d->ofs] = FK_ENTITY;
+		else if (type == ev_float)
+			sv_globalkind[d->ofs] = FK_RAW;
+	}
+}
+
+/*
+===============
+SV_SaveString
+
+Progs strings are stored as their offset, anything else as -(index + 1) into
+the string table, with duplicates shared.
+===============
+*/
+static int SV_SaveString (int num)
+{
+	const char	*s;
+	unsigned int	hash;
+	int			i, slot, len;
+
+	if (!num || PR_IsProgsString (num))
+		return num;
+
+	s = PR_GetString (num);
+
+	if (savestrings.count * 2 >= savestrings.hashsize)
+	{	// rehash
+		free (savestrings.hash);
+		savestrings.hashsize = savestrings.hashsize ? savestrings.hashsize * 2 : 1024;
+		savestrings.hash = (int *) calloc (savestrings.hashsize, sizeof(int));
+		savestrings.offsets = (int *) realloc (savestrings.offsets, savestrings.hashsize / 2 * sizeof(int));
+		if (!savestrings.hash || !savestrings.offsets)
+			Sys_Error ("SV_SaveString: out of memory");
+		for (i = 0; i < savestrings.count; i++)
+		{
+			hash = COM_HashString ((const char *)savestrings.text.data + savestrings.offsets[i]);
+			for (slot = hash & (savestrings.hashsize - 1); savestrings.hash[slot]; slot = (slot + 1) & (savestrings.hashsize - 1))
+				;
+			savestrings.hash[slot] = i + 1;
+		}
+	}
+
+	hash = COM_HashString (s);
+	for (slot = hash & (savestrings.hashsize - 1); savestrings.hash[slot]; slot = (slot + 1) & (savestrings.hashsize - 1))
+	{
+		i = savestrings.hash[slot] - 1;
+		if (!strcmp ((const char *)savestrings.text.data + savestrings.offsets[i], s))
+			return -1 - i;
+	}
+
+	i = savestrings.count++;
+	len = strlen (s) + 1;
+	savestrings.offsets[i] = savestrings.text.cursize;
+	SB_Write (&savestrings.text, s, len);
+	savestrings.hash[slot] = i + 1;
+	return -1 - i;
+}
+
+static int SV_LoadString (int num, savereader_t *sr)
+{
+	if (num >= 0)
+	{
+		if (!PR_IsProgsString (num))
+		{
+			sr->badread = true;
+			return 0;
+		}
+		return num;
+	}
+	if (-1 - num >= numloadstrings)
+	{
+		sr->badread = true;
+		return 0;
+	}
+	return loadstrings[-1 - num];
+}
+
+static int SV_SaveEntity (int ofs)
+{
+	return ofs / pr_edict_size;
+}
+
+static int SV_LoadEntity (int num, savereader_t *sr)
+{
+	if (num < 0 || num >= sv.max_edicts)
+	{
+		sr->badread = true;
+		return 0;
+	}
+	return EDICT_TO_PROG(EDICT_NUM(num));
+}
+
+static int SV_SaveValue (int kind, int value)
+{
+	if (kind == FK_STRING)
+		return SV_SaveString (value);
+	if (kind == FK_ENTITY)
+		return SV_SaveEntity (value);
+	return value;
+}
+
+static int SV_LoadValue (int kind, int value, savereader_t *sr)
+{
+	if (kind == FK_STRING)
+		return SV_LoadString (value, sr);
+	if (kind == FK_ENTITY)
+		return SV_LoadEntity (value, sr);
+	return value;
+}
+
+/*
+===============================================================================
+
+SAVING
+
+===============================================================================
+*/
+
+static void SV_WriteGlobals (savebuf_t *sb)
+{
+	int		i, count;
+	int		countofs;
+
+	count = 0;
+	countofs = sb->cursize;
+	SB_WriteLong (sb, 0);
+	for (i = 0; i < progs->numglobals; i++)
+	{
+		if (sv_globalkind[i] == FK_NONE)
+			continue;
+		SB_WriteLong (sb, i);
+		SB_WriteLong (sb, SV_SaveValue (sv_globalkind[i], ((int *)pr_globals)[i]));
+		count++;
+	}
+	count = LittleLong (count);
+	memcpy (sb->data + countofs, &count, 4);
+}
+
+static void SV_WriteEdicts (savebuf_t *sb)
+{
+	edict_t	*ent;
+	int		i, j;
+	int		*v;
+
+	SB_WriteLong (sb, sv.num_edicts);
+	SB_WriteLong (sb, progs->entityfields);
+	for (i = 0; i < sv.num_edicts; i++)
+	{
+		ent = EDICT_NUM(i);
+		if (ent->free)
+		{
+			SB_WriteByte (sb, 1);
+			continue;
+		}
+		SB_WriteByte (sb, 0);
+		SB_WriteByte (sb, ent->alpha);
+
+		v = (int *)&ent->v;
+		for (j = 0; j < progs->entityfields; j++)
+			SB_WriteLong (sb, SV_SaveValue (sv_fieldkind[j], v[j]));
+	}
+}
+
+/*
+===============
+SV_SaveGameBinary
+===============
+*/
+qboolean SV_SaveGameBinary (const char *name, const char *comment)
+{
+	savebuf_t	file, section, globals, edicts;
+	FILE		*f;
+	int			i, j, count;
+	qboolean	ok;
+
+	memset (&file, 0, sizeof(file));
+	memset (&section, 0, sizeof(section));
+	memset (&globals, 0, sizeof(globals));
+	memset (&edicts, 0, sizeof(edicts));
+	memset (&savestrings, 0, sizeof(savestrings));
+
+	SV_BuildFieldKinds ();
+
+// globals and edicts first, they fill in the string table
+	SV_WriteGlobals (&globals);
+	SV_WriteEdicts (&edicts);
+
+	SB_Write (&file, BINSAVE_MAGIC, 4);
+	SB_WriteLong (&file, BINSAVE_VERSION);
+
+	SB_Write (&section, comment, SAVEGAME_COMMENT_LENGTH + 1);
+	SB_WriteString (&section, sv.name);
+	SB_WriteLong (&section, current_skill);
+	SB_WriteDouble (&section, sv.time);
+	SB_WriteLong (&section, NUM_SPAWN_PARMS);
+	for (i = 0; i < NUM_SPAWN_PARMS; i++)
+		SB_WriteFloat (&section, svs.clients->spawn_parms[i]);
+	SB_WriteLong (&section, pr_crc);
+	SB_WriteLong (&section, progs->entityfields);
+	SB_WriteSection (&file, BS_HEADER, &section);
+
+	section.cursize = 0;
+	SB_WriteLong (&section, savestrings.count);
+	SB_Write (&section, savestrings.text.data, savestrings.text.cursize);
+	SB_WriteSection (&file, BS_STRINGS, &section);
+
+	section.cursize = 0;
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+		SB_WriteString (&section, sv.lightstyles[i] ? sv.lightstyles[i] : "m");
+	SB_WriteSection (&file, BS_LIGHTSTYLES, &section);
+
+	SB_WriteSection (&file, BS_GLOBALS, &globals);
+	SB_WriteSection (&file, BS_EDICTS, &edicts);
+
+	section.cursize = 0;
+	SB_WriteLong (&section, sv.num_edicts);
+	for (i = 0; i < sv.num_edicts; i++)
+		SB_WriteFloat (&section, EDICT_NUM(i)->freetime);
+	SB_WriteSection (&file, BS_FREETIMES, &section);
+
+	section.cursize = 0;
+	SB_WriteLong (&section, MAX_WAYPOINTS);
+	for (i = 0; i < MAX_WAYPOINTS; i++)
+		SB_WriteByte (&section, waypoints[i].open);
+	SB_WriteSection (&file, BS_WAYPOINTS, &section);
+
+	section.cursize = 0;
+	SB_WriteLong (&section, MaxZombies);
+	for (i = 0; i < MaxZombies; i++)
+	{
+		count = CLAMP (0, zombie_list[i].pathlist_length, MAX_WAYPOINTS);
+		SB_WriteLong (&section, zombie_list[i].zombienum);
+		SB_WriteLong (&section, count);
+		for (j = 0; j < count; j++)
+			SB_WriteLong (&section, zombie_list[i].pathlist[j]);
+	}
+	SB_WriteLong (&section, sv.num_edicts);
+	for (i = 0; i < sv.num_edicts; i++)
+		SB_WriteLong (&section, closest_waypoints[i]);
+	SB_WriteSection (&file, BS_ZOMBIES, &section);
+
+	SB_WriteLong (&file, BS_END);
+	SB_WriteLong (&file, 0);
+
+	ok = false;
+	f = fopen (name, "wb");
+	if (f)
+	{
+		ok = fwrite (file.data, 1, file.cursize, f) == (size_t)file.cursize;
+		if (fclose (f))
+			ok = false;
+	}
+	if (!ok)
+		Con_Printf ("ERROR: couldn't write %s.\n", name);
+
+	SB_Free (&file);
+	SB_Free (&section);
+	SB_Free (&globals);
+	SB_Free (&edicts);
+	SB_Free (&savestrings.text);
+	free (savestrings.hash);
+	free (savestrings.offsets);
+	memset (&savestrings, 0, sizeof(savestrings));
+
+	return ok;
+}
+
+/*
+===============================================================================
+
+LOADING
+
+===============================================================================
+*/
+
+/*
+===============
+SV_IsBinarySave
+===============
+*/
+qboolean SV_IsBinarySave (const char *name)
+{
+	FILE	*f;
+	char	magic[4];
+	qboolean	ret;
+
+	f = fopen (name, "rb");
+	if (!f)
+		return false;
+	ret = fread (magic, 1, 4, f) == 4 && !memcmp (magic, BINSAVE_MAGIC, 4);
+	fclose (f);
+	return ret;
+}
+
+static qboolean SV_ReadStrings (savereader_t *sr)
+{
+	const char	*s;
+	char		*p;
+	int			i, count, len;
+
+	count = SR_ReadLong (sr);
+	if (count < 0 || count > sr->cursize)
+		return false;
+
+	loadstrings = (int *) realloc (loadstrings, (count + 1) * sizeof(int));
+	if (!loadstrings)
+		Sys_Error ("SV_ReadStrings: out of memory");
+	numloadstrings = count;
+	for (i = 0; i < count; i++)
+	{
+		s = SR_ReadString (sr);
+		len = strlen (s) + 1;
+		loadstrings[i] = PR_AllocString (len, &p);
+		memcpy (p, s, len);
+	}
+	return !sr->badread;
+}
+
+static qboolean SV_ReadLightstyles (savereader_t *sr)
+{
+	int		i;
+
+	for (i = 0; i < MAX_LIGHTSTYLES; i++)
+		sv.lightstyles[i] = (const char *)Hunk_Strdup (SR_ReadString (sr), "lightstyles");
+	return !sr->badread;
+}
+
+static qboolean SV_ReadGlobals (savereader_t *sr)
+{
+	int		i, count, ofs, value;
+
+	count = SR_ReadLong (sr);
+	for (i = 0; i < count && !sr->badread; i++)
+	{
+		ofs = SR_ReadLong (sr);
+		value = SR_ReadLong (sr);
+		if (ofs < 0 || ofs >= progs->numglobals || sv_globalkind[ofs] == FK_NONE)
+			return false;
+		((int *)pr_globals)[ofs] = SV_LoadValue (sv_globalkind[ofs], value, sr);
+	}
+	return !sr->badread;
+}
+
+static qboolean SV_ReadEdicts (savereader_t *sr)
+{
+	edict_t	*ent;
+	int		i, j, num, fields;
+	int		*v;
+
+	num = SR_ReadLong (sr);
+	fields = SR_ReadLong (sr);
+	if (num < 1 || num > sv.max_edicts || fields != progs->entityfields)
+		return false;
+
+	for (i = 0; i < num; i++)
+	{
+		ent = EDICT_NUM(i);
+		if (i < sv.num_edicts)
+		{
+			ent->free = false;
+			memset (&ent->v, 0, progs->entityfields * 4);
+		}
+		else
+			memset (ent, 0, pr_edict_size);
+
+		if (SR_ReadByte (sr))
+		{
+			ent->free = true;
+			continue;
+		}
+		ent->alpha = SR_ReadByte (sr);
+
+		v = (int *)&ent->v;
+		for (j = 0; j < fields; j++)
+			v[j] = SV_LoadValue (sv_fieldkind[j], SR_ReadLong (sr), sr);
+		if (sr->badread)
+			return false;
+
+	// link it into the bsp tree
+		SV_LinkEdict (ent, false);
+	}
+
+	sv.num_edicts = num;
+	SV_MirrorRebuild ();
+	return !sr->badread;
+}
+
+static qboolean SV_ReadFreetimes (savereader_t *sr)
+{
+	int		i, count;
+
+	count = SR_ReadLong (sr);
+	if (count != sv.num_edicts)
+		return false;
+	for (i = 0; i < count; i++)
+		EDICT_NUM(i)->freetime = SR_ReadFloat (sr);
+	return !sr->badread;
+}
+
+static qboolean SV_ReadWaypoints (savereader_t *sr)
+{
+	int		i, count;
+
+	count = SR_ReadLong (sr);
+	if (count != MAX_WAYPOINTS)
+		return false;
+	for (i = 0; i < MAX_WAYPOINTS; i++)
+		waypoints[i].open = SR_ReadByte (sr);
+	return !sr->badread;
+}
+
+static qboolean SV_ReadZombies (savereader_t *sr)
+{
+	int		i, j, count;
+
+	count = SR_ReadLong (sr);
+	if (count != MaxZombies)
+		return false;
+	for (i = 0; i < MaxZombies; i++)
+	{
+		zombie_list[i].zombienum = SR_ReadLong (sr);
+		zombie_list[i].pathlist_length = CLAMP (0, SR_ReadLong (sr), MAX_WAYPOINTS);
+		for (j = 0; j < zombie_list[i].pathlist_length; j++)
+			zombie_list[i].pathlist[j] = SR_ReadLong (sr);
+	}
+	count = SR_ReadLong (sr);
+	if (count < 0 || count > MAX_EDICTS)
+		return false;
+	for (i = 0; i < count; i++)
+		closest_waypoints[i] = SR_ReadLong (sr);
+	return !sr->badread;
+}
+
+/*
+===============
+SV_LoadGameBinary
+
+Loads a savegame written by SV_SaveGameBinary and starts the server.
+Returns false if the file couldn't be used.
+===============
+*/
+qboolean SV_LoadGameBinary (const char *name)
+{
+	static byte	*start;	// freed on the next call if a Host_Error hits
+
+	savereader_t	file, sr;
+	char		mapname[MAX_QPATH];
+	float		spawn_parms[NUM_SPAWN_PARMS];
+	double		time;
+	int			i, id, length, count, crc, fields;
+	long		size;
+	FILE		*f;
+	qboolean	ok;
+
+	if (start != NULL)
+		free (start);
+	start = NULL;
+
+	f = fopen (name, "rb");
+	if (!f)
+	{
+		Con_Printf ("ERROR: couldn't open.\n");
+		return false;
+	}
+	fseek (f, 0, SEEK_END);
+	size = ftell (f);
+	fseek (f, 0, SEEK_SET);
+	start = (byte *) malloc (size > 0 ? size : 1);
+	if (!start || fread (start, 1, size, f) != (size_t)size)
+	{
+		fclose (f);
+		Con_Printf ("ERROR: couldn't read.\n");
+		return false;
+	}
+	fclose (f);
+
+	memset (&file, 0, sizeof(file));
+	file.data = start;
+	file.cursize = size;
+
+	SR_Read (&file, 4);
+	i = SR_ReadLong (&file);
+	if (file.badread || memcmp (start, BINSAVE_MAGIC, 4) || i != BINSAVE_VERSION)
+	{
+		Con_Printf ("Binary savegame is version %i, not %i\n", i, BINSAVE_VERSION);
+		goto fail;
+	}
+
+// the header must come first
+	id = SR_ReadLong (&file);
+	length = SR_ReadLong (&file);
+	memset (&sr, 0, sizeof(sr));
+	sr.data = SR_Read (&file, length);
+	sr.cursize = length;
+	if (id != BS_HEADER || !sr.data)
+	{
+		Con_Printf ("Savegame is corrupt\n");
+		goto fail;
+	}
+
+	SR_Read (&sr, SAVEGAME_COMMENT_LENGTH + 1);
+	q_strlcpy (mapname, SR_ReadString (&sr), sizeof(mapname));
+	current_skill = SR_ReadLong (&sr);
+	time = SR_ReadDouble (&sr);
+	count = SR_ReadLong (&sr);
+	for (i = 0; i < count; i++)
+	{
+		if (i < NUM_SPAWN_PARMS)
+			spawn_parms[i] = SR_ReadFloat (&sr);
+		else
+			SR_ReadFloat (&sr);
+	}
+	for ( ; i < NUM_SPAWN_PARMS; i++)
+		spawn_parms[i] = 0;
+	crc = SR_ReadLong (&sr);
+	fields = SR_ReadLong (&sr);
+	if (sr.badread)
+	{
+		Con_Printf ("Savegame is corrupt\n");
+		goto fail;
+	}
+	Cvar_SetValue ("skill", (float)current_skill);
+
+	CL_Disconnect_f ();
+
+	SV_SpawnServer (mapname);
+
+	if (!sv.active)
+	{
+		Con_Printf ("Couldn't load map\n");
+		goto fail;
+	}
+	if (crc != pr_crc || fields != progs->entityfields)
+		Host_Error ("%s was saved with a different progs.dat", name);
+
+	sv.paused = true;		// pause until all clients connect
+	sv.loadgame = true;
+
+	SV_BuildFieldKinds ();
+	numloadstrings = 0;
+
+	for (;;)
+	{
+		id = SR_ReadLong (&file);
+		length = SR_ReadLong (&file);
+		memset (&sr, 0, sizeof(sr));
+		sr.data = SR_Read (&file, length);
+		sr.cursize = length;
+		if (file.badread)
+			Host_Error ("%s is truncated", name);
+		if (id == BS_END)
+			break;
+
+		switch (id)
+		{
+		case BS_STRINGS:	ok = SV_ReadStrings (&sr); break;
+		case BS_LIGHTSTYLES:	ok = SV_ReadLightstyles (&sr); break;
+		case BS_GLOBALS:	ok = SV_ReadGlobals (&sr); break;
+		case BS_EDICTS:		ok = SV_ReadEdicts (&sr); break;
+		case BS_FREETIMES:	ok = SV_ReadFreetimes (&sr); break;
+		case BS_WAYPOINTS:	ok = SV_ReadWaypoints (&sr); break;
+		case BS_ZOMBIES:	ok = SV_ReadZombies (&sr); break;
+		default:
+			Con_DPrintf ("SV_LoadGameBinary: skipping unknown section %i\n", id);
+			ok = true;
+			break;
+		}
+		if (!ok)
+			Host_Error ("%s: bad section %i", name, id);
+	}
+
+	sv.time = time;
+
+	free (start);
+	start = NULL;
+
+	for (i = 0; i < NUM_SPAWN_PARMS; i++)
+		svs.clients->spawn_parms[i] = spawn_parms[i];
+
+	return true;
+
+fail:
+	free (start);
+	start = NULL;
+	return false;
+}
@@ -28,17 +28,8 @@ edict_t	*sv_player;
 extern	cvar_t	sv_friction;
 cvar_t	sv_edgefriction = {"edgefriction", "2", CVAR_NONE};
 extern	cvar_t	sv_stopspeed;
-
-static	vec3_t		forward, right, up;
-
-// world
-float	*angles;
-float	*origin;
-float	*velocity;
-
-qboolean	onground;
-
-usercmd_t	cmd;
+extern	cvar_t	sv_gravity;
+extern	cvar_t	sv_nostep;
 
 cvar_t	sv_idealpitchscale = {"sv_idealpitchscale","0.8",CVAR_NONE};
 cvar_t	sv_altnoclip = {"sv_altnoclip","1",CVAR_ARCHIVE}; //johnfitz
@@ -112,98 +103,66 @@ void SV_SetIdealPitch (void)
 }
 
 
+cvar_t	sv_maxspeed = {"sv_maxspeed", "320", CVAR_NOTIFY|CVAR_SERVERINFO};
+cvar_t	sv_accelerate = {"sv_accelerate", "10", CVAR_NONE};
+
 /*
 ==================
-SV_UserFriction
+SV_PlayerMoveVars
 
+Collects the movement tunables for ent. These are also what gets sent to
+predicting clients with svc_movevars.
 ==================
 */
-void SV_UserFriction (void)
+void SV_PlayerMoveVars (edict_t *ent, movevars_t *mv)
 {
-	float	*vel;
-	float	speed, newspeed, control;
-	vec3_t	start, stop;
-	float	friction;
-	trace_t	trace;
-
-	vel = velocity;
-
-	speed = sqrt(vel[0]*vel[0] +vel[1]*vel[1]);
-	if (!speed)
-		return;
-
-// if the leading edge is over a dropoff, increase friction
-	start[0] = stop[0] = origin[0] + vel[0]/speed*16;
-	start[1] = stop[1] = origin[1] + vel[1]/speed*16;
-	start[2] = origin[2] + sv_player->v.mins[2];
-	stop[2] = start[2] - 34;
-
-	trace = SV_Move (start, vec3_origin, vec3_origin, stop, true, sv_player);
+	eval_t	*val;
 
-	if (trace.fraction == 1.0)
-		friction = sv_friction.value*sv_edgefriction.value;
+	memset (mv, 0, sizeof(*mv));
+	mv->gravity = sv_gravity.value;
+	val = GetEdictFieldValueAt(ent, pr_extfields.gravity);
+	if (val && val->_float)
+		mv->entgravity = val->_float;
 	else
-		friction = sv_friction.value;
-
-// apply friction
-	control = speed < sv_stopspeed.value ? sv_stopspeed.value : speed;
-	newspeed = speed - host_frametime*control*friction;
-
-	if (newspeed < 0)
-		newspeed = 0;
-	newspeed /= speed;
-
-	vel[0] = vel[0] * newspeed;
-	vel[1] = vel[1] * newspeed;
-	vel[2] = vel[2] * newspeed;
+		mv->entgravity = 1.0;
+	mv->friction = sv_friction.value;
+	mv->edgefriction = sv_edgefriction.value;
+	mv->stopspeed = sv_stopspeed.value;
+	mv->maxspeed = sv_maxspeed.value;
+	mv->accelerate = sv_accelerate.value;
+	VectorCopy (ent->v.mins, mv->mins);
+	VectorCopy (ent->v.maxs, mv->maxs);
+	if (sv_altnoclip.value)
+		mv->flags |= MVF_ALTNOCLIP;
+	if (sv_nostep.value)
+		mv->flags |= MVF_NOSTEP;
 }
 
 /*
-==============
-SV_Accelerate
-==============
+==================
+SV_PlayerTrace
+
+pmove trace callback; the edge friction check ignores monsters
+==================
 */
-cvar_t	sv_maxspeed = {"sv_maxspeed", "320", CVAR_NOTIFY|CVAR_SERVERINFO};
-cvar_t	sv_accelerate = {"sv_accelerate", "10", CVAR_NONE};
-void SV_Accelerate (float wishspeed, const vec3_t wishdir)
+static void SV_PlayerTrace (const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, pmtrace_t *pmtrace)
 {
-	int			i;
-	float		addspeed, accelspeed, currentspeed;
+	trace_t	trace;
 
-	currentspeed = DotProduct (velocity, wishdir);
-	addspeed = wishspeed - currentspeed;
-	if (addspeed <= 0)
-		return;
-	accelspeed = sv_accelerate.value*host_frametime*wishspeed;
-	if (accelspeed > addspeed)
-		accelspeed = addspeed;
+	trace = SV_Move ((float *)start, (float *)mins, (float *)maxs, (float *)end, MOVE_NOMONSTERS, sv_player);
 
-	for (i=0 ; i<3 ; i++)
-		velocity[i] += accelspeed*wishdir[i];
+	pmtrace->allsolid = trace.allsolid;
+	pmtrace->startsolid = trace.startsolid;
+	pmtrace->fraction = trace.fraction;
+	VectorCopy (trace.endpos, pmtrace->endpos);
+	VectorCopy (trace.plane.normal, pmtrace->normal);
 }
 
-void SV_AirAccelerate (float wishspeed, vec3_t wishveloc)
+static int SV_PlayerPointContents (const vec3_t p)
 {
-	int			i;
-	float		addspeed, wishspd, accelspeed, currentspeed;
-
-	wishspd = VectorNormalize (wishveloc);
-	if (wishspd > 30)
-		wishspd = 30;
-	currentspeed = DotProduct (velocity, wishveloc);
-	addspeed = wishspd - currentspeed;
-	if (addspeed <= 0)
-		return;
-//	accelspeed = sv_accelerate.value * host_frametime;
-	accelspeed = sv_accelerate.value*wishspeed * host_frametime;
-	if (accelspeed > addspeed)
-		accelspeed = addspeed;
-
-	for (i=0 ; i<3 ; i++)
-		velocity[i] += accelspeed*wishveloc[i];
+	return SV_PointContents ((float *)p);
 }
 
-
 void DropPunchAngle (void)
 {
 	float	len;
@@ -216,72 +175,6 @@ void DropPunchAngle (void)
 	VectorScale (sv_player->v.punchangle, len, sv_player->v.punchangle);
 }
 
-/*
-===================
-SV_WaterMove
-
-===================
-*/
-void SV_WaterMove (void)
-{
-	int		i;
-	vec3_t	wishvel;
-	float	speed, newspeed, wishspeed, addspeed, accelspeed;
-
-//
-// user intentions
-//
-	AngleVectors (sv_player->v.v_angle, forward, right, up);
-
-	for (i=0 ; i<3 ; i++)
-		wishvel[i] = forward[i]*cmd.forwardmove + right[i]*cmd.sidemove;
-
-	if (!cmd.forwardmove && !cmd.sidemove && !cmd.upmove)
-		wishvel[2] -= 60;		// drift towards bottom
-	else
-		wishvel[2] += cmd.upmove;
-
-	wishspeed = VectorLength(wishvel);
-	if (wishspeed > sv_maxspeed.value)
-	{
-		VectorScale (wishvel, sv_maxspeed.value/wishspeed, wishvel);
-		wishspeed = sv_maxspeed.value;
-	}
-	wishspeed *= 0.7;
-
-//
-// water friction
-//
-	speed = VectorLength (velocity);
-	if (speed)
-	{
-		newspeed = speed - host_frametime * speed * sv_friction.value;
-		if (newspeed < 0)
-			newspeed = 0;
-		VectorScale (velocity, newspeed/speed, velocity);
-	}
-	else
-		newspeed = 0;
-
-//
-// water acceleration
-//
-	if (!wishspeed)
-		return;
-
-	addspeed = wishspeed - newspeed;
-	if (addspeed <= 0)
-		return;
-
-	VectorNormalize (wishvel);
-	accelspeed = sv_accelerate.value * wishspeed * host_frametime;
-	if (accelspeed > addspeed)
-		accelspeed = addspeed;
-
-	for (i=0 ; i<3 ; i++)
-		velocity[i] += accelspeed * wishvel[i];
-}
-
 void SV_WaterJump (void)
 {
 	if (sv.time > sv_player->v.teleport_time
@@ -294,81 +187,6 @@ void SV_WaterJump (void)
 	sv_player->v.velocity[1] = sv_player->v.movedir[1];
 }
 
-/*
-===================
-SV_NoclipMove -- johnfitz
-
-new, alternate noclip. old noclip is still handled in SV_AirMove
-===================
-*/
-void SV_NoclipMove (void)
-{
-	AngleVectors (sv_player->v.v_angle, forward, right, up);
-
-	velocity[0] = forward[0]*cmd.forwardmove + right[0]*cmd.sidemove;
-	velocity[1] = forward[1]*cmd.forwardmove + right[1]*cmd.sidemove;
-	velocity[2] = forward[2]*cmd.forwardmove + right[2]*cmd.sidemove;
-	velocity[2] += cmd.upmove*2; //doubled to match running speed
-
-	if (VectorLength (velocity) > sv_maxspeed.value)
-	{
-		VectorNormalize (velocity);
-		VectorScale (velocity, sv_maxspeed.value, velocity);
-	}
-}
-
-/*
-===================
-SV_AirMove
-===================
-*/
-void SV_AirMove (void)
-{
-	int			i;
-	vec3_t		wishvel, wishdir;
-	float		wishspeed;
-	float		fmove, smove;
-
-	AngleVectors (sv_player->v.angles, forward, right, up);
-
-	fmove = cmd.forwardmove;
-	smove = cmd.sidemove;
-
-// hack to not let you back into teleporter
-	if (sv.time < sv_player->v.teleport_time && fmove < 0)
-		fmove = 0;
-
-	for (i=0 ; i<3 ; i++)
-		wishvel[i] = forward[i]*fmove + right[i]*smove;
-
-	if ( (int)sv_player->v.movetype != MOVETYPE_WALK)
-		wishvel[2] = cmd.upmove;
-	else
-		wishvel[2] = 0;
-
-	VectorCopy (wishvel, wishdir);
-	wishspeed = VectorNormalize(wishdir);
-	if (wishspeed > sv_maxspeed.value)
-	{
-		VectorScale (wishvel, sv_maxspeed.value/wishspeed, wishvel);
-		wishspeed = sv_maxspeed.value;
-	}
-
-	if ( sv_player->v.movetype == MOVETYPE_NOCLIP)
-	{	// noclip
-		VectorCopy (wishvel, velocity);
-	}
-	else if ( onground )
-	{
-		SV_UserFriction ();
-		SV_Accelerate (wishspeed, wishdir);
-	}
-	else
-	{	// not on ground, so little effect on velocity
-		SV_AirAccelerate (wishspeed, wishvel);
-	}
-}
-
 /*
 ===================
 SV_ClientThink
@@ -380,15 +198,13 @@ the angle fields specify an exact angular motion in degrees
 void SV_ClientThink (void)
 {
 	vec3_t		v_angle;
+	float		*angles;
+	movevars_t	movevars;
+	pmove_t		pm;
 
 	if (sv_player->v.movetype == MOVETYPE_NONE)
 		return;
 
-	onground = (int)sv_player->v.flags & FL_ONGROUND;
-
-	origin = sv_player->v.origin;
-	velocity = sv_player->v.velocity;
-
 	DropPunchAngle ();
 
 //
@@ -400,7 +216,6 @@ void SV_ClientThink (void)
 //
 // angles
 // show 1/3 the pitch angle and all the roll angle
-	cmd = host_client->cmd;
 	angles = sv_player->v.angles;
 
 	VectorAdd (sv_player->v.v_angle, sv_player->v.punchangle, v_angle);
@@ -419,14 +234,30 @@ void SV_ClientThink (void)
 //
 // walk
 //
-	//johnfitz -- alternate noclip
-	if (sv_player->v.movetype == MOVETYPE_NOCLIP && sv_altnoclip.value)
-		SV_NoclipMove ();
-	else if (sv_player->v.waterlevel >= 2 && sv_player->v.movetype != MOVETYPE_NOCLIP)
-		SV_WaterMove ();
-	else
-		SV_AirMove ();
-	//johnfitz
+	SV_PlayerMoveVars (sv_player, &movevars);
+
+	memset (&pm, 0, sizeof(pm));
+	VectorCopy (sv_player->v.origin, pm.origin);
+	VectorCopy (sv_player->v.velocity, pm.velocity);
+	if ((int)sv_player->v.flags & FL_ONGROUND)
+		pm.flags |= PMF_ONGROUND;
+	if (sv.time < sv_player->v.teleport_time)
+		pm.flags |= PMF_NOBACKMOVE;
+	pm.waterlevel = sv_player->v.waterlevel;
+	pm.watertype = sv_player->v.watertype;
+	pm.cmd = host_client->cmd;
+	VectorCopy (sv_player->v.v_angle, pm.v_angle);
+	VectorCopy (sv_player->v.angles, pm.angles);
+	pm.movetype = sv_player->v.movetype;
+	pm.viewheight = sv_player->v.view_ofs[2];
+	pm.frametime = host_frametime;
+	pm.movevars = &movevars;
+	pm.trace = SV_PlayerTrace;
+	pm.pointcontents = SV_PlayerPointContents;
+
+	PM_PlayerThink (&pm);
+
+	VectorCopy (pm.velocity, sv_player->v.velocity);
 }
 
 
@@ -575,9 +406,14 @@ nextmsg:
 					ret = 1;
 				else if (q_strncasecmp(s, "ban", 3) == 0)
 					ret = 1;
+				else if (q_strncasecmp(s, "predict", 7) == 0)
+					ret = 1;
 
 				if (ret == 1)
+				{
+					SV_RecordClientCommand (s);
 					Cmd_ExecuteString (s, src_client);
+				}
 				else
 					Con_DPrintf("%s tried to %s\n", host_client->name, s);
 				break;
@@ -588,6 +424,11 @@ nextmsg:
 
 			case clc_move:
 				SV_ReadClientMove (&host_client->cmd);
+				SV_RecordClientMove ();
+				break;
+
+			case clc_moveseq:
+				host_client->movesequence = MSG_ReadLong ();
 				break;
 			}
 		}
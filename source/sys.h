@@ -42,6 +42,11 @@ int Sys_FileWrite (int handle,const void *data, int count);
 int Sys_FileTime (const char *path);
 void Sys_mkdir (const char *path);
 
+const void *Sys_MapFile (const char *path, int *size);
+void Sys_UnmapFile (const void *base, int size);
+// maps the whole file read only, NULL if it can't (or is empty) and
+// the caller should read it instead
+
 //
 // system IO
 //
@@ -57,12 +62,23 @@ void Sys_Printf (const char *fmt, ...) FUNC_PRINTF(1,2);
 // send text to the console
 
 double Sys_DoubleTime (void);
+double Sys_PreciseTime (void);
+// seconds like Sys_DoubleTime, but from the highest resolution counter
+// there is, for profiling. Not related to Sys_DoubleTime's zero.
 
 const char *Sys_ConsoleInput (void);
 
 void Sys_Sleep (unsigned long msecs);
 // yield for about 'msecs' milliseconds.
 
+void *Sys_ReserveMemory (int size);
+// sets aside size bytes of address space without backing it with memory.
+// NULL if the platform can't, and the caller should fall back to malloc.
+qboolean Sys_CommitMemory (void *base, int size);
+void Sys_DecommitMemory (void *base, int size);
+// make page aligned parts of a reserved range usable, and give them back.
+// Committed memory reads as zero.
+
 void Sys_SendKeyEvents (void);
 // Perform Key_Event () callbacks until the input que is empty
 
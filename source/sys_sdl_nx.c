@@ -127,6 +127,16 @@ int Sys_FileWrite (int handle, const void *data, int count)
 	return fwrite (data, 1, count, sys_handles[handle]);
 }
 
+// no file mapping here, files are read into memory
+const void *Sys_MapFile (const char *path, int *size)
+{
+	return NULL;
+}
+
+void Sys_UnmapFile (const void *base, int size)
+{
+}
+
 int Sys_FileTime (const char *path)
 {
 	FILE	*f;
@@ -250,6 +260,15 @@ double Sys_DoubleTime (void)
 	return SDL_GetTicks() / 1000.0;
 }
 
+double Sys_PreciseTime (void)
+{
+	static double	scale;
+
+	if (!scale)
+		scale = 1.0 / SDL_GetPerformanceFrequency ();
+	return SDL_GetPerformanceCounter () * scale;
+}
+
 const char *Sys_ConsoleInput (void)
 {
 	static char	con_text[256];
@@ -304,6 +323,21 @@ void Sys_Sleep (unsigned long msecs)
 	SDL_Delay (msecs);
 }
 
+// the hunk is a plain allocation here, see main_sdl_nx.c
+void *Sys_ReserveMemory (int size)
+{
+	return NULL;
+}
+
+qboolean Sys_CommitMemory (void *base, int size)
+{
+	return true;
+}
+
+void Sys_DecommitMemory (void *base, int size)
+{
+}
+
 void Sys_SendKeyEvents (void)
 {
 	IN_Commands();		//ericw -- allow joysticks to add keys so they can be used to confirm SCR_ModalMessage
@@ -32,6 +32,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 #include <sys/stat.h>
 #include <sys/time.h>
+#ifndef VITA
+#include <sys/mman.h>
+#endif
 #include <fcntl.h>
 #include <time.h>
 #ifdef DO_USERDIRS
@@ -156,6 +159,42 @@ int Sys_FileWrite (int handle, const void *data, int count)
 	return fwrite (data, 1, count, sys_handles[handle]);
 }
 
+#ifdef VITA
+const void *Sys_MapFile (const char *path, int *size)
+{
+	return NULL;
+}
+
+void Sys_UnmapFile (const void *base, int size)
+{
+}
+#else
+const void *Sys_MapFile (const char *path, int *size)
+{
+	struct stat	st;
+	void	*p;
+	int		fd;
+
+	fd = open (path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+	p = MAP_FAILED;
+	if (fstat (fd, &st) == 0 && st.st_size > 0 && st.st_size <= 0x7fffffff)
+		p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close (fd);	// the mapping keeps the file
+	if (p == MAP_FAILED)
+		return NULL;
+
+	*size = (int) st.st_size;
+	return p;
+}
+
+void Sys_UnmapFile (const void *base, int size)
+{
+	munmap ((void *) base, size);
+}
+#endif
+
 int Sys_FileTime (const char *path)
 {
 	FILE	*f;
@@ -460,6 +499,19 @@ double Sys_DoubleTime (void)
 	return SDL_GetTicks() / 1000.0;
 }
 
+double Sys_PreciseTime (void)
+{
+#if defined(USE_SDL2)
+	static double	scale;
+
+	if (!scale)
+		scale = 1.0 / SDL_GetPerformanceFrequency ();
+	return SDL_GetPerformanceCounter () * scale;
+#else
+	return Sys_DoubleTime ();
+#endif
+}
+
 const char *Sys_ConsoleInput (void)
 {
 	static char	con_text[256];
@@ -514,6 +566,49 @@ void Sys_Sleep (unsigned long msecs)
 	SDL_Delay (msecs);
 }
 
+#ifdef VITA
+void *Sys_ReserveMemory (int size)
+{
+	return NULL;
+}
+
+qboolean Sys_CommitMemory (void *base, int size)
+{
+	return true;
+}
+
+void Sys_DecommitMemory (void *base, int size)
+{
+}
+#else
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE	0
+#endif
+
+void *Sys_ReserveMemory (int size)
+{
+	void	*p;
+
+	p = mmap (NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return (p == MAP_FAILED) ? NULL : p;
+}
+
+qboolean Sys_CommitMemory (void *base, int size)
+{
+	return mprotect (base, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void Sys_DecommitMemory (void *base, int size)
+{
+// drop the pages first so that they read as zero when committed again
+	madvise (base, size, MADV_DONTNEED);
+	mprotect (base, size, PROT_NONE);
+}
+#endif
+
 void Sys_SendKeyEvents (void)
 {
 	IN_Commands();		//ericw -- allow joysticks to add keys so they can be used to confirm SCR_ModalMessage
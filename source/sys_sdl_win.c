@@ -139,6 +139,39 @@ int Sys_FileWrite (int handle, const void *data, int count)
 	return fwrite (data, 1, count, sys_handles[handle]);
 }
 
+const void *Sys_MapFile (const char *path, int *size)
+{
+	HANDLE	file, mapping;
+	DWORD	high, low;
+	void	*p;
+
+	file = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	low = GetFileSize (file, &high);
+	if (low == INVALID_FILE_SIZE || high || !low || low > 0x7fffffff)
+	{
+		CloseHandle (file);
+		return NULL;
+	}
+	mapping = CreateFileMappingA (file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle (file);
+	if (!mapping)
+		return NULL;
+	p = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle (mapping);	// the view keeps the mapping
+	if (!p)
+		return NULL;
+
+	*size = (int) low;
+	return p;
+}
+
+void Sys_UnmapFile (const void *base, int size)
+{
+	UnmapViewOfFile (base);
+}
+
 int Sys_FileTime (const char *path)
 {
 	FILE	*f;
@@ -363,6 +396,19 @@ double Sys_DoubleTime (void)
 	return SDL_GetTicks() / 1000.0;
 }
 
+double Sys_PreciseTime (void)
+{
+#if defined(USE_SDL2)
+	static double	scale;
+
+	if (!scale)
+		scale = 1.0 / SDL_GetPerformanceFrequency ();
+	return SDL_GetPerformanceCounter () * scale;
+#else
+	return Sys_DoubleTime ();
+#endif
+}
+
 const char *Sys_ConsoleInput (void)
 {
 	static char	con_text[256];
@@ -435,6 +481,21 @@ void Sys_Sleep (unsigned long msecs)
 	SDL_Delay (msecs);
 }
 
+void *Sys_ReserveMemory (int size)
+{
+	return VirtualAlloc (NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+qboolean Sys_CommitMemory (void *base, int size)
+{
+	return VirtualAlloc (base, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void Sys_DecommitMemory (void *base, int size)
+{
+	VirtualFree (base, size, MEM_DECOMMIT);
+}
+
 void Sys_SendKeyEvents (void)
 {
 	IN_Commands();		//ericw -- allow joysticks to add keys so they can be used to confirm SCR_ModalMessage
@@ -255,15 +255,16 @@ loaded:
 }
 
 //converts paletted to rgba
-static byte *ConvertWad3ToRGBA(miptex_t *tex) {
-   byte *in, *data, *pal;
+static byte *ConvertWad3ToRGBA(const miptex_t *tex, const byte *base) {
+   const byte *in, *pal;
+   byte *data;
    int i, p, image_size;
 
    if (!tex->offsets[0])
       Sys_Error("ConvertWad3ToRGBA: tex->offsets[0] == 0");
 
    image_size = tex->width * tex->height;
-   in = (byte *) ((byte *) tex + tex->offsets[0]);
+   in = base + tex->offsets[0];
    data = malloc(image_size * 4); // Baker
 
    pal = in + ((image_size * 85) >> 6) + 2;
@@ -282,7 +283,7 @@ static byte *ConvertWad3ToRGBA(miptex_t *tex) {
    return data;
 }
 
-byte *WAD3_LoadTexture(miptex_t *mt) {
+byte *WAD3_LoadTexture(const miptex_t *mt, const byte *base) {
    char texname[MAX_QPATH];
    int i, j, lowmark = 0;
    FILE *file;
@@ -290,7 +291,7 @@ byte *WAD3_LoadTexture(miptex_t *mt) {
    byte *data;
 
    if (mt->offsets[0])
-      return ConvertWad3ToRGBA(mt);
+      return ConvertWad3ToRGBA(mt, base);
 
    texname[sizeof(texname) - 1] = 0;
    W_CleanupName (mt->name, texname);
@@ -320,7 +321,7 @@ byte *WAD3_LoadTexture(miptex_t *mt) {
       }
       for (j = 0;j < MIPLEVELS;j++)
          tex->offsets[j] = LittleLong(tex->offsets[j]);
-      data = ConvertWad3ToRGBA(tex);
+      data = ConvertWad3ToRGBA(tex, (byte *) tex);
       Hunk_FreeToLowMark(lowmark);
       return data;
    }
@@ -78,7 +78,7 @@ void	*W_GetLumpNum (int num);
 
 // Naievil hlbsp
 void WAD3_LoadTextureWadFile (char *filename);
-byte *WAD3_LoadTexture(miptex_t *mt);
+byte *WAD3_LoadTexture(const miptex_t *mt, const byte *base); // mt swapped, base where its offsets start
 
 void SwapPic (qpic_t *pic);
 
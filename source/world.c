@@ -119,6 +119,44 @@ hull_t	*SV_HullForBox (vec3_t mins, vec3_t maxs)
 
 
 
+/*
+================
+SV_HullForBrushModel
+
+Picks the precomputed clipping hull of a brush model that fits an object of
+mins/maxs size. Shared with client side movement prediction.
+================
+*/
+hull_t *SV_HullForBrushModel (qmodel_t *model, vec3_t mins, vec3_t maxs)
+{
+	vec3_t		size;
+
+	VectorSubtract (maxs, mins, size);
+
+	// naievil -- hlbsp implementation 
+	if (model->bspversion == HL_BSPVERSION) {
+		if (size[0] < 3) {
+			return &model->hulls[0];
+		} else if (size[0] <= 32) {
+			if (size[2] < 54) {
+				// Pick the nearest of 36 or 72
+				return &model->hulls[3]; 	// 32x32x36
+			} else {
+				return &model->hulls[1];	// 32x32x72
+			}
+		} else {
+			return &model->hulls[2]; 		// 64x64x64
+		}
+	}
+
+	if (size[0] < 3)
+		return &model->hulls[0];
+	else if (size[0] <= 32)
+		return &model->hulls[1];
+	else
+		return &model->hulls[2];
+}
+
 /*
 ================
 SV_HullForEntity
@@ -132,7 +170,6 @@ testing object's origin to get a point to use with the returned hull.
 hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
 {
 	qmodel_t	*model;
-	vec3_t		size;
 	vec3_t		hullmins, hullmaxs;
 	hull_t		*hull;
 
@@ -149,31 +186,7 @@ hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
 			Host_Error ("SOLID_BSP with a non bsp model (%s at %f %f %f)",
 				    PR_GetString(ent->v.classname), ent->v.origin[0], ent->v.origin[1], ent->v.origin[2]);
 
-		VectorSubtract (maxs, mins, size);
-
-		// naievil -- hlbsp implementation 
-		if (model->bspversion == HL_BSPVERSION) {
-			if (size[0] < 3) {
-				hull = &model->hulls[0];
-			} else if (size[0] <= 32) {
-				if (size[2] < 54) {
-					// Pick the nearest of 36 or 72
-					hull = &model->hulls[3]; 	// 32x32x36
-				} else {
-					hull = &model->hulls[1];	// 32x32x72
-				}
-			} else {
-				hull = &model->hulls[2]; 		// 64x64x64
-			}
-		} else {
-			if (size[0] < 3)
-				hull = &model->hulls[0];
-			else if (size[0] <= 32)
-				hull = &model->hulls[1];
-			else
-				hull = &model->hulls[2];
-		}
-		
+		hull = SV_HullForBrushModel (model, mins, maxs);
 
 // calculate an offset value to center the origin
 		VectorSubtract (hull->clip_mins, mins, offset);
@@ -261,6 +274,20 @@ areanode_t *SV_CreateAreaNode (int depth, vec3_t mins, vec3_t maxs)
 	return anode;
 }
 
+/*
+===============
+SV_AreaNodeState
+
+The area node tree, for saving and restoring it along with the edicts
+linked into it
+===============
+*/
+void *SV_AreaNodeState (int *size)
+{
+	*size = sizeof(sv_areanodes);
+	return sv_areanodes;
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -344,7 +371,7 @@ SV_AreaTriggerEdicts ( edict_t *ent, areanode_t *node, edict_t **list, int *list
 ====================
 SV_TouchLinks
 
-ericw -- copy the touching edicts to an array (on the hunk) so we can avoid
+ericw -- copy the touching edicts to an array (in the server frame arena) so we can avoid
 iteating the trigger_edicts linked list while calling PR_ExecuteProgram
 which could potentially corrupt the list while it's being iterated.
 Based on code from Spike.
@@ -358,8 +385,8 @@ void SV_TouchLinks (edict_t *ent)
 	int		i, listcount;
 	int		mark;
 	
-	mark = Hunk_LowMark ();
-	list = (edict_t **) Hunk_Alloc (sv.num_edicts*sizeof(edict_t *));
+	mark = Frame_LowMark (FRAME_SERVER);
+	list = (edict_t **) Frame_Alloc (FRAME_SERVER, sv.num_edicts*sizeof(edict_t *));
 	
 	listcount = 0;
 	SV_AreaTriggerEdicts (ent, sv_areanodes, list, &listcount, sv.num_edicts);
@@ -392,8 +419,8 @@ void SV_TouchLinks (edict_t *ent)
 		pr_global_struct->other = old_other;
 	}
 
-// free hunk-allocated edicts array
-	Hunk_FreeToLowMark (mark);
+// free the edicts array
+	Frame_FreeToLowMark (FRAME_SERVER, mark);
 }
 
 
@@ -485,6 +512,7 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 		ent->v.absmax[1] += 1;
 		ent->v.absmax[2] += 1;
 	}
+	SV_MirrorSync (ent);
 
 // link to PVS leafs
 	ent->num_leafs = 0;
@@ -49,6 +49,9 @@ typedef struct
 void SV_ClearWorld (void);
 // called after the world model has been loaded, before linking any entities
 
+void *SV_AreaNodeState (int *size);
+// the area node tree, for saving and restoring it with the edicts
+
 void SV_UnlinkEdict (edict_t *ent);
 // call before removing an entity, and before trying to move one,
 // so it doesn't clip against itself
@@ -84,5 +87,8 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 
 qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
 
+hull_t *SV_HullForBrushModel (qmodel_t *model, vec3_t mins, vec3_t maxs);
+// picks the clipping hull of a brush model for an object of mins/maxs size
+
 #endif	/* _QUAKE_WORLD_H */
 
@@ -34,19 +34,202 @@ typedef struct memblock_s
 	int	tag;		// a tag of 0 is a free block
 	int	id;		// should be ZONEID
 	int	pad;		// pad to 64 bit boundary
-	struct	memblock_s	*next, *prev;
+	struct	memblock_s	*next, *prev;	// the blocks before and after in memory
 } memblock_t;
 
+// a free block keeps its free list links where the data would go, so no
+// block may be smaller than this
+typedef struct freeblock_s
+{
+	memblock_t	block;
+	struct freeblock_s	*nextfree, *prevfree;
+} freeblock_t;
+
+// free blocks are kept in lists by size, two levels deep: the first level
+// is the power of two the size is in, the second splits that power of two
+// into ZONE_SLCOUNT equal ranges. Sizes under ZONE_SMALL all go in the
+// first list, ZONE_SLCOUNT lists 8 bytes apart. A bit is set in flmap for
+// each first level with a free block and in slmap for each list with one,
+// so finding a list that can hold a size is two bit scans.
+#define	ZONE_SLBITS		4
+#define	ZONE_SLCOUNT	(1 << ZONE_SLBITS)
+#define	ZONE_ALIGNBITS	3
+#define	ZONE_FLSHIFT	(ZONE_SLBITS + ZONE_ALIGNBITS)
+#define	ZONE_SMALL		(1 << ZONE_FLSHIFT)
+#define	ZONE_FLCOUNT	(32 - ZONE_FLSHIFT)
+
 typedef struct
 {
 	int		size;		// total bytes malloced, including header
 	memblock_t	blocklist;	// start / end cap for linked list
-	memblock_t	*rover;
+	unsigned int	flmap;
+	unsigned int	slmap[ZONE_FLCOUNT];
+	freeblock_t	*freelists[ZONE_FLCOUNT][ZONE_SLCOUNT];
+	int		used, peak;		// bytes in allocated blocks, including headers
+	int		allocs;
 } memzone_t;
 
 void Cache_FreeLow (int new_low_hunk);
 void Cache_FreeHigh (int new_high_hunk);
 
+/*
+==============================================================================
+
+						MEMORY ACCOUNTING
+
+Every allocation from the hunk, the zone, the cache and Mem_Alloc is
+charged to a memtag_t, so that memstats can say where the memory went and
+how much of it was ever needed at once.
+==============================================================================
+*/
+
+enum
+{
+	MEMPOOL_HUNK,
+	MEMPOOL_ZONE,
+	MEMPOOL_CACHE,
+	MEMPOOL_MALLOC,
+	MEM_NUMPOOLS
+};
+
+typedef struct
+{
+	int		bytes[MEM_NUMPOOLS];
+	int		peak;		// most bytes held at once, all pools
+	int		count;		// allocations held
+	int		allocs;		// allocations ever made
+} memstats_t;
+
+memtag_t	mem_tag;
+
+static memstats_t	mem_stats[MEM_NUMTAGS];
+static int			mem_poolbytes[MEM_NUMPOOLS];
+static int			mem_poolpeak[MEM_NUMPOOLS];
+static int			hunk_peak;		// most low + high hunk used at once
+
+static const char *mem_tagnames[MEM_NUMTAGS] =
+{
+	"misc", "models", "textures", "sounds", "qc", "net", "particles"
+};
+
+static const char *mem_poolnames[MEM_NUMPOOLS] =
+{
+	"hunk", "zone", "cache", "malloc"
+};
+
+static FILE		*mem_csvfile;	// memstats_csv
+
+/*
+========================
+Mem_Charge
+
+count is +1 for a new allocation, -1 for one freed and 0 for one resized
+========================
+*/
+static void Mem_Charge (int tag, int pool, int bytes, int count)
+{
+	memstats_t	*s = &mem_stats[tag];
+	int		i, sum;
+
+	s->bytes[pool] += bytes;
+	s->count += count;
+	if (count > 0)
+		s->allocs++;
+
+	for (i = sum = 0; i < MEM_NUMPOOLS; i++)
+		sum += s->bytes[i];
+	s->peak = q_max (s->peak, sum);
+
+	mem_poolbytes[pool] += bytes;
+	mem_poolpeak[pool] = q_max (mem_poolpeak[pool], mem_poolbytes[pool]);
+}
+
+/*
+========================
+Mem_SetTag
+
+Returns the tag it replaces
+========================
+*/
+memtag_t Mem_SetTag (memtag_t tag)
+{
+	memtag_t	old = mem_tag;
+
+	mem_tag = tag;
+	return old;
+}
+
+// a Mem_Alloc block starts with this, 16 bytes to keep the data aligned
+typedef struct
+{
+	int		size;
+	int		tag;
+	int		pad[2];
+} memheader_t;
+
+/*
+========================
+Mem_Alloc
+
+malloc for memory that can't come from the hunk, charged to tag
+========================
+*/
+void *Mem_Alloc (memtag_t tag, int size)
+{
+	memheader_t	*h;
+
+	if (size < 0)
+		return NULL;
+	h = (memheader_t *) calloc (1, sizeof(memheader_t) + size);
+	if (!h)
+		return NULL;
+	h->size = size;
+	h->tag = tag;
+	Mem_Charge (tag, MEMPOOL_MALLOC, size, 1);
+
+	return (void *)(h + 1);
+}
+
+/*
+========================
+Mem_Realloc
+
+Like realloc, with anything added 0 filled
+========================
+*/
+void *Mem_Realloc (memtag_t tag, void *ptr, int size)
+{
+	memheader_t	*h;
+
+	if (!ptr)
+		return Mem_Alloc (tag, size);
+	if (size < 0)
+		return NULL;
+
+	h = (memheader_t *)ptr - 1;
+	h = (memheader_t *) realloc (h, sizeof(memheader_t) + size);
+	if (!h)
+		return NULL;
+	if (size > h->size)
+		memset ((byte *)(h + 1) + h->size, 0, size - h->size);
+	Mem_Charge (h->tag, MEMPOOL_MALLOC, size - h->size, 0);
+	h->size = size;
+
+	return (void *)(h + 1);
+}
+
+void Mem_Free (void *ptr)
+{
+	memheader_t	*h;
+
+	if (!ptr)
+		return;
+
+	h = (memheader_t *)ptr - 1;
+	Mem_Charge (h->tag, MEMPOOL_MALLOC, -h->size, -1);
+	free (h);
+}
+
 
 /*
 ==============================================================================
@@ -56,7 +239,9 @@ void Cache_FreeHigh (int new_high_hunk);
 There is never any space between memblocks, and there will never be two
 contiguous free memblocks.
 
-The rover can be left pointing at a non-empty block
+Every free memblock is on the free list for its size, allocating takes the
+first block of the smallest list that is sure to be big enough, so both
+allocating and freeing take the same time however many blocks there are.
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
@@ -65,104 +250,292 @@ all big things are allocated on the hunk.
 
 static memzone_t	*mainzone;
 
+static FILE		*zone_tracefile;	// zone_trace
+
+static void Z_TraceOp (int op, memblock_t *block, memblock_t *newblock, int size);
+
+static int Z_HighBit (unsigned int x)
+{
+#ifdef __GNUC__
+	return 31 - __builtin_clz (x);
+#else
+	int	n = 0;
+	while (x >>= 1)
+		n++;
+	return n;
+#endif
+}
+
+static int Z_LowBit (unsigned int x)
+{
+#ifdef __GNUC__
+	return __builtin_ctz (x);
+#else
+	int	n = 0;
+	while (!(x & 1))
+	{
+		x >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
 
 /*
 ========================
-Z_Free
+Z_MapSize
+
+The free list a block of size bytes goes on
 ========================
 */
-void Z_Free (void *ptr)
+static void Z_MapSize (int size, int *fl, int *sl)
 {
-	memblock_t	*block, *other;
+	int		bit;
 
-	if (!ptr)
-		Sys_Error ("Z_Free: NULL pointer");
+	if (size < ZONE_SMALL)
+	{
+		*fl = 0;
+		*sl = size >> ZONE_ALIGNBITS;
+	}
+	else
+	{
+		bit = Z_HighBit (size);
+		*fl = bit - ZONE_FLSHIFT + 1;
+		*sl = (size >> (bit - ZONE_SLBITS)) - ZONE_SLCOUNT;
+	}
+}
 
-	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-	if (block->id != ZONEID)
-		Sys_Error ("Z_Free: freed a pointer without ZONEID");
-	if (block->tag == 0)
-		Sys_Error ("Z_Free: freed a freed pointer");
+static void Z_LinkFree (memzone_t *zone, memblock_t *block)
+{
+	freeblock_t	*fb = (freeblock_t *)block;
+	int		fl, sl;
+
+	Z_MapSize (block->size, &fl, &sl);
+	fb->prevfree = NULL;
+	fb->nextfree = zone->freelists[fl][sl];
+	if (fb->nextfree)
+		fb->nextfree->prevfree = fb;
+	zone->freelists[fl][sl] = fb;
+	zone->flmap |= 1u << fl;
+	zone->slmap[fl] |= 1u << sl;
+}
+
+static void Z_UnlinkFree (memzone_t *zone, memblock_t *block)
+{
+	freeblock_t	*fb = (freeblock_t *)block;
+	int		fl, sl;
+
+	if (fb->nextfree)
+		fb->nextfree->prevfree = fb->prevfree;
+	if (fb->prevfree)
+	{
+		fb->prevfree->nextfree = fb->nextfree;
+		return;
+	}
+
+	Z_MapSize (block->size, &fl, &sl);
+	zone->freelists[fl][sl] = fb->nextfree;
+	if (!fb->nextfree)
+	{
+		zone->slmap[fl] &= ~(1u << sl);
+		if (!zone->slmap[fl])
+			zone->flmap &= ~(1u << fl);
+	}
+}
+
+/*
+========================
+Z_FindFree
+
+Returns a free block of at least size bytes, or NULL
+========================
+*/
+static memblock_t *Z_FindFree (memzone_t *zone, int size)
+{
+	unsigned int	map;
+	int		fl, sl;
+
+// round up to the start of the next list, so that any block on the list
+// found is big enough
+	if (size >= ZONE_SMALL)
+		size += (1 << (Z_HighBit (size) - ZONE_SLBITS)) - 1;
+	Z_MapSize (size, &fl, &sl);
+	if (fl >= ZONE_FLCOUNT)
+		return NULL;
+
+	map = zone->slmap[fl] & (~0u << sl);
+	if (!map)
+	{
+		if (fl + 1 >= ZONE_FLCOUNT)
+			return NULL;
+		map = zone->flmap & (~0u << (fl + 1));
+		if (!map)
+			return NULL;
+		fl = Z_LowBit (map);
+		map = zone->slmap[fl];
+	}
+	sl = Z_LowBit (map);
+
+	return &zone->freelists[fl][sl]->block;
+}
+
+/*
+========================
+Z_BlockSize
+
+Size of the block for a size byte allocation
+========================
+*/
+static int Z_BlockSize (int size)
+{
+	size += sizeof(memblock_t);	// account for size of block header
+	size += 4;					// space for memory trash tester
+	size = (size + 7) & ~7;		// align to 8-byte boundary
+	if (size < (int)sizeof(freeblock_t))
+		size = sizeof(freeblock_t);
+	return size;
+}
+
+#ifdef DEBUG
+// marker for memory trash testing
+#define	Z_SetTrash(b)	(*(int *)((byte *)(b) + (b)->size - 4) = ZONEID)
+#define	Z_Trashed(b)	(*(int *)((byte *)(b) + (b)->size - 4) != ZONEID)
+#else
+#define	Z_SetTrash(b)
+#endif
+
+/*
+========================
+Z_SplitBlock
+
+Frees the end of an allocated block beyond size, if there is enough of it
+========================
+*/
+static void Z_SplitBlock (memzone_t *zone, memblock_t *block, int size)
+{
+	memblock_t	*newblock, *other;
+	int		extra;
+
+	extra = block->size - size;
+	if (extra <= MINFRAGMENT)
+		return;
+
+	newblock = (memblock_t *) ((byte *)block + size);
+	newblock->size = extra;
+	newblock->tag = 0;			// free block
+	newblock->id = ZONEID;
+	newblock->prev = block;
+	newblock->next = block->next;
+	newblock->next->prev = newblock;
+	block->next = newblock;
+	block->size = size;
+	zone->used -= extra;
+
+	other = newblock->next;
+	if (!other->tag)
+	{	// merge the next free block onto the end
+		Z_UnlinkFree (zone, other);
+		newblock->size += other->size;
+		newblock->next = other->next;
+		newblock->next->prev = newblock;
+	}
+	Z_LinkFree (zone, newblock);
+}
 
+static void Z_FreeBlock (memzone_t *zone, memblock_t *block)
+{
+	memblock_t	*other;
+
+	zone->used -= block->size;
+	zone->allocs--;
 	block->tag = 0;		// mark as free
 
 	other = block->prev;
 	if (!other->tag)
 	{	// merge with previous free block
+		Z_UnlinkFree (zone, other);
 		other->size += block->size;
 		other->next = block->next;
 		other->next->prev = other;
-		if (block == mainzone->rover)
-			mainzone->rover = other;
 		block = other;
 	}
 
 	other = block->next;
 	if (!other->tag)
 	{	// merge the next free block onto the end
+		Z_UnlinkFree (zone, other);
 		block->size += other->size;
 		block->next = other->next;
 		block->next->prev = block;
-		if (other == mainzone->rover)
-			mainzone->rover = block;
 	}
+
+	Z_LinkFree (zone, block);
 }
 
+static memblock_t *Z_CheckBlock (void *ptr, const char *func)
+{
+	memblock_t	*block;
+
+	if (!ptr)
+		Sys_Error ("%s: NULL pointer", func);
+
+	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
+	if (block->id != ZONEID)
+		Sys_Error ("%s: pointer without ZONEID", func);
+	if (block->tag == 0)
+		Sys_Error ("%s: pointer already freed", func);
+#ifdef DEBUG
+	if (Z_Trashed (block))
+		Sys_Error ("%s: memory written past the end of a block", func);
+#endif
+
+	return block;
+}
 
-static void *Z_TagMalloc (int size, int tag)
+/*
+========================
+Z_Free
+========================
+*/
+void Z_Free (void *ptr)
 {
-	int		extra;
-	memblock_t	*start, *rover, *newblock, *base;
+	memblock_t	*block;
 
-	if (!tag)
-		Host_Error ("Z_TagMalloc: tried to use a 0 tag");
+	block = Z_CheckBlock (ptr, "Z_Free");
+	if (zone_tracefile)
+		Z_TraceOp ('F', block, NULL, 0);
+	Mem_Charge (block->tag - 1, MEMPOOL_ZONE, -block->size, -1);
+	Z_FreeBlock (mainzone, block);
+}
 
-//
-// scan through the block list looking for the first free block
-// of sufficient size
-//
-	size += sizeof(memblock_t);	// account for size of block header
-	size += 4;					// space for memory trash tester
-	size = (size + 7) & ~7;		// align to 8-byte boundary
 
-	base = rover = mainzone->rover;
-	start = base->prev;
+static void *Z_TagMalloc (memzone_t *zone, int size, int tag)
+{
+	memblock_t	*base;
 
-	do
-	{
-		if (rover == start)	// scaned all the way around the list
-			return NULL;
-		if (rover->tag)
-			base = rover = rover->next;
-		else
-			rover = rover->next;
-	} while (base->tag || base->size < size);
+	if (!tag)
+		Host_Error ("Z_TagMalloc: tried to use a 0 tag");
+	if (size < 0 || size > zone->size)
+		return NULL;
+
+	size = Z_BlockSize (size);
+	base = Z_FindFree (zone, size);
+	if (!base)
+		return NULL;
 
 //
 // found a block big enough
 //
-	extra = base->size - size;
-	if (extra >  MINFRAGMENT)
-	{	// there will be a free fragment after the allocated block
-		newblock = (memblock_t *) ((byte *)base + size );
-		newblock->size = extra;
-		newblock->tag = 0;			// free block
-		newblock->prev = base;
-		newblock->id = ZONEID;
-		newblock->next = base->next;
-		newblock->next->prev = newblock;
-		base->next = newblock;
-		base->size = size;
-	}
-
+	Z_UnlinkFree (zone, base);
 	base->tag = tag;				// no longer a free block
-
-	mainzone->rover = base->next;	// next allocation will start looking here
-
 	base->id = ZONEID;
+	zone->used += base->size;
+	zone->allocs++;
 
-// marker for memory trash testing
-	*(int *)((byte *)base + base->size - 4) = ZONEID;
+	Z_SplitBlock (zone, base, size);
+	zone->peak = q_max (zone->peak, zone->used);
+
+	Z_SetTrash (base);
 
 	return (void *) ((byte *)base + sizeof(memblock_t));
 }
@@ -172,12 +545,22 @@ static void *Z_TagMalloc (int size, int tag)
 Z_CheckHeap
 ========================
 */
+#ifdef DEBUG
 static void Z_CheckHeap (void)
 {
 	memblock_t	*block;
+	int		fl, sl;
 
 	for (block = mainzone->blocklist.next ; ; block = block->next)
 	{
+		if (block->tag && Z_Trashed (block))
+			Host_Error ("Z_CheckHeap: memory written past the end of a block\n");
+		if (!block->tag)
+		{
+			Z_MapSize (block->size, &fl, &sl);
+			if (!(mainzone->slmap[fl] & (1u << sl)))
+				Host_Error ("Z_CheckHeap: free block not on a free list\n");
+		}
 		if (block->next == &mainzone->blocklist)
 			break;			// all blocks have been hit
 		if ( (byte *)block + block->size != (byte *)block->next)
@@ -188,110 +571,583 @@ static void Z_CheckHeap (void)
 			Host_Error ("Z_CheckHeap: two consecutive free blocks\n");
 	}
 }
+#endif
+
+
+/*
+========================
+Z_Malloc
+========================
+*/
+void *Z_Malloc (int size)
+{
+	void	*buf;
+
+#ifdef DEBUG
+	Z_CheckHeap ();
+#endif
+	buf = Z_TagMalloc (mainzone, size, 1 + mem_tag);	// tag 0 is free
+	if (!buf)
+		Host_Error ("Z_Malloc: failed on allocation of %i bytes",size);
+	Q_memset (buf, 0, size);
+	Mem_Charge (mem_tag, MEMPOOL_ZONE, ((memblock_t *)buf - 1)->size, 1);
+
+	if (zone_tracefile)
+		Z_TraceOp ('M', NULL, (memblock_t *)buf - 1, size);
+
+	return buf;
+}
+
+/*
+========================
+Z_TagRealloc
+
+Grows or shrinks the block where it is when it can, returns NULL if there
+is no room for it
+========================
+*/
+static void *Z_TagRealloc (memzone_t *zone, void *ptr, int size)
+{
+	int old_size, newsize;
+	memblock_t *block, *next;
+	void *newptr;
+
+	block = (memblock_t *) ((byte *) ptr - sizeof (memblock_t));
+	old_size = block->size;
+	old_size -= (4 + (int)sizeof(memblock_t));	/* see Z_TagMalloc() */
+
+	newsize = Z_BlockSize (size);
+	next = block->next;
+	if (newsize > block->size && !next->tag && block->size + next->size >= newsize)
+	{	// take in the free block after it
+		Z_UnlinkFree (zone, next);
+		block->size += next->size;
+		block->next = next->next;
+		block->next->prev = block;
+		zone->used += next->size;
+	}
+
+	if (newsize <= block->size)
+	{
+		Z_SplitBlock (zone, block, newsize);
+		Z_SetTrash (block);
+		zone->peak = q_max (zone->peak, zone->used);
+		newptr = ptr;
+	}
+	else
+	{
+		newptr = Z_TagMalloc (zone, size, block->tag);
+		if (!newptr)
+			return NULL;
+		memcpy (newptr, ptr, q_min(old_size, size));
+		Z_FreeBlock (zone, block);
+	}
+
+	if (old_size < size)
+		memset ((byte *)newptr + old_size, 0, size - old_size);
+
+	return newptr;
+}
+
+/*
+========================
+Z_Realloc
+========================
+*/
+void *Z_Realloc(void *ptr, int size)
+{
+	void *old_ptr;
+	memblock_t *block;
+	int old_size;
+
+	if (!ptr)
+		return Z_Malloc (size);
+
+	block = Z_CheckBlock (ptr, "Z_Realloc");
+	if (size < 0)
+		Sys_Error ("Z_Realloc: failed on allocation of %i bytes", size);
+
+	old_ptr = ptr;
+	old_size = block->size;
+	ptr = Z_TagRealloc (mainzone, ptr, size);
+	if (!ptr)
+		Sys_Error ("Z_Realloc: failed on allocation of %i bytes", size);
+	block = (memblock_t *)ptr - 1;
+	Mem_Charge (block->tag - 1, MEMPOOL_ZONE, block->size - old_size, 0);
+
+	if (zone_tracefile)
+		Z_TraceOp ('R', (memblock_t *)old_ptr - 1, (memblock_t *)ptr - 1, size);
+
+	return ptr;
+}
+
+char *Z_Strdup (const char *s)
+{
+	size_t sz = strlen(s) + 1;
+	char *ptr = (char *) Z_Malloc (sz);
+	memcpy (ptr, s, sz);
+	return ptr;
+}
+
+
+/*
+========================
+Z_Print
+========================
+*/
+void Z_Print (memzone_t *zone)
+{
+	memblock_t	*block;
+
+	Con_Printf ("zone size: %i  location: %p\n",zone->size,zone);
+	Con_Printf ("%i blocks, %i bytes in use, %i peak\n", zone->allocs, zone->used, zone->peak);
+
+	for (block = zone->blocklist.next ; ; block = block->next)
+	{
+		Con_Printf ("block:%p    size:%7i    tag:%3i\n",
+			block, block->size, block->tag);
+
+		if (block->next == &zone->blocklist)
+			break;			// all blocks have been hit
+		if ( (byte *)block + block->size != (byte *)block->next)
+			Con_Printf ("ERROR: block size does not touch the next block\n");
+		if ( block->next->prev != block)
+			Con_Printf ("ERROR: next block doesn't have proper back link\n");
+		if (!block->tag && !block->next->tag)
+			Con_Printf ("ERROR: two consecutive free blocks\n");
+	}
+}
+
+
+/*
+==============================================================================
+
+						ZONE ALLOCATION TRACES
+
+zone_trace writes every Z_Malloc, Z_Free and Z_Realloc to a file while a
+game is played, and zone_bench plays the file back against a zone of its
+own and against the system malloc, to time the allocator on what the game
+really does. Blocks are named by where they are in the zone, which is
+unique among the blocks allocated at the same time.
+==============================================================================
+*/
+
+#define	ZTRACE_VERSION	1
+
+typedef struct
+{
+	int		op;			// 'M', 'F' or 'R'
+	int		block;		// the block freed or realloced
+	int		newblock;	// the block allocated or realloced
+	int		size;
+} ztraceop_t;
+
+static void Z_TraceOp (int op, memblock_t *block, memblock_t *newblock, int size)
+{
+	ztraceop_t	t;
+
+	t.op = op;
+	t.block = block ? (int)((byte *)block - (byte *)mainzone) : 0;
+	t.newblock = newblock ? (int)((byte *)newblock - (byte *)mainzone) : 0;
+	t.size = size;
+	if (fwrite (&t, sizeof(t), 1, zone_tracefile) != 1)
+	{
+		Con_Printf ("zone_trace: write failed, stopped\n");
+		fclose (zone_tracefile);
+		zone_tracefile = NULL;
+	}
+}
+
+/*
+========================
+Z_Trace_f
+
+zone_trace <file> | stop
+========================
+*/
+static void Z_Trace_f (void)
+{
+	char	name[MAX_OSPATH];
+	int		header[2];
+
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf ("zone_trace <file> : write zone allocations to file\n");
+		Con_Printf ("zone_trace stop   : stop writing\n");
+		return;
+	}
+
+	if (zone_tracefile)
+	{
+		fclose (zone_tracefile);
+		zone_tracefile = NULL;
+		Con_Printf ("zone trace stopped\n");
+	}
+	if (!strcmp (Cmd_Argv(1), "stop"))
+		return;
+
+	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
+	COM_AddExtension (name, ".ztr", sizeof(name));
+	zone_tracefile = fopen (name, "wb");
+	if (!zone_tracefile)
+	{
+		Con_Printf ("zone_trace: couldn't create %s\n", name);
+		return;
+	}
+	header[0] = LittleLong (('Z'<<24) | ('T'<<16) | ('R'<<8) | 'C');
+	header[1] = ZTRACE_VERSION;
+	fwrite (header, sizeof(header), 1, zone_tracefile);
+	Con_Printf ("writing zone trace to %s\n", name);
+}
+
+/*
+========================
+Z_BenchPass
+
+Plays the trace once, with the zone allocator if zone is set or the system
+malloc if not, and returns the seconds it took. live is indexed by block
+number / 8, and is left empty.
+========================
+*/
+static double Z_BenchPass (memzone_t *zone, const ztraceop_t *ops, int numops, void **live, int numlive, int *failed)
+{
+	const ztraceop_t	*t;
+	double	start, time;
+	void	*p;
+	int		i;
+
+	*failed = 0;
+	start = Sys_PreciseTime ();
+	for (i = 0, t = ops; i < numops; i++, t++)
+	{
+		switch (t->op)
+		{
+		case 'M':
+			p = zone ? Z_TagMalloc (zone, t->size, 1) : malloc (t->size);
+			if (!p)
+			{
+				(*failed)++;
+				break;
+			}
+			memset (p, 0, t->size);
+			live[t->newblock >> 3] = p;
+			break;
+		case 'F':
+			p = live[t->block >> 3];
+			if (!p)
+				break;		// allocated before the trace started
+			if (zone)
+				Z_FreeBlock (zone, (memblock_t *)p - 1);
+			else
+				free (p);
+			live[t->block >> 3] = NULL;
+			break;
+		case 'R':
+			p = live[t->block >> 3];
+			live[t->block >> 3] = NULL;
+			if (zone)
+				p = p ? Z_TagRealloc (zone, p, t->size) : Z_TagMalloc (zone, t->size, 1);
+			else
+				p = realloc (p, t->size);
+			if (!p)
+			{
+				(*failed)++;
+				break;
+			}
+			live[t->newblock >> 3] = p;
+			break;
+		}
+	}
+	time = Sys_PreciseTime () - start;
+
+	for (i = 0; i < numlive; i++)
+	{
+		if (!live[i])
+			continue;
+		if (zone)
+			Z_FreeBlock (zone, (memblock_t *)live[i] - 1);
+		else
+			free (live[i]);
+		live[i] = NULL;
+	}
+
+	return time;
+}
+
+static void Memory_InitZone (memzone_t *zone, int size);
+
+/*
+========================
+Z_Bench_f
+
+zone_bench <file> [passes]
+========================
+*/
+static void Z_Bench_f (void)
+{
+	char	name[MAX_OSPATH];
+	FILE	*f;
+	ztraceop_t	*ops;
+	memzone_t	*zone;
+	void	**live;
+	int		header[2];
+	int		numops, numlive, passes, pass, i, counts[3], failed, peak;
+	long	len;
+	double	ztime, mtime, t;
+
+	if (Cmd_Argc() < 2)
+	{
+		Con_Printf ("zone_bench <file> [passes] : time the zone allocator on a zone_trace file\n");
+		return;
+	}
+	passes = (Cmd_Argc() > 2) ? q_max (1, Q_atoi (Cmd_Argv(2))) : 10;
+
+	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
+	COM_AddExtension (name, ".ztr", sizeof(name));
+	f = fopen (name, "rb");
+	if (!f)
+	{
+		Con_Printf ("zone_bench: couldn't open %s\n", name);
+		return;
+	}
+	fseek (f, 0, SEEK_END);
+	len = ftell (f) - (long)sizeof(header);
+	fseek (f, 0, SEEK_SET);
+	if (len < 0 || fread (header, sizeof(header), 1, f) != 1 ||
+		LittleLong (header[0]) != (('Z'<<24) | ('T'<<16) | ('R'<<8) | 'C') || header[1] != ZTRACE_VERSION)
+	{
+		Con_Printf ("zone_bench: %s is not a version %i zone trace\n", name, ZTRACE_VERSION);
+		fclose (f);
+		return;
+	}
+	numops = len / sizeof(ztraceop_t);
+	ops = (ztraceop_t *) malloc (numops * sizeof(ztraceop_t) + 1);
+	numlive = mainzone->size / 8;
+	live = (void **) calloc (numlive, sizeof(void *));
+	zone = (memzone_t *) malloc (mainzone->size);
+	if (!ops || !live || !zone || (int)fread (ops, sizeof(ztraceop_t), numops, f) != numops)
+	{
+		Con_Printf ("zone_bench: couldn't load %s\n", name);
+		free (ops);
+		free (live);
+		free (zone);
+		fclose (f);
+		return;
+	}
+	fclose (f);
+
+	counts[0] = counts[1] = counts[2] = 0;
+	for (i = 0; i < numops; i++)
+	{
+		if ((unsigned)ops[i].block >= (unsigned)mainzone->size || (unsigned)ops[i].newblock >= (unsigned)mainzone->size)
+		{
+			Con_Printf ("zone_bench: %s was written with a bigger zone\n", name);
+			numops = 0;
+			break;
+		}
+		counts[ops[i].op == 'M' ? 0 : ops[i].op == 'F' ? 1 : 2]++;
+	}
+	Con_Printf ("%i mallocs, %i frees, %i reallocs\n", counts[0], counts[1], counts[2]);
+
+	Memory_InitZone (zone, mainzone->size);
+	ztime = mtime = 0;
+	peak = 0;
+	for (pass = 0; pass < passes && numops; pass++)
+	{
+		t = Z_BenchPass (zone, ops, numops, live, numlive, &failed);
+		if (!pass || t < ztime)
+			ztime = t;
+		if (failed && !pass)
+			Con_Printf ("zone: %i allocations failed\n", failed);
+		peak = zone->peak;
+
+		t = Z_BenchPass (NULL, ops, numops, live, numlive, &failed);
+		if (!pass || t < mtime)
+			mtime = t;
+	}
+	if (numops)
+	{
+		Con_Printf ("zone:   %8.3f ms, %6.1f ns/op, peak %i bytes\n", ztime * 1000.0, ztime * 1e9 / numops, peak);
+		Con_Printf ("malloc: %8.3f ms, %6.1f ns/op\n", mtime * 1000.0, mtime * 1e9 / numops);
+	}
+
+	free (ops);
+	free (live);
+	free (zone);
+}
+
+
+/*
+==============================================================================
+
+						FRAME ARENAS
+
+Memory that is only needed for a while is taken from the end of an arena
+and all given back at once: the server arena after every server frame, the
+client arena at the end of every host frame. Nothing is ever freed on its
+own, but Frame_LowMark and Frame_FreeToLowMark work as they do for the
+hunk, for a user that would otherwise use up the arena over a frame.
+
+An arena is a list of chunks. When a frame has needed more than the first
+one, the reset puts them all in one chunk big enough for that frame, so an
+arena soon settles into a single chunk.
+==============================================================================
+*/
 
+#define	FRAME_CHUNKSIZE	(64 * 1024)
 
-/*
-========================
-Z_Malloc
-========================
-*/
-void *Z_Malloc (int size)
+typedef struct framechunk_s
 {
-	void	*buf;
+	struct framechunk_s	*next;
+	int		start;		// offset of the chunk in the arena
+	int		size;
+} framechunk_t;
 
-	Z_CheckHeap ();	// DEBUG
-	buf = Z_TagMalloc (size, 1);
-	if (!buf)
-		Host_Error ("Z_Malloc: failed on allocation of %i bytes",size);
-	Q_memset (buf, 0, size);
+#define	FRAME_HEADERSIZE	((int)(sizeof(framechunk_t) + 15) & ~15)
 
-	return buf;
+typedef struct
+{
+	const char		*name;
+	framechunk_t	*chunks;
+	framechunk_t	*current;
+	int		used;			// in current
+	int		high;			// most used this frame
+	int		lastframe;		// most used in the frame before
+	int		peak;			// most used in any frame
+} arena_t;
+
+static arena_t	frame_arenas[FRAME_NUMARENAS] =
+{
+	{"client"},
+	{"server"}
+};
+
+static arena_t	frame_temp = {"temp"};	// Hunk_TempAlloc, reset at each call
+
+static framechunk_t *Frame_NewChunk (int size, int start)
+{
+	framechunk_t	*c;
+
+	c = (framechunk_t *) Mem_Alloc (MEM_MISC, FRAME_HEADERSIZE + size);
+	if (!c)
+		Sys_Error ("Frame_Alloc: couldn't allocate %i bytes", size);
+	c->size = size;
+	c->start = start;
+	return c;
 }
 
-/*
-========================
-Z_Realloc
-========================
-*/
-void *Z_Realloc(void *ptr, int size)
+static void Frame_FreeChunks (framechunk_t *c)
 {
-	int old_size;
-	void *old_ptr;
-	memblock_t *block;
+	framechunk_t	*next;
 
-	if (!ptr)
-		return Z_Malloc (size);
+	for ( ; c; c = next)
+	{
+		next = c->next;
+		Mem_Free (c);
+	}
+}
 
-	block = (memblock_t *) ((byte *) ptr - sizeof (memblock_t));
-	if (block->id != ZONEID)
-		Sys_Error ("Z_Realloc: realloced a pointer without ZONEID");
-	if (block->tag == 0)
-		Sys_Error ("Z_Realloc: realloced a freed pointer");
+static void *Arena_Alloc (arena_t *a, int size)
+{
+	framechunk_t	*c;
+	void	*buf;
 
-	old_size = block->size;
-	old_size -= (4 + (int)sizeof(memblock_t));	/* see Z_TagMalloc() */
-	old_ptr = ptr;
+	if (size < 0)
+		Sys_Error ("Frame_Alloc: bad size %i", size);
+	size = (size + 15) & ~15;
 
-	Z_Free (ptr);
-	ptr = Z_TagMalloc (size, 1);
-	if (!ptr)
-		Sys_Error ("Z_Realloc: failed on allocation of %i bytes", size);
+	c = a->current;
+	if (!c)
+		c = a->current = a->chunks = Frame_NewChunk (q_max (size, FRAME_CHUNKSIZE), 0);
+	else if (a->used + size > c->size)
+	{
+	// move on to the next chunk, if it is big enough
+		if (!c->next || c->next->size < size)
+		{
+			Frame_FreeChunks (c->next);
+			c->next = Frame_NewChunk (q_max (size, FRAME_CHUNKSIZE), 0);
+		}
+		c->next->start = c->start + c->size;
+		c = a->current = c->next;
+		a->used = 0;
+	}
 
-	if (ptr != old_ptr)
-		memmove (ptr, old_ptr, q_min(old_size, size));
-	if (old_size < size)
-		memset ((byte *)ptr + old_size, 0, size - old_size);
+	buf = (byte *)c + FRAME_HEADERSIZE + a->used;
+	a->used += size;
+	a->high = q_max (a->high, c->start + a->used);
 
-	return ptr;
+	return buf;
 }
 
-char *Z_Strdup (const char *s)
+static void Arena_Reset (arena_t *a)
 {
-	size_t sz = strlen(s) + 1;
-	char *ptr = (char *) Z_Malloc (sz);
-	memcpy (ptr, s, sz);
-	return ptr;
-}
+	int		size;
+
+	a->lastframe = a->high;
+	a->peak = q_max (a->peak, a->high);
 
+	if (a->current && a->current != a->chunks)
+	{	// this frame didn't fit in one chunk, so make one it would fit in
+		size = (a->high + FRAME_CHUNKSIZE - 1) & ~(FRAME_CHUNKSIZE - 1);
+		Frame_FreeChunks (a->chunks);
+		a->chunks = Frame_NewChunk (size, 0);
+	}
+	a->current = a->chunks;
+	a->used = 0;
+	a->high = 0;
+}
 
 /*
-========================
-Z_Print
-========================
+===================
+Frame_Alloc
+
+16 byte aligned, not cleared, and gone when the arena is reset
+===================
 */
-void Z_Print (memzone_t *zone)
+void *Frame_Alloc (framearena_t arena, int size)
 {
-	memblock_t	*block;
+	return Arena_Alloc (&frame_arenas[arena], size);
+}
 
-	Con_Printf ("zone size: %i  location: %p\n",mainzone->size,mainzone);
+int Frame_LowMark (framearena_t arena)
+{
+	arena_t	*a = &frame_arenas[arena];
 
-	for (block = zone->blocklist.next ; ; block = block->next)
-	{
-		Con_Printf ("block:%p    size:%7i    tag:%3i\n",
-			block, block->size, block->tag);
+	return a->current ? a->current->start + a->used : 0;
+}
 
-		if (block->next == &zone->blocklist)
-			break;			// all blocks have been hit
-		if ( (byte *)block + block->size != (byte *)block->next)
-			Con_Printf ("ERROR: block size does not touch the next block\n");
-		if ( block->next->prev != block)
-			Con_Printf ("ERROR: next block doesn't have proper back link\n");
-		if (!block->tag && !block->next->tag)
-			Con_Printf ("ERROR: two consecutive free blocks\n");
-	}
+void Frame_FreeToLowMark (framearena_t arena, int mark)
+{
+	arena_t		*a = &frame_arenas[arena];
+	framechunk_t	*c;
+
+	if (!a->current)
+		return;
+	if (mark < 0 || mark > a->current->start + a->used)
+		Sys_Error ("Frame_FreeToLowMark: bad mark %i", mark);
+
+	for (c = a->chunks; c != a->current && mark >= c->start + c->size; c = c->next)
+		;
+	a->current = c;
+	a->used = mark - c->start;
 }
 
+void Frame_Reset (framearena_t arena)
+{
+	Arena_Reset (&frame_arenas[arena]);
+}
 
 //============================================================================
 
 #define	HUNK_SENTINAL	0x1df001ed
 
-#define HUNKNAME_LEN	24
+#define HUNKNAME_LEN	20
 typedef struct
 {
 	int		sentinal;
 	int		size;		// including sizeof(hunk_t), -1 = not allocated
 	char	name[HUNKNAME_LEN];
+	int		tag;		// memtag_t, -1 = not charged
 } hunk_t;
 
 byte	*hunk_base;
@@ -300,8 +1156,54 @@ int		hunk_size;
 int		hunk_low_used;
 int		hunk_high_used;
 
-qboolean	hunk_tempactive;
-int		hunk_tempmark;
+// When the platform can reserve address space, hunk_size is the whole
+// reservation and pages are only committed as the low and high hunks grow
+// into them. hunk_cachesize is the -heapsize the fixed hunk would have had,
+// and keeps the cache from spreading over the rest of the reservation.
+static qboolean	hunk_reserved;
+static int		hunk_cachesize;
+static int		hunk_lowcommit;		// bytes committed from the bottom
+static int		hunk_highcommit;	// bytes committed from the top
+
+#define	HUNK_COMMITSTEP	(1024*1024)
+#define	CACHE_MINSIZE	(16*1024*1024)	// cache space kept once the hunk is past -heapsize
+
+/*
+==============
+Hunk_CommitLow
+
+Makes the bottom top bytes of the hunk usable
+==============
+*/
+static void Hunk_CommitLow (int top)
+{
+	int		start;
+
+	if (!hunk_reserved || top <= hunk_lowcommit)
+		return;
+	top = q_min ((top + HUNK_COMMITSTEP - 1) & ~(HUNK_COMMITSTEP - 1), hunk_size);
+	start = q_max (hunk_lowcommit, 0);
+	if (!Sys_CommitMemory (hunk_base + start, top - start))
+		Sys_Error ("Hunk_CommitLow: couldn't commit %i bytes", top);
+	hunk_lowcommit = top;
+}
+
+/*
+==============
+Hunk_CommitHigh
+
+Makes the top used bytes of the hunk usable
+==============
+*/
+static void Hunk_CommitHigh (int used)
+{
+	if (!hunk_reserved || used <= hunk_highcommit)
+		return;
+	used = q_min ((used + HUNK_COMMITSTEP - 1) & ~(HUNK_COMMITSTEP - 1), hunk_size);
+	if (!Sys_CommitMemory (hunk_base + hunk_size - used, used - hunk_highcommit))
+		Sys_Error ("Hunk_CommitHigh: couldn't commit %i bytes", used);
+	hunk_highcommit = used;
+}
 
 /*
 ==============
@@ -446,12 +1348,16 @@ void *Hunk_AllocName (int size, const char *name)
 	hunk_low_used += size;
 
 	Cache_FreeLow (hunk_low_used);
+	Hunk_CommitLow (hunk_low_used);
 
 	memset (h, 0, size);
 
 	h->size = size;
 	h->sentinal = HUNK_SENTINAL;
 	q_strlcpy (h->name, name, HUNKNAME_LEN);
+	h->tag = mem_tag;
+	Mem_Charge (mem_tag, MEMPOOL_HUNK, size, 1);
+	hunk_peak = q_max (hunk_peak, hunk_low_used + hunk_high_used);
 
 	return (void *)(h+1);
 }
@@ -466,6 +1372,26 @@ void *Hunk_Alloc (int size)
 	return Hunk_AllocName (size, "unknown");
 }
 
+/*
+===================
+Hunk_Uncharge
+
+Takes the hunk blocks from start to end off the memory accounts
+===================
+*/
+static void Hunk_Uncharge (byte *start, byte *end)
+{
+	hunk_t	*h;
+
+	for (h = (hunk_t *)start ; (byte *)h < end ; h = (hunk_t *)((byte *)h+h->size))
+	{
+		if (h->sentinal != HUNK_SENTINAL || h->size < (int) sizeof(hunk_t))
+			Sys_Error ("Hunk_Uncharge: trashed hunk block");
+		if (h->tag >= 0)
+			Mem_Charge (h->tag, MEMPOOL_HUNK, -h->size, -1);
+	}
+}
+
 int	Hunk_LowMark (void)
 {
 	return hunk_low_used;
@@ -475,30 +1401,21 @@ void Hunk_FreeToLowMark (int mark)
 {
 	if (mark < 0 || mark > hunk_low_used)
 		Sys_Error ("Hunk_FreeToLowMark: bad mark %i", mark);
+	Hunk_Uncharge (hunk_base + mark, hunk_base + hunk_low_used);
 	memset (hunk_base + mark, 0, hunk_low_used - mark);
 	hunk_low_used = mark;
 }
 
 int	Hunk_HighMark (void)
 {
-	if (hunk_tempactive)
-	{
-		hunk_tempactive = false;
-		Hunk_FreeToHighMark (hunk_tempmark);
-	}
-
 	return hunk_high_used;
 }
 
 void Hunk_FreeToHighMark (int mark)
 {
-	if (hunk_tempactive)
-	{
-		hunk_tempactive = false;
-		Hunk_FreeToHighMark (hunk_tempmark);
-	}
 	if (mark < 0 || mark > hunk_high_used)
 		Sys_Error ("Hunk_FreeToHighMark: bad mark %i", mark);
+	Hunk_Uncharge (hunk_base + hunk_size - hunk_high_used, hunk_base + hunk_size - mark);
 	memset (hunk_base + hunk_size - hunk_high_used, 0, hunk_high_used - mark);
 	hunk_high_used = mark;
 }
@@ -516,12 +1433,6 @@ void *Hunk_HighAllocName (int size, const char *name)
 	if (size < 0)
 		Sys_Error ("Hunk_HighAllocName: bad size: %i", size);
 
-	if (hunk_tempactive)
-	{
-		Hunk_FreeToHighMark (hunk_tempmark);
-		hunk_tempactive = false;
-	}
-
 #ifdef PARANOID
 	Hunk_Check ();
 #endif
@@ -536,6 +1447,7 @@ void *Hunk_HighAllocName (int size, const char *name)
 
 	hunk_high_used += size;
 	Cache_FreeHigh (hunk_high_used);
+	Hunk_CommitHigh (hunk_high_used);
 
 	h = (hunk_t *)(hunk_base + hunk_size - hunk_high_used);
 
@@ -543,6 +1455,9 @@ void *Hunk_HighAllocName (int size, const char *name)
 	h->size = size;
 	h->sentinal = HUNK_SENTINAL;
 	q_strlcpy (h->name, name, HUNKNAME_LEN);
+	h->tag = mem_tag;
+	Mem_Charge (mem_tag, MEMPOOL_HUNK, size, 1);
+	hunk_peak = q_max (hunk_peak, hunk_low_used + hunk_high_used);
 
 	return (void *)(h+1);
 }
@@ -552,28 +1467,15 @@ void *Hunk_HighAllocName (int size, const char *name)
 =================
 Hunk_TempAlloc
 
-Return space from the top of the hunk
+Return space that lasts until the next call. It comes from an arena of its
+own rather than the top of the hunk, so that it doesn't push cached data
+out of the way every time.
 =================
 */
 void *Hunk_TempAlloc (int size)
 {
-	void	*buf;
-
-	size = (size+15)&~15;
-
-	if (hunk_tempactive)
-	{
-		Hunk_FreeToHighMark (hunk_tempmark);
-		hunk_tempactive = false;
-	}
-
-	hunk_tempmark = Hunk_HighMark ();
-
-	buf = Hunk_HighAllocName (size, "temp");
-
-	hunk_tempactive = true;
-
-	return buf;
+	Arena_Reset (&frame_temp);
+	return Arena_Alloc (&frame_temp, size);
 }
 
 char *Hunk_Strdup (const char *s, const char *name)
@@ -598,6 +1500,7 @@ typedef struct cache_system_s
 	int			size;		// including this header
 	cache_user_t		*user;
 	char			name[CACHENAME_LEN];
+	int			tag;		// memtag_t
 	struct cache_system_s	*prev, *next;
 	struct cache_system_s	*lru_prev, *lru_next;	// for LRU flushing
 } cache_system_t;
@@ -606,6 +1509,26 @@ cache_system_t *Cache_TryAlloc (int size, qboolean nobottom);
 
 cache_system_t	cache_head;
 
+/*
+============
+Cache_Top
+
+End of the space the cache may use with high_used bytes of high hunk. With
+a fixed hunk that is everything below the high hunk; with a reserved one it
+is what a fixed -heapsize hunk would have left, and never less than
+CACHE_MINSIZE above the low hunk.
+============
+*/
+static byte *Cache_Top (int high_used)
+{
+	int		top;
+
+	top = hunk_size - high_used;
+	if (hunk_reserved)
+		top = q_min (top, q_max (hunk_cachesize - high_used, hunk_low_used + CACHE_MINSIZE));
+	return hunk_base + top;
+}
+
 /*
 ===========
 Cache_Move
@@ -624,7 +1547,9 @@ void Cache_Move ( cache_system_t *c)
 		Q_memcpy ( new_cs+1, c+1, c->size - sizeof(cache_system_t) );
 		new_cs->user = c->user;
 		Q_memcpy (new_cs->name, c->name, sizeof(new_cs->name));
+		new_cs->tag = c->tag;
 		Cache_Free (c->user, false); //johnfitz -- added second argument
+		Mem_Charge (new_cs->tag, MEMPOOL_CACHE, new_cs->size, 1);
 		new_cs->user->data = (void *)(new_cs+1);
 	}
 	else
@@ -674,7 +1599,7 @@ void Cache_FreeHigh (int new_high_hunk)
 		c = cache_head.prev;
 		if (c == &cache_head)
 			return;		// nothing in cache at all
-		if ( (byte *)c + c->size <= hunk_base + hunk_size - new_high_hunk)
+		if ( (byte *)c + c->size <= Cache_Top (new_high_hunk))
 			return;		// there is space to grow the hunk
 		if (c == prev)
 			Cache_Free (c->user, true);	// didn't move out of the way //johnfitz -- added second argument
@@ -728,6 +1653,7 @@ cache_system_t *Cache_TryAlloc (int size, qboolean nobottom)
 			Sys_Error ("Cache_TryAlloc: %i is greater then free hunk", size);
 
 		new_cs = (cache_system_t *) (hunk_base + hunk_low_used);
+		Hunk_CommitLow (hunk_low_used + size);
 		memset (new_cs, 0, sizeof(*new_cs));
 		new_cs->size = size;
 
@@ -770,8 +1696,9 @@ cache_system_t *Cache_TryAlloc (int size, qboolean nobottom)
 	} while (cs != &cache_head);
 
 // try to allocate one at the very end
-	if ( hunk_base + hunk_size - hunk_high_used - (byte *)new_cs >= size)
+	if ( Cache_Top (hunk_high_used) - (byte *)new_cs >= size)
 	{
+		Hunk_CommitLow ((byte *)new_cs + size - hunk_base);
 		memset (new_cs, 0, sizeof(*new_cs));
 		new_cs->size = size;
 
@@ -825,7 +1752,90 @@ Cache_Report
 */
 void Cache_Report (void)
 {
-	Con_DPrintf ("%4.1f megabyte data cache\n", (hunk_size - hunk_high_used - hunk_low_used) / (float)(1024*1024) );
+	Con_DPrintf ("%4.1f megabyte data cache\n", (Cache_Top (hunk_high_used) - hunk_base - hunk_low_used) / (float)(1024*1024) );
+}
+
+/*
+============
+Cache_Compact
+
+Slides every cache block down against the low hunk, so that the space
+above them is in one piece. Block order and LRU order are kept.
+============
+*/
+static void Cache_Compact (void)
+{
+	cache_system_t	*c, *dest;
+	byte	*start;
+
+	start = hunk_base + hunk_low_used;
+	for (c = cache_head.next ; c != &cache_head ; c = dest->next)
+	{
+		dest = (cache_system_t *)start;
+		if (dest != c)
+		{
+			memmove (dest, c, c->size);
+			dest->prev->next = dest;
+			dest->next->prev = dest;
+			dest->lru_prev->lru_next = dest;
+			dest->lru_next->lru_prev = dest;
+			dest->user->data = (void *)(dest+1);
+		}
+		start = (byte *)dest + dest->size;
+	}
+}
+
+/*
+============
+Hunk_Trim
+
+Gives the committed pages that neither the hunk nor the cache use back to
+the system. Called at map changes, once the last level has been freed, so
+that a big map doesn't keep its memory for the rest of the session. The
+cache was pushed up by the level's hunk, so it is packed down first.
+============
+*/
+void Hunk_Trim (void)
+{
+	int		low, high, start, end, released;
+
+	if (!hunk_reserved)
+		return;
+
+	Cache_Compact ();
+
+	released = 0;
+	low = hunk_low_used;
+	if (cache_head.prev != &cache_head)
+		low = (byte *)cache_head.prev + cache_head.prev->size - hunk_base;
+	low = q_min ((low + HUNK_COMMITSTEP - 1) & ~(HUNK_COMMITSTEP - 1), hunk_size);
+	if (hunk_lowcommit > low)
+	{
+	// pages the high hunk committed too are left for it to release
+		end = q_min (hunk_lowcommit, hunk_size - hunk_highcommit);
+		if (end > low)
+		{
+			Sys_DecommitMemory (hunk_base + low, end - low);
+			released += end - low;
+		}
+		hunk_lowcommit = low;
+	}
+
+	high = q_min ((hunk_high_used + HUNK_COMMITSTEP - 1) & ~(HUNK_COMMITSTEP - 1), hunk_size);
+	if (hunk_highcommit > high)
+	{
+		start = q_max (hunk_size - hunk_highcommit, hunk_lowcommit);
+		end = hunk_size - high;
+		if (end > start)
+		{
+			Sys_DecommitMemory (hunk_base + start, end - start);
+			released += end - start;
+		}
+		hunk_highcommit = high;
+	}
+
+	if (released)
+		Con_DPrintf ("Hunk_Trim: released %i KB\n", released / 1024);
 }
 
 /*
@@ -857,6 +1867,7 @@ void Cache_Free (cache_user_t *c, qboolean freetextures) //johnfitz -- added sec
 		Sys_Error ("Cache_Free: not allocated");
 
 	cs = ((cache_system_t *)c->data) - 1;
+	Mem_Charge (cs->tag, MEMPOOL_CACHE, -cs->size, -1);
 
 	cs->prev->next = cs->next;
 	cs->next->prev = cs->prev;
@@ -923,6 +1934,8 @@ void *Cache_Alloc (cache_user_t *c, int size, const char *name)
 			q_strlcpy (cs->name, name, CACHENAME_LEN);
 			c->data = (void *)(cs+1);
 			cs->user = c;
+			cs->tag = mem_tag;
+			Mem_Charge (mem_tag, MEMPOOL_CACHE, size, 1);
 			break;
 		}
 
@@ -939,37 +1952,242 @@ void *Cache_Alloc (cache_user_t *c, int size, const char *name)
 //============================================================================
 
 
+/*
+==============================================================================
+
+						MEMORY REPORTS
+
+==============================================================================
+*/
+
+/*
+========================
+Z_Fragmentation
+
+Share of the free zone memory that is not in its biggest free block
+========================
+*/
+static float Z_Fragmentation (memzone_t *zone, int *freebytes)
+{
+	freeblock_t	*fb;
+	int		fl, sl, largest;
+
+	*freebytes = zone->size - (int)sizeof(memzone_t) - zone->used;
+	if (!zone->flmap || *freebytes <= 0)
+		return 0;
+
+	fl = Z_HighBit (zone->flmap);
+	sl = Z_HighBit (zone->slmap[fl]);
+	largest = 0;
+	for (fb = zone->freelists[fl][sl]; fb; fb = fb->nextfree)
+		largest = q_max (largest, fb->block.size);
+
+	return 1.0f - (float)largest / *freebytes;
+}
+
+/*
+========================
+Cache_Fragmentation
+
+Share of the memory between the low and high hunk that is neither cached
+nor in the biggest gap between cache blocks
+========================
+*/
+static float Cache_Fragmentation (int *freebytes)
+{
+	cache_system_t	*cs;
+	byte	*start, *end;
+	int		gap, largest;
+
+	start = hunk_base + hunk_low_used;
+	end = Cache_Top (hunk_high_used);
+	*freebytes = largest = 0;
+	for (cs = cache_head.next; ; cs = cs->next)
+	{
+		gap = ((cs == &cache_head) ? end : (byte *)cs) - start;
+		*freebytes += gap;
+		largest = q_max (largest, gap);
+		if (cs == &cache_head)
+			break;
+		start = (byte *)cs + cs->size;
+	}
+
+	if (*freebytes <= 0)
+		return 0;
+	return 1.0f - (float)largest / *freebytes;
+}
+
+static int Mem_TagBytes (int tag)
+{
+	int		i, sum;
+
+	for (i = sum = 0; i < MEM_NUMPOOLS; i++)
+		sum += mem_stats[tag].bytes[i];
+	return sum;
+}
+
+/*
+========================
+Mem_Stats_f
+========================
+*/
+static void Mem_Stats_f (void)
+{
+	memstats_t	*s;
+	int		i, j, freebytes, count;
+	float	frag;
+
+	Con_Printf ("tag            hunk     zone    cache   malloc     total      peak count\n");
+	for (i = 0, count = 0; i < MEM_NUMTAGS; i++)
+	{
+		s = &mem_stats[i];
+		Con_Printf ("%-10s", mem_tagnames[i]);
+		for (j = 0; j < MEM_NUMPOOLS; j++)
+			Con_Printf (" %8i", s->bytes[j]);
+		Con_Printf (" %9i %9i %5i\n", Mem_TagBytes (i), s->peak, s->count);
+		count += s->count;
+	}
+	Con_Printf ("%-10s", "total");
+	for (j = 0; j < MEM_NUMPOOLS; j++)
+		Con_Printf (" %8i", mem_poolbytes[j]);
+	Con_Printf (" %9i %9s %5i\n", mem_poolbytes[0] + mem_poolbytes[1] + mem_poolbytes[2] + mem_poolbytes[3], "", count);
+	Con_Printf ("%-10s", "peak");
+	for (j = 0; j < MEM_NUMPOOLS; j++)
+		Con_Printf (" %8i", mem_poolpeak[j]);
+	Con_Printf ("\n\n");
+
+	Con_Printf ("hunk:  %i low, %i high, %i of %i free, %i most ever used\n",
+		hunk_low_used, hunk_high_used, hunk_size - hunk_low_used - hunk_high_used, hunk_size, hunk_peak);
+	if (hunk_reserved)
+		Con_Printf ("       %i committed low, %i committed high\n", hunk_lowcommit, hunk_highcommit);
+	frag = Z_Fragmentation (mainzone, &freebytes);
+	Con_Printf ("zone:  %i of %i free, %i most ever used, %.1f%% fragmented\n",
+		freebytes, mainzone->size, mainzone->peak, frag * 100);
+	frag = Cache_Fragmentation (&freebytes);
+	Con_Printf ("cache: %i free, %.1f%% fragmented\n", freebytes, frag * 100);
+	for (i = 0; i <= FRAME_NUMARENAS; i++)
+	{
+		arena_t	*a = (i < FRAME_NUMARENAS) ? &frame_arenas[i] : &frame_temp;
+		Con_Printf ("arena %-6s %i used, %i in the last frame, %i most in a frame\n",
+			a->name, a->current ? a->current->start + a->used : 0, a->lastframe, q_max (a->peak, a->high));
+	}
+}
+
+/*
+========================
+Mem_CSV_f
+
+memstats_csv <file> | stop
+========================
+*/
+static void Mem_CSV_f (void)
+{
+	char	name[MAX_OSPATH];
+	int		i;
+
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf ("memstats_csv <file> : write memory use to file every frame\n");
+		Con_Printf ("memstats_csv stop   : stop writing\n");
+		return;
+	}
+
+	if (mem_csvfile)
+	{
+		fclose (mem_csvfile);
+		mem_csvfile = NULL;
+		Con_Printf ("memstats_csv stopped\n");
+	}
+	if (!strcmp (Cmd_Argv(1), "stop"))
+		return;
+
+	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
+	COM_AddExtension (name, ".csv", sizeof(name));
+	mem_csvfile = fopen (name, "w");
+	if (!mem_csvfile)
+	{
+		Con_Printf ("memstats_csv: couldn't create %s\n", name);
+		return;
+	}
+
+	fprintf (mem_csvfile, "frame,time");
+	for (i = 0; i < MEM_NUMTAGS; i++)
+		fprintf (mem_csvfile, ",%s,%s_count", mem_tagnames[i], mem_tagnames[i]);
+	for (i = 0; i < MEM_NUMPOOLS; i++)
+		fprintf (mem_csvfile, ",%s_total", mem_poolnames[i]);
+	fprintf (mem_csvfile, ",hunk_low,hunk_high,zone_frag,cache_frag\n");
+	Con_Printf ("writing memory use to %s\n", name);
+}
+
+/*
+========================
+Mem_Frame
+
+Called at the end of every host frame
+========================
+*/
+void Mem_Frame (void)
+{
+	int		i, freebytes;
+
+	mem_tag = MEM_MISC;		// a Host_Error can leave a loader's tag set
+
+	if (!mem_csvfile)
+		return;
+
+	fprintf (mem_csvfile, "%i,%.4f", host_framecount, realtime);
+	for (i = 0; i < MEM_NUMTAGS; i++)
+		fprintf (mem_csvfile, ",%i,%i", Mem_TagBytes (i), mem_stats[i].count);
+	for (i = 0; i < MEM_NUMPOOLS; i++)
+		fprintf (mem_csvfile, ",%i", mem_poolbytes[i]);
+	fprintf (mem_csvfile, ",%i,%i", hunk_low_used, hunk_high_used);
+	fprintf (mem_csvfile, ",%.4f", Z_Fragmentation (mainzone, &freebytes));
+	fprintf (mem_csvfile, ",%.4f\n", Cache_Fragmentation (&freebytes));
+}
+
+//============================================================================
+
 static void Memory_InitZone (memzone_t *zone, int size)
 {
 	memblock_t	*block;
 
 // set the entire zone to one free block
 
+	memset (zone, 0, sizeof(memzone_t));
+	zone->size = size;
 	zone->blocklist.next = zone->blocklist.prev = block =
 		(memblock_t *)( (byte *)zone + sizeof(memzone_t) );
 	zone->blocklist.tag = 1;	// in use block
 	zone->blocklist.id = 0;
 	zone->blocklist.size = 0;
-	zone->rover = block;
 
 	block->prev = block->next = &zone->blocklist;
 	block->tag = 0;			// free block
 	block->id = ZONEID;
-	block->size = size - sizeof(memzone_t);
+	block->size = (size - sizeof(memzone_t)) & ~7;
+	Z_LinkFree (zone, block);
 }
 
 /*
 ========================
 Memory_Init
+
+buf holds size bytes, or if reserved is not 0, is an address range of that
+many bytes that Sys_ReserveMemory set aside and that is committed as it
+is used. size then only sets how much of it the cache gets.
 ========================
 */
-void Memory_Init (void *buf, int size)
+void Memory_Init (void *buf, int size, int reserved)
 {
 	int p;
 	int zonesize = DYNAMIC_SIZE;
 
 	hunk_base = (byte *) buf;
-	hunk_size = size;
+	hunk_reserved = (reserved > 0);
+	hunk_size = hunk_reserved ? reserved : size;
+	hunk_cachesize = size;
+	hunk_lowcommit = 0;
+	hunk_highcommit = 0;
 	hunk_low_used = 0;
 	hunk_high_used = 0;
 
@@ -985,6 +2203,16 @@ void Memory_Init (void *buf, int size)
 	mainzone = (memzone_t *) Hunk_AllocName (zonesize, "zone" );
 	Memory_InitZone (mainzone, zonesize);
 
+// what is in the zone is charged as it is allocated, not the zone itself
+	((hunk_t *)mainzone - 1)->tag = -1;
+	memset (mem_stats, 0, sizeof(mem_stats));
+	memset (mem_poolbytes, 0, sizeof(mem_poolbytes));
+	memset (mem_poolpeak, 0, sizeof(mem_poolpeak));
+
 	Cmd_AddCommand ("hunk_print", Hunk_Print_f); //johnfitz
+	Cmd_AddCommand ("zone_trace", Z_Trace_f);
+	Cmd_AddCommand ("zone_bench", Z_Bench_f);
+	Cmd_AddCommand ("memstats", Mem_Stats_f);
+	Cmd_AddCommand ("memstats_csv", Mem_CSV_f);
 }
 
@@ -89,7 +89,7 @@ Zone block
 
 */
 
-void Memory_Init (void *buf, int size);
+void Memory_Init (void *buf, int size, int reserved);
 
 void Z_Free (void *ptr);
 void *Z_Malloc (int size);			// returns 0 filled memory
@@ -103,11 +103,27 @@ char *Hunk_Strdup (const char *s, const char *name);
 
 int	Hunk_LowMark (void);
 void Hunk_FreeToLowMark (int mark);
+void Hunk_Trim (void);		// gives unused pages of a reserved hunk back
 
 int	Hunk_HighMark (void);
 void Hunk_FreeToHighMark (int mark);
 
-void *Hunk_TempAlloc (int size);
+void *Hunk_TempAlloc (int size);	// lasts until the next call
+
+// bump allocated memory that lasts until the end of the frame: the server
+// arena is reset after each server frame, the client arena at the end of
+// each host frame
+typedef enum
+{
+	FRAME_CLIENT,
+	FRAME_SERVER,
+	FRAME_NUMARENAS
+} framearena_t;
+
+void *Frame_Alloc (framearena_t arena, int size);	// not 0 filled
+int Frame_LowMark (framearena_t arena);
+void Frame_FreeToLowMark (framearena_t arena, int mark);
+void Frame_Reset (framearena_t arena);
 
 void Hunk_Check (void);
 
@@ -130,5 +146,30 @@ void *Cache_Alloc (cache_user_t *c, int size, const char *name);
 
 void Cache_Report (void);
 
+// every hunk, zone, cache and Mem_Alloc allocation is charged to a
+// subsystem, the one in mem_tag at the time for all but Mem_Alloc.
+// Loaders set it with Mem_SetTag and put back what it returned.
+typedef enum
+{
+	MEM_MISC,
+	MEM_MODELS,
+	MEM_TEXTURES,
+	MEM_SOUNDS,
+	MEM_QC,
+	MEM_NET,
+	MEM_PARTICLES,
+	MEM_NUMTAGS
+} memtag_t;
+
+extern	memtag_t	mem_tag;
+
+memtag_t Mem_SetTag (memtag_t tag);
+
+void *Mem_Alloc (memtag_t tag, int size);	// returns 0 filled memory, NULL if there is none
+void *Mem_Realloc (memtag_t tag, void *ptr, int size);
+void Mem_Free (void *ptr);
+
+void Mem_Frame (void);
+
 #endif	/* __ZZONE_H */
 